@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "resp_client.hpp"
+#include "server_process.hpp"
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double seconds_since(BenchClock::time_point start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// Send commands depth at a time, reading each group's replies before the
+// next group goes out, as a client with that many requests in flight
+// would. Throws on an error reply.
+inline void pipeline(RespClient& client, const std::vector<std::vector<std::string>>& commands, size_t depth) {
+    std::string batch;
+    for (size_t i = 0; i < commands.size(); i += depth) {
+        size_t end = std::min(commands.size(), i + depth);
+        batch.clear();
+        for (size_t j = i; j < end; j++) RespClient::encode(batch, commands[j]);
+        client.send_raw(batch);
+        for (size_t j = i; j < end; j++) {
+            RespReply reply = client.read();
+            if (reply.is_error()) throw std::runtime_error(commands[j][0] + ": " + reply.str);
+        }
+    }
+}
+
+// Resident set size of a process, from /proc
+inline size_t rss_bytes(pid_t pid) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) return std::stoull(line.substr(6)) * 1024;
+    }
+    return 0;
+}
+
+// p in [0, 1] of samples, which it sorts
+inline double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+}
+
+// Benchmarks take the server binary and an optional size
+inline size_t bench_args(int argc, char** argv, std::string& binary, size_t default_size) {
+    if (argc < 2 || argc > 3) {
+        std::fprintf(stderr, "usage: %s <server binary> [n]\n", argv[0]);
+        std::exit(2);
+    }
+    binary = argv[1];
+    return argc == 3 ? std::stoull(argv[2]) : default_size;
+}
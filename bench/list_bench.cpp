@@ -0,0 +1,58 @@
+// List push/pop throughput and memory per element for a few quicklist
+// layouts: RPUSH n elements one command at a time, read MEMORY USAGE and
+// the server's RSS growth, then LPOP them all. One client, pipeline 100.
+//
+// Usage: list_bench <path to server binary> [elements, default 1000000]
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+struct Layout {
+    const char* name;
+    std::vector<std::string> args;
+};
+
+int main(int argc, char** argv) {
+    std::string binary;
+    size_t n = bench_args(argc, argv, binary, 1000000);
+    const size_t depth = 100;
+
+    const Layout layouts[] = {
+        {"default (8 KB nodes)", {}},
+        {"fill 128 entries", {"--list-max-listpack-size", "128"}},
+        {"8 KB nodes, compress 1", {"--list-compress-depth", "1"}},
+    };
+
+    std::vector<std::vector<std::string>> pushes, pops(n, {"LPOP", "list"});
+    pushes.reserve(n);
+    for (size_t i = 0; i < n; i++) pushes.push_back({"RPUSH", "list", "job:" + std::to_string(i) + ":payload"});
+
+    std::filesystem::path dir = make_temp_dir("list-bench");
+    std::printf("%zu elements, pipeline %zu\n", n, depth);
+    std::printf("%-24s %12s %12s %12s %12s\n", "layout", "push/s", "pop/s", "B/element", "RSS B/elem");
+    for (const auto& layout : layouts) {
+        ServerProcess server(binary, free_port(), dir, layout.args);
+        RespClient client(server.port());
+        size_t rss_before = rss_bytes(server.pid());
+
+        auto start = BenchClock::now();
+        pipeline(client, pushes, depth);
+        double push_time = seconds_since(start);
+
+        double usage = static_cast<double>(client.call({"MEMORY", "USAGE", "list"}).integer) / n;
+        double rss = (static_cast<double>(rss_bytes(server.pid())) - rss_before) / n;
+
+        start = BenchClock::now();
+        pipeline(client, pops, depth);
+        double pop_time = seconds_since(start);
+
+        std::printf("%-24s %11.0fk %11.0fk %12.1f %12.1f\n", layout.name, n / push_time / 1000, n / pop_time / 1000,
+                    usage, rss);
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,66 @@
+// One 100-key MGET against 100 GETs sent as one pipelined batch. Loads n
+// keys with 50-byte values, then times batches of 100 random keys fetched
+// either way, one batch in flight at a time, over loopback.
+//
+// Usage: mget_bench <path to server binary> [keys, default 2000000]
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+int main(int argc, char** argv) {
+    std::string binary;
+    size_t n = bench_args(argc, argv, binary, 2000000);
+    const size_t batch = 100;
+    const size_t rounds = 20000;
+
+    std::filesystem::path dir = make_temp_dir("mget-bench");
+    ServerProcess server(binary, free_port(), dir);
+    RespClient client(server.port());
+
+    std::string value(50, 'v');
+    std::vector<std::vector<std::string>> sets;
+    sets.reserve(n);
+    for (size_t i = 0; i < n; i++) sets.push_back({"SET", "key:" + std::to_string(i), value});
+    pipeline(client, sets, 1000);
+    sets.clear();
+
+    std::mt19937_64 rng(1);
+    std::vector<double> mget_us, get_us;
+    std::string request;
+    for (size_t round = 0; round < rounds; round++) {
+        // Fresh random keys each way, so neither finds the other's in cache
+        std::vector<std::string> mget = {"MGET"};
+        for (size_t i = 0; i < batch; i++) mget.push_back("key:" + std::to_string(rng() % n));
+        request.clear();
+        for (size_t i = 0; i < batch; i++) RespClient::encode(request, {"GET", "key:" + std::to_string(rng() % n)});
+
+        auto start = BenchClock::now();
+        RespReply reply = client.call(mget);
+        mget_us.push_back(seconds_since(start) * 1e6);
+        if (reply.elements.size() != batch) throw std::runtime_error("MGET: short reply");
+
+        start = BenchClock::now();
+        client.send_raw(request);
+        for (size_t i = 0; i < batch; i++) {
+            if (client.read().type != RespReply::Type::Bulk) throw std::runtime_error("GET: unexpected reply");
+        }
+        get_us.push_back(seconds_since(start) * 1e6);
+    }
+
+    std::printf("%zu keys, %zu batches of %zu\n", n, rounds, batch);
+    std::printf("%-24s %10s %10s %10s\n", "", "p50 us", "p99 us", "batches/s");
+    for (auto [name, samples] : {std::pair{"MGET", &mget_us}, std::pair{"pipelined GETs", &get_us}}) {
+        double total = 0;
+        for (double us : *samples) total += us;
+        double p50 = percentile(*samples, 0.5), p99 = percentile(*samples, 0.99);
+        std::printf("%-24s %10.1f %10.1f %10.0f\n", name, p50, p99, samples->size() / total * 1e6);
+    }
+    server.stop();
+    std::filesystem::remove_all(dir);
+    return 0;
+}
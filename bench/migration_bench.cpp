@@ -0,0 +1,101 @@
+// Slot migration throughput: two cluster nodes on loopback, n small string
+// keys in one slot of the first, moved to the second with CLUSTER
+// MIGRATESLOT at a few BATCH/PIPELINE settings. A reader thread keeps
+// issuing GETs for keys in the slot while it moves, following ASK and
+// MOVED, and reports their latency.
+//
+// Usage: migration_bench <path to server binary> [keys, default 1000000]
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+
+// Hash slot of "{user1000}", owned by the first node
+static const char* SLOT = "3443";
+
+struct Setting {
+    const char* batch;
+    const char* pipeline;
+};
+
+int main(int argc, char** argv) {
+    std::string binary;
+    size_t n = bench_args(argc, argv, binary, 1000000);
+    const Setting settings[] = {{"1", "1"}, {"100", "8"}};
+
+    std::printf("%zu keys in one slot\n", n);
+    std::printf("%-22s %10s %10s %8s %10s %10s %10s\n", "setting", "keys/s", "seconds", "retried", "GETs", "p50 ms",
+                "p99 ms");
+    for (const auto& setting : settings) {
+        std::filesystem::path dir = make_temp_dir("migration-bench");
+        std::filesystem::create_directories(dir / "a");
+        std::filesystem::create_directories(dir / "b");
+        int port_a = free_port(), port_b = free_port();
+        std::ofstream(dir / "nodes.conf") << "aaaa 127.0.0.1:" << port_a << " master 0-8191\n"
+                                          << "bbbb 127.0.0.1:" << port_b << " master 8192-16383\n";
+        auto node_args = [&](const char* id) {
+            return std::vector<std::string>{"--cluster-enabled", "yes", "--cluster-config-file",
+                                            (dir / "nodes.conf").string(), "--cluster-node-id", id};
+        };
+        ServerProcess a(binary, port_a, dir / "a", node_args("aaaa"));
+        ServerProcess b(binary, port_b, dir / "b", node_args("bbbb"));
+
+        {
+            RespClient loader(port_a);
+            std::vector<std::vector<std::string>> sets;
+            sets.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                sets.push_back({"SET", "{user1000}k" + std::to_string(i), "value" + std::to_string(i % 1000)});
+            }
+            pipeline(loader, sets, 1000);
+        }
+
+        std::atomic<bool> stop{false};
+        std::vector<double> latencies;
+        std::thread reader([&] {
+            RespClient from_a(port_a), from_b(port_b);
+            for (size_t i = 0; !stop; i += 7919) {
+                std::string key = "{user1000}k" + std::to_string(i % n);
+                auto start = BenchClock::now();
+                RespReply reply = from_a.call({"GET", key});
+                if (reply.is_error() && reply.str.rfind("ASK ", 0) == 0) {
+                    from_b.send({"ASKING"});
+                    from_b.send({"GET", key});
+                    from_b.read();
+                    reply = from_b.read();
+                } else if (reply.is_error() && reply.str.rfind("MOVED ", 0) == 0) {
+                    reply = from_b.call({"GET", key});
+                }
+                if (reply.type != RespReply::Type::Bulk) {
+                    std::fprintf(stderr, "GET %s: unexpected reply %s\n", key.c_str(), reply.str.c_str());
+                }
+                latencies.push_back(seconds_since(start) * 1000);
+            }
+        });
+
+        RespClient admin(port_a);
+        auto start = BenchClock::now();
+        RespReply result = admin.call({"CLUSTER", "MIGRATESLOT", SLOT, "bbbb", "BATCH", setting.batch, "PIPELINE",
+                                       setting.pipeline});
+        double elapsed = seconds_since(start);
+        stop = true;
+        reader.join();
+        if (result.is_error()) throw std::runtime_error("MIGRATESLOT: " + result.str);
+
+        std::string name = std::string("BATCH ") + setting.batch + " PIPELINE " + setting.pipeline;
+        size_t gets = latencies.size();
+        double p50 = percentile(latencies, 0.5), p99 = percentile(latencies, 0.99);
+        std::printf("%-22s %9.1fk %10.1f %8lld %10zu %10.3f %10.3f\n", name.c_str(), n / elapsed / 1000, elapsed,
+                    static_cast<long long>(result.elements[3].integer), gets, p50, p99);
+        a.stop();
+        b.stop();
+        std::filesystem::remove_all(dir);
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Sorted set index comparison, skiplist against B+tree. First the two
+// index structures alone, without the network: insert, a range of 100 at
+// a random rank and a full scan. Then a server per --zset-large-encoding,
+// loaded with n "player:N" members at random scores by pipelined ZADD,
+// measuring memory per member and the common queries. One client.
+//
+// Usage: zset_bench <path to server binary> [members, default 1000000]
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "bplustree.hpp"
+#include "skiplist.hpp"
+
+static volatile double sink;
+
+// Time count runs of one random command, pipeline deep; commands/s
+template <typename F>
+static double rate(RespClient& client, size_t count, size_t depth, F&& make) {
+    std::vector<std::vector<std::string>> commands;
+    commands.reserve(count);
+    for (size_t i = 0; i < count; i++) commands.push_back(make());
+    auto start = BenchClock::now();
+    pipeline(client, commands, depth);
+    return count / seconds_since(start);
+}
+
+static void bench_indexes(size_t n) {
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> score(0, 1e9);
+    std::vector<std::string> members;
+    std::vector<double> scores;
+    members.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        members.push_back("player:" + std::to_string(i));
+        scores.push_back(score(rng));
+    }
+    std::vector<size_t> ranks(10000);
+    for (auto& rank : ranks) rank = rng() % (n > 100 ? n - 100 : 1);
+
+    SkipList skiplist;
+    BPlusTree btree;
+    auto start = BenchClock::now();
+    for (size_t i = 0; i < n; i++) skiplist.insert(scores[i], &members[i]);
+    double skiplist_insert = seconds_since(start);
+    start = BenchClock::now();
+    for (size_t i = 0; i < n; i++) btree.insert(scores[i], &members[i]);
+    double btree_insert = seconds_since(start);
+
+    start = BenchClock::now();
+    for (size_t rank : ranks) {
+        SkipList::Node* node = skiplist.at_rank(rank);
+        for (int i = 0; i < 100 && node; i++, node = node->next()) sink = node->score;
+    }
+    double skiplist_range = seconds_since(start);
+    start = BenchClock::now();
+    for (size_t rank : ranks) {
+        BPlusTree::Cursor cursor = btree.at_rank(rank);
+        for (int i = 0; i < 100 && cursor.valid(); i++, cursor.next()) sink = cursor.score();
+    }
+    double btree_range = seconds_since(start);
+
+    start = BenchClock::now();
+    for (SkipList::Node* node = skiplist.first(); node; node = node->next()) sink = node->score;
+    double skiplist_scan = seconds_since(start);
+    start = BenchClock::now();
+    for (BPlusTree::Cursor cursor = btree.at_rank(0); cursor.valid(); cursor.next()) sink = cursor.score();
+    double btree_scan = seconds_since(start);
+
+    std::printf("%-28s %12s %12s\n", ("index alone, " + std::to_string(n)).c_str(), "skiplist", "btree");
+    std::printf("  %-26s %12.0f %12.0f\n", "insert ns/member", skiplist_insert / n * 1e9, btree_insert / n * 1e9);
+    std::printf("  %-26s %12.2f %12.2f\n", "range of 100 us", skiplist_range / ranks.size() * 1e6,
+                btree_range / ranks.size() * 1e6);
+    std::printf("  %-26s %12.1f %12.1f\n", "full scan ns/member", skiplist_scan / n * 1e9, btree_scan / n * 1e9);
+    std::printf("  %-26s %12.1f %12.1f\n", "index B/member", static_cast<double>(skiplist.memory_usage()) / n,
+                static_cast<double>(btree.memory_usage()) / n);
+}
+
+struct ServerResult {
+    double zadd, usage, rss, byscore, top, zrank, zincrby;
+};
+
+static ServerResult bench_server(const std::string& binary, const std::string& encoding, size_t n) {
+    std::filesystem::path dir = make_temp_dir("zset-bench");
+    ServerProcess server(binary, free_port(), dir, {"--zset-large-encoding", encoding});
+    RespClient client(server.port());
+    std::mt19937_64 rng(2);
+    auto random_score = [&] { return std::to_string(rng() % 1000000000); };
+    auto random_member = [&] { return "player:" + std::to_string(rng() % n); };
+
+    ServerResult result;
+    size_t rss_before = rss_bytes(server.pid());
+    size_t i = 0;
+    result.zadd = rate(client, n, 200, [&] {
+        return std::vector<std::string>{"ZADD", "lb", random_score(), "player:" + std::to_string(i++)};
+    });
+    result.usage = static_cast<double>(client.call({"MEMORY", "USAGE", "lb"}).integer) / n;
+    result.rss = (static_cast<double>(rss_bytes(server.pid())) - rss_before) / n;
+    result.byscore = rate(client, 20000, 1, [&] {
+        return std::vector<std::string>{"ZRANGE", "lb", random_score(), "+inf", "BYSCORE", "LIMIT", "0", "100"};
+    });
+    result.top = rate(client, 20000, 1, [&] {
+        return std::vector<std::string>{"ZRANGE", "lb", "0", "99", "REV", "WITHSCORES"};
+    });
+    result.zrank = rate(client, 50000, 1, [&] { return std::vector<std::string>{"ZRANK", "lb", random_member()}; });
+    result.zincrby = rate(client, 300000, 64, [&] {
+        return std::vector<std::string>{"ZINCRBY", "lb", random_score(), random_member()};
+    });
+    server.stop();
+    std::filesystem::remove_all(dir);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    std::string binary;
+    size_t n = bench_args(argc, argv, binary, 1000000);
+
+    bench_indexes(n);
+
+    ServerResult skiplist = bench_server(binary, "skiplist", n);
+    ServerResult btree = bench_server(binary, "btree", n);
+    std::printf("\n%-28s %12s %12s\n", ("server, " + std::to_string(n)).c_str(), "skiplist", "btree");
+    std::printf("  %-26s %11.0fk %11.0fk\n", "ZADD load, pipeline 200/s", skiplist.zadd / 1000, btree.zadd / 1000);
+    std::printf("  %-26s %12.1f %12.1f\n", "MEMORY USAGE B/member", skiplist.usage, btree.usage);
+    std::printf("  %-26s %12.1f %12.1f\n", "RSS B/member", skiplist.rss, btree.rss);
+    std::printf("  %-26s %11.1fk %11.1fk\n", "BYSCORE LIMIT 100/s", skiplist.byscore / 1000, btree.byscore / 1000);
+    std::printf("  %-26s %11.1fk %11.1fk\n", "top 100 REV/s", skiplist.top / 1000, btree.top / 1000);
+    std::printf("  %-26s %11.1fk %11.1fk\n", "ZRANK/s", skiplist.zrank / 1000, btree.zrank / 1000);
+    std::printf("  %-26s %11.0fk %11.0fk\n", "ZINCRBY, pipeline 64/s", skiplist.zincrby / 1000, btree.zincrby / 1000);
+    return 0;
+}
@@ -1,157 +1,593 @@
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 #include <string>
 #include <cstring>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <thread>
 #include <vector>
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include <chrono>
+#include <charconv>
+#include <strings.h>
 
-const int BUFFER_SIZE = 1024;
-
-// Structure to hold value and expiry time
-struct ValueWithExpiry {
-    std::string value;
-    std::chrono::time_point<std::chrono::steady_clock> expiry;
-    bool has_expiry;
-    
-    ValueWithExpiry(const std::string& val) : 
-        value(val), has_expiry(false) {}
-    
-    ValueWithExpiry(const std::string& val, long px_millis) : 
-        value(val), 
-        expiry(std::chrono::steady_clock::now() + std::chrono::milliseconds(px_millis)),
-        has_expiry(true) {}
-        
-    bool is_expired() const {
-        if (!has_expiry) return false;
-        return std::chrono::steady_clock::now() > expiry;
-    }
-};
+#include "bitops.hpp"
+#include "blocking.hpp"
+#include "bloom.hpp"
+#include "cluster.hpp"
+#include "expire.hpp"
+#include "geo.hpp"
+#include "hash.hpp"
+#include "hyperloglog.hpp"
+#include "list.hpp"
+#include "migrate.hpp"
+#include "multi.hpp"
+#include "net.hpp"
+#include "pubsub.hpp"
+#include "rdb.hpp"
+#include "replication.hpp"
+#include "resp.hpp"
+#include "script.hpp"
+#include "server.hpp"
+#include "set.hpp"
+#include "store.hpp"
+#include "stream.hpp"
+#include "string.hpp"
+#include "util.hpp"
+#include "zset.hpp"
+
+const int BUFFER_SIZE = 16 * 1024;
 
 // Global key-value store with mutex for thread safety
-std::unordered_map<std::string, ValueWithExpiry> kv_store;
-std::mutex kv_mutex;
+Keyspace kv_store;
+Dict<std::monostate> kv_expires;
+std::shared_mutex kv_mutex;
 
-// Parse RESP array and return vector of strings
-std::vector<std::string> parse_resp(const std::string& input) {
-    std::vector<std::string> parts;
-    std::istringstream iss(input);
-    std::string line;
-    
-    // First line should be array length
-    std::getline(iss, line);
-    if (line[0] != '*') return parts;
-    
-    int array_len = std::stoi(line.substr(1));
-    
-    for (int i = 0; i < array_len; i++) {
-        // Get bulk string length
-        std::getline(iss, line);
-        if (line[0] != '$') continue;
-        
-        // Get actual string
-        std::getline(iss, line);
-        parts.push_back(line);
-    }
-    
-    return parts;
-}
-
-// Convert string to uppercase for case-insensitive comparison
-std::string to_upper(const std::string& str) {
-    std::string upper = str;
-    for (char& c : upper) {
-        c = toupper(c);
-    }
-    return upper;
+ServerConfig server_config;
+
+// Command name (uppercase) to its spec, filled before any client connects
+static std::unordered_map<std::string, Command> command_table;
+
+void register_command(const Command& command) {
+    command_table[command.name] = command;
+}
+
+std::vector<size_t> command_key_positions(const Command& command, const std::vector<std::string>& parts) {
+    if (command.get_keys) return command.get_keys(parts);
+
+    std::vector<size_t> positions;
+    if (command.first_key <= 0) return positions;
+
+    size_t argc = parts.size();
+    int last = command.last_key >= 0 ? command.last_key : static_cast<int>(argc) + command.last_key;
+    for (int i = command.first_key; i <= last && i < static_cast<int>(argc); i += command.key_step) {
+        positions.push_back(i);
+    }
+    return positions;
+}
+
+const Command* lookup_command(const std::vector<std::string>& parts, std::string& error) {
+    if (parts.empty()) {
+        error = "-ERR empty command\r\n";
+        return nullptr;
+    }
+
+    auto it = command_table.find(to_upper(parts[0]));
+    if (it == command_table.end()) {
+        error = "-ERR unknown command\r\n";
+        return nullptr;
+    }
+
+    const Command& command = it->second;
+    int argc = static_cast<int>(parts.size());
+    if ((command.arity > 0 && argc != command.arity) || (command.arity < 0 && argc < -command.arity)) {
+        error = "-ERR wrong number of arguments for '" + parts[0] + "' command\r\n";
+        return nullptr;
+    }
+    return &command;
+}
+
+std::string handle_command_locked(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const Command* command = lookup_command(parts, error);
+    if (!command) return error;
+
+    if (server_config.cluster_enabled) {
+        std::string redirect = cluster_route(*command, parts, client);
+        if (!redirect.empty()) return redirect;
+    }
+
+    bool is_write = command->flags & CMD_WRITE;
+    bool is_replica = replication_is_replica();
+    if (is_write && !client.is_master && is_replica && server_config.replica_read_only) {
+        return "-READONLY You can't write against a read only replica.\r\n";
+    }
+
+    std::string response = command->handler(parts, client);
+    // Give back buckets once deletes have left the keyspace mostly empty
+    if (is_write) {
+        kv_store.shrink();
+        kv_expires.shrink();
+    }
+
+    // An error, or a handler propagating nothing, means nothing changed
+    bool changed = is_write && (response.empty() || response[0] != '-') &&
+                   !(client.propagate_as && client.propagate_as->empty());
+    if (changed) {
+        touch_keys(*command, parts);
+        signal_keys(*command, parts);
+    }
+
+    // Writes from our own master are forwarded byte for byte by the replication
+    // link, and local writes on a writable replica stay local
+    if (changed && !is_replica) {
+        if (client.propagate_as) {
+            for (const auto& rewritten : *client.propagate_as) client.woff = replication_propagate(rewritten);
+        } else {
+            client.woff = replication_propagate(parts);
+        }
+    }
+    client.propagate_as.reset();
+    return response;
+}
+
+// Delete keys a read command found expired, and tell replicas. Replicas
+// keep hiding such keys until their master's DEL arrives.
+static void delete_expired_keys(ClientContext& client) {
+    if (!replication_is_replica()) {
+        std::lock_guard<std::shared_mutex> lock(kv_mutex);
+        for (const auto& key : client.expired_keys) {
+            auto it = kv_store.find(key);
+            if (it != kv_store.end() && it->second.is_expired()) {
+                kv_store.erase(it);
+                kv_expires.erase(key);
+                replication_propagate({"DEL", key});
+            }
+        }
+        kv_store.shrink();
+        kv_expires.shrink();
+    }
+    client.expired_keys.clear();
+}
+
+// Run a command under the lock its flags ask for
+static std::string run_command(const Command& command, const std::vector<std::string>& parts,
+                               ClientContext& client) {
+    std::string response;
+    if (!(command.flags & (CMD_WRITE | CMD_MAY_WRITE | CMD_READONLY))) {
+        // Shard channels go to their slot's owner without touching keys
+        if (server_config.cluster_enabled && (command.flags & CMD_SHARD_CHANNEL)) {
+            std::string redirect = cluster_route(command, parts, client);
+            if (!redirect.empty()) return redirect;
+        }
+        response = command.handler(parts, client);
+    } else if (command.flags & (CMD_WRITE | CMD_MAY_WRITE)) {
+        std::lock_guard<std::shared_mutex> lock(kv_mutex);
+        response = handle_command_locked(parts, client);
+    } else {
+        // Reads only share the lock, so replicas serve GETs in parallel
+        // with each other and with the replication link between writes
+        std::shared_lock<std::shared_mutex> lock(kv_mutex);
+        response = handle_command_locked(parts, client);
+    }
+
+    if (!client.expired_keys.empty()) {
+        delete_expired_keys(client);
+    }
+    if (!client.hll_stale_keys.empty()) {
+        hll_refresh_cache(client);
+    }
+    return response;
 }
 
 // Handle different commands
-std::string handle_command(const std::vector<std::string>& parts) {
-    if (parts.empty()) return "-ERR empty command\r\n";
-    
+std::string handle_command(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const Command* command = lookup_command(parts, error);
+    if (!command) {
+        // A command rejected inside MULTI fails the whole transaction
+        if (client.in_multi) client.multi_error = true;
+        return error;
+    }
+    if (!(command->flags & CMD_PUBSUB) && pubsub_subscriptions(client) > 0) {
+        std::string name = parts[0];
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        return "-ERR Can't execute '" + name +
+               "': only (P|S)SUBSCRIBE / (P|S)UNSUBSCRIBE / PING / QUIT / RESET are allowed in this context\r\n";
+    }
+    if (client.in_multi && (command->flags & CMD_NO_MULTI)) {
+        client.multi_error = true;
+        return "-ERR Command not allowed inside a transaction\r\n";
+    }
+    if (client.in_multi && !(command->flags & CMD_NO_QUEUE)) {
+        return multi_queue_command(*command, parts, client);
+    }
+
+    // A blocking command that found nothing to serve has parked the client
+    // on its keys. It runs again whenever one of them is written, and its
+    // last reply stands once the timeout passes.
+    client.may_block = command->flags & CMD_BLOCKING;
+    std::string response = run_command(*command, parts, client);
+    while (blocking_wait(client)) response = run_command(*command, blocking_command(client, parts), client);
+    client.may_block = false;
+    return response;
+}
+
+ValueWithExpiry* lookup_key_read(const std::string& key, ClientContext& client) {
+    auto it = kv_store.find(key);
+    if (it == kv_store.end()) return nullptr;
+    if (it->second.is_expired()) {
+        // Removed once the read lock is released
+        client.expired_keys.push_back(key);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+ValueWithExpiry* lookup_key_write(const std::string& key) {
+    auto it = kv_store.find(key);
+    if (it == kv_store.end()) return nullptr;
+    if (it->second.is_expired()) {
+        kv_store.erase(it);
+        kv_expires.erase(key);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+const char* value_type_name(ValueType type) {
+    switch (type) {
+    case ValueType::String: return "string";
+    case ValueType::List: return "list";
+    case ValueType::Hash: return "hash";
+    case ValueType::Set: return "set";
+    case ValueType::ZSet: return "zset";
+    case ValueType::Stream: return "stream";
+    // The names RedisBloom gives its types, which its clients check for
+    case ValueType::Bloom: return "MBbloom--";
+    case ValueType::Cuckoo: return "MBbloomCF";
+    }
+    return "none";
+}
+
+static std::string cmd_ping(const std::vector<std::string>& parts, ClientContext& client) {
+    // A subscribed client gets replies shaped like messages
+    if (pubsub_subscriptions(client) > 0) {
+        std::string reply = resp_array_header(2);
+        resp_append_bulk(reply, "pong");
+        resp_append_bulk(reply, parts.size() > 1 ? parts[1] : "");
+        return reply;
+    }
+    return "+PONG\r\n";
+}
+
+static std::string cmd_echo(const std::vector<std::string>& parts, ClientContext& client) {
+    return resp_bulk(parts[1]);
+}
+
+static std::string cmd_del(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t deleted = 0;
+    for (size_t i = 1; i < parts.size(); i++) {
+        auto it = kv_store.find(parts[i]);
+        if (it == kv_store.end()) continue;
+        if (!it->second.is_expired()) deleted++;
+        if (it->second.has_expiry) kv_expires.erase(parts[i]);
+        kv_store.erase(it);
+    }
+    return resp_integer(deleted);
+}
+
+static std::string cmd_type(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    return resp_simple(value ? value_type_name(value->type) : "none");
+}
+
+// MEMORY USAGE key: bytes held by a key and its value, including the
+// keyspace entry itself
+static std::string cmd_memory(const std::vector<std::string>& parts, ClientContext& client) {
+    if (to_upper(parts[1]) != "USAGE" || (parts.size() != 3 && parts.size() != 5)) {
+        return "-ERR unknown subcommand or wrong number of arguments for '" + parts[1] + "'\r\n";
+    }
+
+    ValueWithExpiry* value = lookup_key_read(parts[2], client);
+    if (!value) return resp_null();
+
+    size_t bytes = sizeof(std::pair<const std::string, ValueWithExpiry>) + 2 * sizeof(void*);
+    bytes += string_heap_bytes(parts[2]);
+    bytes += string_heap_bytes(value->value);
+    if (value->object) bytes += value->object->memory_usage();
+    return resp_integer(bytes);
+}
+
+// OBJECT ENCODING key
+static std::string cmd_object(const std::vector<std::string>& parts, ClientContext& client) {
+    if (to_upper(parts[1]) != "ENCODING" || parts.size() != 3) {
+        return "-ERR unknown subcommand or wrong number of arguments for '" + parts[1] + "'\r\n";
+    }
+
+    ValueWithExpiry* value = lookup_key_read(parts[2], client);
+    if (!value) return resp_null();
+    if (value->object) return resp_bulk(value->object->encoding());
+    if (value->is_integer) return resp_bulk("int");
+
+    int64_t integer;
+    if (string_to_int64(value->value, integer)) return resp_bulk("int");
+    return resp_bulk(value->value.size() <= 44 ? "embstr" : "raw");
+}
+
+std::string parse_scan_args(const std::vector<std::string>& parts, size_t first, ScanArgs& args) {
+    const std::string& cursor = parts[first];
+    auto [ptr, ec] = std::from_chars(cursor.data(), cursor.data() + cursor.size(), args.cursor);
+    if (ec != std::errc() || ptr != cursor.data() + cursor.size()) return "-ERR invalid cursor\r\n";
+
     std::string command = to_upper(parts[0]);
-    
-    if (command == "PING") {
-        return "+PONG\r\n";
-    }
-    else if (command == "ECHO" && parts.size() > 1) {
-        return "+" + parts[1] + "\r\n";
-    }
-    else if (command == "SET" && parts.size() >= 2) {
-        std::lock_guard<std::mutex> lock(kv_mutex);
-        
-        // Check for PX argument
-        if (parts.size() >= 4 && to_upper(parts[3]) == "PX" && parts.size() >= 5) {
-            try {
-                long px_millis = std::stol(parts[4]);
-                kv_store[parts[1]] = ValueWithExpiry(parts[2], px_millis);
-            } catch (const std::exception& e) {
-                return "-ERR invalid expire time in 'set' command\r\n";
-            }
+    for (size_t i = first + 1; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        bool has_value = i + 1 < parts.size();
+        if (option == "MATCH" && has_value) {
+            args.match.emplace(parts[++i]);
+        } else if (option == "COUNT" && has_value) {
+            int64_t count;
+            if (!string_to_int64(parts[++i], count)) return "-ERR value is not an integer or out of range\r\n";
+            if (count < 1) return "-ERR syntax error\r\n";
+            args.count = count;
+        } else if (option == "TYPE" && has_value && command == "SCAN") {
+            args.type = parts[++i];
+        } else if (option == "NOVALUES" && command == "HSCAN") {
+            args.novalues = true;
         } else {
-            kv_store[parts[1]] = ValueWithExpiry(parts[2]);
+            return "-ERR syntax error\r\n";
         }
-        return "+OK\r\n";
-    }
-    else if (command == "GET" && parts.size() > 1) {
-        std::lock_guard<std::mutex> lock(kv_mutex);
-        auto it = kv_store.find(parts[1]);
-        if (it != kv_store.end()) {
-            if (!it->second.is_expired()) {
-                return "+" + it->second.value + "\r\n";
-            }
-            // Remove expired key
-            kv_store.erase(it);
+    }
+    return "";
+}
+
+std::string scan_reply(uint64_t cursor, size_t count, const std::string& items) {
+    std::string reply = resp_array_header(2);
+    resp_append_bulk(reply, std::to_string(cursor));
+    reply += resp_array_header(count);
+    reply += items;
+    return reply;
+}
+
+// SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+static std::string cmd_scan(const std::vector<std::string>& parts, ClientContext& client) {
+    ScanArgs args;
+    std::string error = parse_scan_args(parts, 1, args);
+    if (!error.empty()) return error;
+
+    std::string items;
+    size_t count = 0;
+    auto visit = [&](const Keyspace::value_type& entry) {
+        const auto& [key, value] = entry;
+        if (args.match && !args.match->matches(key)) return;
+        if (value.is_expired()) {
+            client.expired_keys.push_back(key);
+            return;
         }
-        return "$-1\r\n"; // Redis null response
+        if (args.type && strcasecmp(args.type->c_str(), value_type_name(value.type)) != 0) return;
+        resp_append_bulk(items, key);
+        count++;
+    };
+
+    // A pattern without wildcards names one key, found without scanning
+    if (args.match && args.match->is_literal()) {
+        auto it = kv_store.find(args.match->literal_prefix());
+        if (it != kv_store.end()) visit(*it);
+        return scan_reply(0, count, items);
     }
-    
-    return "-ERR unknown command\r\n";
+
+    uint64_t cursor = scan_bounded(args, [](uint64_t at, const auto& step) { return kv_store.scan(at, step); }, visit);
+    return scan_reply(cursor, count, items);
+}
+
+static std::string cmd_info(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string clients = "# Clients\r\nblocked_clients:" + std::to_string(blocked_clients()) + "\r\n";
+    return resp_bulk(clients + "\r\n" + replication_stats() + "\r\n" + replication_info() + "\r\n" + cluster_info());
+}
+
+static void register_server_commands() {
+    register_command({"PING", -1, CMD_PUBSUB, cmd_ping});
+    register_command({"ECHO", 2, 0, cmd_echo});
+    register_command({"DEL", -2, CMD_WRITE, cmd_del, 1, -1, 1});
+    register_command({"TYPE", 2, CMD_READONLY, cmd_type, 1, 1, 1});
+    register_command({"SCAN", -2, CMD_READONLY, cmd_scan});
+    register_command({"MEMORY", -2, CMD_READONLY, cmd_memory, 2, 2, 1});
+    register_command({"OBJECT", -2, CMD_READONLY, cmd_object, 2, 2, 1});
+    register_command({"INFO", -1, 0, cmd_info});
 }
 
 void handle_client(int client_fd) {
     char buffer[BUFFER_SIZE];
     std::string incomplete_data;
-    
+    ClientContext client;
+    client.fd = client_fd;
+
+    std::vector<std::string> parts;
+    size_t consumed;
+
     while (true) {
-        std::memset(buffer, 0, BUFFER_SIZE);
-        ssize_t bytes_read = recv(client_fd, buffer, BUFFER_SIZE - 1, 0);
-        
+        // A subscriber also waits for messages published to it
+        if (client.subscriber && !pubsub_wait(client)) break;
+        ssize_t bytes_read = recv(client_fd, buffer, BUFFER_SIZE, 0);
+
         if (bytes_read <= 0) {
             std::cout << "Client disconnected\n";
             break;
         }
-        
-        incomplete_data += std::string(buffer, bytes_read);
-        
+
+        incomplete_data.append(buffer, bytes_read);
+
         // Process all complete commands in the buffer
-        size_t pos;
-        while ((pos = incomplete_data.find("\r\n")) != std::string::npos) {
-            std::string command = incomplete_data.substr(0, pos + 2);
-            incomplete_data = incomplete_data.substr(pos + 2);
-            
-            std::vector<std::string> parts = parse_resp(command);
-            std::string response = handle_command(parts);
-            send(client_fd, response.c_str(), response.length(), 0);
+        // Replies to a pipelined read go out in one write, so small replies
+        // don't each wait on Nagle and the peer's delayed ACK
+        size_t pos = 0;
+        ParseResult result;
+        std::string replies;
+        while ((result = parse_resp(incomplete_data, pos, parts, consumed)) == ParseResult::Complete) {
+            pos += consumed;
+            if (parts.empty()) continue;
+
+            std::string response = handle_command(parts, client);
+            // Replicas only receive the replication stream, never replies
+            if (!client.is_replica) {
+                replies += response;
+            }
+        }
+        incomplete_data.erase(0, pos);
+        if (!replies.empty()) {
+            send_all(client_fd, replies);
+        }
+
+        if (result == ParseResult::Error) {
+            send_all(client_fd, "-ERR Protocol error\r\n");
+            break;
         }
     }
+
+    if (client.is_replica) {
+        replication_replica_disconnected(client);
+    }
+    unwatch_all_keys(client);
+    pubsub_unsubscribe_all(client);
     close(client_fd);
 }
 
+static bool parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+
+        try {
+            if (option == "--port") {
+                server_config.port = std::stoi(value);
+            } else if (option == "--dir") {
+                server_config.dir = value;
+            } else if (option == "--dbfilename") {
+                server_config.dbfilename = value;
+            } else if (option == "--replicaof") {
+                std::istringstream iss(value);
+                if (!(iss >> server_config.master_host >> server_config.master_port)) {
+                    std::cerr << "--replicaof expects \"<host> <port>\"\n";
+                    return false;
+                }
+            } else if (option == "--repl-backlog-size") {
+                server_config.repl_backlog_size = std::stoull(value);
+                if (server_config.repl_backlog_size == 0) return false;
+            } else if (option == "--repl-diskless-sync") {
+                if (value != "yes" && value != "no") {
+                    std::cerr << "--repl-diskless-sync expects yes or no\n";
+                    return false;
+                }
+                server_config.repl_diskless_sync = value == "yes";
+            } else if (option == "--repl-diskless-sync-delay") {
+                server_config.repl_diskless_sync_delay = std::stoi(value);
+            } else if (option == "--replica-read-only") {
+                if (value != "yes" && value != "no") {
+                    std::cerr << "--replica-read-only expects yes or no\n";
+                    return false;
+                }
+                server_config.replica_read_only = value == "yes";
+            } else if (option == "--cluster-enabled") {
+                if (value != "yes" && value != "no") {
+                    std::cerr << "--cluster-enabled expects yes or no\n";
+                    return false;
+                }
+                server_config.cluster_enabled = value == "yes";
+            } else if (option == "--cluster-config-file") {
+                server_config.cluster_config_file = value;
+            } else if (option == "--hash-max-listpack-entries") {
+                server_config.hash_max_listpack_entries = std::stoul(value);
+            } else if (option == "--hash-max-listpack-value") {
+                server_config.hash_max_listpack_value = std::stoul(value);
+            } else if (option == "--set-max-intset-entries") {
+                server_config.set_max_intset_entries = std::stoul(value);
+            } else if (option == "--zset-max-listpack-entries") {
+                server_config.zset_max_listpack_entries = std::stoul(value);
+            } else if (option == "--zset-max-listpack-value") {
+                server_config.zset_max_listpack_value = std::stoul(value);
+            } else if (option == "--zset-large-encoding") {
+                if (value != "skiplist" && value != "btree") {
+                    std::cerr << "--zset-large-encoding expects skiplist or btree\n";
+                    return false;
+                }
+                server_config.zset_use_btree = value == "btree";
+            } else if (option == "--stream-node-max-bytes") {
+                server_config.stream_node_max_bytes = std::stoul(value);
+            } else if (option == "--stream-node-max-entries") {
+                server_config.stream_node_max_entries = std::stoul(value);
+            } else if (option == "--hll-sparse-max-bytes") {
+                server_config.hll_sparse_max_bytes = std::stoul(value);
+            } else if (option == "--list-max-listpack-size") {
+                server_config.list_max_listpack_size = std::stoi(value);
+            } else if (option == "--list-compress-depth") {
+                server_config.list_compress_depth = std::stoi(value);
+            } else if (option == "--cluster-node-id") {
+                server_config.cluster_node_id = value;
+            } else if (option == "--lua-time-limit") {
+                server_config.lua_time_limit = std::stoi(value);
+            } else {
+                std::cerr << "Unknown option " << option << "\n";
+                return false;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Invalid value for " << option << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char **argv) {
-    // Main function remains unchanged
     std::cout << std::unitbuf;
     std::cerr << std::unitbuf;
 
+    if (!parse_args(argc, argv)) {
+        return 1;
+    }
+
+    register_server_commands();
+    register_string_commands();
+    register_expire_commands();
+    register_multi_commands();
+    register_replication_commands();
+    register_cluster_commands();
+    register_migrate_commands();
+    register_list_commands();
+    register_hash_commands();
+    register_set_commands();
+    register_zset_commands();
+    register_stream_commands();
+    register_hyperloglog_commands();
+    register_bitops_commands();
+    register_geo_commands();
+    register_bloom_commands();
+    register_script_commands();
+    register_pubsub_commands();
+    register_blocking_commands();
+    replication_init();
+
+    if (server_config.cluster_enabled && !cluster_init()) {
+        return 1;
+    }
+
+    if (rdb_load_file(rdb_path())) {
+        std::cout << "Loaded " << kv_store.size() << " keys from " << rdb_path() << "\n";
+    }
+    start_active_expire();
+
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         std::cerr << "Failed to create server socket\n";
@@ -167,19 +603,25 @@ int main(int argc, char **argv) {
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(6379);
+    server_addr.sin_port = htons(server_config.port);
 
     if (bind(server_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
-        std::cerr << "Failed to bind to port 6379\n";
+        std::cerr << "Failed to bind to port " << server_config.port << "\n";
         return 1;
     }
 
-    int connection_backlog = 5;
+    // As Redis's tcp-backlog, so a burst of subscribers connecting at once
+    // isn't dropped into SYN retries
+    int connection_backlog = 511;
     if (listen(server_fd, connection_backlog) != 0) {
         std::cerr << "listen failed\n";
         return 1;
     }
 
+    if (!server_config.master_host.empty()) {
+        replication_set_master(server_config.master_host, server_config.master_port);
+    }
+
     std::cout << "Waiting for clients to connect...\n";
 
     std::vector<std::thread> client_threads;
@@ -187,7 +629,7 @@ int main(int argc, char **argv) {
     while (true) {
         struct sockaddr_in client_addr;
         int client_addr_len = sizeof(client_addr);
-        
+
         int client_fd = accept(server_fd, (struct sockaddr *) &client_addr, (socklen_t *) &client_addr_len);
         if (client_fd < 0) {
             std::cerr << "Failed to accept client connection\n";
@@ -195,11 +637,15 @@ int main(int argc, char **argv) {
         }
 
         std::cout << "Client connected\n";
-        
+
+        // Replies are written as soon as they're ready, don't batch them up
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
         client_threads.emplace_back(handle_client, client_fd);
         client_threads.back().detach();
     }
 
     close(server_fd);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,650 @@
+#include "bitops.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+static constexpr const char* SYNTAX_ERROR = "-ERR syntax error\r\n";
+static constexpr const char* NOT_INTEGER_ERROR = "-ERR value is not an integer or out of range\r\n";
+static constexpr const char* BIT_OFFSET_ERROR = "-ERR bit offset is not an integer or out of range\r\n";
+
+// Strings stop at 512 MB, so offsets must be below this many bits
+static constexpr uint64_t MAX_BITMAP_BITS = uint64_t(512) * 1024 * 1024 * 8;
+
+enum class BitOp { And, Or, Xor, Not };
+
+// Kernels. Each comes as a portable version working a word at a time and
+// AVX2 and AVX-512 versions picked at runtime.
+
+static uint64_t popcount_scalar(const uint8_t* p, size_t len) {
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        count += std::popcount(word);
+    }
+    for (; i < len; i++) count += std::popcount(p[i]);
+    return count;
+}
+
+// Index of the first byte that isn't skip, or len
+static size_t find_byte_not_scalar(const uint8_t* p, size_t len, uint8_t skip) {
+    uint64_t pattern = skip * 0x0101010101010101ULL;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        if (word != pattern) break;
+    }
+    for (; i < len; i++) {
+        if (p[i] != skip) return i;
+    }
+    return len;
+}
+
+template <BitOp op>
+static void fold_scalar_op(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        std::memcpy(&a, dst + i, 8);
+        std::memcpy(&b, src + i, 8);
+        if constexpr (op == BitOp::And) a &= b;
+        if constexpr (op == BitOp::Or) a |= b;
+        if constexpr (op == BitOp::Xor) a ^= b;
+        if constexpr (op == BitOp::Not) a = ~b;
+        std::memcpy(dst + i, &a, 8);
+    }
+    for (; i < len; i++) {
+        if constexpr (op == BitOp::And) dst[i] &= src[i];
+        if constexpr (op == BitOp::Or) dst[i] |= src[i];
+        if constexpr (op == BitOp::Xor) dst[i] ^= src[i];
+        if constexpr (op == BitOp::Not) dst[i] = ~src[i];
+    }
+}
+
+#if defined(__x86_64__)
+
+// Per-nibble lookup (Mula): two shuffles count the bits of 32 bytes. A byte
+// gains at most 8 per step, so byte counters are folded into 64-bit sums
+// every 31 steps.
+__attribute__((target("avx2")))
+static uint64_t popcount_avx2(const uint8_t* p, size_t len) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i counts = zero;
+        for (int step = 0; step < 31 && i + 32 <= len; step++, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low4));
+            __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+            counts = _mm256_add_epi8(counts, _mm256_add_epi8(low, high));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, zero));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_scalar(p + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint64_t popcount_avx512(const uint8_t* p, size_t len) {
+    __m512i total = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(p + i)));
+    }
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, total);
+    uint64_t count = 0;
+    for (uint64_t lane : lanes) count += lane;
+    return count + popcount_scalar(p + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_byte_not_avx2(const uint8_t* p, size_t len, uint8_t skip) {
+    const __m256i pattern = _mm256_set1_epi8(static_cast<char>(skip));
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto same = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern)));
+        if (same != 0xffffffff) return i + std::countr_one(same);
+    }
+    return i + find_byte_not_scalar(p + i, len - i, skip);
+}
+
+template <BitOp op>
+__attribute__((target("avx2")))
+static void fold_avx2_op(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        auto* out = reinterpret_cast<__m256i*>(dst + i);
+        __m256i a = _mm256_loadu_si256(out);
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        if constexpr (op == BitOp::And) a = _mm256_and_si256(a, b);
+        if constexpr (op == BitOp::Or) a = _mm256_or_si256(a, b);
+        if constexpr (op == BitOp::Xor) a = _mm256_xor_si256(a, b);
+        if constexpr (op == BitOp::Not) a = _mm256_xor_si256(b, _mm256_set1_epi8(-1));
+        _mm256_storeu_si256(out, a);
+    }
+    fold_scalar_op<op>(dst + i, src + i, len - i);
+}
+
+template <BitOp op>
+__attribute__((target("avx512f")))
+static void fold_avx512_op(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i a = _mm512_loadu_si512(dst + i);
+        __m512i b = _mm512_loadu_si512(src + i);
+        if constexpr (op == BitOp::And) a = _mm512_and_si512(a, b);
+        if constexpr (op == BitOp::Or) a = _mm512_or_si512(a, b);
+        if constexpr (op == BitOp::Xor) a = _mm512_xor_si512(a, b);
+        if constexpr (op == BitOp::Not) a = _mm512_ternarylogic_epi64(b, b, b, 0x55);
+        _mm512_storeu_si512(dst + i, a);
+    }
+    fold_scalar_op<op>(dst + i, src + i, len - i);
+}
+
+static const bool cpu_has_avx2 = __builtin_cpu_supports("avx2");
+static const bool cpu_has_avx512 = __builtin_cpu_supports("avx512f");
+static const bool cpu_has_avx512_popcount = cpu_has_avx512 && __builtin_cpu_supports("avx512vpopcntdq");
+
+#endif
+
+static uint64_t popcount(const uint8_t* p, size_t len) {
+#if defined(__x86_64__)
+    if (cpu_has_avx512_popcount) return popcount_avx512(p, len);
+    if (cpu_has_avx2) return popcount_avx2(p, len);
+#endif
+    return popcount_scalar(p, len);
+}
+
+static size_t find_byte_not(const uint8_t* p, size_t len, uint8_t skip) {
+#if defined(__x86_64__)
+    if (cpu_has_avx2) return find_byte_not_avx2(p, len, skip);
+#endif
+    return find_byte_not_scalar(p, len, skip);
+}
+
+template <BitOp op>
+static void fold_op(uint8_t* dst, const uint8_t* src, size_t len) {
+#if defined(__x86_64__)
+    if (cpu_has_avx512) return fold_avx512_op<op>(dst, src, len);
+    if (cpu_has_avx2) return fold_avx2_op<op>(dst, src, len);
+#endif
+    fold_scalar_op<op>(dst, src, len);
+}
+
+// dst = dst op src, or dst = ~src for NOT
+static void fold(BitOp op, uint8_t* dst, const uint8_t* src, size_t len) {
+    switch (op) {
+    case BitOp::And: return fold_op<BitOp::And>(dst, src, len);
+    case BitOp::Or: return fold_op<BitOp::Or>(dst, src, len);
+    case BitOp::Xor: return fold_op<BitOp::Xor>(dst, src, len);
+    case BitOp::Not: return fold_op<BitOp::Not>(dst, src, len);
+    }
+}
+
+// Combine the sources into out[0, len), shorter sources padded with zeros.
+// The result is built a block at a time, every source folded into a block
+// while it is still in cache, so each source byte is read once and each
+// result byte written once however many sources there are.
+static void bitop(BitOp op, const std::vector<std::string_view>& sources, uint8_t* out, size_t len) {
+    constexpr size_t BLOCK = 32 * 1024;
+    for (size_t start = 0; start < len; start += BLOCK) {
+        size_t n = std::min(BLOCK, len - start);
+        uint8_t* block = out + start;
+        auto slice = [&](std::string_view source) {
+            return source.size() > start ? std::min(n, source.size() - start) : 0;
+        };
+        auto bytes = [&](std::string_view source) {
+            return reinterpret_cast<const uint8_t*>(source.data()) + start;
+        };
+
+        if (op == BitOp::Not) {
+            // A single source, as long as the result
+            fold(op, block, bytes(sources[0]), n);
+            continue;
+        }
+        size_t have = slice(sources[0]);
+        std::memcpy(block, bytes(sources[0]), have);
+        std::memset(block + have, 0, n - have);
+        for (size_t i = 1; i < sources.size(); i++) {
+            size_t m = slice(sources[i]);
+            fold(op, block, bytes(sources[i]), m);
+            if (op == BitOp::And) std::memset(block + m, 0, n - m);
+        }
+    }
+}
+
+// Position of the first bit set to bit in [first, last], -1 if none
+static int64_t find_bit(const std::string& bitmap, uint64_t first, uint64_t last, bool bit) {
+    const auto* p = reinterpret_cast<const uint8_t*>(bitmap.data());
+    size_t first_byte = first >> 3, last_byte = last >> 3;
+    // Bits outside the range are made to look like the ones we skip
+    auto load = [&](size_t i) {
+        uint8_t byte = bit ? p[i] : ~p[i];
+        if (i == first_byte) byte &= 0xff >> (first & 7);
+        if (i == last_byte) byte &= 0xff << (7 - (last & 7));
+        return byte;
+    };
+
+    size_t i = first_byte;
+    if (load(i) == 0 && i < last_byte) {
+        i++;
+        if (i < last_byte) i += find_byte_not(p + i, last_byte - i, bit ? 0x00 : 0xff);
+    }
+    uint8_t byte = load(i);
+    if (byte == 0) return -1;
+    return static_cast<int64_t>(i * 8 + std::countl_zero(byte));
+}
+
+// Bit offset argument; in BITFIELD "#n" means the n-th field of width bits
+static bool parse_bit_offset(const std::string& arg, bool fields, int bits, uint64_t& offset) {
+    bool hash = fields && !arg.empty() && arg[0] == '#';
+    int64_t value;
+    if (!string_to_int64(std::string_view(arg).substr(hash ? 1 : 0), value) || value < 0) return false;
+    if (hash && value > static_cast<int64_t>(MAX_BITMAP_BITS / bits)) return false;
+    offset = hash ? static_cast<uint64_t>(value) * bits : static_cast<uint64_t>(value);
+    return offset < MAX_BITMAP_BITS;
+}
+
+// Clamp a start/end pair the way BITCOUNT and BITPOS do: negative counts
+// from the end, and both ends are pulled inside [0, len - 1]
+static bool clamp_range(int64_t& start, int64_t& end, int64_t len) {
+    if (start < 0) start += len;
+    if (end < 0) end += len;
+    start = std::max<int64_t>(start, 0);
+    end = std::max<int64_t>(end, 0);
+    end = std::min(end, len - 1);
+    return start <= end;
+}
+
+static std::string* bitmap_for_write(const std::string& key, bool create, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (value && value->type != ValueType::String) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value) {
+        if (!create) return nullptr;
+        value = &(kv_store[key] = ValueWithExpiry(std::string()));
+    }
+    return &value->string_for_write();
+}
+
+// A counter's text is formatted into scratch
+static const std::string* bitmap_for_read(const std::string& key, ClientContext& client, std::string& error,
+                                          std::string& scratch) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::String) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->string_for_read(scratch);
+}
+
+// SETBIT key offset value
+static std::string cmd_setbit(const std::vector<std::string>& parts, ClientContext&) {
+    uint64_t offset;
+    if (!parse_bit_offset(parts[2], false, 0, offset)) return BIT_OFFSET_ERROR;
+    if (parts[3] != "0" && parts[3] != "1") return "-ERR bit is not an integer or out of range\r\n";
+
+    std::string error;
+    std::string* bitmap = bitmap_for_write(parts[1], true, error);
+    if (!bitmap) return error;
+
+    size_t byte = offset >> 3;
+    if (bitmap->size() <= byte) bitmap->resize(byte + 1);
+    uint8_t mask = 0x80 >> (offset & 7);
+    auto& target = reinterpret_cast<uint8_t&>((*bitmap)[byte]);
+    bool old = target & mask;
+    if (parts[3] == "1") {
+        target |= mask;
+    } else {
+        target &= ~mask;
+    }
+    return resp_integer(old);
+}
+
+// GETBIT key offset
+static std::string cmd_getbit(const std::vector<std::string>& parts, ClientContext& client) {
+    uint64_t offset;
+    if (!parse_bit_offset(parts[2], false, 0, offset)) return BIT_OFFSET_ERROR;
+
+    std::string error, scratch;
+    const std::string* bitmap = bitmap_for_read(parts[1], client, error, scratch);
+    if (!bitmap) return error.empty() ? resp_integer(0) : error;
+
+    size_t byte = offset >> 3;
+    if (byte >= bitmap->size()) return resp_integer(0);
+    return resp_integer((static_cast<uint8_t>((*bitmap)[byte]) >> (7 - (offset & 7))) & 1);
+}
+
+// Parse the optional BYTE | BIT unit at parts[i], true for BIT
+static bool parse_bit_unit(const std::vector<std::string>& parts, size_t i, bool& bits) {
+    bits = false;
+    if (i >= parts.size()) return true;
+    std::string unit = to_upper(parts[i]);
+    if (unit == "BIT") {
+        bits = true;
+        return true;
+    }
+    return unit == "BYTE";
+}
+
+// BITCOUNT key [start end [BYTE | BIT]]
+static std::string cmd_bitcount(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t start = 0, end = -1;
+    bool bits = false;
+    if (parts.size() == 4 || parts.size() == 5) {
+        if (!string_to_int64(parts[2], start) || !string_to_int64(parts[3], end)) return NOT_INTEGER_ERROR;
+        if (!parse_bit_unit(parts, 4, bits)) return SYNTAX_ERROR;
+    } else if (parts.size() != 2) {
+        return SYNTAX_ERROR;
+    }
+
+    std::string error, scratch;
+    const std::string* bitmap = bitmap_for_read(parts[1], client, error, scratch);
+    if (!bitmap) return error.empty() ? resp_integer(0) : error;
+
+    if (start < 0 && end < 0 && start > end) return resp_integer(0);
+    int64_t len = static_cast<int64_t>(bitmap->size()) * (bits ? 8 : 1);
+    if (!clamp_range(start, end, len)) return resp_integer(0);
+    if (!bits) {
+        start *= 8;
+        end = end * 8 + 7;
+    }
+
+    // Whole bytes, less the bits of the end bytes outside the range
+    const auto* p = reinterpret_cast<const uint8_t*>(bitmap->data());
+    size_t first = start >> 3, last = end >> 3;
+    uint64_t count = popcount(p + first, last - first + 1);
+    count -= std::popcount(static_cast<uint8_t>(p[first] & ~(0xff >> (start & 7))));
+    count -= std::popcount(static_cast<uint8_t>(p[last] & (0xff >> ((end & 7) + 1))));
+    return resp_integer(static_cast<int64_t>(count));
+}
+
+// BITPOS key bit [start [end [BYTE | BIT]]]
+static std::string cmd_bitpos(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t bit;
+    if (!string_to_int64(parts[2], bit)) return NOT_INTEGER_ERROR;
+    if (bit != 0 && bit != 1) return "-ERR The bit argument must be 1 or 0.\r\n";
+
+    // A missing key is an endless run of zeros
+    std::string error, scratch;
+    const std::string* bitmap = bitmap_for_read(parts[1], client, error, scratch);
+    if (!bitmap) return error.empty() ? resp_integer(bit ? -1 : 0) : error;
+
+    int64_t start = 0, end = -1;
+    bool end_given = false, bits = false;
+    if (parts.size() >= 4 && parts.size() <= 6) {
+        if (!string_to_int64(parts[3], start)) return NOT_INTEGER_ERROR;
+        if (parts.size() >= 5) {
+            if (!string_to_int64(parts[4], end)) return NOT_INTEGER_ERROR;
+            end_given = true;
+        }
+        if (!parse_bit_unit(parts, 5, bits)) return SYNTAX_ERROR;
+    } else if (parts.size() != 3) {
+        return SYNTAX_ERROR;
+    }
+
+    int64_t len = static_cast<int64_t>(bitmap->size()) * (bits ? 8 : 1);
+    if (!clamp_range(start, end, len)) return resp_integer(-1);
+    if (!bits) {
+        start *= 8;
+        end = end * 8 + 7;
+    }
+
+    int64_t pos = find_bit(*bitmap, start, end, bit);
+    // Looking for a clear bit past the end of the string finds the padding,
+    // unless the caller bounded the range
+    if (pos < 0 && bit == 0 && !end_given) pos = end + 1;
+    return resp_integer(pos);
+}
+
+// BITOP AND | OR | XOR | NOT destkey key [key ...]
+static std::string cmd_bitop(const std::vector<std::string>& parts, ClientContext&) {
+    std::string name = to_upper(parts[1]);
+    BitOp op;
+    if (name == "AND") {
+        op = BitOp::And;
+    } else if (name == "OR") {
+        op = BitOp::Or;
+    } else if (name == "XOR") {
+        op = BitOp::Xor;
+    } else if (name == "NOT") {
+        op = BitOp::Not;
+    } else {
+        return SYNTAX_ERROR;
+    }
+    if (op == BitOp::Not && parts.size() != 4) {
+        return "-ERR BITOP NOT must be called with a single source key.\r\n";
+    }
+
+    std::string error;
+    std::vector<std::string_view> sources;
+    size_t len = 0;
+    for (size_t i = 3; i < parts.size(); i++) {
+        const std::string* bitmap = bitmap_for_write(parts[i], false, error);
+        if (!error.empty()) return error;
+        sources.emplace_back(bitmap ? std::string_view(*bitmap) : std::string_view());
+        len = std::max(len, sources.back().size());
+    }
+
+    if (len == 0) {
+        kv_store.erase(parts[2]);
+        return resp_integer(0);
+    }
+    // The sources may include the destination, so build the result aside
+    std::string result;
+    result.resize_and_overwrite(len, [&](char* buf, size_t n) {
+        bitop(op, sources, reinterpret_cast<uint8_t*>(buf), n);
+        return n;
+    });
+    kv_store[parts[2]] = ValueWithExpiry(std::move(result));
+    return resp_integer(static_cast<int64_t>(len));
+}
+
+// One BITFIELD operation
+struct BitfieldOp {
+    enum Kind { Get, Set, Incrby } kind;
+    enum Overflow { Wrap, Sat, Fail } overflow;
+    bool is_signed;
+    int bits;
+    uint64_t offset;
+    int64_t value;  // for SET and INCRBY
+};
+
+// Read bits [offset, offset + bits) as an unsigned number, bits <= 64. The
+// field spans at most nine bytes.
+static uint64_t read_field(const std::string& bitmap, uint64_t offset, int bits) {
+    size_t first = offset >> 3;
+    unsigned __int128 window = 0;
+    for (size_t i = first; i < first + 9; i++) {
+        window = window << 8 | (i < bitmap.size() ? static_cast<uint8_t>(bitmap[i]) : 0);
+    }
+    window >>= 72 - (offset & 7) - bits;
+    return bits == 64 ? static_cast<uint64_t>(window) : static_cast<uint64_t>(window) & ((uint64_t(1) << bits) - 1);
+}
+
+// The bitmap must already cover the field
+static void write_field(std::string& bitmap, uint64_t offset, int bits, uint64_t value) {
+    size_t first = offset >> 3;
+    size_t count = ((offset & 7) + bits + 7) / 8;
+    unsigned shift = count * 8 - (offset & 7) - bits;
+    unsigned __int128 mask = ((unsigned __int128)1 << bits) - 1;
+    unsigned __int128 window = 0;
+    for (size_t i = 0; i < count; i++) window = window << 8 | static_cast<uint8_t>(bitmap[first + i]);
+    window = (window & ~(mask << shift)) | ((value & mask) << shift);
+    for (size_t i = count; i-- > 0;) {
+        bitmap[first + i] = static_cast<char>(window);
+        window >>= 8;
+    }
+}
+
+// Add incr to a field holding value, applying the overflow policy. False if
+// the policy is FAIL and the result doesn't fit.
+static bool bitfield_add(const BitfieldOp& op, int64_t value, int64_t incr, uint64_t& result) {
+    __int128 min, max;
+    if (op.is_signed) {
+        max = ((__int128)1 << (op.bits - 1)) - 1;
+        min = -max - 1;
+    } else {
+        min = 0;
+        max = ((__int128)1 << op.bits) - 1;
+    }
+    // SET on an unsigned field takes the argument's two's complement bits
+    __int128 base = op.is_signed ? (__int128)value : (__int128)(uint64_t)value;
+    __int128 sum = base + incr;
+    if (sum >= min && sum <= max) {
+        result = static_cast<uint64_t>(sum);
+        return true;
+    }
+
+    switch (op.overflow) {
+    case BitfieldOp::Wrap:
+        result = static_cast<uint64_t>(sum);
+        return true;
+    case BitfieldOp::Sat:
+        result = static_cast<uint64_t>(sum > max ? max : min);
+        return true;
+    case BitfieldOp::Fail:
+        break;
+    }
+    return false;
+}
+
+static int64_t field_value(const BitfieldOp& op, uint64_t raw) {
+    if (!op.is_signed || op.bits == 64) return static_cast<int64_t>(raw);
+    // Sign-extend from the field width
+    uint64_t sign = uint64_t(1) << (op.bits - 1);
+    return static_cast<int64_t>((raw ^ sign) - sign);
+}
+
+static std::string bitfield_generic(const std::vector<std::string>& parts, ClientContext& client, bool read_only) {
+    std::vector<BitfieldOp> ops;
+    auto overflow = BitfieldOp::Wrap;
+    bool writes = false;
+    uint64_t end_bit = 0;
+    for (size_t i = 2; i < parts.size(); i++) {
+        std::string sub = to_upper(parts[i]);
+        size_t remaining = parts.size() - i - 1;
+        BitfieldOp op{};
+        if (sub == "GET" && remaining >= 2) {
+            op.kind = BitfieldOp::Get;
+        } else if (sub == "SET" && remaining >= 3) {
+            op.kind = BitfieldOp::Set;
+        } else if (sub == "INCRBY" && remaining >= 3) {
+            op.kind = BitfieldOp::Incrby;
+        } else if (sub == "OVERFLOW" && remaining >= 1) {
+            std::string type = to_upper(parts[++i]);
+            if (type == "WRAP") {
+                overflow = BitfieldOp::Wrap;
+            } else if (type == "SAT") {
+                overflow = BitfieldOp::Sat;
+            } else if (type == "FAIL") {
+                overflow = BitfieldOp::Fail;
+            } else {
+                return "-ERR Invalid OVERFLOW type specified\r\n";
+            }
+            continue;
+        } else {
+            return SYNTAX_ERROR;
+        }
+
+        // Type: i1 to i64 or u1 to u63
+        const std::string& type = parts[i + 1];
+        int64_t bits = 0;
+        bool valid = type.size() >= 2 && (type[0] == 'i' || type[0] == 'u') &&
+                     string_to_int64(std::string_view(type).substr(1), bits);
+        op.is_signed = type[0] == 'i';
+        if (!valid || bits < 1 || bits > (op.is_signed ? 64 : 63)) {
+            return "-ERR Invalid bitfield type. Use something like i16 u8. Note that u64 is not supported but i64 is.\r\n";
+        }
+        op.bits = static_cast<int>(bits);
+        if (!parse_bit_offset(parts[i + 2], true, op.bits, op.offset)) return BIT_OFFSET_ERROR;
+        if (op.kind != BitfieldOp::Get) {
+            if (!string_to_int64(parts[i + 3], op.value)) return NOT_INTEGER_ERROR;
+            writes = true;
+            end_bit = std::max(end_bit, op.offset + op.bits);
+        }
+        if (read_only && op.kind != BitfieldOp::Get) return "-ERR BITFIELD_RO only supports the GET subcommand\r\n";
+        op.overflow = overflow;
+        ops.push_back(op);
+        i += op.kind == BitfieldOp::Get ? 2 : 3;
+    }
+
+    std::string error, scratch;
+    std::string* bitmap = nullptr;
+    const std::string* view = nullptr;
+    static const std::string empty;
+    if (writes) {
+        bitmap = bitmap_for_write(parts[1], true, error);
+        if (!bitmap) return error;
+        if (bitmap->size() < (end_bit + 7) / 8) bitmap->resize((end_bit + 7) / 8);
+        view = bitmap;
+    } else {
+        view = read_only ? bitmap_for_read(parts[1], client, error, scratch) : bitmap_for_write(parts[1], false, error);
+        if (!error.empty()) return error;
+        if (!view) view = &empty;
+        // Nothing changed, so there is nothing to replicate
+        client.propagate_as.emplace();
+    }
+
+    std::string reply = resp_array_header(ops.size());
+    for (const BitfieldOp& op : ops) {
+        int64_t old = field_value(op, read_field(*view, op.offset, op.bits));
+        if (op.kind == BitfieldOp::Get) {
+            reply += resp_integer(old);
+            continue;
+        }
+        uint64_t result;
+        bool ok = op.kind == BitfieldOp::Set ? bitfield_add(op, op.value, 0, result)
+                                             : bitfield_add(op, old, op.value, result);
+        if (!ok) {
+            reply += resp_null();
+            continue;
+        }
+        write_field(*bitmap, op.offset, op.bits, result);
+        reply += resp_integer(op.kind == BitfieldOp::Set ? old : field_value(op, read_field(*bitmap, op.offset, op.bits)));
+    }
+    return reply;
+}
+
+// BITFIELD key [GET type offset] [SET type offset value] [INCRBY type offset increment]
+//     [OVERFLOW WRAP | SAT | FAIL] ...
+static std::string cmd_bitfield(const std::vector<std::string>& parts, ClientContext& client) {
+    return bitfield_generic(parts, client, false);
+}
+
+// BITFIELD_RO key [GET type offset] ...
+static std::string cmd_bitfield_ro(const std::vector<std::string>& parts, ClientContext& client) {
+    return bitfield_generic(parts, client, true);
+}
+
+void register_bitops_commands() {
+    register_command({"SETBIT", 4, CMD_WRITE, cmd_setbit, 1, 1, 1});
+    register_command({"GETBIT", 3, CMD_READONLY, cmd_getbit, 1, 1, 1});
+    register_command({"BITCOUNT", -2, CMD_READONLY, cmd_bitcount, 1, 1, 1});
+    register_command({"BITPOS", -3, CMD_READONLY, cmd_bitpos, 1, 1, 1});
+    register_command({"BITOP", -4, CMD_WRITE, cmd_bitop, 2, -1, 1});
+    register_command({"BITFIELD", -2, CMD_WRITE, cmd_bitfield, 1, 1, 1});
+    register_command({"BITFIELD_RO", -2, CMD_READONLY, cmd_bitfield_ro, 1, 1, 1});
+}
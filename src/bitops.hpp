@@ -0,0 +1,6 @@
+#pragma once
+
+// Bitmap commands over string values: SETBIT, GETBIT, BITCOUNT, BITPOS,
+// BITOP and BITFIELD. Bit 0 is the most significant bit of the first byte,
+// and bytes past the end of a string read as zero.
+void register_bitops_commands();
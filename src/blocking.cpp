@@ -0,0 +1,325 @@
+#include "blocking.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "list.hpp"
+#include "resp.hpp"
+#include "util.hpp"
+
+// A client parked by a blocking command. Writers mark it ready and signal
+// wake_fd; its own thread waits on that and on its socket, so a client
+// that hangs up while blocked is let go at once rather than at timeout.
+struct BlockedClient {
+    int wake_fd;
+    std::vector<std::string> keys;
+    bool fan_out = false;
+    std::chrono::steady_clock::time_point deadline;  // max() for no timeout
+    std::vector<std::string> retry;
+    bool parked = false;  // the last run of the command asked to wait
+    bool ready = false;   // guarded by blocking_mutex
+
+    explicit BlockedClient(int fd) : wake_fd(fd) {}
+    ~BlockedClient() { close(wake_fd); }
+};
+
+// Parked clients per key, longest waiting first. A client stays in these
+// lists from the first time its command blocks until it is served or
+// times out, so waking up to find another client got there first doesn't
+// cost it its place in line.
+static std::mutex blocking_mutex;
+static std::unordered_map<std::string, std::deque<BlockedClient*>> waiters_by_key;
+static std::atomic<size_t> waiter_count{0};
+
+void block_on_keys(ClientContext& client, const std::vector<std::string>& keys, int64_t timeout_ms, bool fan_out,
+                   std::vector<std::string> retry) {
+    if (!client.may_block) return;
+
+    if (!client.blocked) {
+        int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        // Without a descriptor to wait on, time out at once
+        if (wake_fd < 0) return;
+        client.blocked = std::make_shared<BlockedClient>(wake_fd);
+    }
+    BlockedClient& blocked = *client.blocked;
+    blocked.parked = true;
+    if (!retry.empty()) blocked.retry = std::move(retry);
+
+    std::lock_guard<std::mutex> lock(blocking_mutex);
+    blocked.ready = false;
+    // Running again after a wakeup keeps the original place and deadline
+    if (!blocked.keys.empty()) return;
+
+    blocked.keys = keys;
+    blocked.fan_out = fan_out;
+    blocked.deadline = timeout_ms > 0
+        ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)
+        : std::chrono::steady_clock::time_point::max();
+    for (const auto& key : blocked.keys) {
+        auto& waiters = waiters_by_key[key];
+        // BLPOP k k waits once
+        if (std::find(waiters.begin(), waiters.end(), &blocked) == waiters.end()) waiters.push_back(&blocked);
+    }
+    waiter_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void release_keys(BlockedClient& blocked) {
+    std::lock_guard<std::mutex> lock(blocking_mutex);
+    if (blocked.keys.empty()) return;
+    for (const auto& key : blocked.keys) {
+        auto it = waiters_by_key.find(key);
+        if (it == waiters_by_key.end()) continue;
+        std::erase(it->second, &blocked);
+        if (it->second.empty()) waiters_by_key.erase(it);
+    }
+    blocked.keys.clear();
+    blocked.retry.clear();
+    waiter_count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool blocking_wait(ClientContext& client) {
+    if (!client.blocked) return false;
+    BlockedClient& blocked = *client.blocked;
+    if (!blocked.parked) {
+        release_keys(blocked);
+        return false;
+    }
+    blocked.parked = false;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(blocking_mutex);
+            if (blocked.ready) return true;
+        }
+
+        int timeout = -1;
+        if (blocked.deadline != std::chrono::steady_clock::time_point::max()) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(blocked.deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) break;
+            timeout = static_cast<int>(std::min<int64_t>(left.count(), INT32_MAX));
+        }
+
+        // Data the client pipelines behind the blocking command waits its
+        // turn; only a hangup ends the wait early
+        struct pollfd fds[2] = {{client.fd, POLLRDHUP, 0}, {blocked.wake_fd, POLLIN, 0}};
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) break;
+        if (fds[1].revents) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t got = read(blocked.wake_fd, &count, sizeof(count));
+        }
+    }
+    release_keys(blocked);
+    return false;
+}
+
+const std::vector<std::string>& blocking_command(const ClientContext& client, const std::vector<std::string>& parts) {
+    if (client.blocked && !client.blocked->retry.empty()) return client.blocked->retry;
+    return parts;
+}
+
+// Caller holds blocking_mutex
+static void wake(BlockedClient& blocked) {
+    blocked.ready = true;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(blocked.wake_fd, &one, sizeof(one));
+}
+
+void signal_keys(const Command& command, const std::vector<std::string>& parts) {
+    if (waiter_count.load(std::memory_order_relaxed) == 0) return;
+
+    std::lock_guard<std::mutex> lock(blocking_mutex);
+    for (size_t pos : command_key_positions(command, parts)) {
+        auto it = waiters_by_key.find(parts[pos]);
+        if (it == waiters_by_key.end()) continue;
+        // Readers of a stream all get each new entry. A popped element or
+        // a group's entry goes to one client, and serving it writes the
+        // key again, which passes the turn to the next in line.
+        bool woke_one = false;
+        for (BlockedClient* blocked : it->second) {
+            if (blocked->fan_out) {
+                wake(*blocked);
+            } else if (!woke_one && !blocked->ready) {
+                wake(*blocked);
+                woke_one = true;
+            }
+        }
+    }
+}
+
+size_t blocked_clients() { return waiter_count.load(std::memory_order_relaxed); }
+
+// Timeout argument of the list commands, in seconds with decimals
+static bool parse_timeout(const std::string& arg, int64_t& timeout_ms, std::string& error) {
+    double seconds;
+    if (!string_to_double(arg, seconds) || !std::isfinite(seconds)) {
+        error = "-ERR timeout is not a float or out of range\r\n";
+        return false;
+    }
+    if (seconds < 0) {
+        error = "-ERR timeout is negative\r\n";
+        return false;
+    }
+    // Checked before the cast and the deadline arithmetic, either of which
+    // would overflow; 2^50 ms is some 35000 years
+    constexpr double max_ms = static_cast<double>(int64_t(1) << 50);
+    if (std::ceil(seconds * 1000) > max_ms) {
+        error = "-ERR timeout is out of range\r\n";
+        return false;
+    }
+    timeout_ms = static_cast<int64_t>(std::ceil(seconds * 1000));
+    return true;
+}
+
+// BLPOP/BRPOP key [key ...] timeout
+static std::string bpop_generic(const std::vector<std::string>& parts, ClientContext& client, bool front) {
+    int64_t timeout_ms;
+    std::string error;
+    if (!parse_timeout(parts.back(), timeout_ms, error)) return error;
+
+    std::vector<std::string> keys(parts.begin() + 1, parts.end() - 1);
+    for (const auto& key : keys) {
+        ValueWithExpiry* value = lookup_key_write(key);
+        if (!value) continue;
+        if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+
+        QuickList& list = value->as<QuickList>();
+        std::string element;
+        if (front) {
+            list.pop_front(element);
+        } else {
+            list.pop_back(element);
+        }
+        if (list.size() == 0) kv_store.erase(key);
+
+        client.propagate_as.emplace().push_back({front ? "LPOP" : "RPOP", key});
+        std::string reply = resp_array_header(2);
+        resp_append_bulk(reply, key);
+        resp_append_bulk(reply, element);
+        return reply;
+    }
+
+    block_on_keys(client, keys, timeout_ms, false);
+    client.propagate_as.emplace();
+    return "*-1\r\n";
+}
+
+static std::string cmd_blpop(const std::vector<std::string>& parts, ClientContext& client) {
+    return bpop_generic(parts, client, true);
+}
+
+static std::string cmd_brpop(const std::vector<std::string>& parts, ClientContext& client) {
+    return bpop_generic(parts, client, false);
+}
+
+// LEFT or RIGHT, as true for the head of the list
+static bool parse_side(const std::string& arg, bool& front) {
+    std::string side = to_upper(arg);
+    if (side != "LEFT" && side != "RIGHT") return false;
+    front = side == "LEFT";
+    return true;
+}
+
+// Move an element from source's from_front end to destination's to_front
+// end. False if source is empty or either key holds something other than
+// a list, which sets error.
+static bool move_element(const std::string& source, const std::string& destination, bool from_front, bool to_front,
+                         std::string& element, std::string& error) {
+    ValueWithExpiry* src = lookup_key_write(source);
+    if (!src) return false;
+    ValueWithExpiry* dst = lookup_key_write(destination);
+    if (src->type != ValueType::List || (dst && dst->type != ValueType::List)) {
+        error = WRONGTYPE_ERROR;
+        return false;
+    }
+
+    QuickList& list = src->as<QuickList>();
+    if (from_front) {
+        list.pop_front(element);
+    } else {
+        list.pop_back(element);
+    }
+    if (list.size() == 0 && source != destination) {
+        kv_store.erase(source);
+    }
+
+    if (!dst) dst = &(kv_store[destination] = ValueWithExpiry(ValueType::List, make_list()));
+    QuickList& target = dst->as<QuickList>();
+    if (to_front) {
+        target.push_front(element);
+    } else {
+        target.push_back(element);
+    }
+    return true;
+}
+
+// LMOVE, and BLMOVE and BRPOPLPUSH once their arguments are parsed.
+// Replicas always get the LMOVE.
+static std::string move_generic(const std::string& source, const std::string& destination, bool from_front,
+                                bool to_front, ClientContext& client, int64_t timeout_ms = -1) {
+    std::string element, error;
+    if (move_element(source, destination, from_front, to_front, element, error)) {
+        client.propagate_as.emplace().push_back(
+            {"LMOVE", source, destination, from_front ? "LEFT" : "RIGHT", to_front ? "LEFT" : "RIGHT"});
+        return resp_bulk(element);
+    }
+    if (!error.empty()) return error;
+
+    if (timeout_ms >= 0) block_on_keys(client, {source}, timeout_ms, false);
+    client.propagate_as.emplace();
+    return resp_null();
+}
+
+// LMOVE source destination LEFT|RIGHT LEFT|RIGHT
+static std::string cmd_lmove(const std::vector<std::string>& parts, ClientContext& client) {
+    bool from_front, to_front;
+    if (!parse_side(parts[3], from_front) || !parse_side(parts[4], to_front)) return "-ERR syntax error\r\n";
+    return move_generic(parts[1], parts[2], from_front, to_front, client);
+}
+
+// RPOPLPUSH source destination
+static std::string cmd_rpoplpush(const std::vector<std::string>& parts, ClientContext& client) {
+    return move_generic(parts[1], parts[2], false, true, client);
+}
+
+// BLMOVE source destination LEFT|RIGHT LEFT|RIGHT timeout
+static std::string cmd_blmove(const std::vector<std::string>& parts, ClientContext& client) {
+    bool from_front, to_front;
+    if (!parse_side(parts[3], from_front) || !parse_side(parts[4], to_front)) return "-ERR syntax error\r\n";
+    int64_t timeout_ms;
+    std::string error;
+    if (!parse_timeout(parts[5], timeout_ms, error)) return error;
+    return move_generic(parts[1], parts[2], from_front, to_front, client, timeout_ms);
+}
+
+// BRPOPLPUSH source destination timeout
+static std::string cmd_brpoplpush(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t timeout_ms;
+    std::string error;
+    if (!parse_timeout(parts[3], timeout_ms, error)) return error;
+    return move_generic(parts[1], parts[2], false, true, client, timeout_ms);
+}
+
+void register_blocking_commands() {
+    register_command({"BLPOP", -3, CMD_WRITE | CMD_BLOCKING, cmd_blpop, 1, -2, 1});
+    register_command({"BRPOP", -3, CMD_WRITE | CMD_BLOCKING, cmd_brpop, 1, -2, 1});
+    register_command({"LMOVE", 5, CMD_WRITE, cmd_lmove, 1, 2, 1});
+    register_command({"RPOPLPUSH", 3, CMD_WRITE, cmd_rpoplpush, 1, 2, 1});
+    register_command({"BLMOVE", 6, CMD_WRITE | CMD_BLOCKING, cmd_blmove, 1, 2, 1});
+    register_command({"BRPOPLPUSH", 4, CMD_WRITE | CMD_BLOCKING, cmd_brpoplpush, 1, 2, 1});
+}
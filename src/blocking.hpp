@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+
+// Blocking list commands: BLPOP, BRPOP, BLMOVE and BRPOPLPUSH. XREAD and
+// XREADGROUP block through the same calls, from stream.cpp.
+void register_blocking_commands();
+
+// Called by the handler of a CMD_BLOCKING command that found nothing to
+// serve, with kv_mutex held: park the client on keys once the handler
+// returns, for timeout_ms or for ever when 0. With fan_out every parked
+// client is woken by a write to the key, otherwise only the longest
+// waiting one. retry, if given, replaces the command when it runs again,
+// e.g. XREAD with $ resolved to the IDs it started from. Does nothing
+// inside MULTI, scripts and the replication stream, where the handler's
+// reply stands as if the timeout had passed.
+void block_on_keys(ClientContext& client, const std::vector<std::string>& keys, int64_t timeout_ms, bool fan_out,
+                   std::vector<std::string> retry = {});
+
+// Wait while the client is parked. True once a write to one of its keys
+// woke it and the command should run again; false on timeout, when the
+// client hung up or when it wasn't parked, after which its keys are
+// released.
+bool blocking_wait(ClientContext& client);
+
+// The command to run again after blocking_wait: parts, or its retry
+const std::vector<std::string>& blocking_command(const ClientContext& client, const std::vector<std::string>& parts);
+
+// Wake the clients parked on the keys of a write that changed them.
+// Costs nothing while no client is blocked. Caller holds kv_mutex
+// exclusively.
+void signal_keys(const Command& command, const std::vector<std::string>& parts);
+
+// Number of clients parked right now, for INFO
+size_t blocked_clients();
@@ -0,0 +1,600 @@
+#include "bloom.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+static constexpr int BLOCK_BITS = 512;
+// Past this many bits per item a layer spends a whole block on each item
+static constexpr double MAX_BITS_PER_ITEM = BLOCK_BITS;
+// Layers and tables are refused beyond the size of the largest string
+static constexpr uint64_t MAX_FILTER_BYTES = uint64_t(512) * 1024 * 1024;
+static constexpr size_t MAX_CUCKOO_TABLES = 32;
+
+static constexpr double BLOOM_DEFAULT_ERROR_RATE = 0.01;
+static constexpr uint64_t BLOOM_DEFAULT_CAPACITY = 100;
+static constexpr uint32_t BLOOM_DEFAULT_EXPANSION = 2;
+static constexpr uint64_t CUCKOO_DEFAULT_CAPACITY = 1024;
+static constexpr uint32_t CUCKOO_DEFAULT_MAX_ITERATIONS = 20;
+static constexpr uint32_t CUCKOO_DEFAULT_EXPANSION = 1;
+
+uint64_t bloom_hash(std::string_view item) {
+    return murmur_hash64a(item, 0x5f3759dfULL);
+}
+
+// Index in [0, n) from the high bits of a hash, without a division
+static uint64_t reduce(uint64_t hash, uint64_t n) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * n) >> 64);
+}
+
+// Further hashes to place bits inside a block, independent of the block
+// index (splitmix64's finalizer)
+static uint64_t remix(uint64_t hash) {
+    uint64_t z = hash + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// False positive rate of a blocked filter: the classic rate for the load
+// of a block, averaged over how many items land in a block, which is
+// Poisson distributed. Uneven loads make it worse than an unblocked
+// filter of the same size.
+static double blocked_error_rate(double bits_per_item, uint32_t hashes) {
+    double lambda = BLOCK_BITS / bits_per_item;
+    double log_clear = hashes * std::log1p(-1.0 / BLOCK_BITS);
+    double limit = lambda + 10 * std::sqrt(lambda) + 10;
+    double weight = std::exp(-lambda);
+    double rate = 0;
+    for (int load = 0; load <= limit; load++) {
+        rate += weight * std::pow(-std::expm1(log_clear * load), hashes);
+        weight *= lambda / (load + 1);
+    }
+    return rate;
+}
+
+// Bits per item and bits set per item that keep a blocked layer under
+// error_rate: the classic optimum grown a step at a time until it does
+static void bloom_sizing(double error_rate, double& bits_per_item, uint32_t& hashes) {
+    bits_per_item = -std::log(error_rate) / (M_LN2 * M_LN2);
+    for (;; bits_per_item *= 1.03) {
+        if (bits_per_item >= MAX_BITS_PER_ITEM) {
+            bits_per_item = MAX_BITS_PER_ITEM;
+            hashes = 64;
+            return;
+        }
+        double best = 1;
+        hashes = 1;
+        for (uint32_t k = 1; k <= 64; k++) {
+            double rate = blocked_error_rate(bits_per_item, k);
+            if (rate > best) break;
+            best = rate;
+            hashes = k;
+        }
+        if (best <= error_rate) return;
+    }
+}
+
+static uint64_t bloom_layer_blocks(double error_rate, uint64_t capacity, uint32_t& hashes) {
+    double bits_per_item;
+    bloom_sizing(error_rate, bits_per_item, hashes);
+    double blocks = std::ceil(static_cast<double>(capacity) * bits_per_item / BLOCK_BITS);
+    return static_cast<uint64_t>(std::max(blocks, 1.0));
+}
+
+// The bits an item sets in its block, as one mask per word. Each 64-bit
+// remix of the hash gives seven independent 9-bit positions.
+static void block_mask(uint64_t hash, uint32_t hashes, uint64_t (&mask)[8]) {
+    std::fill(std::begin(mask), std::end(mask), 0);
+    uint64_t h = hash;
+    for (uint32_t i = 0; i < hashes; i++) {
+        if (i % 7 == 0) h = remix(h);
+        uint32_t pos = (h >> (9 * (i % 7))) & (BLOCK_BITS - 1);
+        mask[pos >> 6] |= uint64_t(1) << (pos & 63);
+    }
+}
+
+BloomObject::Layer BloomObject::make_layer(double error_rate, uint64_t capacity) {
+    Layer layer;
+    layer.capacity = capacity;
+    layer.error_rate = error_rate;
+    layer.blocks.resize(bloom_layer_blocks(error_rate, capacity, layer.hashes));
+    return layer;
+}
+
+BloomObject::BloomObject(double error_rate, uint64_t capacity, uint32_t expansion) : expansion_(expansion) {
+    // Layers take half, a quarter, ... of the error rate, a sum that stays
+    // under the whole of it however far the filter grows
+    layers_.push_back(make_layer(expansion ? error_rate / 2 : error_rate, capacity));
+}
+
+bool BloomObject::contains(uint64_t hash) const {
+    uint64_t mask[8];
+    uint32_t mask_hashes = 0;
+    for (const Layer& layer : layers_) {
+        if (layer.hashes != mask_hashes) {
+            block_mask(hash, layer.hashes, mask);
+            mask_hashes = layer.hashes;
+        }
+        const BloomBlock& block = layer.blocks[reduce(hash, layer.blocks.size())];
+        uint64_t missing = 0;
+        for (int w = 0; w < 8; w++) missing |= mask[w] & ~block.words[w];
+        if (!missing) return true;
+    }
+    return false;
+}
+
+bool BloomObject::add(uint64_t hash) {
+    if (layers_.back().items >= layers_.back().capacity) {
+        if (expansion_ == 0) return false;
+        const Layer& last = layers_.back();
+        uint64_t capacity = last.capacity * expansion_;
+        uint32_t hashes;
+        if (capacity / expansion_ != last.capacity ||
+            bloom_layer_blocks(last.error_rate / 2, capacity, hashes) > MAX_FILTER_BYTES / sizeof(BloomBlock)) {
+            return false;
+        }
+        layers_.push_back(make_layer(last.error_rate / 2, capacity));
+    }
+
+    Layer& layer = layers_.back();
+    uint64_t mask[8];
+    block_mask(hash, layer.hashes, mask);
+    BloomBlock& block = layer.blocks[reduce(hash, layer.blocks.size())];
+    for (int w = 0; w < 8; w++) block.words[w] |= mask[w];
+    layer.items++;
+    return true;
+}
+
+void BloomObject::prefetch(uint64_t hash) const {
+    for (const Layer& layer : layers_) __builtin_prefetch(&layer.blocks[reduce(hash, layer.blocks.size())]);
+}
+
+uint64_t BloomObject::items() const {
+    uint64_t items = 0;
+    for (const Layer& layer : layers_) items += layer.items;
+    return items;
+}
+
+bool BloomObject::load_layer(Layer layer) {
+    if (layer.blocks.empty() || layer.hashes == 0 || layer.hashes > 64 || layer.capacity == 0) return false;
+    layers_.push_back(std::move(layer));
+    return true;
+}
+
+size_t BloomObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + layers_.capacity() * sizeof(Layer);
+    for (const Layer& layer : layers_) bytes += layer.blocks.capacity() * sizeof(BloomBlock);
+    return bytes;
+}
+
+// Cuckoo filter. The fingerprint is the top 16 bits of the hash, the first
+// bucket comes from the low 32, and the second is derived from the first
+// and the fingerprint alone, so a fingerprint can be moved between its two
+// buckets without knowing the item.
+
+static constexpr uint64_t LANE_LOW = 0x0001000100010001ULL;
+static constexpr uint64_t LANE_MAX = 0x7fff7fff7fff7fffULL;
+
+static uint16_t fingerprint(uint64_t hash) {
+    uint16_t fp = static_cast<uint16_t>(hash >> 48);
+    return fp ? fp : 1;
+}
+
+static uint64_t first_bucket(uint64_t hash, uint64_t buckets) {
+    return (static_cast<uint32_t>(hash) * buckets) >> 32;
+}
+
+// The other bucket of a fingerprint: (h(fp) - index) mod buckets, which
+// maps each of the pair to the other
+static uint64_t other_bucket(uint64_t index, uint16_t fp, uint64_t buckets) {
+    uint64_t h = ((fp * 0x9e3779b97f4a7c15ULL) >> 32) * buckets >> 32;
+    return h >= index ? h - index : h + buckets - index;
+}
+
+// High bit of each 16-bit lane of the bucket holding fp
+static uint64_t lanes_matching(uint64_t bucket, uint16_t fp) {
+    uint64_t x = bucket ^ (fp * LANE_LOW);
+    return ~(((x & LANE_MAX) + LANE_MAX) | x | LANE_MAX);
+}
+
+static uint64_t bucket_count(uint64_t capacity) {
+    return std::max<uint64_t>((capacity + CuckooObject::BUCKET_SLOTS - 1) / CuckooObject::BUCKET_SLOTS, 1);
+}
+
+static bool place(uint64_t& bucket, uint16_t fp) {
+    uint64_t free = lanes_matching(bucket, 0);
+    if (!free) return false;
+    bucket |= uint64_t(fp) << (std::countr_zero(free) - 15);
+    return true;
+}
+
+CuckooObject::CuckooObject(uint64_t capacity, uint32_t max_iterations, uint32_t expansion) :
+    max_iterations_(max_iterations), expansion_(expansion) {
+    tables_.push_back(Table{std::vector<uint64_t>(bucket_count(capacity))});
+}
+
+uint64_t CuckooObject::count(uint64_t hash) const {
+    uint16_t fp = fingerprint(hash);
+    uint64_t count = 0;
+    for (const Table& table : tables_) {
+        uint64_t i1 = first_bucket(hash, table.buckets.size());
+        uint64_t i2 = other_bucket(i1, fp, table.buckets.size());
+        count += std::popcount(lanes_matching(table.buckets[i1], fp));
+        if (i2 != i1) count += std::popcount(lanes_matching(table.buckets[i2], fp));
+    }
+    return count;
+}
+
+bool CuckooObject::contains(uint64_t hash) const {
+    uint16_t fp = fingerprint(hash);
+    for (const Table& table : tables_) {
+        uint64_t i1 = first_bucket(hash, table.buckets.size());
+        uint64_t i2 = other_bucket(i1, fp, table.buckets.size());
+        if (lanes_matching(table.buckets[i1], fp) | lanes_matching(table.buckets[i2], fp)) return true;
+    }
+    return false;
+}
+
+// Make room by moving fingerprints to their other buckets, up to
+// max_iterations moves. The victim slot is picked from the fingerprint
+// and the move count, so replicas make the same moves. A failed attempt
+// is undone, leaving the table as it was.
+bool CuckooObject::insert(Table& table, uint16_t fp, uint64_t index) {
+    struct Move {
+        uint64_t index;
+        int shift;
+        uint16_t fp;
+    };
+    std::vector<Move> moves;
+    uint64_t buckets = table.buckets.size();
+    for (uint32_t n = 0; n < max_iterations_; n++) {
+        int shift = 16 * ((fp + n) % BUCKET_SLOTS);
+        uint64_t& bucket = table.buckets[index];
+        uint16_t victim = static_cast<uint16_t>(bucket >> shift);
+        bucket = (bucket & ~(uint64_t(0xffff) << shift)) | (uint64_t(fp) << shift);
+        moves.push_back({index, shift, victim});
+        fp = victim;
+        index = other_bucket(index, fp, buckets);
+        if (place(table.buckets[index], fp)) return true;
+    }
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it) {
+        uint64_t& bucket = table.buckets[it->index];
+        bucket = (bucket & ~(uint64_t(0xffff) << it->shift)) | (uint64_t(it->fp) << it->shift);
+    }
+    return false;
+}
+
+bool CuckooObject::add(uint64_t hash) {
+    uint16_t fp = fingerprint(hash);
+    for (Table& table : tables_) {
+        uint64_t i1 = first_bucket(hash, table.buckets.size());
+        if (place(table.buckets[i1], fp) || place(table.buckets[other_bucket(i1, fp, table.buckets.size())], fp)) {
+            items_++;
+            return true;
+        }
+    }
+
+    Table& last = tables_.back();
+    if (insert(last, fp, first_bucket(hash, last.buckets.size()))) {
+        items_++;
+        return true;
+    }
+
+    uint64_t buckets = last.buckets.size() * expansion_;
+    if (expansion_ == 0 || tables_.size() >= MAX_CUCKOO_TABLES || buckets / expansion_ != last.buckets.size() ||
+        buckets > MAX_FILTER_BYTES / sizeof(uint64_t)) {
+        return false;
+    }
+    tables_.push_back(Table{std::vector<uint64_t>(buckets)});
+    Table& table = tables_.back();
+    place(table.buckets[first_bucket(hash, buckets)], fp);
+    items_++;
+    return true;
+}
+
+bool CuckooObject::remove(uint64_t hash) {
+    uint16_t fp = fingerprint(hash);
+    for (auto table = tables_.rbegin(); table != tables_.rend(); ++table) {
+        uint64_t i1 = first_bucket(hash, table->buckets.size());
+        for (uint64_t index : {i1, other_bucket(i1, fp, table->buckets.size())}) {
+            uint64_t& bucket = table->buckets[index];
+            uint64_t match = lanes_matching(bucket, fp);
+            if (!match) continue;
+            bucket &= ~(uint64_t(0xffff) << (std::countr_zero(match) - 15));
+            items_--;
+            deletes_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CuckooObject::prefetch(uint64_t hash) const {
+    uint16_t fp = fingerprint(hash);
+    for (const Table& table : tables_) {
+        uint64_t i1 = first_bucket(hash, table.buckets.size());
+        __builtin_prefetch(&table.buckets[i1]);
+        __builtin_prefetch(&table.buckets[other_bucket(i1, fp, table.buckets.size())]);
+    }
+}
+
+bool CuckooObject::load_table(Table table) {
+    if (table.buckets.empty()) return false;
+    tables_.push_back(std::move(table));
+    return true;
+}
+
+void CuckooObject::load_counters(uint64_t items, uint64_t deletes) {
+    items_ = items;
+    deletes_ = deletes;
+}
+
+size_t CuckooObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + tables_.capacity() * sizeof(Table);
+    for (const Table& table : tables_) bytes += table.buckets.capacity() * sizeof(uint64_t);
+    return bytes;
+}
+
+// Commands
+
+static constexpr const char* SYNTAX_ERROR = "-ERR syntax error\r\n";
+static constexpr const char* ITEM_EXISTS_ERROR = "-ERR item exists\r\n";
+static constexpr const char* BLOOM_FULL_ERROR = "-ERR non scaling filter is full\r\n";
+static constexpr const char* CUCKOO_FULL_ERROR = "-ERR Filter is full\r\n";
+
+// Filter of type T at key, nullptr if missing or of another type (which
+// sets error)
+template <typename T>
+static T* filter_at(ValueWithExpiry* value, ValueType type, std::string& error) {
+    if (!value) return nullptr;
+    if (value->type != type) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->as<T>();
+}
+
+static BloomObject* bloom_for_write(const std::string& key, bool create, std::string& error) {
+    BloomObject* bloom = filter_at<BloomObject>(lookup_key_write(key), ValueType::Bloom, error);
+    if (!bloom && create && error.empty()) {
+        auto object = std::make_unique<BloomObject>(BLOOM_DEFAULT_ERROR_RATE, BLOOM_DEFAULT_CAPACITY,
+                                                    BLOOM_DEFAULT_EXPANSION);
+        bloom = object.get();
+        kv_store[key] = ValueWithExpiry(ValueType::Bloom, std::move(object));
+    }
+    return bloom;
+}
+
+static CuckooObject* cuckoo_for_write(const std::string& key, bool create, std::string& error) {
+    CuckooObject* cuckoo = filter_at<CuckooObject>(lookup_key_write(key), ValueType::Cuckoo, error);
+    if (!cuckoo && create && error.empty()) {
+        auto object = std::make_unique<CuckooObject>(CUCKOO_DEFAULT_CAPACITY, CUCKOO_DEFAULT_MAX_ITERATIONS,
+                                                     CUCKOO_DEFAULT_EXPANSION);
+        cuckoo = object.get();
+        kv_store[key] = ValueWithExpiry(ValueType::Cuckoo, std::move(object));
+    }
+    return cuckoo;
+}
+
+// Hashes of parts[first..], with the cache lines they map to in filter
+// already on their way, so a batch waits for memory once rather than
+// once per item
+template <typename T>
+static std::vector<uint64_t> hash_items(const std::vector<std::string>& parts, size_t first, const T* filter) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(parts.size() - first);
+    for (size_t i = first; i < parts.size(); i++) {
+        hashes.push_back(bloom_hash(parts[i]));
+        if (filter) filter->prefetch(hashes.back());
+    }
+    return hashes;
+}
+
+static bool parse_positive(const std::string& arg, uint64_t& value) {
+    int64_t parsed;
+    if (!string_to_int64(arg, parsed) || parsed <= 0) return false;
+    value = static_cast<uint64_t>(parsed);
+    return true;
+}
+
+// BF.RESERVE key error_rate capacity [EXPANSION expansion] [NONSCALING]
+static std::string cmd_bf_reserve(const std::vector<std::string>& parts, ClientContext& client) {
+    double error_rate;
+    if (!string_to_double(parts[2], error_rate)) return "-ERR bad error rate\r\n";
+    if (!(error_rate > 0 && error_rate < 1)) return "-ERR (0 < error rate range < 1)\r\n";
+    int64_t capacity;
+    if (!string_to_int64(parts[3], capacity)) return "-ERR bad capacity\r\n";
+    if (capacity <= 0) return "-ERR (capacity should be larger than 0)\r\n";
+
+    uint64_t expansion = BLOOM_DEFAULT_EXPANSION;
+    bool expansion_given = false, nonscaling = false;
+    for (size_t i = 4; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "EXPANSION" && i + 1 < parts.size()) {
+            if (!parse_positive(parts[++i], expansion) || expansion > UINT32_MAX) {
+                return "-ERR expansion should be greater or equal to 1\r\n";
+            }
+            expansion_given = true;
+        } else if (option == "NONSCALING") {
+            nonscaling = true;
+        } else {
+            return SYNTAX_ERROR;
+        }
+    }
+    if (nonscaling && expansion_given) return "-ERR Nonscaling filters cannot expand\r\n";
+
+    if (lookup_key_write(parts[1])) return ITEM_EXISTS_ERROR;
+    uint32_t hashes;
+    if (bloom_layer_blocks(nonscaling ? error_rate : error_rate / 2, capacity, hashes) >
+        MAX_FILTER_BYTES / sizeof(BloomBlock)) {
+        return "-ERR filter would be larger than 512 MB\r\n";
+    }
+    kv_store[parts[1]] = ValueWithExpiry(
+        ValueType::Bloom, std::make_unique<BloomObject>(error_rate, capacity, nonscaling ? 0 : expansion));
+    return "+OK\r\n";
+}
+
+// BF.ADD key item
+static std::string cmd_bf_add(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    BloomObject* bloom = bloom_for_write(parts[1], true, error);
+    if (!bloom) return error;
+
+    uint64_t hash = bloom_hash(parts[2]);
+    if (bloom->contains(hash)) return resp_integer(0);
+    if (!bloom->add(hash)) return BLOOM_FULL_ERROR;
+    return resp_integer(1);
+}
+
+// BF.MADD key item [item ...]
+static std::string cmd_bf_madd(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    BloomObject* bloom = bloom_for_write(parts[1], true, error);
+    if (!bloom) return error;
+
+    std::string reply = resp_array_header(parts.size() - 2);
+    for (uint64_t hash : hash_items(parts, 2, bloom)) {
+        if (bloom->contains(hash)) {
+            reply += resp_integer(0);
+        } else {
+            reply += bloom->add(hash) ? resp_integer(1) : BLOOM_FULL_ERROR;
+        }
+    }
+    return reply;
+}
+
+// BF.EXISTS key item
+static std::string cmd_bf_exists(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const BloomObject* bloom = filter_at<BloomObject>(lookup_key_read(parts[1], client), ValueType::Bloom, error);
+    if (!error.empty()) return error;
+    return resp_integer(bloom && bloom->contains(bloom_hash(parts[2])));
+}
+
+// BF.MEXISTS key item [item ...]
+static std::string cmd_bf_mexists(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const BloomObject* bloom = filter_at<BloomObject>(lookup_key_read(parts[1], client), ValueType::Bloom, error);
+    if (!error.empty()) return error;
+
+    std::string reply = resp_array_header(parts.size() - 2);
+    for (uint64_t hash : hash_items(parts, 2, bloom)) reply += resp_integer(bloom && bloom->contains(hash));
+    return reply;
+}
+
+// BF.CARD key
+static std::string cmd_bf_card(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const BloomObject* bloom = filter_at<BloomObject>(lookup_key_read(parts[1], client), ValueType::Bloom, error);
+    if (!error.empty()) return error;
+    return resp_integer(bloom ? static_cast<int64_t>(bloom->items()) : 0);
+}
+
+// CF.RESERVE key capacity [MAXITERATIONS iterations] [EXPANSION expansion]
+static std::string cmd_cf_reserve(const std::vector<std::string>& parts, ClientContext& client) {
+    uint64_t capacity;
+    if (!parse_positive(parts[2], capacity)) return "-ERR Bad capacity\r\n";
+    uint64_t max_iterations = CUCKOO_DEFAULT_MAX_ITERATIONS;
+    uint64_t expansion = CUCKOO_DEFAULT_EXPANSION;
+    for (size_t i = 3; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "MAXITERATIONS" && i + 1 < parts.size()) {
+            if (!parse_positive(parts[++i], max_iterations) || max_iterations > 65535) {
+                return "-ERR MAXITERATIONS: value must be an integer between 1 and 65535, inclusive.\r\n";
+            }
+        } else if (option == "EXPANSION" && i + 1 < parts.size()) {
+            int64_t parsed;
+            if (!string_to_int64(parts[++i], parsed) || parsed < 0 || parsed > 32768) {
+                return "-ERR EXPANSION: value must be an integer between 0 and 32768, inclusive.\r\n";
+            }
+            expansion = static_cast<uint64_t>(parsed);
+        } else {
+            return SYNTAX_ERROR;
+        }
+    }
+
+    if (lookup_key_write(parts[1])) return ITEM_EXISTS_ERROR;
+    if (bucket_count(capacity) > MAX_FILTER_BYTES / sizeof(uint64_t)) {
+        return "-ERR filter would be larger than 512 MB\r\n";
+    }
+    kv_store[parts[1]] = ValueWithExpiry(ValueType::Cuckoo, std::make_unique<CuckooObject>(capacity, max_iterations,
+                                                                                         expansion));
+    return "+OK\r\n";
+}
+
+// CF.ADD key item
+static std::string cmd_cf_add(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    CuckooObject* cuckoo = cuckoo_for_write(parts[1], true, error);
+    if (!cuckoo) return error;
+    return cuckoo->add(bloom_hash(parts[2])) ? resp_integer(1) : CUCKOO_FULL_ERROR;
+}
+
+// CF.ADDNX key item
+static std::string cmd_cf_addnx(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    CuckooObject* cuckoo = cuckoo_for_write(parts[1], true, error);
+    if (!cuckoo) return error;
+    uint64_t hash = bloom_hash(parts[2]);
+    if (cuckoo->contains(hash)) return resp_integer(0);
+    return cuckoo->add(hash) ? resp_integer(1) : CUCKOO_FULL_ERROR;
+}
+
+// CF.DEL key item
+static std::string cmd_cf_del(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    CuckooObject* cuckoo = cuckoo_for_write(parts[1], false, error);
+    if (!cuckoo) return error.empty() ? "-ERR Not found\r\n" : error;
+    return resp_integer(cuckoo->remove(bloom_hash(parts[2])));
+}
+
+// CF.EXISTS key item
+static std::string cmd_cf_exists(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const CuckooObject* cuckoo =
+        filter_at<CuckooObject>(lookup_key_read(parts[1], client), ValueType::Cuckoo, error);
+    if (!error.empty()) return error;
+    return resp_integer(cuckoo && cuckoo->contains(bloom_hash(parts[2])));
+}
+
+// CF.MEXISTS key item [item ...]
+static std::string cmd_cf_mexists(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const CuckooObject* cuckoo =
+        filter_at<CuckooObject>(lookup_key_read(parts[1], client), ValueType::Cuckoo, error);
+    if (!error.empty()) return error;
+
+    std::string reply = resp_array_header(parts.size() - 2);
+    for (uint64_t hash : hash_items(parts, 2, cuckoo)) reply += resp_integer(cuckoo && cuckoo->contains(hash));
+    return reply;
+}
+
+// CF.COUNT key item
+static std::string cmd_cf_count(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const CuckooObject* cuckoo =
+        filter_at<CuckooObject>(lookup_key_read(parts[1], client), ValueType::Cuckoo, error);
+    if (!error.empty()) return error;
+    return resp_integer(cuckoo ? static_cast<int64_t>(cuckoo->count(bloom_hash(parts[2]))) : 0);
+}
+
+void register_bloom_commands() {
+    register_command({"BF.RESERVE", -4, CMD_WRITE, cmd_bf_reserve, 1, 1, 1});
+    register_command({"BF.ADD", 3, CMD_WRITE, cmd_bf_add, 1, 1, 1});
+    register_command({"BF.MADD", -3, CMD_WRITE, cmd_bf_madd, 1, 1, 1});
+    register_command({"BF.EXISTS", 3, CMD_READONLY, cmd_bf_exists, 1, 1, 1});
+    register_command({"BF.MEXISTS", -3, CMD_READONLY, cmd_bf_mexists, 1, 1, 1});
+    register_command({"BF.CARD", 2, CMD_READONLY, cmd_bf_card, 1, 1, 1});
+    register_command({"CF.RESERVE", -3, CMD_WRITE, cmd_cf_reserve, 1, 1, 1});
+    register_command({"CF.ADD", 3, CMD_WRITE, cmd_cf_add, 1, 1, 1});
+    register_command({"CF.ADDNX", 3, CMD_WRITE, cmd_cf_addnx, 1, 1, 1});
+    register_command({"CF.DEL", 3, CMD_WRITE, cmd_cf_del, 1, 1, 1});
+    register_command({"CF.EXISTS", 3, CMD_READONLY, cmd_cf_exists, 1, 1, 1});
+    register_command({"CF.MEXISTS", -3, CMD_READONLY, cmd_cf_mexists, 1, 1, 1});
+    register_command({"CF.COUNT", 3, CMD_READONLY, cmd_cf_count, 1, 1, 1});
+}
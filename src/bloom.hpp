@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "store.hpp"
+
+// Probabilistic membership filters, the BF.* and CF.* commands. Items are
+// hashed once with bloom_hash and the filters work on the 64-bit hash.
+uint64_t bloom_hash(std::string_view item);
+
+// One cache line of a Bloom filter
+struct alignas(64) BloomBlock {
+    uint64_t words[8] = {};
+};
+
+// A scalable Bloom filter: a chain of layers, each sized for its capacity
+// at its error rate. Once the newest layer is full another is added with
+// expansion times the capacity and half the error rate; the first takes
+// half the requested rate, so the chain as a whole stays under it.
+// Expansion 0 makes a single layer with the full rate that refuses items
+// once it is full.
+//
+// Layers are blocked: an item sets all of its bits inside one 512-bit
+// block picked by its hash, so a lookup touches one cache line per layer
+// instead of one per bit.
+class BloomObject : public DataObject {
+public:
+    struct Layer {
+        uint64_t capacity = 0;
+        uint64_t items = 0;
+        double error_rate = 0;
+        uint32_t hashes = 0;  // bits set per item
+        std::vector<BloomBlock> blocks;
+    };
+
+    BloomObject(double error_rate, uint64_t capacity, uint32_t expansion);
+    // Empty chain for the RDB loader to fill with load_layer
+    explicit BloomObject(uint32_t expansion) : expansion_(expansion) {}
+
+    bool contains(uint64_t hash) const;
+    // Add an item contains() said no to, false if the filter is full
+    bool add(uint64_t hash);
+    // Start loading the cache lines an item maps to
+    void prefetch(uint64_t hash) const;
+
+    uint64_t items() const;
+    uint32_t expansion() const { return expansion_; }
+    const std::vector<Layer>& layers() const { return layers_; }
+    bool load_layer(Layer layer);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return "blocked"; }
+
+private:
+    static Layer make_layer(double error_rate, uint64_t capacity);
+
+    std::vector<Layer> layers_;
+    uint32_t expansion_;
+};
+
+// A cuckoo filter: 16-bit fingerprints in buckets of four, each item
+// having two candidate buckets. Unlike a Bloom filter it supports deletes
+// and counts. When an insert can't make room by relocating fingerprints,
+// another table of expansion times the previous size is chained on;
+// expansion 0 makes the filter report itself full instead.
+class CuckooObject : public DataObject {
+public:
+    static constexpr int BUCKET_SLOTS = 4;
+
+    struct Table {
+        std::vector<uint64_t> buckets;  // four fingerprints each, 0 is a free slot
+    };
+
+    CuckooObject(uint64_t capacity, uint32_t max_iterations, uint32_t expansion);
+    // No tables, for the RDB loader to fill with load_table
+    CuckooObject(uint32_t max_iterations, uint32_t expansion) :
+        max_iterations_(max_iterations), expansion_(expansion) {}
+
+    // Number of stored copies of the item's fingerprint
+    uint64_t count(uint64_t hash) const;
+    bool contains(uint64_t hash) const;
+    // False if the filter is full
+    bool add(uint64_t hash);
+    // Remove one copy, false if there was none
+    bool remove(uint64_t hash);
+    void prefetch(uint64_t hash) const;
+
+    uint64_t items() const { return items_; }
+    uint64_t deletes() const { return deletes_; }
+    uint32_t max_iterations() const { return max_iterations_; }
+    uint32_t expansion() const { return expansion_; }
+    const std::vector<Table>& tables() const { return tables_; }
+    bool load_table(Table table);
+    void load_counters(uint64_t items, uint64_t deletes);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return "cuckoo"; }
+
+private:
+    bool insert(Table& table, uint16_t fingerprint, uint64_t index);
+
+    std::vector<Table> tables_;
+    uint64_t items_ = 0;
+    uint64_t deletes_ = 0;
+    uint32_t max_iterations_;
+    uint32_t expansion_;
+};
+
+void register_bloom_commands();
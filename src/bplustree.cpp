@@ -0,0 +1,364 @@
+#include "bplustree.hpp"
+
+#include <cstring>
+
+// Element order: by score, then by member bytes
+static bool key_less(double score, std::string_view member, double other_score, std::string_view other) {
+    return score < other_score || (score == other_score && member < other);
+}
+
+void BPlusTree::Cursor::next() {
+    if (++index < leaf->count) return;
+    leaf = leaf->next;
+    index = 0;
+}
+
+void BPlusTree::Cursor::prev() {
+    if (index > 0) {
+        index--;
+        return;
+    }
+    leaf = leaf->prev;
+    if (leaf) index = leaf->count - 1;
+}
+
+BPlusTree::BPlusTree() : root_(new Leaf()) {}
+
+BPlusTree::~BPlusTree() {
+    free_tree(root_);
+}
+
+void BPlusTree::free_tree(Node* node) {
+    if (node->leaf) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for (size_t i = 0; i < inner->count; i++) free_tree(inner->children[i]);
+    delete inner;
+}
+
+size_t BPlusTree::subtree_size(const Node* node) {
+    if (node->leaf) return node->count;
+    const Inner* inner = static_cast<const Inner*>(node);
+    size_t size = 0;
+    for (size_t i = 0; i < inner->count; i++) size += inner->sizes[i];
+    return size;
+}
+
+// Refresh the smallest key of child i from the child itself
+void BPlusTree::set_key(Inner* parent, size_t i) {
+    const Node* child = parent->children[i];
+    if (child->leaf) {
+        parent->scores[i] = static_cast<const Leaf*>(child)->scores[0];
+        parent->members[i] = static_cast<const Leaf*>(child)->members[0];
+    } else {
+        parent->scores[i] = static_cast<const Inner*>(child)->scores[0];
+        parent->members[i] = static_cast<const Inner*>(child)->members[0];
+    }
+}
+
+// Child whose range holds the key: the last one starting at or before it
+size_t BPlusTree::child_index(const Inner* node, double score, std::string_view member) {
+    size_t low = 1, high = node->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (key_less(score, member, node->scores[mid], *node->members[mid])) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low - 1;
+}
+
+// Array shuffles on the parallel arrays of a node
+template <typename T>
+static void open_gap(T* array, size_t pos, size_t count) {
+    std::memmove(array + pos + 1, array + pos, (count - pos) * sizeof(T));
+}
+
+template <typename T>
+static void close_gap(T* array, size_t pos, size_t count) {
+    std::memmove(array + pos, array + pos + 1, (count - pos - 1) * sizeof(T));
+}
+
+template <typename T>
+static void copy_entries(T* from, size_t start, size_t count, T* to) {
+    std::memcpy(to, from + start, count * sizeof(T));
+}
+
+void BPlusTree::insert_child(Inner* node, size_t pos, Node* child) {
+    open_gap(node->scores, pos, node->count);
+    open_gap(node->members, pos, node->count);
+    open_gap(node->sizes, pos, node->count);
+    open_gap(node->children, pos, node->count);
+    node->children[pos] = child;
+    node->sizes[pos] = subtree_size(child);
+    node->count++;
+    set_key(node, pos);
+}
+
+void BPlusTree::remove_child(Inner* node, size_t pos) {
+    close_gap(node->scores, pos, node->count);
+    close_gap(node->members, pos, node->count);
+    close_gap(node->sizes, pos, node->count);
+    close_gap(node->children, pos, node->count);
+    node->count--;
+}
+
+// Insert below node, returning the new right sibling if node had to split
+BPlusTree::Node* BPlusTree::insert_into(Node* node, double score, const std::string* member) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        Leaf* right = nullptr;
+        if (leaf->count == LEAF_CAPACITY) {
+            right = new Leaf();
+            leaves_++;
+            size_t half = LEAF_CAPACITY / 2;
+            right->count = LEAF_CAPACITY - half;
+            copy_entries(leaf->scores, half, right->count, right->scores);
+            copy_entries(leaf->members, half, right->count, right->members);
+            leaf->count = half;
+
+            right->next = leaf->next;
+            right->prev = leaf;
+            if (leaf->next) leaf->next->prev = right;
+            leaf->next = right;
+
+            if (!key_less(score, *member, right->scores[0], *right->members[0])) leaf = right;
+        }
+
+        size_t pos = 0, high = leaf->count;
+        while (pos < high) {
+            size_t mid = (pos + high) / 2;
+            if (key_less(leaf->scores[mid], *leaf->members[mid], score, *member)) {
+                pos = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        open_gap(leaf->scores, pos, leaf->count);
+        open_gap(leaf->members, pos, leaf->count);
+        leaf->scores[pos] = score;
+        leaf->members[pos] = member;
+        leaf->count++;
+        return right;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    size_t i = child_index(inner, score, *member);
+    Node* split = insert_into(inner->children[i], score, member);
+    inner->sizes[i]++;
+    set_key(inner, i);
+    if (!split) return nullptr;
+
+    inner->sizes[i] = subtree_size(inner->children[i]);
+    Inner* right = nullptr;
+    Inner* target = inner;
+    size_t pos = i + 1;
+    if (inner->count == INNER_CAPACITY) {
+        right = new Inner();
+        inners_++;
+        size_t half = INNER_CAPACITY / 2;
+        right->count = INNER_CAPACITY - half;
+        copy_entries(inner->scores, half, right->count, right->scores);
+        copy_entries(inner->members, half, right->count, right->members);
+        copy_entries(inner->sizes, half, right->count, right->sizes);
+        copy_entries(inner->children, half, right->count, right->children);
+        inner->count = half;
+        if (pos > half) {
+            target = right;
+            pos -= half;
+        }
+    }
+    insert_child(target, pos, split);
+    return right;
+}
+
+void BPlusTree::insert(double score, const std::string* member) {
+    Node* split = insert_into(root_, score, member);
+    size_++;
+    if (!split) return;
+
+    Inner* root = new Inner();
+    inners_++;
+    insert_child(root, 0, root_);
+    insert_child(root, 1, split);
+    root_ = root;
+}
+
+// Even out two neighbouring children after a delete left one of them thin,
+// merging them into the left one when they fit in a single node
+void BPlusTree::rebalance(Inner* parent, size_t left) {
+    Node* a = parent->children[left];
+    Node* b = parent->children[left + 1];
+    size_t total = a->count + b->count;
+
+    if (a->leaf) {
+        Leaf* x = static_cast<Leaf*>(a);
+        Leaf* y = static_cast<Leaf*>(b);
+        if (total <= LEAF_CAPACITY) {
+            copy_entries(y->scores, 0, y->count, x->scores + x->count);
+            copy_entries(y->members, 0, y->count, x->members + x->count);
+            x->count = total;
+            x->next = y->next;
+            if (y->next) y->next->prev = x;
+            delete y;
+            leaves_--;
+            remove_child(parent, left + 1);
+            parent->sizes[left] = total;
+            return;
+        }
+
+        size_t target = total / 2;
+        if (x->count < target) {
+            size_t n = target - x->count;
+            copy_entries(y->scores, 0, n, x->scores + x->count);
+            copy_entries(y->members, 0, n, x->members + x->count);
+            std::memmove(y->scores, y->scores + n, (y->count - n) * sizeof(double));
+            std::memmove(y->members, y->members + n, (y->count - n) * sizeof(void*));
+        } else {
+            size_t n = x->count - target;
+            std::memmove(y->scores + n, y->scores, y->count * sizeof(double));
+            std::memmove(y->members + n, y->members, y->count * sizeof(void*));
+            copy_entries(x->scores, target, n, y->scores);
+            copy_entries(x->members, target, n, y->members);
+        }
+        x->count = target;
+        y->count = total - target;
+    } else {
+        Inner* x = static_cast<Inner*>(a);
+        Inner* y = static_cast<Inner*>(b);
+        if (total <= INNER_CAPACITY) {
+            copy_entries(y->scores, 0, y->count, x->scores + x->count);
+            copy_entries(y->members, 0, y->count, x->members + x->count);
+            copy_entries(y->sizes, 0, y->count, x->sizes + x->count);
+            copy_entries(y->children, 0, y->count, x->children + x->count);
+            x->count = total;
+            delete y;
+            inners_--;
+            remove_child(parent, left + 1);
+            parent->sizes[left] = subtree_size(x);
+            return;
+        }
+
+        size_t target = total / 2;
+        if (x->count < target) {
+            size_t n = target - x->count;
+            copy_entries(y->scores, 0, n, x->scores + x->count);
+            copy_entries(y->members, 0, n, x->members + x->count);
+            copy_entries(y->sizes, 0, n, x->sizes + x->count);
+            copy_entries(y->children, 0, n, x->children + x->count);
+            std::memmove(y->scores, y->scores + n, (y->count - n) * sizeof(double));
+            std::memmove(y->members, y->members + n, (y->count - n) * sizeof(void*));
+            std::memmove(y->sizes, y->sizes + n, (y->count - n) * sizeof(size_t));
+            std::memmove(y->children, y->children + n, (y->count - n) * sizeof(void*));
+        } else {
+            size_t n = x->count - target;
+            std::memmove(y->scores + n, y->scores, y->count * sizeof(double));
+            std::memmove(y->members + n, y->members, y->count * sizeof(void*));
+            std::memmove(y->sizes + n, y->sizes, y->count * sizeof(size_t));
+            std::memmove(y->children + n, y->children, y->count * sizeof(void*));
+            copy_entries(x->scores, target, n, y->scores);
+            copy_entries(x->members, target, n, y->members);
+            copy_entries(x->sizes, target, n, y->sizes);
+            copy_entries(x->children, target, n, y->children);
+        }
+        x->count = target;
+        y->count = total - target;
+    }
+
+    parent->sizes[left] = subtree_size(a);
+    parent->sizes[left + 1] = subtree_size(b);
+    set_key(parent, left + 1);
+}
+
+bool BPlusTree::erase_from(Node* node, double score, std::string_view member) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        size_t pos = 0, high = leaf->count;
+        while (pos < high) {
+            size_t mid = (pos + high) / 2;
+            if (key_less(leaf->scores[mid], *leaf->members[mid], score, member)) {
+                pos = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (pos == leaf->count || leaf->scores[pos] != score || *leaf->members[pos] != member) return false;
+        close_gap(leaf->scores, pos, leaf->count);
+        close_gap(leaf->members, pos, leaf->count);
+        leaf->count--;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    size_t i = child_index(inner, score, member);
+    Node* child = inner->children[i];
+    if (!erase_from(child, score, member)) return false;
+    inner->sizes[i]--;
+
+    if (child->count == 0) {
+        if (child->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(child);
+            if (leaf->prev) leaf->prev->next = leaf->next;
+            if (leaf->next) leaf->next->prev = leaf->prev;
+            delete leaf;
+            leaves_--;
+        } else {
+            delete static_cast<Inner*>(child);
+            inners_--;
+        }
+        remove_child(inner, i);
+        return true;
+    }
+
+    set_key(inner, i);
+    size_t capacity = child->leaf ? LEAF_CAPACITY : INNER_CAPACITY;
+    if (child->count < capacity / 4 && inner->count > 1) {
+        rebalance(inner, i + 1 < inner->count ? i : i - 1);
+    }
+    return true;
+}
+
+bool BPlusTree::erase(double score, std::string_view member) {
+    if (!erase_from(root_, score, member)) return false;
+    size_--;
+
+    // Drop roots left with a single child
+    while (!root_->leaf && root_->count <= 1) {
+        Inner* old = static_cast<Inner*>(root_);
+        root_ = old->count == 1 ? old->children[0] : new Leaf();
+        if (old->count == 0) leaves_++;
+        delete old;
+        inners_--;
+    }
+    return true;
+}
+
+size_t BPlusTree::rank(double score, std::string_view member) const {
+    return count_before([&](double other_score, std::string_view other) {
+        return key_less(other_score, other, score, member);
+    });
+}
+
+BPlusTree::Cursor BPlusTree::at_rank(size_t rank) const {
+    if (rank >= size_) return Cursor();
+
+    const Node* node = root_;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        size_t i = 0;
+        while (rank >= inner->sizes[i]) {
+            rank -= inner->sizes[i];
+            i++;
+        }
+        node = inner->children[i];
+    }
+    return Cursor{static_cast<const Leaf*>(node), rank};
+}
+
+size_t BPlusTree::memory_usage() const {
+    return sizeof(*this) + leaves_ * sizeof(Leaf) + inners_ * sizeof(Inner);
+}
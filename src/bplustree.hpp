@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Members ordered by (score, member) in a B+tree of 1 KB nodes, the
+// alternative to SkipList for large sorted sets. Leaves hold 62 entries
+// as parallel arrays of scores and member pointers and are linked both
+// ways for range scans. Inner nodes keep, per child, its smallest key and
+// its element count, so ranks are summed on the way down like skiplist
+// spans. Each lookup touches a handful of contiguous nodes instead of one
+// scattered node per level.
+//
+// Members are owned by the sorted set's member -> score map; entries point
+// at its keys. Every key held by an inner node is the current minimum of
+// its child, so none of them outlives the member it points at.
+class BPlusTree {
+public:
+    static constexpr size_t NODE_BYTES = 1024;
+
+    struct Node {
+        unsigned short count = 0;
+        bool leaf;
+        explicit Node(bool is_leaf) : leaf(is_leaf) {}
+    };
+    static constexpr size_t LEAF_CAPACITY = (NODE_BYTES - 24) / (sizeof(double) + sizeof(void*));
+    static constexpr size_t INNER_CAPACITY = (NODE_BYTES - 8) / (sizeof(double) + 3 * sizeof(void*));
+
+    struct alignas(64) Leaf : Node {
+        Leaf* prev = nullptr;
+        Leaf* next = nullptr;
+        double scores[LEAF_CAPACITY];
+        const std::string* members[LEAF_CAPACITY];
+        Leaf() : Node(true) {}
+    };
+    // Key i is the smallest key under child i, size i the elements under it
+    struct alignas(64) Inner : Node {
+        double scores[INNER_CAPACITY];
+        const std::string* members[INNER_CAPACITY];
+        size_t sizes[INNER_CAPACITY];
+        Node* children[INNER_CAPACITY];
+        Inner() : Node(false) {}
+    };
+
+    // Position of one element, for walking ranges through the leaf chain
+    struct Cursor {
+        const Leaf* leaf = nullptr;
+        size_t index = 0;
+
+        bool valid() const { return leaf != nullptr; }
+        double score() const { return leaf->scores[index]; }
+        const std::string& member() const { return *leaf->members[index]; }
+        void next();
+        void prev();
+    };
+
+    BPlusTree();
+    ~BPlusTree();
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    size_t size() const { return size_; }
+
+    // Insert a member that is not in the tree yet
+    void insert(double score, const std::string* member);
+    bool erase(double score, std::string_view member);
+
+    // 0-based rank of a member known to be in the tree
+    size_t rank(double score, std::string_view member) const;
+    // Element at a 0-based rank, invalid past the end
+    Cursor at_rank(size_t rank) const;
+
+    // Number of elements for which before(score, member) holds. before must
+    // be true for a prefix of the tree and false after it.
+    template <typename F>
+    size_t count_before(F&& before) const;
+
+    size_t memory_usage() const;
+
+private:
+    static size_t subtree_size(const Node* node);
+    static void set_key(Inner* parent, size_t i);
+    static size_t child_index(const Inner* node, double score, std::string_view member);
+
+    Node* insert_into(Node* node, double score, const std::string* member);
+    bool erase_from(Node* node, double score, std::string_view member);
+    void insert_child(Inner* node, size_t pos, Node* child);
+    void remove_child(Inner* node, size_t pos);
+    void rebalance(Inner* parent, size_t left);
+    void free_tree(Node* node);
+
+    Node* root_;
+    size_t size_ = 0;
+    size_t leaves_ = 1;
+    size_t inners_ = 0;
+};
+
+static_assert(sizeof(BPlusTree::Leaf) <= BPlusTree::NODE_BYTES);
+static_assert(sizeof(BPlusTree::Inner) <= BPlusTree::NODE_BYTES);
+
+template <typename F>
+size_t BPlusTree::count_before(F&& before) const {
+    size_t rank = 0;
+    const Node* node = root_;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        // Children whose smallest key is before the bound; the bound falls
+        // inside the last of them
+        size_t low = 0, high = inner->count;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (before(inner->scores[mid], *inner->members[mid])) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low == 0) return rank;
+        for (size_t i = 0; i + 1 < low; i++) rank += inner->sizes[i];
+        node = inner->children[low - 1];
+    }
+
+    const Leaf* leaf = static_cast<const Leaf*>(node);
+    size_t low = 0, high = leaf->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (before(leaf->scores[mid], *leaf->members[mid])) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return rank + low;
+}
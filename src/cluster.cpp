@@ -0,0 +1,637 @@
+#include "cluster.hpp"
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <unistd.h>
+
+#include "crc16.hpp"
+#include "migrate.hpp"
+#include "net.hpp"
+#include "pubsub.hpp"
+#include "resp.hpp"
+#include "store.hpp"
+
+// A node from the static topology file. Membership is fixed at startup;
+// only slot ownership and migration states change at runtime.
+struct ClusterNode {
+    std::string id;
+    std::string host;
+    int port = 0;
+    std::string master_id;  // empty for masters
+};
+
+struct SlotState {
+    ClusterNode* owner = nullptr;
+    ClusterNode* migrating_to = nullptr;    // set on the source while keys move out
+    ClusterNode* importing_from = nullptr;  // set on the target while keys move in
+};
+
+// Guards the slot table. Lock order is kv_mutex before cluster_mutex.
+static std::shared_mutex cluster_mutex;
+static std::vector<std::unique_ptr<ClusterNode>> nodes;
+static ClusterNode* myself = nullptr;
+static std::array<SlotState, CLUSTER_SLOTS> slots;
+
+int key_hash_slot(const std::string& key) {
+    size_t open = key.find('{');
+    if (open != std::string::npos) {
+        size_t close = key.find('}', open + 1);
+        // An empty tag "{}" hashes the whole key
+        if (close != std::string::npos && close != open + 1) {
+            return crc16(key.data() + open + 1, close - open - 1) & (CLUSTER_SLOTS - 1);
+        }
+    }
+    return crc16(key.data(), key.size()) & (CLUSTER_SLOTS - 1);
+}
+
+static ClusterNode* find_node(const std::string& id) {
+    for (auto& node : nodes) {
+        if (node->id == id) return node.get();
+    }
+    return nullptr;
+}
+
+static bool parse_slot_range(const std::string& token, int& start, int& end) {
+    try {
+        size_t dash = token.find('-');
+        start = std::stoi(token.substr(0, dash));
+        end = dash == std::string::npos ? start : std::stoi(token.substr(dash + 1));
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return start >= 0 && start <= end && end < CLUSTER_SLOTS;
+}
+
+// One node per line:
+//   <id> <host>:<port> master <slot>|<start>-<end> ...
+//   <id> <host>:<port> replica <master-id>
+static bool load_topology(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open cluster config " << path << "\n";
+        return false;
+    }
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> slot_specs;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream iss(line);
+        std::string id, addr, role;
+        if (!(iss >> id)) continue;
+        if (!(iss >> addr >> role)) {
+            std::cerr << path << ":" << line_no << ": expected <id> <host>:<port> <role>\n";
+            return false;
+        }
+
+        auto node = std::make_unique<ClusterNode>();
+        node->id = id;
+        size_t colon = addr.rfind(':');
+        try {
+            if (colon == std::string::npos) throw std::invalid_argument(addr);
+            node->host = addr.substr(0, colon);
+            node->port = std::stoi(addr.substr(colon + 1));
+        } catch (const std::exception& e) {
+            std::cerr << path << ":" << line_no << ": bad address " << addr << "\n";
+            return false;
+        }
+
+        role = to_upper(role);
+        if (role == "MASTER") {
+            std::vector<std::string> ranges;
+            std::string token;
+            while (iss >> token) ranges.push_back(token);
+            slot_specs.emplace_back(id, ranges);
+        } else if (role == "REPLICA" || role == "SLAVE") {
+            if (!(iss >> node->master_id)) {
+                std::cerr << path << ":" << line_no << ": replica needs a master id\n";
+                return false;
+            }
+        } else {
+            std::cerr << path << ":" << line_no << ": unknown role " << role << "\n";
+            return false;
+        }
+
+        if (find_node(id)) {
+            std::cerr << path << ":" << line_no << ": duplicate node id " << id << "\n";
+            return false;
+        }
+        nodes.push_back(std::move(node));
+    }
+
+    for (const auto& [id, ranges] : slot_specs) {
+        ClusterNode* owner = find_node(id);
+        for (const auto& token : ranges) {
+            int start, end;
+            if (!parse_slot_range(token, start, end)) {
+                std::cerr << "Bad slot range " << token << " for node " << id << "\n";
+                return false;
+            }
+            for (int slot = start; slot <= end; slot++) {
+                if (slots[slot].owner) {
+                    std::cerr << "Slot " << slot << " is assigned twice\n";
+                    return false;
+                }
+                slots[slot].owner = owner;
+            }
+        }
+    }
+
+    for (const auto& node : nodes) {
+        if (!node->master_id.empty() && !find_node(node->master_id)) {
+            std::cerr << "Replica " << node->id << " follows unknown master " << node->master_id << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cluster_init() {
+    if (!load_topology(server_config.cluster_config_file)) return false;
+
+    // Without an explicit id, we are the only node listening on our port
+    for (auto& node : nodes) {
+        bool match = server_config.cluster_node_id.empty()
+            ? node->port == server_config.port
+            : node->id == server_config.cluster_node_id;
+        if (!match) continue;
+        if (myself) {
+            std::cerr << "Several cluster nodes match this server, use --cluster-node-id\n";
+            return false;
+        }
+        myself = node.get();
+    }
+    if (!myself) {
+        std::cerr << "This server is not part of the cluster topology\n";
+        return false;
+    }
+
+    if (!myself->master_id.empty()) {
+        ClusterNode* master = find_node(myself->master_id);
+        server_config.master_host = master->host;
+        server_config.master_port = master->port;
+    }
+
+    std::cout << "Cluster node " << myself->id << " loaded " << nodes.size() << " nodes\n";
+    return true;
+}
+
+static std::string redirect(const char* kind, int slot, const ClusterNode& node) {
+    return "-" + std::string(kind) + " " + std::to_string(slot) + " " + node.host + ":"
+        + std::to_string(node.port) + "\r\n";
+}
+
+std::string cluster_route(const Command& command, const std::vector<std::string>& parts, ClientContext& client) {
+    // ASKING only covers the command right after it
+    bool asking = client.asking || (command.flags & CMD_ASKING);
+    client.asking = false;
+
+    if (!server_config.cluster_enabled || client.is_master) return "";
+
+    std::vector<size_t> positions = command_key_positions(command, parts);
+    if (positions.empty()) return "";
+
+    int slot = -1;
+    for (size_t pos : positions) {
+        int key_slot = key_hash_slot(parts[pos]);
+        if (slot != -1 && key_slot != slot) {
+            return "-CROSSSLOT Keys in request don't hash to the same slot\r\n";
+        }
+        slot = key_slot;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+    const SlotState& state = slots[slot];
+    if (!state.owner) {
+        return "-CLUSTERDOWN Hash slot not served\r\n";
+    }
+
+    if (state.owner == myself) {
+        // Shard channels stay here until the slot itself is handed over
+        if (!state.migrating_to || (command.flags & CMD_SHARD_CHANNEL)) return "";
+
+        // Keys that already moved to the target are served there
+        size_t missing = 0;
+        for (size_t pos : positions) {
+            auto it = kv_store.find(parts[pos]);
+            if (it == kv_store.end() || it->second.is_expired()) missing++;
+        }
+        if (missing == 0) return "";
+        if (missing == positions.size()) return redirect("ASK", slot, *state.migrating_to);
+        return "-TRYAGAIN Multiple keys request during rehashing of slot\r\n";
+    }
+
+    if (state.importing_from && asking) return "";
+
+    // Replicas of the owner serve reads to clients that opted in with READONLY
+    if (client.readonly && !(command.flags & CMD_WRITE) && myself->master_id == state.owner->id) {
+        return "";
+    }
+    return redirect("MOVED", slot, *state.owner);
+}
+
+// Caller holds cluster_mutex
+static std::vector<std::pair<int, int>> slot_ranges_of(const ClusterNode* node) {
+    std::vector<std::pair<int, int>> ranges;
+    for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        if (slots[slot].owner != node) continue;
+        if (!ranges.empty() && ranges.back().second == slot - 1) {
+            ranges.back().second = slot;
+        } else {
+            ranges.emplace_back(slot, slot);
+        }
+    }
+    return ranges;
+}
+
+static std::vector<const ClusterNode*> replicas_of(const ClusterNode* master) {
+    std::vector<const ClusterNode*> result;
+    for (const auto& node : nodes) {
+        if (node->master_id == master->id) result.push_back(node.get());
+    }
+    return result;
+}
+
+static std::string cluster_nodes() {
+    std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+    std::ostringstream out;
+
+    for (const auto& node : nodes) {
+        bool is_master = node->master_id.empty();
+        out << node->id << " " << node->host << ":" << node->port << "@" << node->port + 10000 << " "
+            << (node.get() == myself ? "myself," : "") << (is_master ? "master" : "slave") << " "
+            << (is_master ? "-" : node->master_id) << " 0 0 0 connected";
+
+        for (const auto& [start, end] : slot_ranges_of(node.get())) {
+            out << " " << start;
+            if (end != start) out << "-" << end;
+        }
+        if (node.get() == myself) {
+            for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+                if (slots[slot].migrating_to) out << " [" << slot << "->-" << slots[slot].migrating_to->id << "]";
+                if (slots[slot].importing_from) out << " [" << slot << "-<-" << slots[slot].importing_from->id << "]";
+            }
+        }
+        out << "\n";
+    }
+    return resp_bulk(out.str());
+}
+
+static std::string node_endpoint(const ClusterNode& node) {
+    return resp_array_header(3) + resp_bulk(node.host) + resp_integer(node.port) + resp_bulk(node.id);
+}
+
+static std::string cluster_slots() {
+    std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+
+    // Contiguous runs with the same owner, in slot order
+    std::vector<std::pair<std::pair<int, int>, const ClusterNode*>> runs;
+    for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        const ClusterNode* owner = slots[slot].owner;
+        if (!owner) continue;
+        if (!runs.empty() && runs.back().second == owner && runs.back().first.second == slot - 1) {
+            runs.back().first.second = slot;
+        } else {
+            runs.push_back({{slot, slot}, owner});
+        }
+    }
+
+    std::string out = resp_array_header(runs.size());
+    for (const auto& [range, owner] : runs) {
+        std::vector<const ClusterNode*> followers = replicas_of(owner);
+        out += resp_array_header(3 + followers.size());
+        out += resp_integer(range.first) + resp_integer(range.second);
+        out += node_endpoint(*owner);
+        for (const ClusterNode* replica : followers) {
+            out += node_endpoint(*replica);
+        }
+    }
+    return out;
+}
+
+static std::string shard_node(const ClusterNode& node, const char* role) {
+    return resp_array_header(14)
+        + resp_bulk("id") + resp_bulk(node.id)
+        + resp_bulk("port") + resp_integer(node.port)
+        + resp_bulk("ip") + resp_bulk(node.host)
+        + resp_bulk("endpoint") + resp_bulk(node.host)
+        + resp_bulk("role") + resp_bulk(role)
+        + resp_bulk("replication-offset") + resp_integer(0)
+        + resp_bulk("health") + resp_bulk("online");
+}
+
+static std::string cluster_shards() {
+    std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+
+    std::vector<const ClusterNode*> masters;
+    for (const auto& node : nodes) {
+        if (node->master_id.empty()) masters.push_back(node.get());
+    }
+
+    std::string out = resp_array_header(masters.size());
+    for (const ClusterNode* master : masters) {
+        std::vector<std::pair<int, int>> ranges = slot_ranges_of(master);
+        std::vector<const ClusterNode*> followers = replicas_of(master);
+
+        out += resp_array_header(4);
+        out += resp_bulk("slots") + resp_array_header(ranges.size() * 2);
+        for (const auto& [start, end] : ranges) {
+            out += resp_integer(start) + resp_integer(end);
+        }
+        out += resp_bulk("nodes") + resp_array_header(1 + followers.size());
+        out += shard_node(*master, "master");
+        for (const ClusterNode* replica : followers) {
+            out += shard_node(*replica, "replica");
+        }
+    }
+    return out;
+}
+
+std::string cluster_info() {
+    if (!server_config.cluster_enabled) return "# Cluster\r\ncluster_enabled:0\r\n";
+
+    std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+    int assigned = 0;
+    for (const auto& state : slots) {
+        if (state.owner) assigned++;
+    }
+    int size = 0;
+    for (const auto& node : nodes) {
+        if (node->master_id.empty() && !slot_ranges_of(node.get()).empty()) size++;
+    }
+
+    std::ostringstream info;
+    info << "# Cluster\r\n";
+    info << "cluster_enabled:1\r\n";
+    info << "cluster_state:" << (assigned == CLUSTER_SLOTS ? "ok" : "fail") << "\r\n";
+    info << "cluster_slots_assigned:" << assigned << "\r\n";
+    info << "cluster_known_nodes:" << nodes.size() << "\r\n";
+    info << "cluster_size:" << size << "\r\n";
+    return info.str();
+}
+
+// CLUSTER SETSLOT <slot> IMPORTING|MIGRATING|NODE <node-id> or STABLE
+static std::string cluster_setslot(const std::vector<std::string>& parts) {
+    if (parts.size() < 4) return "-ERR wrong number of arguments for 'cluster|setslot' command\r\n";
+
+    int slot;
+    if (!parse_slot_range(parts[2], slot, slot)) return "-ERR Invalid or out of range slot\r\n";
+
+    std::string action = to_upper(parts[3]);
+    ClusterNode* node = nullptr;
+    if (action != "STABLE") {
+        if (parts.size() < 5) return "-ERR syntax error\r\n";
+        node = find_node(parts[4]);
+        if (!node) return "-ERR I don't know about node " + parts[4] + "\r\n";
+        if (!node->master_id.empty()) return "-ERR Target node is not a master\r\n";
+    }
+
+    std::unique_lock<std::shared_mutex> lock(cluster_mutex);
+    SlotState& state = slots[slot];
+    bool given_away = false;
+
+    if (action == "MIGRATING") {
+        if (state.owner != myself) return "-ERR I'm not the owner of hash slot " + parts[2] + "\r\n";
+        state.migrating_to = node;
+    } else if (action == "IMPORTING") {
+        if (state.owner == myself) return "-ERR I'm already the owner of hash slot " + parts[2] + "\r\n";
+        state.importing_from = node;
+    } else if (action == "NODE") {
+        given_away = state.owner == myself && node != myself;
+        state.owner = node;
+        state.migrating_to = nullptr;
+        state.importing_from = nullptr;
+    } else if (action == "STABLE") {
+        state.migrating_to = nullptr;
+        state.importing_from = nullptr;
+    } else {
+        return "-ERR Invalid CLUSTER SETSLOT action or number of arguments\r\n";
+    }
+    lock.unlock();
+
+    // Shard channels live on the slot's owner only
+    if (given_away) pubsub_drop_shard_slot(slot);
+    return "+OK\r\n";
+}
+
+// Live keys hashing to a slot. There is no per-slot index, so this walks the
+// whole keyspace; fine for occasional admin commands and one pass per
+// migration. Takes kv_mutex itself.
+static std::vector<std::string> keys_in_slot(int slot, size_t limit) {
+    std::vector<std::string> keys;
+    std::shared_lock<std::shared_mutex> lock(kv_mutex);
+    for (const auto& [key, value] : kv_store) {
+        if (keys.size() >= limit) break;
+        if (value.is_expired() || key_hash_slot(key) != slot) continue;
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Send one command on a connection we own and read a single-line reply
+static bool node_command(int fd, std::string& buffer, const std::vector<std::string>& command, std::string& reply) {
+    return send_all(fd, resp_command(command)) && read_line(fd, buffer, reply);
+}
+
+// CLUSTER MIGRATESLOT <slot> <node-id> [BATCH keys] [PIPELINE batches]
+//
+// Moves a whole slot we own to another master: marks it IMPORTING on the
+// target and MIGRATING here, so clients get ASK for keys that already left,
+// then streams the keys over as pipelined RESTORE-ASKING batches, keeping
+// several batches in flight to hide the round trip. Keys written while their
+// batch was in flight are sent again. Once the slot is empty, ownership is
+// handed to the target, then to us, then to every other node.
+static std::string cluster_migrateslot(const std::vector<std::string>& parts) {
+    if (parts.size() < 4) return "-ERR wrong number of arguments for 'cluster|migrateslot' command\r\n";
+
+    int slot;
+    if (!parse_slot_range(parts[2], slot, slot)) return "-ERR Invalid or out of range slot\r\n";
+
+    size_t batch_size = 100;
+    size_t pipeline = 8;
+    for (size_t i = 4; i + 1 < parts.size(); i += 2) {
+        std::string option = to_upper(parts[i]);
+        long long n;
+        try {
+            n = std::stoll(parts[i + 1]);
+        } catch (const std::exception& e) {
+            return "-ERR value is not an integer or out of range\r\n";
+        }
+        if (n <= 0) return "-ERR value is out of range, must be positive\r\n";
+        if (option == "BATCH") {
+            batch_size = n;
+        } else if (option == "PIPELINE") {
+            pipeline = n;
+        } else {
+            return "-ERR syntax error\r\n";
+        }
+    }
+    if (parts.size() % 2 != 0) return "-ERR syntax error\r\n";
+
+    ClusterNode* target = find_node(parts[3]);
+    if (!target) return "-ERR I don't know about node " + parts[3] + "\r\n";
+    if (!target->master_id.empty()) return "-ERR Target node is not a master\r\n";
+    if (target == myself) return "-ERR Can't migrate a slot to myself\r\n";
+    {
+        std::shared_lock<std::shared_mutex> lock(cluster_mutex);
+        if (slots[slot].owner != myself) return "-ERR I'm not the owner of hash slot " + parts[2] + "\r\n";
+        if (slots[slot].migrating_to) return "-ERR Hash slot " + parts[2] + " is already migrating\r\n";
+    }
+
+    int fd = connect_tcp(target->host, target->port);
+    if (fd < 0) return "-IOERR error connecting to the target node\r\n";
+
+    auto start = std::chrono::steady_clock::now();
+    std::string buffer;
+    std::string reply;
+    if (!node_command(fd, buffer, {"CLUSTER", "SETSLOT", parts[2], "IMPORTING", myself->id}, reply) || reply != "+OK") {
+        close(fd);
+        return "-ERR Target refused to import the slot: " + reply + "\r\n";
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(cluster_mutex);
+        slots[slot].migrating_to = target;
+    }
+
+    // New keys in a migrating slot are created on the target via ASK, so
+    // after one pass the only leftovers are keys that changed mid-flight
+    std::deque<std::string> pending;
+    for (auto& key : keys_in_slot(slot, SIZE_MAX)) pending.push_back(std::move(key));
+
+    std::deque<MigrationBatch> in_flight;
+    size_t moved = 0;
+    size_t retried = 0;
+    std::string error;
+    while (error.empty()) {
+        while (in_flight.size() < pipeline && !pending.empty()) {
+            size_t n = std::min(batch_size, pending.size());
+            std::vector<std::string> candidates(pending.begin(), pending.begin() + n);
+            pending.erase(pending.begin(), pending.begin() + n);
+
+            in_flight.emplace_back();
+            if (!migrate_send_batch(fd, candidates, in_flight.back(), true, true)) {
+                error = "IOERR error writing to the target node";
+                break;
+            }
+        }
+        if (!error.empty()) break;
+
+        if (in_flight.empty()) {
+            // Anything left behind by a retry that raced with expiry or writes
+            std::vector<std::string> left = keys_in_slot(slot, batch_size);
+            if (left.empty()) break;
+            pending.insert(pending.end(), left.begin(), left.end());
+            continue;
+        }
+
+        MigrationBatch& batch = in_flight.front();
+        if (!migrate_finish_batch(fd, buffer, batch, false)) {
+            error = "IOERR error reading from the target node";
+        } else if (!batch.error.empty()) {
+            error = batch.error;
+        }
+        moved += batch.moved;
+        retried += batch.retry.size();
+        pending.insert(pending.end(), batch.retry.begin(), batch.retry.end());
+        in_flight.pop_front();
+    }
+
+    if (!error.empty()) {
+        // Leave the slot MIGRATING/IMPORTING so it can be finished or rolled
+        // back by hand with SETSLOT, like an interrupted redis-cli reshard
+        close(fd);
+        return "-" + error + " (" + std::to_string(moved) + " keys moved)\r\n";
+    }
+
+    // The target must own the slot before we stop sending ASK for it
+    bool handed_over = node_command(fd, buffer, {"CLUSTER", "SETSLOT", parts[2], "NODE", target->id}, reply) && reply == "+OK";
+    close(fd);
+    if (!handed_over) return "-ERR Target failed to take ownership of the slot: " + reply + "\r\n";
+
+    {
+        std::unique_lock<std::shared_mutex> lock(cluster_mutex);
+        slots[slot].owner = target;
+        slots[slot].migrating_to = nullptr;
+        slots[slot].importing_from = nullptr;
+    }
+    pubsub_drop_shard_slot(slot);
+
+    // Best effort, nodes we can't reach catch up through MOVED from us
+    for (const auto& node : nodes) {
+        if (node.get() == myself || node.get() == target) continue;
+        int node_fd = connect_tcp(node->host, node->port);
+        if (node_fd < 0) continue;
+        std::string node_buffer;
+        node_command(node_fd, node_buffer, {"CLUSTER", "SETSLOT", parts[2], "NODE", target->id}, reply);
+        close(node_fd);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::string result = resp_array_header(6);
+    result += resp_bulk("moved") + resp_integer(moved);
+    result += resp_bulk("retried") + resp_integer(retried);
+    result += resp_bulk("elapsed_ms") + resp_integer(elapsed.count());
+    return result;
+}
+
+static std::string cmd_cluster(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string sub = to_upper(parts[1]);
+
+    if (sub == "KEYSLOT" && parts.size() == 3) {
+        return resp_integer(key_hash_slot(parts[2]));
+    }
+    if (!server_config.cluster_enabled) {
+        return "-ERR This instance has cluster support disabled\r\n";
+    }
+
+    if (sub == "MYID") return resp_bulk(myself->id);
+    if (sub == "INFO") return resp_bulk(cluster_info());
+    if (sub == "NODES") return cluster_nodes();
+    if (sub == "SLOTS") return cluster_slots();
+    if (sub == "SHARDS") return cluster_shards();
+    if (sub == "SETSLOT") return cluster_setslot(parts);
+    if (sub == "MIGRATESLOT") return cluster_migrateslot(parts);
+
+    if ((sub == "COUNTKEYSINSLOT" && parts.size() == 3) || (sub == "GETKEYSINSLOT" && parts.size() == 4)) {
+        int slot;
+        if (!parse_slot_range(parts[2], slot, slot)) return "-ERR Invalid slot\r\n";
+        if (sub == "COUNTKEYSINSLOT") return resp_integer(keys_in_slot(slot, SIZE_MAX).size());
+
+        long long count;
+        try {
+            count = std::stoll(parts[3]);
+        } catch (const std::exception& e) {
+            return "-ERR value is not an integer or out of range\r\n";
+        }
+        if (count < 0) return "-ERR Invalid number of keys\r\n";
+
+        std::vector<std::string> keys = keys_in_slot(slot, count);
+        std::string reply = resp_array_header(keys.size());
+        for (const auto& key : keys) reply += resp_bulk(key);
+        return reply;
+    }
+    return "-ERR unknown subcommand '" + parts[1] + "'\r\n";
+}
+
+static std::string cmd_asking(const std::vector<std::string>& parts, ClientContext& client) {
+    if (!server_config.cluster_enabled) {
+        return "-ERR This instance has cluster support disabled\r\n";
+    }
+    client.asking = true;
+    return "+OK\r\n";
+}
+
+void register_cluster_commands() {
+    register_command({"CLUSTER", -2, CMD_NO_MULTI, cmd_cluster});
+    register_command({"ASKING", 1, 0, cmd_asking});
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+
+constexpr int CLUSTER_SLOTS = 16384;
+
+// Hash slot of a key, hashing only the {tag} part when there is one
+int key_hash_slot(const std::string& key);
+
+// Load the static topology from cluster_config_file and find ourselves in
+// it. A node listed as a replica starts following its master.
+bool cluster_init();
+
+// Decide whether this node serves a keyed command. Returns a MOVED, ASK,
+// CROSSSLOT or CLUSTERDOWN error to send instead, or an empty string to go
+// ahead. Called with kv_mutex held so key existence checks for migrating
+// slots match what the command itself will see; CMD_SHARD_CHANNEL commands
+// check no keys and come without it.
+std::string cluster_route(const Command& command, const std::vector<std::string>& parts, ClientContext& client);
+
+// Body of INFO cluster
+std::string cluster_info();
+
+void register_cluster_commands();
@@ -0,0 +1,27 @@
+#include "crc16.hpp"
+
+#include <array>
+
+static constexpr uint16_t CRC16_POLY = 0x1021;
+
+static constexpr std::array<uint16_t, 256> make_crc16_table() {
+    std::array<uint16_t, 256> table{};
+    for (unsigned i = 0; i < 256; i++) {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ CRC16_POLY) : static_cast<uint16_t>(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, 256> crc16_table = make_crc16_table();
+
+uint16_t crc16(const char* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = static_cast<uint16_t>((crc << 8) ^ crc16_table[((crc >> 8) ^ static_cast<unsigned char>(data[i])) & 0xff]);
+    }
+    return crc;
+}
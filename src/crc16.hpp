@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-16/XMODEM as used by Redis Cluster to map keys to hash slots
+uint16_t crc16(const char* data, size_t len);
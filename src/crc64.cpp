@@ -0,0 +1,28 @@
+#include "crc64.hpp"
+
+#include <array>
+
+// Reflected form of the Jones polynomial 0xad93d23594c935a9
+static constexpr uint64_t CRC64_POLY = 0x95ac9329ac4bc9b5ULL;
+
+static constexpr std::array<uint64_t, 256> make_crc64_table() {
+    std::array<uint64_t, 256> table{};
+    for (uint64_t i = 0; i < 256; i++) {
+        uint64_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC64_POLY : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static constexpr std::array<uint64_t, 256> crc64_table = make_crc64_table();
+
+uint64_t crc64(uint64_t crc, const void* data, size_t len) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; i++) {
+        crc = crc64_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
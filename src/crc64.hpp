@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-64/Jones as used by Redis for RDB and DUMP payload checksums
+uint64_t crc64(uint64_t crc, const void* data, size_t len);
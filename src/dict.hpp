@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hash table from strings to values with the subset of the
+// std::unordered_map interface the server uses, plus cursor scanning.
+//
+// Buckets are chained and their number is a power of two, so an entry's
+// bucket is the low bits of its hash and growing or shrinking the table
+// splits or merges buckets along those bits. scan() relies on that: its
+// cursor walks bucket indexes in bit-reversed order, which returns every
+// entry present for the whole scan at least once however the table is
+// resized between calls.
+//
+// Nodes never move, so pointers and references to entries stay valid until
+// the entry is erased, as with std::unordered_map. Iterators are
+// invalidated by any insert.
+template <typename V>
+class Dict {
+public:
+    using value_type = std::pair<const std::string, V>;
+
+private:
+    struct Node {
+        Node* next;
+        size_t hash;
+        value_type entry;
+
+        template <typename... Args>
+        Node(size_t hash, Args&&... args) : next(nullptr), hash(hash), entry(std::forward<Args>(args)...) {}
+    };
+
+    template <bool Const>
+    class Iter {
+        using DictPtr = std::conditional_t<Const, const Dict*, Dict*>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Dict::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        Iter() = default;
+        Iter(const Iter<false>& other) : dict_(other.dict_), bucket_(other.bucket_), node_(other.node_) {}
+
+        reference operator*() const { return node_->entry; }
+        pointer operator->() const { return &node_->entry; }
+
+        Iter& operator++() {
+            node_ = node_->next;
+            if (!node_) settle(bucket_ + 1);
+            return *this;
+        }
+        Iter operator++(int) {
+            Iter old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iter& other) const { return node_ == other.node_; }
+
+    private:
+        friend class Dict;
+        template <bool>
+        friend class Iter;
+
+        Iter(DictPtr dict, size_t bucket, Node* node) : dict_(dict), bucket_(bucket), node_(node) {}
+
+        // Move to the first entry at or after bucket
+        void settle(size_t bucket) {
+            for (; bucket < dict_->buckets_.size(); bucket++) {
+                if (dict_->buckets_[bucket]) {
+                    bucket_ = bucket;
+                    node_ = dict_->buckets_[bucket];
+                    return;
+                }
+            }
+            node_ = nullptr;
+        }
+
+        DictPtr dict_ = nullptr;
+        size_t bucket_ = 0;
+        Node* node_ = nullptr;
+    };
+
+public:
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    Dict() = default;
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+    Dict(Dict&& other) noexcept :
+        buckets_(std::move(other.buckets_)), size_(std::exchange(other.size_, 0)) {}
+    Dict& operator=(Dict&& other) noexcept {
+        if (this != &other) {
+            clear();
+            buckets_ = std::move(other.buckets_);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+    ~Dict() { clear(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t bucket_count() const { return buckets_.size(); }
+
+    iterator begin() {
+        iterator it(this, 0, nullptr);
+        it.settle(0);
+        return it;
+    }
+    iterator end() { return iterator(this, 0, nullptr); }
+    const_iterator begin() const {
+        const_iterator it(this, 0, nullptr);
+        it.settle(0);
+        return it;
+    }
+    const_iterator end() const { return const_iterator(this, 0, nullptr); }
+
+    iterator find(std::string_view key) {
+        size_t hash = hash_of(key);
+        size_t bucket;
+        Node* node = find_node(key, hash, bucket);
+        return node ? iterator(this, bucket, node) : end();
+    }
+    const_iterator find(std::string_view key) const {
+        size_t hash = hash_of(key);
+        size_t bucket;
+        Node* node = find_node(key, hash, bucket);
+        return node ? const_iterator(this, bucket, node) : end();
+    }
+    size_t count(std::string_view key) const { return find(key) != end(); }
+    bool contains(std::string_view key) const { return find(key) != end(); }
+
+    // Add the entry unless the key is there, as std::unordered_map does
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        size_t hash = hash_of(key);
+        size_t bucket;
+        if (Node* node = find_node(key, hash, bucket)) return {iterator(this, bucket, node), false};
+        Node* node = new Node(hash, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+        return {link(node), true};
+    }
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+        return try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename M>
+    std::pair<iterator, bool> insert_or_assign(K&& key, M&& value) {
+        auto result = try_emplace(std::forward<K>(key), std::forward<M>(value));
+        if (!result.second) result.first->second = std::forward<M>(value);
+        return result;
+    }
+
+    V& operator[](const std::string& key) { return try_emplace(key).first->second; }
+    V& operator[](std::string&& key) { return try_emplace(std::move(key)).first->second; }
+
+    size_t erase(std::string_view key) {
+        size_t hash = hash_of(key);
+        if (buckets_.empty()) return 0;
+        for (Node** link = &buckets_[hash & mask()]; *link; link = &(*link)->next) {
+            Node* node = *link;
+            if (node->hash == hash && node->entry.first == key) {
+                *link = node->next;
+                delete node;
+                size_--;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Erase the entry at it, returning the iterator to the next one
+    iterator erase(const_iterator it) {
+        iterator next(this, it.bucket_, it.node_);
+        ++next;
+        Node** link = &buckets_[it.bucket_];
+        while (*link != it.node_) link = &(*link)->next;
+        *link = it.node_->next;
+        delete it.node_;
+        size_--;
+        return next;
+    }
+    iterator erase(iterator it) { return erase(const_iterator(it)); }
+
+    void clear() {
+        for (Node*& head : buckets_) {
+            while (head) delete std::exchange(head, head->next);
+        }
+        buckets_.clear();
+        size_ = 0;
+    }
+
+    // Make room for count entries without growing again
+    void reserve(size_t count) {
+        if (count > buckets_.size()) rehash(std::bit_ceil(count));
+    }
+
+    // Give back buckets once the table is mostly empty. Never done
+    // implicitly, so erasing while iterating is safe; owners call this
+    // after erasing.
+    void shrink() {
+        size_t target = std::max<size_t>(std::bit_ceil(size_), MIN_BUCKETS);
+        if (buckets_.size() > 4 * target) rehash(target);
+    }
+
+    // Start loading the first node of key's bucket, ahead of a find
+    void prefetch(std::string_view key) const {
+        if (buckets_.empty()) return;
+        if (Node* node = buckets_[hash_of(key) & mask()]) __builtin_prefetch(node);
+    }
+
+    // Call visit(entry) for each entry in the bucket cursor names, and
+    // return the cursor of the next bucket to visit, 0 once done. Starting
+    // from 0 and feeding each result back in covers the whole table.
+    template <typename F>
+    uint64_t scan(uint64_t cursor, F&& visit) const {
+        if (buckets_.empty()) return 0;
+        uint64_t m = mask();
+        for (Node* node = buckets_[cursor & m]; node; node = node->next) visit(node->entry);
+
+        // Increment the bits under the mask in reverse order: the cursor
+        // then reaches a bucket only after every bucket it could have been
+        // split from or merged into at another size.
+        cursor |= ~m;
+        cursor = reverse_bits(cursor);
+        cursor++;
+        return reverse_bits(cursor);
+    }
+
+private:
+    static constexpr size_t MIN_BUCKETS = 4;
+
+    static size_t hash_of(std::string_view key) { return std::hash<std::string_view>()(key); }
+
+    static uint64_t reverse_bits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+        v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(v);
+    }
+
+    size_t mask() const { return buckets_.size() - 1; }
+
+    Node* find_node(std::string_view key, size_t hash, size_t& bucket) const {
+        if (buckets_.empty()) return nullptr;
+        bucket = hash & mask();
+        for (Node* node = buckets_[bucket]; node; node = node->next) {
+            if (node->hash == hash && node->entry.first == key) return node;
+        }
+        return nullptr;
+    }
+
+    // Insert a node known to be new, growing at a load factor of one
+    iterator link(Node* node) {
+        if (size_ >= buckets_.size()) rehash(std::max(MIN_BUCKETS, 2 * buckets_.size()));
+        size_t bucket = node->hash & mask();
+        node->next = buckets_[bucket];
+        buckets_[bucket] = node;
+        size_++;
+        return iterator(this, bucket, node);
+    }
+
+    void rehash(size_t count) {
+        std::vector<Node*> buckets(count, nullptr);
+        for (Node* head : buckets_) {
+            while (head) {
+                Node* node = std::exchange(head, head->next);
+                size_t bucket = node->hash & (count - 1);
+                node->next = buckets[bucket];
+                buckets[bucket] = node;
+            }
+        }
+        buckets_ = std::move(buckets);
+    }
+
+    std::vector<Node*> buckets_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,192 @@
+#include "expire.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replication.hpp"
+#include "resp.hpp"
+#include "server.hpp"
+#include "store.hpp"
+#include "util.hpp"
+
+// Active expiry wakes up ten times a second and samples keys with an
+// expiry in rounds. As in Redis a round that finds more than a quarter of
+// its sample expired is followed by another, so a burst of expiring keys
+// goes quickly, but one wakeup holds the lock for 25 ms at most.
+static constexpr auto ACTIVE_EXPIRE_INTERVAL = std::chrono::milliseconds(100);
+static constexpr auto ACTIVE_EXPIRE_CYCLE_TIME = std::chrono::milliseconds(25);
+static constexpr size_t ACTIVE_EXPIRE_KEYS_PER_ROUND = 20;
+
+// EXPIRE key seconds [NX | XX | GT | LT], and the same for PEXPIRE in
+// milliseconds and EXPIREAT and PEXPIREAT at a unix time
+static std::string expire_generic(const std::vector<std::string>& parts, ClientContext& client,
+                                  bool seconds, bool relative) {
+    int64_t when;
+    if (!string_to_int64(parts[2], when)) return "-ERR value is not an integer or out of range\r\n";
+
+    bool nx = false, xx = false, gt = false, lt = false;
+    for (size_t i = 3; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "NX") {
+            nx = true;
+        } else if (option == "XX") {
+            xx = true;
+        } else if (option == "GT") {
+            gt = true;
+        } else if (option == "LT") {
+            lt = true;
+        } else {
+            return "-ERR Unsupported option " + parts[i] + "\r\n";
+        }
+    }
+    if (nx && (xx || gt || lt)) return "-ERR NX and XX, GT or LT options at the same time are not compatible\r\n";
+    if (gt && lt) return "-ERR GT and LT options at the same time are not compatible\r\n";
+
+    if ((seconds && __builtin_mul_overflow(when, 1000, &when)) ||
+        (relative && __builtin_add_overflow(when, unix_now_ms(), &when))) {
+        return "-ERR invalid expire time in '" + parts[0] + "' command\r\n";
+    }
+
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    auto at = unix_ms_to_steady(when);
+    // A key without an expiry counts as expiring never for GT and LT
+    if (!value || (nx && value->has_expiry) || (xx && !value->has_expiry) ||
+        (gt && (!value->has_expiry || at <= value->expiry)) || (lt && value->has_expiry && at >= value->expiry)) {
+        client.propagate_as.emplace();
+        return resp_integer(0);
+    }
+
+    // A time already past deletes the key, and replicas are told so
+    // rather than left to work it out from their own clock
+    if (when <= unix_now_ms()) {
+        remove_expiry(parts[1], *value);
+        kv_store.erase(parts[1]);
+        client.propagate_as.emplace().push_back({"DEL", parts[1]});
+        return resp_integer(1);
+    }
+
+    set_expiry(parts[1], *value, at);
+    client.propagate_as.emplace().push_back({"PEXPIREAT", parts[1], std::to_string(when)});
+    return resp_integer(1);
+}
+
+static std::string cmd_expire(const std::vector<std::string>& parts, ClientContext& client) {
+    return expire_generic(parts, client, true, true);
+}
+
+static std::string cmd_pexpire(const std::vector<std::string>& parts, ClientContext& client) {
+    return expire_generic(parts, client, false, true);
+}
+
+static std::string cmd_expireat(const std::vector<std::string>& parts, ClientContext& client) {
+    return expire_generic(parts, client, true, false);
+}
+
+static std::string cmd_pexpireat(const std::vector<std::string>& parts, ClientContext& client) {
+    return expire_generic(parts, client, false, false);
+}
+
+// TTL key, and PTTL in milliseconds, EXPIRETIME and PEXPIRETIME as a unix
+// time: -2 if the key doesn't exist, -1 if it has no expiry
+static std::string ttl_generic(const std::vector<std::string>& parts, ClientContext& client,
+                               bool milliseconds, bool absolute) {
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    if (!value) return resp_integer(-2);
+    if (!value->has_expiry) return resp_integer(-1);
+
+    int64_t when = steady_to_unix_ms(value->expiry);
+    int64_t result = absolute ? when : std::max<int64_t>(when - unix_now_ms(), 0);
+    return resp_integer(milliseconds ? result : (result + 500) / 1000);
+}
+
+static std::string cmd_ttl(const std::vector<std::string>& parts, ClientContext& client) {
+    return ttl_generic(parts, client, false, false);
+}
+
+static std::string cmd_pttl(const std::vector<std::string>& parts, ClientContext& client) {
+    return ttl_generic(parts, client, true, false);
+}
+
+static std::string cmd_expiretime(const std::vector<std::string>& parts, ClientContext& client) {
+    return ttl_generic(parts, client, false, true);
+}
+
+static std::string cmd_pexpiretime(const std::vector<std::string>& parts, ClientContext& client) {
+    return ttl_generic(parts, client, true, true);
+}
+
+// PERSIST key
+static std::string cmd_persist(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value || !value->has_expiry) {
+        client.propagate_as.emplace();
+        return resp_integer(0);
+    }
+    remove_expiry(parts[1], *value);
+    return resp_integer(1);
+}
+
+// One wakeup of active expiry, continuing the walk over kv_expires from
+// cursor. Names whose key is gone or no longer has an expiry are dropped
+// along the way.
+static void active_expire_cycle(uint64_t& cursor) {
+    std::lock_guard<std::shared_mutex> lock(kv_mutex);
+    // Replicas wait for their master's DELs, as with keys found expired
+    // on reads
+    if (replication_is_replica()) return;
+
+    auto deadline = std::chrono::steady_clock::now() + ACTIVE_EXPIRE_CYCLE_TIME;
+    std::vector<std::string> sample;
+    size_t dropped;
+    do {
+        sample.clear();
+        do {
+            cursor = kv_expires.scan(cursor, [&](const auto& entry) { sample.push_back(entry.first); });
+        } while (cursor != 0 && sample.size() < ACTIVE_EXPIRE_KEYS_PER_ROUND);
+
+        dropped = 0;
+        for (const auto& key : sample) {
+            auto it = kv_store.find(key);
+            bool listed = it != kv_store.end() && it->second.has_expiry;
+            if (listed && !it->second.is_expired()) continue;
+
+            kv_expires.erase(key);
+            dropped++;
+            if (listed) {
+                kv_store.erase(it);
+                replication_propagate({"DEL", key});
+            }
+        }
+    } while (dropped * 4 > sample.size() && std::chrono::steady_clock::now() < deadline);
+
+    kv_store.shrink();
+    kv_expires.shrink();
+}
+
+void start_active_expire() {
+    std::thread([] {
+        uint64_t cursor = 0;
+        while (true) {
+            std::this_thread::sleep_for(ACTIVE_EXPIRE_INTERVAL);
+            active_expire_cycle(cursor);
+        }
+    }).detach();
+}
+
+void register_expire_commands() {
+    register_command({"EXPIRE", -3, CMD_WRITE, cmd_expire, 1, 1, 1});
+    register_command({"PEXPIRE", -3, CMD_WRITE, cmd_pexpire, 1, 1, 1});
+    register_command({"EXPIREAT", -3, CMD_WRITE, cmd_expireat, 1, 1, 1});
+    register_command({"PEXPIREAT", -3, CMD_WRITE, cmd_pexpireat, 1, 1, 1});
+    register_command({"TTL", 2, CMD_READONLY, cmd_ttl, 1, 1, 1});
+    register_command({"PTTL", 2, CMD_READONLY, cmd_pttl, 1, 1, 1});
+    register_command({"EXPIRETIME", 2, CMD_READONLY, cmd_expiretime, 1, 1, 1});
+    register_command({"PEXPIRETIME", 2, CMD_READONLY, cmd_pexpiretime, 1, 1, 1});
+    register_command({"PERSIST", 2, CMD_WRITE, cmd_persist, 1, 1, 1});
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Key expiry: EXPIRE, PEXPIRE, EXPIREAT and PEXPIREAT to set it, TTL,
+// PTTL, EXPIRETIME and PEXPIRETIME to read it, and PERSIST to drop it
+void register_expire_commands();
+
+// Start the thread that deletes expired keys nobody reads. It samples the
+// keys listed in kv_expires, never the rest of the keyspace.
+void start_active_expire();
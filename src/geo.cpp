@@ -0,0 +1,624 @@
+#include "geo.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+#include "zset.hpp"
+
+static constexpr const char* SYNTAX_ERROR = "-ERR syntax error\r\n";
+static constexpr const char* UNIT_ERROR = "-ERR unsupported unit provided. please use M, KM, FT, MI\r\n";
+
+// The indexed part of the globe. Latitudes stop where Web Mercator does, as
+// in Redis, so the cells are close to square away from the poles.
+static constexpr double GEO_LONG_MIN = -180;
+static constexpr double GEO_LONG_MAX = 180;
+static constexpr double GEO_LAT_MIN = -85.05112878;
+static constexpr double GEO_LAT_MAX = 85.05112878;
+
+// Bits per coordinate in a stored score, 52 in all, which a double holds
+// exactly
+static constexpr int GEO_STEP_MAX = 26;
+
+static constexpr double EARTH_RADIUS_IN_METERS = 6372797.560856;
+static constexpr double MERCATOR_MAX = 20037726.37;
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+static constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL;
+static constexpr uint64_t ODD_BITS = 0xaaaaaaaaaaaaaaaaULL;
+
+// A geohash cell: step bits of latitude in the even bit positions and step
+// bits of longitude in the odd ones. Step 0 marks a cell left out of a
+// search.
+struct GeoHash {
+    uint64_t bits = 0;
+    int step = 0;
+
+    bool operator==(const GeoHash&) const = default;
+};
+
+struct GeoArea {
+    double lon_min, lon_max;
+    double lat_min, lat_max;
+};
+
+// Bit interleaving. BMI2 does each direction in two instructions; the
+// portable version spreads or gathers the bits in five shift-and-mask
+// rounds.
+
+static uint64_t spread_bits(uint64_t x) {
+    x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+    x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & EVEN_BITS;
+    return x;
+}
+
+static uint32_t gather_bits(uint64_t x) {
+    x &= EVEN_BITS;
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+    return static_cast<uint32_t>(x);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2")))
+static uint64_t interleave_bmi2(uint32_t lat, uint32_t lon) {
+    return _pdep_u64(lat, EVEN_BITS) | _pdep_u64(lon, ODD_BITS);
+}
+
+__attribute__((target("bmi2")))
+static void deinterleave_bmi2(uint64_t bits, uint32_t& lat, uint32_t& lon) {
+    lat = static_cast<uint32_t>(_pext_u64(bits, EVEN_BITS));
+    lon = static_cast<uint32_t>(_pext_u64(bits, ODD_BITS));
+}
+
+static const bool cpu_has_bmi2 = __builtin_cpu_supports("bmi2");
+#endif
+
+static uint64_t interleave(uint32_t lat, uint32_t lon) {
+#if defined(__x86_64__)
+    if (cpu_has_bmi2) return interleave_bmi2(lat, lon);
+#endif
+    return spread_bits(lat) | (spread_bits(lon) << 1);
+}
+
+static void deinterleave(uint64_t bits, uint32_t& lat, uint32_t& lon) {
+#if defined(__x86_64__)
+    if (cpu_has_bmi2) return deinterleave_bmi2(bits, lat, lon);
+#endif
+    lat = gather_bits(bits);
+    lon = gather_bits(bits >> 1);
+}
+
+static bool valid_point(double lon, double lat) {
+    return lon >= GEO_LONG_MIN && lon <= GEO_LONG_MAX && lat >= GEO_LAT_MIN && lat <= GEO_LAT_MAX;
+}
+
+// Cell of the given step holding a point, which must be valid
+static GeoHash geohash_encode(double lon, double lat, int step) {
+    double cells = static_cast<double>(1ULL << step);
+    double lat_offset = (lat - GEO_LAT_MIN) / (GEO_LAT_MAX - GEO_LAT_MIN) * cells;
+    double lon_offset = (lon - GEO_LONG_MIN) / (GEO_LONG_MAX - GEO_LONG_MIN) * cells;
+    // The upper edge of the range belongs to the last cell
+    uint32_t last = static_cast<uint32_t>((1ULL << step) - 1);
+    return {interleave(std::min(static_cast<uint32_t>(lat_offset), last),
+                       std::min(static_cast<uint32_t>(lon_offset), last)),
+            step};
+}
+
+static GeoArea geohash_area(const GeoHash& hash) {
+    uint32_t lat, lon;
+    deinterleave(hash.bits, lat, lon);
+    double cells = static_cast<double>(1ULL << hash.step);
+    GeoArea area;
+    area.lat_min = GEO_LAT_MIN + (lat * 1.0 / cells) * (GEO_LAT_MAX - GEO_LAT_MIN);
+    area.lat_max = GEO_LAT_MIN + ((lat + 1) * 1.0 / cells) * (GEO_LAT_MAX - GEO_LAT_MIN);
+    area.lon_min = GEO_LONG_MIN + (lon * 1.0 / cells) * (GEO_LONG_MAX - GEO_LONG_MIN);
+    area.lon_max = GEO_LONG_MIN + ((lon + 1) * 1.0 / cells) * (GEO_LONG_MAX - GEO_LONG_MIN);
+    return area;
+}
+
+// Point a stored score stands for: the centre of its step 26 cell. Scores
+// written by ZADD rather than GEOADD are clamped into the 52-bit range.
+static void score_to_point(double score, double& lon, double& lat) {
+    uint64_t bits = 0;
+    if (score > 0) bits = score < 0x1p52 ? static_cast<uint64_t>(score) : (1ULL << 52) - 1;
+    GeoArea area = geohash_area({bits, GEO_STEP_MAX});
+    lon = std::clamp((area.lon_min + area.lon_max) / 2, GEO_LONG_MIN, GEO_LONG_MAX);
+    lat = std::clamp((area.lat_min + area.lat_max) / 2, GEO_LAT_MIN, GEO_LAT_MAX);
+}
+
+// Neighbouring cell, dx cells east and dy cells north, wrapping around at
+// the edges. Adding to one coordinate's bits works in place once the other
+// coordinate's bit positions are filled with ones for the carry to run
+// through.
+static GeoHash geohash_move(GeoHash hash, int dx, int dy) {
+    uint64_t lon = hash.bits & ODD_BITS;
+    uint64_t lat = hash.bits & EVEN_BITS;
+    int shift = 64 - hash.step * 2;
+    if (dx) {
+        uint64_t fill = EVEN_BITS >> shift;
+        lon = dx > 0 ? lon + (fill + 1) : (lon | fill) - (fill + 1);
+        lon &= ODD_BITS >> shift;
+    }
+    if (dy) {
+        uint64_t fill = ODD_BITS >> shift;
+        lat = dy > 0 ? lat + (fill + 1) : (lat | fill) - (fill + 1);
+        lat &= EVEN_BITS >> shift;
+    }
+    hash.bits = lon | lat;
+    return hash;
+}
+
+static double deg_rad(double deg) { return deg * DEG_TO_RAD; }
+static double rad_deg(double rad) { return rad / DEG_TO_RAD; }
+
+static double lat_distance(double lat1, double lat2) {
+    return EARTH_RADIUS_IN_METERS * std::fabs(deg_rad(lat2) - deg_rad(lat1));
+}
+
+// Haversine great-circle distance in meters
+static double geo_distance(double lon1, double lat1, double lon2, double lat2) {
+    double v = std::sin((deg_rad(lon2) - deg_rad(lon1)) / 2);
+    // Same longitude, the distance is along the meridian
+    if (v == 0.0) return lat_distance(lat1, lat2);
+    double lat1r = deg_rad(lat1);
+    double lat2r = deg_rad(lat2);
+    double u = std::sin((lat2r - lat1r) / 2);
+    double a = u * u + std::cos(lat1r) * std::cos(lat2r) * v * v;
+    return 2.0 * EARTH_RADIUS_IN_METERS * std::asin(std::sqrt(a));
+}
+
+// Meters per unit, 0 for an unknown unit
+static double unit_to_meters(const std::string& unit) {
+    std::string upper = to_upper(unit);
+    if (upper == "M") return 1;
+    if (upper == "KM") return 1000;
+    if (upper == "FT") return 0.3048;
+    if (upper == "MI") return 1609.34;
+    return 0;
+}
+
+// A search area: a circle of radius, or a box of width by height, around
+// a centre point. Sizes are in the requested unit, conversion meters each.
+struct GeoShape {
+    double lon = 0;
+    double lat = 0;
+    bool box = false;
+    double radius = 0;
+    double width = 0;
+    double height = 0;
+    double conversion = 1;
+};
+
+// Distance from the centre of the shape to a point inside it; false if
+// the point is outside
+static bool point_in_shape(const GeoShape& shape, double lon, double lat, double& distance) {
+    // The latitude distance is cheap and never more than the great-circle
+    // distance, so rule points out on it first. The circle check leaves a
+    // margin for rounding, the box check is the definition.
+    if (!shape.box) {
+        double radius = shape.radius * shape.conversion;
+        if (lat_distance(lat, shape.lat) > radius * (1 + 1e-9)) return false;
+        distance = geo_distance(shape.lon, shape.lat, lon, lat);
+        return distance <= radius;
+    }
+    if (lat_distance(lat, shape.lat) > shape.height * shape.conversion / 2) return false;
+    if (geo_distance(lon, lat, shape.lon, lat) > shape.width * shape.conversion / 2) return false;
+    distance = geo_distance(shape.lon, shape.lat, lon, lat);
+    return true;
+}
+
+// Cell size that makes a radius fit in a cell and its neighbours: cells
+// at step s are MERCATOR_MAX / 2^(s-1) meters across at the equator
+static int estimate_step(double radius_meters, double lat) {
+    if (radius_meters == 0) return GEO_STEP_MAX;
+    int step = 1;
+    while (radius_meters < MERCATOR_MAX) {
+        radius_meters *= 2;
+        step++;
+    }
+    // Leave a margin, and more towards the poles where meridians converge
+    step -= 2;
+    if (lat > 66 || lat < -66) {
+        step--;
+        if (lat > 80 || lat < -80) step--;
+    }
+    return std::clamp(step, 1, GEO_STEP_MAX);
+}
+
+// The cells to scan for a search: the centre's cell and its eight
+// neighbours, at a step just coarse enough for the shape to fit in them.
+// Neighbours the shape's bounding box doesn't reach are left out.
+static void search_cells(const GeoShape& shape, GeoHash (&cells)[9]) {
+    double half_height = shape.conversion * (shape.box ? shape.height / 2 : shape.radius);
+    double half_width = shape.conversion * (shape.box ? shape.width / 2 : shape.radius);
+    double lat_delta = rad_deg(half_height / EARTH_RADIUS_IN_METERS);
+    double lon_delta_top = rad_deg(half_width / EARTH_RADIUS_IN_METERS / std::cos(deg_rad(shape.lat + lat_delta)));
+    double lon_delta_bottom =
+        rad_deg(half_width / EARTH_RADIUS_IN_METERS / std::cos(deg_rad(shape.lat - lat_delta)));
+    // The edge nearer the pole is the wider one
+    double lon_delta = shape.lat < 0 ? lon_delta_bottom : lon_delta_top;
+    GeoArea bounds{shape.lon - lon_delta, shape.lon + lon_delta, shape.lat - lat_delta, shape.lat + lat_delta};
+
+    double radius_meters = shape.box ? std::sqrt((shape.width / 2) * (shape.width / 2) +
+                                                 (shape.height / 2) * (shape.height / 2))
+                                     : shape.radius;
+    int step = estimate_step(radius_meters * shape.conversion, shape.lat);
+
+    auto fill = [&](int s) {
+        GeoHash centre = geohash_encode(shape.lon, shape.lat, s);
+        cells[0] = centre;
+        cells[1] = geohash_move(centre, 0, 1);
+        cells[2] = geohash_move(centre, 0, -1);
+        cells[3] = geohash_move(centre, 1, 0);
+        cells[4] = geohash_move(centre, -1, 0);
+        cells[5] = geohash_move(centre, 1, 1);
+        cells[6] = geohash_move(centre, -1, 1);
+        cells[7] = geohash_move(centre, 1, -1);
+        cells[8] = geohash_move(centre, -1, -1);
+    };
+    fill(step);
+
+    // Near the edge of the centre cell the estimate can be one step too
+    // fine for the neighbours to cover the bounding box
+    if (step > 1 && (geohash_area(cells[1]).lat_max < bounds.lat_max ||
+                     geohash_area(cells[2]).lat_min > bounds.lat_min ||
+                     geohash_area(cells[3]).lon_max < bounds.lon_max ||
+                     geohash_area(cells[4]).lon_min > bounds.lon_min)) {
+        fill(--step);
+    }
+
+    if (step >= 2) {
+        GeoArea area = geohash_area(cells[0]);
+        auto drop = [&](int a, int b, int c) { cells[a] = cells[b] = cells[c] = GeoHash{}; };
+        if (area.lat_min < bounds.lat_min) drop(2, 7, 8);
+        if (area.lat_max > bounds.lat_max) drop(1, 5, 6);
+        if (area.lon_min < bounds.lon_min) drop(4, 6, 8);
+        if (area.lon_max > bounds.lon_max) drop(3, 5, 7);
+    }
+}
+
+struct GeoMatch {
+    ListPackEntry member;  // points into the sorted set, valid under the lock
+    size_t rank;
+    double score;
+    double distance;
+    double lon;
+    double lat;
+};
+
+// Members of zset inside shape, in cell order. With limit set, stops once
+// it has that many. With fetch_members false, only ranks are filled in:
+// when a few nearest matches are kept out of many, fetching just those
+// saves a cache miss per match on the large encodings.
+static void geo_search(const ZSetObject& zset, const GeoShape& shape, size_t limit, bool fetch_members,
+                       std::vector<GeoMatch>& matches) {
+    GeoHash cells[9];
+    search_cells(shape, cells);
+
+    for (int i = 0; i < 9; i++) {
+        if (cells[i].step == 0) continue;
+        // At coarse steps neighbours wrap around onto each other
+        if (std::find(cells, cells + i, cells[i]) != cells + i) continue;
+
+        // A cell is a contiguous range of step 26 scores
+        int shift = 2 * (GEO_STEP_MAX - cells[i].step);
+        double min = static_cast<double>(cells[i].bits << shift);
+        double max = static_cast<double>((cells[i].bits + 1) << shift);
+        size_t start = zset.count_by_score(min, false);
+        size_t end = zset.count_by_score(max, false);
+
+        size_t rank = start;
+        auto visit = [&](double score, const auto& member) {
+            rank++;
+            if (limit && matches.size() >= limit) return;
+            GeoMatch match{{}, rank - 1, score, 0, 0, 0};
+            score_to_point(score, match.lon, match.lat);
+            if (!point_in_shape(shape, match.lon, match.lat, match.distance)) return;
+            if (fetch_members) match.member = member();
+            matches.push_back(match);
+        };
+        while (start < end && (!limit || matches.size() < limit)) {
+            // With a limit, walk in batches so a crowded cell is not
+            // scanned past the point where enough members matched
+            size_t stop = limit ? std::min(end, start + std::max<size_t>(limit - matches.size(), 64)) : end;
+            zset.for_range_scores(start, stop, visit);
+            start = stop;
+        }
+        if (limit && matches.size() >= limit) break;
+    }
+}
+
+// Sorted set at key for a write, created if missing unless create is false
+static ZSetObject* geo_for_write(const std::string& key, bool create, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (value && value->type != ValueType::ZSet) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value) {
+        if (!create) return nullptr;
+        value = &(kv_store[key] = ValueWithExpiry(ValueType::ZSet, make_zset()));
+    }
+    return &value->as<ZSetObject>();
+}
+
+static const ZSetObject* geo_for_read(const std::string& key, ClientContext& client, std::string& error) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::ZSet) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->as<ZSetObject>();
+}
+
+static std::string invalid_point_error(double lon, double lat) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "-ERR invalid longitude,latitude pair %f,%f\r\n", lon, lat);
+    return buf;
+}
+
+// Parse a longitude and latitude pair at parts[i], setting error if it is
+// not numeric or not on the indexed part of the globe
+static bool parse_point(const std::vector<std::string>& parts, size_t i, double& lon, double& lat,
+                        std::string& error) {
+    if (!string_to_double(parts[i], lon) || !string_to_double(parts[i + 1], lat)) {
+        error = "-ERR value is not a valid float\r\n";
+        return false;
+    }
+    if (!valid_point(lon, lat)) {
+        error = invalid_point_error(lon, lat);
+        return false;
+    }
+    return true;
+}
+
+// Coordinates print with 17 decimals less trailing zeros, as Redis does
+static void append_coordinate(std::string& out, double value) {
+    char buf[64];
+    int len = std::snprintf(buf, sizeof(buf), "%.17Lf", static_cast<long double>(value));
+    while (len > 0 && buf[len - 1] == '0') len--;
+    if (len > 0 && buf[len - 1] == '.') len--;
+    resp_append_bulk(out, std::string_view(buf, len));
+}
+
+static void append_point(std::string& out, double lon, double lat) {
+    out += resp_array_header(2);
+    append_coordinate(out, lon);
+    append_coordinate(out, lat);
+}
+
+static void append_distance(std::string& out, double meters, double conversion) {
+    char buf[64];
+    int len = std::snprintf(buf, sizeof(buf), "%.4f", meters / conversion);
+    resp_append_bulk(out, std::string_view(buf, len));
+}
+
+// GEOADD key [NX|XX] [CH] longitude latitude member [longitude latitude member ...]
+static std::string cmd_geoadd(const std::vector<std::string>& parts, ClientContext& client) {
+    bool nx = false, xx = false, ch = false;
+    size_t first = 2;
+    for (; first < parts.size(); first++) {
+        std::string option = to_upper(parts[first]);
+        if (option == "NX") {
+            nx = true;
+        } else if (option == "XX") {
+            xx = true;
+        } else if (option == "CH") {
+            ch = true;
+        } else {
+            break;
+        }
+    }
+    if (first == parts.size() || (parts.size() - first) % 3 != 0 || (nx && xx)) return SYNTAX_ERROR;
+
+    // Validate every point before touching the set
+    std::string error;
+    std::vector<double> scores;
+    scores.reserve((parts.size() - first) / 3);
+    for (size_t i = first; i < parts.size(); i += 3) {
+        double lon, lat;
+        if (!parse_point(parts, i, lon, lat, error)) return error;
+        scores.push_back(static_cast<double>(geohash_encode(lon, lat, GEO_STEP_MAX).bits));
+    }
+
+    ZSetObject* zset = geo_for_write(parts[1], !xx, error);
+    if (!zset) return error.empty() ? resp_integer(0) : error;
+
+    int64_t added = 0;
+    int64_t updated = 0;
+    for (size_t i = 0; i < scores.size(); i++) {
+        const std::string& member = parts[first + 3 * i + 2];
+        double current;
+        if (zset->score(member, current)) {
+            if (nx || current == scores[i]) continue;
+            zset->set(member, scores[i]);
+            updated++;
+        } else if (!xx) {
+            zset->set(member, scores[i]);
+            added++;
+        }
+    }
+    return resp_integer(ch ? added + updated : added);
+}
+
+// GEOPOS key [member ...]
+static std::string cmd_geopos(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const ZSetObject* zset = geo_for_read(parts[1], client, error);
+    if (!error.empty()) return error;
+
+    std::string reply = resp_array_header(parts.size() - 2);
+    for (size_t i = 2; i < parts.size(); i++) {
+        double score;
+        if (!zset || !zset->score(parts[i], score)) {
+            reply += "*-1\r\n";
+            continue;
+        }
+        double lon, lat;
+        score_to_point(score, lon, lat);
+        append_point(reply, lon, lat);
+    }
+    return reply;
+}
+
+// GEODIST key member1 member2 [M|KM|FT|MI]
+static std::string cmd_geodist(const std::vector<std::string>& parts, ClientContext& client) {
+    if (parts.size() > 5) return SYNTAX_ERROR;
+    double conversion = parts.size() == 5 ? unit_to_meters(parts[4]) : 1;
+    if (conversion == 0) return UNIT_ERROR;
+
+    std::string error;
+    const ZSetObject* zset = geo_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_null() : error;
+
+    double score1, score2;
+    if (!zset->score(parts[2], score1) || !zset->score(parts[3], score2)) return resp_null();
+    double lon1, lat1, lon2, lat2;
+    score_to_point(score1, lon1, lat1);
+    score_to_point(score2, lon2, lat2);
+
+    std::string reply;
+    append_distance(reply, geo_distance(lon1, lat1, lon2, lat2), conversion);
+    return reply;
+}
+
+// GEOSEARCH key FROMMEMBER member | FROMLONLAT longitude latitude
+//     BYRADIUS radius M|KM|FT|MI | BYBOX width height M|KM|FT|MI
+//     [ASC|DESC] [COUNT count [ANY]] [WITHCOORD] [WITHDIST] [WITHHASH]
+static std::string cmd_geosearch(const std::vector<std::string>& parts, ClientContext& client) {
+    static constexpr const char* FROM_ERROR =
+        "-ERR exactly one of FROMMEMBER or FROMLONLAT can be specified for GEOSEARCH\r\n";
+    static constexpr const char* BY_ERROR = "-ERR exactly one of BYRADIUS and BYBOX can be specified for GEOSEARCH\r\n";
+
+    std::string error;
+    const ZSetObject* zset = geo_for_read(parts[1], client, error);
+    if (!error.empty()) return error;
+
+    GeoShape shape;
+    const std::string* from_member = nullptr;
+    bool from_point = false;
+    bool by_shape = false;
+    int sort = 0;  // 1 ascending, -1 descending
+    int64_t count = 0;
+    bool any = false;
+    bool with_coord = false, with_dist = false, with_hash = false;
+
+    for (size_t i = 2; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        size_t left = parts.size() - i - 1;
+        if (option == "WITHCOORD") {
+            with_coord = true;
+        } else if (option == "WITHDIST") {
+            with_dist = true;
+        } else if (option == "WITHHASH") {
+            with_hash = true;
+        } else if (option == "ANY") {
+            any = true;
+        } else if (option == "ASC" || option == "DESC") {
+            sort = option == "ASC" ? 1 : -1;
+        } else if (option == "COUNT" && left >= 1) {
+            if (!string_to_int64(parts[++i], count)) return "-ERR value is not an integer or out of range\r\n";
+            if (count <= 0) return "-ERR COUNT must be > 0\r\n";
+        } else if (option == "FROMMEMBER" && left >= 1) {
+            if (from_member || from_point) return FROM_ERROR;
+            from_member = &parts[++i];
+        } else if (option == "FROMLONLAT" && left >= 2) {
+            if (from_member || from_point) return FROM_ERROR;
+            if (!parse_point(parts, i + 1, shape.lon, shape.lat, error)) return error;
+            from_point = true;
+            i += 2;
+        } else if (option == "BYRADIUS" && left >= 2) {
+            if (by_shape) return BY_ERROR;
+            if (!string_to_double(parts[i + 1], shape.radius)) return "-ERR need numeric radius\r\n";
+            if (shape.radius < 0) return "-ERR radius cannot be negative\r\n";
+            shape.conversion = unit_to_meters(parts[i + 2]);
+            if (shape.conversion == 0) return UNIT_ERROR;
+            by_shape = true;
+            i += 2;
+        } else if (option == "BYBOX" && left >= 3) {
+            if (by_shape) return BY_ERROR;
+            if (!string_to_double(parts[i + 1], shape.width)) return "-ERR need numeric width\r\n";
+            if (!string_to_double(parts[i + 2], shape.height)) return "-ERR need numeric height\r\n";
+            if (shape.width < 0 || shape.height < 0) return "-ERR height or width cannot be negative\r\n";
+            shape.conversion = unit_to_meters(parts[i + 3]);
+            if (shape.conversion == 0) return UNIT_ERROR;
+            shape.box = true;
+            by_shape = true;
+            i += 3;
+        } else {
+            return SYNTAX_ERROR;
+        }
+    }
+    if (!from_member && !from_point) return FROM_ERROR;
+    if (!by_shape) return BY_ERROR;
+    if (any && !count) return "-ERR the ANY argument requires COUNT argument\r\n";
+
+    if (!zset) return resp_array_header(0);
+    if (from_member) {
+        double score;
+        if (!zset->score(*from_member, score)) return "-ERR could not decode requested zset member\r\n";
+        score_to_point(score, shape.lon, shape.lat);
+    }
+
+    // COUNT without ANY wants the nearest ones
+    if (count && !any && !sort) sort = 1;
+
+    // COUNT without ANY keeps the nearest of all matches, which may be few
+    // of them: their members are looked up once they are known
+    bool fetch_later = count && !any;
+    std::vector<GeoMatch> matches;
+    geo_search(*zset, shape, any ? static_cast<size_t>(count) : 0, !fetch_later, matches);
+
+    size_t keep = count ? std::min(matches.size(), static_cast<size_t>(count)) : matches.size();
+    if (sort) {
+        auto order = [sort](const GeoMatch& a, const GeoMatch& b) {
+            return sort > 0 ? a.distance < b.distance : a.distance > b.distance;
+        };
+        std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(), order);
+    }
+    if (fetch_later) {
+        for (size_t i = 0; i < keep; i++) {
+            zset->for_range_scores(matches[i].rank, matches[i].rank + 1,
+                                   [&](double, const auto& member) { matches[i].member = member(); });
+        }
+    }
+
+    size_t fields = 1 + with_dist + with_hash + with_coord;
+    std::string reply = resp_array_header(keep);
+    for (size_t i = 0; i < keep; i++) {
+        const GeoMatch& match = matches[i];
+        if (fields == 1) {
+            resp_append_bulk(reply, match.member);
+            continue;
+        }
+        reply += resp_array_header(fields);
+        resp_append_bulk(reply, match.member);
+        if (with_dist) append_distance(reply, match.distance, shape.conversion);
+        if (with_hash) reply += resp_integer(static_cast<int64_t>(match.score));
+        if (with_coord) append_point(reply, match.lon, match.lat);
+    }
+    return reply;
+}
+
+void register_geo_commands() {
+    register_command({"GEOADD", -5, CMD_WRITE, cmd_geoadd, 1, 1, 1});
+    register_command({"GEOPOS", -2, CMD_READONLY, cmd_geopos, 1, 1, 1});
+    register_command({"GEODIST", -4, CMD_READONLY, cmd_geodist, 1, 1, 1});
+    register_command({"GEOSEARCH", -7, CMD_READONLY, cmd_geosearch, 1, 1, 1});
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Geospatial commands: GEOADD, GEOPOS, GEODIST and GEOSEARCH. Points live
+// in an ordinary sorted set scored by a 52-bit geohash, longitude and
+// latitude bits interleaved, so nearby points have nearby scores and a
+// search is a handful of score range lookups. Scores match Redis, so ZSET
+// commands, RDB files and DUMP payloads carry geo sets between servers.
+void register_geo_commands();
@@ -0,0 +1,255 @@
+#include "hash.hpp"
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+HashObject::HashObject(size_t max_entries, size_t max_value) :
+    max_entries_(max_entries), max_value_(max_value) {}
+
+void HashObject::convert() {
+    auto table = std::make_unique<Dict<std::string>>();
+    table->reserve(entries_.size() / 2);
+    for_each([&](const ListPackEntry& field, const ListPackEntry& value) {
+        table->emplace(field.to_string(), value.to_string());
+    });
+    table_ = std::move(table);
+    ListPack().swap(entries_);
+}
+
+bool HashObject::get(const std::string& field, std::string& value) const {
+    if (table_) {
+        auto it = table_->find(field);
+        if (it == table_->end()) return false;
+        value = it->second;
+        return true;
+    }
+
+    size_t pos = entries_.find(entries_.first(), field, 1);
+    if (pos == ListPack::npos) return false;
+    value = entries_.get(entries_.next(pos)).to_string();
+    return true;
+}
+
+bool HashObject::set(const std::string& field, const std::string& value) {
+    if (!table_) {
+        size_t pos = entries_.find(entries_.first(), field, 1);
+        if (pos != ListPack::npos) {
+            if (value.size() <= max_value_) {
+                entries_.replace(entries_.next(pos), value);
+                return false;
+            }
+        } else if (size() < max_entries_ && field.size() <= max_value_ && value.size() <= max_value_) {
+            entries_.push_back(field);
+            entries_.push_back(value);
+            return true;
+        }
+        convert();
+    }
+
+    auto [it, added] = table_->insert_or_assign(field, value);
+    return added;
+}
+
+bool HashObject::erase(const std::string& field) {
+    if (table_) {
+        if (!table_->erase(field)) return false;
+        table_->shrink();
+        return true;
+    }
+
+    size_t pos = entries_.find(entries_.first(), field, 1);
+    if (pos == ListPack::npos) return false;
+    entries_.erase(pos, 2);
+    return true;
+}
+
+bool HashObject::assign(ListPack entries) {
+    if (entries.size() % 2 != 0) return false;
+
+    entries_ = std::move(entries);
+    bool too_big = size() > max_entries_;
+    for_each([&](const ListPackEntry& field, const ListPackEntry& value) {
+        if (field.str.size() > max_value_ || value.str.size() > max_value_) too_big = true;
+    });
+    if (too_big) convert();
+    return true;
+}
+
+size_t HashObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + entries_.data().capacity();
+    if (table_) {
+        bytes += sizeof(*table_) + table_->bucket_count() * sizeof(void*);
+        for (const auto& [field, value] : *table_) {
+            // Node: next pointer, cached hash, the pair
+            bytes += sizeof(void*) + sizeof(size_t) + sizeof(std::pair<const std::string, std::string>);
+            bytes += string_heap_bytes(field) + string_heap_bytes(value);
+        }
+    }
+    return bytes;
+}
+
+std::unique_ptr<HashObject> make_hash() {
+    return std::make_unique<HashObject>(server_config.hash_max_listpack_entries, server_config.hash_max_listpack_value);
+}
+
+// Hash at key for a write, created if missing unless create is false.
+// Sets error on a type mismatch.
+static HashObject* hash_for_write(const std::string& key, bool create, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (value && value->type != ValueType::Hash) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value) {
+        if (!create) return nullptr;
+        value = &(kv_store[key] = ValueWithExpiry(ValueType::Hash, make_hash()));
+    }
+    return &value->as<HashObject>();
+}
+
+static const HashObject* hash_for_read(const std::string& key, ClientContext& client, std::string& error) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::Hash) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->as<HashObject>();
+}
+
+// HSET key field value [field value ...]
+static std::string cmd_hset(const std::vector<std::string>& parts, ClientContext& client) {
+    if (parts.size() % 2 != 0) return "-ERR wrong number of arguments for '" + parts[0] + "' command\r\n";
+
+    std::string error;
+    HashObject* hash = hash_for_write(parts[1], true, error);
+    if (!hash) return error;
+
+    int64_t added = 0;
+    for (size_t i = 2; i < parts.size(); i += 2) {
+        added += hash->set(parts[i], parts[i + 1]);
+    }
+    return resp_integer(added);
+}
+
+static std::string cmd_hget(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const HashObject* hash = hash_for_read(parts[1], client, error);
+    if (!hash) return error.empty() ? resp_null() : error;
+
+    std::string value;
+    if (!hash->get(parts[2], value)) return resp_null();
+    return resp_bulk(value);
+}
+
+// HMGET key field [field ...]
+static std::string cmd_hmget(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const HashObject* hash = hash_for_read(parts[1], client, error);
+    if (!error.empty()) return error;
+
+    std::string reply = resp_array_header(parts.size() - 2);
+    std::string value;
+    for (size_t i = 2; i < parts.size(); i++) {
+        reply += hash && hash->get(parts[i], value) ? resp_bulk(value) : resp_null();
+    }
+    return reply;
+}
+
+// HDEL key field [field ...]
+static std::string cmd_hdel(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    HashObject* hash = hash_for_write(parts[1], false, error);
+    if (!hash) return error.empty() ? resp_integer(0) : error;
+
+    int64_t deleted = 0;
+    for (size_t i = 2; i < parts.size(); i++) {
+        deleted += hash->erase(parts[i]);
+    }
+    if (hash->size() == 0) kv_store.erase(parts[1]);
+    return resp_integer(deleted);
+}
+
+static std::string cmd_hgetall(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const HashObject* hash = hash_for_read(parts[1], client, error);
+    if (!hash) return error.empty() ? resp_array_header(0) : error;
+
+    std::string reply = resp_array_header(hash->size() * 2);
+    hash->for_each([&](const ListPackEntry& field, const ListPackEntry& value) {
+        reply += resp_bulk(field);
+        reply += resp_bulk(value);
+    });
+    return reply;
+}
+
+// HINCRBY key field increment
+static std::string cmd_hincrby(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t increment;
+    if (!string_to_int64(parts[3], increment)) return "-ERR value is not an integer or out of range\r\n";
+
+    std::string error;
+    HashObject* hash = hash_for_write(parts[1], true, error);
+    if (!hash) return error;
+
+    int64_t current = 0;
+    std::string value;
+    if (hash->get(parts[2], value) && !string_to_int64(value, current)) {
+        return "-ERR hash value is not an integer\r\n";
+    }
+
+    int64_t result;
+    if (__builtin_add_overflow(current, increment, &result)) {
+        return "-ERR increment or decrement would overflow\r\n";
+    }
+    hash->set(parts[2], std::to_string(result));
+    return resp_integer(result);
+}
+
+static std::string cmd_hlen(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const HashObject* hash = hash_for_read(parts[1], client, error);
+    if (!hash) return error.empty() ? resp_integer(0) : error;
+    return resp_integer(hash->size());
+}
+
+// HSCAN key cursor [MATCH pattern] [COUNT count] [NOVALUES]
+static std::string cmd_hscan(const std::vector<std::string>& parts, ClientContext& client) {
+    ScanArgs args;
+    std::string error = parse_scan_args(parts, 2, args);
+    if (!error.empty()) return error;
+    const HashObject* hash = hash_for_read(parts[1], client, error);
+    if (!hash) return error.empty() ? scan_reply(0, 0, "") : error;
+
+    std::string items, scratch;
+    size_t count = 0;
+    auto visit = [&](const ListPackEntry& field, const ListPackEntry& value) {
+        if (args.match && !args.match->matches(field.text(scratch))) return;
+        resp_append_bulk(items, field);
+        count++;
+        if (!args.novalues) {
+            resp_append_bulk(items, value);
+            count++;
+        }
+    };
+
+    // A listpack is small enough to return whole
+    if (hash->is_listpack()) {
+        hash->for_each(visit);
+        return scan_reply(0, count, items);
+    }
+    uint64_t cursor = scan_bounded(args, [&](uint64_t at, const auto& step) { return hash->scan(at, step); }, visit);
+    return scan_reply(cursor, count, items);
+}
+
+void register_hash_commands() {
+    register_command({"HSET", -4, CMD_WRITE, cmd_hset, 1, 1, 1});
+    register_command({"HGET", 3, CMD_READONLY, cmd_hget, 1, 1, 1});
+    register_command({"HMGET", -3, CMD_READONLY, cmd_hmget, 1, 1, 1});
+    register_command({"HDEL", -3, CMD_WRITE, cmd_hdel, 1, 1, 1});
+    register_command({"HGETALL", 2, CMD_READONLY, cmd_hgetall, 1, 1, 1});
+    register_command({"HINCRBY", 4, CMD_WRITE, cmd_hincrby, 1, 1, 1});
+    register_command({"HLEN", 2, CMD_READONLY, cmd_hlen, 1, 1, 1});
+    register_command({"HSCAN", -3, CMD_READONLY, cmd_hscan, 1, 1, 1});
+}
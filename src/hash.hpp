@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "dict.hpp"
+#include "listpack.hpp"
+#include "store.hpp"
+
+// A hash is a listpack of alternating fields and values while it is small,
+// where a linear scan beats hashing and takes a fraction of the memory. It
+// becomes a hash table for good once it has more than max_entries fields
+// or a field or value longer than max_value bytes.
+class HashObject : public DataObject {
+public:
+    HashObject(size_t max_entries, size_t max_value);
+
+    size_t size() const { return table_ ? table_->size() : entries_.size() / 2; }
+    bool is_listpack() const { return !table_; }
+    const ListPack& listpack() const { return entries_; }
+
+    bool get(const std::string& field, std::string& value) const;
+    // Returns true if the field was added rather than updated
+    bool set(const std::string& field, const std::string& value);
+    bool erase(const std::string& field);
+
+    // Call visit(field, value) for each pair, as listpack entries
+    template <typename F>
+    void for_each(F&& visit) const;
+    // One step of a cursor scan over the hash table encoding, visiting
+    // pairs like for_each; see Dict::scan
+    template <typename F>
+    uint64_t scan(uint64_t cursor, F&& visit) const;
+
+    // Adopt a listpack loaded from RDB, converting it if it is over the limits
+    bool assign(ListPack entries);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return table_ ? "hashtable" : "listpack"; }
+
+private:
+    void convert();
+
+    ListPack entries_;
+    std::unique_ptr<Dict<std::string>> table_;
+    size_t max_entries_;
+    size_t max_value_;
+};
+
+template <typename F>
+void HashObject::for_each(F&& visit) const {
+    if (!table_) {
+        for (size_t pos = entries_.first(); pos != ListPack::npos; pos = entries_.next(entries_.next(pos))) {
+            visit(entries_.get(pos), entries_.get(entries_.next(pos)));
+        }
+        return;
+    }
+
+    ListPackEntry field, value;
+    for (const auto& [f, v] : *table_) {
+        field.str = f;
+        value.str = v;
+        visit(field, value);
+    }
+}
+
+template <typename F>
+uint64_t HashObject::scan(uint64_t cursor, F&& visit) const {
+    ListPackEntry field, value;
+    return table_->scan(cursor, [&](const auto& entry) {
+        field.str = entry.first;
+        value.str = entry.second;
+        visit(field, value);
+    });
+}
+
+// Empty hash with the configured conversion thresholds
+std::unique_ptr<HashObject> make_hash();
+
+void register_hash_commands();
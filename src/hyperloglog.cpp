@@ -0,0 +1,605 @@
+#include "hyperloglog.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "resp.hpp"
+#include "util.hpp"
+
+static constexpr int HLL_P = 14;                      // register index bits
+static constexpr int HLL_Q = 64 - HLL_P;              // hash bits left for the run of zeros
+static constexpr size_t HLL_REGISTERS = 1 << HLL_P;
+static constexpr int HLL_BITS = 6;
+static constexpr uint8_t HLL_REGISTER_MAX = (1 << HLL_BITS) - 1;
+static constexpr size_t HLL_HEADER_SIZE = 16;
+static constexpr size_t HLL_DENSE_SIZE = HLL_HEADER_SIZE + HLL_REGISTERS * HLL_BITS / 8;
+static constexpr double HLL_ALPHA_INF = 0.721347520444481703680;
+
+// Header: "HYLL", encoding, three unused bytes, then the cached
+// cardinality little-endian, its top bit set while it is stale
+static constexpr char HLL_DENSE = 0;
+static constexpr char HLL_SPARSE = 1;
+static constexpr size_t HLL_CARD_OFFSET = 8;
+static constexpr uint8_t HLL_STALE_BIT = 0x80;
+
+// Sparse opcodes, each covering a run of registers:
+//   ZERO  00xxxxxx           1 to 64 registers at 0
+//   XZERO 01xxxxxx yyyyyyyy  1 to 16384 registers at 0
+//   VAL   1vvvvvxx           1 to 4 registers at 1 to 32
+static constexpr size_t SPARSE_ZERO_MAX_LEN = 64;
+static constexpr size_t SPARSE_XZERO_MAX_LEN = 16384;
+static constexpr int SPARSE_VAL_MAX_VALUE = 32;
+static constexpr size_t SPARSE_VAL_MAX_LEN = 4;
+
+static constexpr const char* INVALID_HLL_ERROR = "-WRONGTYPE Key is not a valid HyperLogLog string value.\r\n";
+static constexpr const char* CORRUPT_HLL_ERROR = "-INVALIDOBJ Corrupted HLL object detected\r\n";
+
+// Register value histogram, indexed by value
+using Histogram = int[64];
+
+// Register an element maps to, and the length of the run of zeros ending
+// its hash plus one, which is what the register keeps the maximum of
+static std::pair<size_t, uint8_t> hll_pattern(std::string_view element) {
+    uint64_t hash = murmur_hash64a(element, 0xadc83b19ULL);
+    size_t index = hash & (HLL_REGISTERS - 1);
+    hash >>= HLL_P;
+    hash |= uint64_t(1) << HLL_Q;  // caps the run at Q
+    return {index, static_cast<uint8_t>(std::countr_zero(hash) + 1)};
+}
+
+static bool is_hll(const std::string& value) {
+    if (value.size() < HLL_HEADER_SIZE || value.compare(0, 4, "HYLL") != 0) return false;
+    if (value[4] == HLL_DENSE) return value.size() == HLL_DENSE_SIZE;
+    return value[4] == HLL_SPARSE;
+}
+
+static bool is_dense(const std::string& hll) {
+    return hll[4] == HLL_DENSE;
+}
+
+static bool cache_valid(const std::string& hll) {
+    return !(static_cast<uint8_t>(hll[HLL_CARD_OFFSET + 7]) & HLL_STALE_BIT);
+}
+
+static uint64_t cached_card(const std::string& hll) {
+    uint64_t card = 0;
+    for (int i = 0; i < 8; i++) card |= uint64_t(static_cast<uint8_t>(hll[HLL_CARD_OFFSET + i])) << (8 * i);
+    return card;
+}
+
+static void set_cached_card(std::string& hll, uint64_t card) {
+    for (int i = 0; i < 8; i++) hll[HLL_CARD_OFFSET + i] = static_cast<char>(card >> (8 * i));
+}
+
+static void invalidate_cache(std::string& hll) {
+    hll[HLL_CARD_OFFSET + 7] = static_cast<char>(hll[HLL_CARD_OFFSET + 7] | HLL_STALE_BIT);
+}
+
+static std::string hll_header(char encoding) {
+    std::string hll(HLL_HEADER_SIZE, '\0');
+    std::memcpy(hll.data(), "HYLL", 4);
+    hll[4] = encoding;
+    return hll;
+}
+
+static uint8_t* dense_registers(std::string& hll) {
+    return reinterpret_cast<uint8_t*>(hll.data()) + HLL_HEADER_SIZE;
+}
+
+static const uint8_t* dense_registers(const std::string& hll) {
+    return reinterpret_cast<const uint8_t*>(hll.data()) + HLL_HEADER_SIZE;
+}
+
+// Registers are packed least significant bits first, so the second and
+// third of every four straddle a byte boundary. The last register of the
+// array never does, which keeps accesses in bounds.
+static uint8_t dense_get(const uint8_t* regs, size_t index) {
+    size_t byte = index * HLL_BITS / 8;
+    unsigned shift = index * HLL_BITS & 7;
+    unsigned value = regs[byte] >> shift;
+    if (shift > 8 - HLL_BITS) value |= regs[byte + 1] << (8 - shift);
+    return value & HLL_REGISTER_MAX;
+}
+
+static void dense_set(uint8_t* regs, size_t index, uint8_t value) {
+    size_t byte = index * HLL_BITS / 8;
+    unsigned shift = index * HLL_BITS & 7;
+    regs[byte] = (regs[byte] & ~(HLL_REGISTER_MAX << shift)) | (value << shift);
+    if (shift > 8 - HLL_BITS) {
+        unsigned high = 8 - shift;
+        regs[byte + 1] = (regs[byte + 1] & ~(HLL_REGISTER_MAX >> high)) | (value >> high);
+    }
+}
+
+// Every four registers fill three bytes; these move between that packing
+// and one byte per register ("raw"), which is what merges work on.
+//
+// Eight registers at a time within a word: spread each three bytes over
+// four, each register into a byte, then take bytewise maxima. Values are
+// below 0x80, so borrowing from a set top bit tells which side is larger.
+static void dense_max_scalar(const uint8_t* regs, uint8_t* max) {
+    constexpr uint64_t LOW6 = 0x0000003f0000003fULL;
+    constexpr uint64_t TOP = 0x8080808080808080ULL;
+    for (size_t i = 0; i < HLL_REGISTERS; i += 8, regs += 6) {
+        uint32_t low;
+        uint16_t high;
+        std::memcpy(&low, regs, 4);
+        std::memcpy(&high, regs + 4, 2);
+        uint64_t packed = low | uint64_t(high) << 32;
+        uint64_t v = (packed & 0xffffff) | (packed & 0xffffff000000ULL) << 8;
+        v = (v & LOW6) | (v << 2 & LOW6 << 8) | (v << 4 & LOW6 << 16) | (v << 6 & LOW6 << 24);
+
+        uint64_t current;
+        std::memcpy(&current, max + i, 8);
+        uint64_t keep = (((current | TOP) - v) & TOP) >> 7;
+        keep *= 0xff;
+        current = (current & keep) | (v & ~keep);
+        std::memcpy(max + i, &current, 8);
+    }
+}
+
+static void dense_from_raw(const uint8_t* raw, uint8_t* regs) {
+    for (size_t i = 0; i < HLL_REGISTERS; i += 4, regs += 3) {
+        uint32_t packed = 0;
+        for (int j = 0; j < 4; j++) packed |= uint32_t(std::min(raw[i + j], HLL_REGISTER_MAX)) << (HLL_BITS * j);
+        regs[0] = packed;
+        regs[1] = packed >> 8;
+        regs[2] = packed >> 16;
+    }
+}
+
+// Redis counts zero registers a word at a time, as most are zero in all
+// but large sets
+static void raw_histogram_scalar(const uint8_t* raw, Histogram& histo) {
+    for (size_t i = 0; i < HLL_REGISTERS; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, raw + i, 8);
+        if (word == 0) {
+            histo[0] += 8;
+            continue;
+        }
+        for (size_t j = 0; j < 8; j++) histo[raw[i + j]]++;
+    }
+}
+
+#if defined(__x86_64__)
+
+// 32 registers per step: each 32-bit lane takes the three bytes of four
+// registers and shifts each register into a byte of its own. The upper
+// half loads from 8 bytes on, not 12, so the last load ends exactly at the
+// end of the registers.
+__attribute__((target("avx2")))
+static void dense_max_avx2(const uint8_t* regs, uint8_t* max) {
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
+    const __m256i byte0 = _mm256_set1_epi32(0x3f);
+    const __m256i byte1 = _mm256_set1_epi32(0x3f00);
+    const __m256i byte2 = _mm256_set1_epi32(0x3f0000);
+    const __m256i byte3 = _mm256_set1_epi32(0x3f000000);
+
+    for (size_t i = 0; i < HLL_REGISTERS; i += 32, regs += 24) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(regs));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(regs + 8));
+        __m256i packed = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), spread);
+        __m256i unpacked = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(packed, byte0), _mm256_and_si256(_mm256_slli_epi32(packed, 2), byte1)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(packed, 4), byte2),
+                            _mm256_and_si256(_mm256_slli_epi32(packed, 6), byte3)));
+        auto* out = reinterpret_cast<__m256i*>(max + i);
+        _mm256_storeu_si256(out, _mm256_max_epu8(_mm256_loadu_si256(out), unpacked));
+    }
+}
+
+// Register values cluster within a few of log2(n / registers), so rather
+// than scatter increments into a table, count each value in that span with
+// one compare per 32 registers. Byte counters are folded into the total
+// before they can wrap.
+__attribute__((target("avx2")))
+static void raw_histogram_avx2(const uint8_t* raw, Histogram& histo) {
+    constexpr size_t VECTORS = HLL_REGISTERS / 32;
+    const auto* vectors = reinterpret_cast<const __m256i*>(raw);
+
+    __m256i low = _mm256_set1_epi8(-1);
+    __m256i high = _mm256_setzero_si256();
+    for (size_t i = 0; i < VECTORS; i++) {
+        __m256i v = _mm256_loadu_si256(vectors + i);
+        low = _mm256_min_epu8(low, v);
+        high = _mm256_max_epu8(high, v);
+    }
+    alignas(32) uint8_t lows[32], highs[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lows), low);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(highs), high);
+    unsigned min = *std::min_element(lows, lows + 32);
+    unsigned max = *std::max_element(highs, highs + 32);
+    if (max - min >= 24) {
+        raw_histogram_scalar(raw, histo);
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    for (unsigned value = min; value <= max; value++) {
+        __m256i target = _mm256_set1_epi8(static_cast<char>(value));
+        __m256i total = zero;
+        for (size_t i = 0; i < VECTORS; i += 255) {
+            __m256i counts = zero;
+            for (size_t j = i; j < std::min(VECTORS, i + 255); j++) {
+                counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_loadu_si256(vectors + j), target));
+            }
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, zero));
+        }
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+        histo[value] += static_cast<int>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    }
+}
+
+static const bool cpu_has_avx2 = __builtin_cpu_supports("avx2");
+
+#endif
+
+static void dense_max(const uint8_t* regs, uint8_t* max) {
+#if defined(__x86_64__)
+    if (cpu_has_avx2) return dense_max_avx2(regs, max);
+#endif
+    dense_max_scalar(regs, max);
+}
+
+static void raw_histogram(const uint8_t* raw, Histogram& histo) {
+#if defined(__x86_64__)
+    if (cpu_has_avx2) return raw_histogram_avx2(raw, histo);
+#endif
+    raw_histogram_scalar(raw, histo);
+}
+
+// Call visit(first register, run length, value) for each opcode of a sparse
+// HLL. False if the opcodes are truncated or don't cover every register
+// exactly once.
+template <typename F>
+static bool sparse_for_each(const std::string& hll, F&& visit) {
+    const auto* p = reinterpret_cast<const uint8_t*>(hll.data()) + HLL_HEADER_SIZE;
+    const auto* end = reinterpret_cast<const uint8_t*>(hll.data()) + hll.size();
+    size_t index = 0;
+    while (p < end) {
+        size_t len;
+        uint8_t value = 0;
+        if ((*p & 0xc0) == 0x00) {
+            len = (*p & 0x3f) + 1;
+            p++;
+        } else if ((*p & 0xc0) == 0x40) {
+            if (p + 1 == end) return false;
+            len = ((*p & 0x3f) << 8 | p[1]) + 1;
+            p += 2;
+        } else {
+            value = ((*p >> 2) & 0x1f) + 1;
+            len = (*p & 0x3) + 1;
+            p++;
+        }
+        if (index + len > HLL_REGISTERS) return false;
+        visit(index, len, value);
+        index += len;
+    }
+    return index == HLL_REGISTERS;
+}
+
+// Append opcodes for a run of registers with the same value
+static void sparse_append_run(std::string& out, size_t len, uint8_t value) {
+    while (len > 0) {
+        if (value == 0) {
+            size_t n = std::min(len, SPARSE_XZERO_MAX_LEN);
+            if (n <= SPARSE_ZERO_MAX_LEN) {
+                out += static_cast<char>(n - 1);
+            } else {
+                out += static_cast<char>(0x40 | (n - 1) >> 8);
+                out += static_cast<char>((n - 1) & 0xff);
+            }
+            len -= n;
+        } else {
+            size_t n = std::min(len, SPARSE_VAL_MAX_LEN);
+            out += static_cast<char>(0x80 | (value - 1) << 2 | (n - 1));
+            len -= n;
+        }
+    }
+}
+
+// Sparse encoding of raw registers, empty if a value is too large for it
+static std::string sparse_from_raw(const uint8_t* raw) {
+    std::string hll = hll_header(HLL_SPARSE);
+    size_t i = 0;
+    while (i < HLL_REGISTERS) {
+        size_t run = 1;
+        while (i + run < HLL_REGISTERS && raw[i + run] == raw[i]) run++;
+        if (raw[i] > SPARSE_VAL_MAX_VALUE) return {};
+        sparse_append_run(hll, run, raw[i]);
+        i += run;
+    }
+    return hll;
+}
+
+static bool sparse_to_dense(std::string& hll) {
+    std::string dense = hll.substr(0, HLL_HEADER_SIZE);
+    dense[4] = HLL_DENSE;
+    dense.resize(HLL_DENSE_SIZE);
+    uint8_t* regs = dense_registers(dense);
+    bool valid = sparse_for_each(hll, [&](size_t first, size_t len, uint8_t value) {
+        if (value == 0) return;
+        for (size_t i = first; i < first + len; i++) dense_set(regs, i, value);
+    });
+    if (!valid) return false;
+    hll = std::move(dense);
+    return true;
+}
+
+// Raise one register of a sparse HLL to value. The opcode covering it is
+// split into at most three runs, then VAL opcodes around the change are
+// merged where they now hold the same value. Returns 1 if the register
+// changed, 0 if it was already at least value, -1 if the HLL is corrupt.
+static int sparse_set(std::string& hll, size_t index, uint8_t value) {
+    size_t pos = HLL_HEADER_SIZE;
+    size_t prev = pos;
+    size_t first = 0;
+    size_t len = 0, op_size = 0;
+    uint8_t current = 0;
+    while (true) {
+        if (pos >= hll.size()) return -1;
+        auto op = static_cast<uint8_t>(hll[pos]);
+        if ((op & 0xc0) == 0x00) {
+            len = (op & 0x3f) + 1;
+            op_size = 1;
+            current = 0;
+        } else if ((op & 0xc0) == 0x40) {
+            if (pos + 1 >= hll.size()) return -1;
+            len = ((op & 0x3f) << 8 | static_cast<uint8_t>(hll[pos + 1])) + 1;
+            op_size = 2;
+            current = 0;
+        } else {
+            len = (op & 0x3) + 1;
+            op_size = 1;
+            current = ((op >> 2) & 0x1f) + 1;
+        }
+        if (index < first + len) break;
+        first += len;
+        prev = pos;
+        pos += op_size;
+    }
+    if (current >= value) return 0;
+
+    std::string runs;
+    if (index > first) sparse_append_run(runs, index - first, current);
+    sparse_append_run(runs, 1, value);
+    if (first + len - 1 > index) sparse_append_run(runs, first + len - 1 - index, current);
+    hll.replace(pos, op_size, runs);
+
+    // Merge from the opcode before the change through the ones it became
+    size_t at = prev;
+    for (int scanned = 0; scanned < 5 && at < hll.size(); scanned++) {
+        auto op = static_cast<uint8_t>(hll[at]);
+        if ((op & 0x80) && at + 1 < hll.size()) {
+            auto next = static_cast<uint8_t>(hll[at + 1]);
+            size_t merged = (op & 0x3) + (next & 0x3) + 2;
+            if ((next & 0x80) && (op & 0x7c) == (next & 0x7c) && merged <= SPARSE_VAL_MAX_LEN) {
+                hll[at] = static_cast<char>((op & 0xfc) | (merged - 1));
+                hll.erase(at + 1, 1);
+                continue;
+            }
+        }
+        at += (op & 0xc0) == 0x40 ? 2 : 1;
+    }
+    return 1;
+}
+
+// Add one element, returns 1 if a register changed, 0 if not and -1 if the
+// HLL is corrupt. Sparse HLLs turn dense when the value doesn't fit a VAL
+// opcode or they grow past hll_sparse_max_bytes.
+static int hll_add(std::string& hll, std::string_view element) {
+    auto [index, count] = hll_pattern(element);
+    if (!is_dense(hll)) {
+        if (count <= SPARSE_VAL_MAX_VALUE) {
+            int changed = sparse_set(hll, index, count);
+            if (changed == 1 && hll.size() > server_config.hll_sparse_max_bytes && !sparse_to_dense(hll)) return -1;
+            return changed;
+        }
+        if (!sparse_to_dense(hll)) return -1;
+    }
+
+    uint8_t* regs = dense_registers(hll);
+    if (dense_get(regs, index) >= count) return 0;
+    dense_set(regs, index, count);
+    return 1;
+}
+
+// max[i] = max(max[i], register i), false if the HLL is corrupt
+static bool hll_max_into(const std::string& hll, uint8_t* max) {
+    if (is_dense(hll)) {
+        dense_max(dense_registers(hll), max);
+        return true;
+    }
+    return sparse_for_each(hll, [&](size_t first, size_t len, uint8_t value) {
+        if (value == 0) return;
+        for (size_t i = first; i < first + len; i++) max[i] = std::max(max[i], value);
+    });
+}
+
+static bool hll_histogram(const std::string& hll, Histogram& histo) {
+    if (is_dense(hll)) {
+        alignas(32) uint8_t raw[HLL_REGISTERS] = {};
+        dense_max(dense_registers(hll), raw);
+        raw_histogram(raw, histo);
+        return true;
+    }
+    return sparse_for_each(hll, [&](size_t, size_t len, uint8_t value) { histo[value] += static_cast<int>(len); });
+}
+
+static double hll_sigma(double x) {
+    if (x == 1.0) return INFINITY;
+    double y = 1.0;
+    double z = x;
+    double previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (previous != z);
+    return z;
+}
+
+static double hll_tau(double x) {
+    if (x == 0.0 || x == 1.0) return 0.0;
+    double y = 1.0;
+    double z = 1 - x;
+    double previous;
+    do {
+        x = std::sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= std::pow(1 - x, 2) * y;
+    } while (previous != z);
+    return z / 3;
+}
+
+// Ertl's estimator from the register histogram, evaluated in the same
+// order as Redis so both give the same count for the same registers
+static uint64_t hll_estimate(const Histogram& histo) {
+    constexpr double m = HLL_REGISTERS;
+    double z = m * hll_tau((m - histo[HLL_Q + 1]) / m);
+    for (int j = HLL_Q; j >= 1; j--) {
+        z += histo[j];
+        z *= 0.5;
+    }
+    z += m * hll_sigma(histo[0] / m);
+    return static_cast<uint64_t>(std::llround(HLL_ALPHA_INF * m * m / z));
+}
+
+static std::string* hll_for_write(const std::string& key, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (!value) return nullptr;
+    if (value->type != ValueType::String) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!is_hll(value->value)) {
+        error = INVALID_HLL_ERROR;
+        return nullptr;
+    }
+    return &value->value;
+}
+
+static const std::string* hll_for_read(const std::string& key, ClientContext& client, std::string& error) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::String) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!is_hll(value->value)) {
+        error = INVALID_HLL_ERROR;
+        return nullptr;
+    }
+    return &value->value;
+}
+
+void hll_refresh_cache(ClientContext& client) {
+    std::lock_guard<std::shared_mutex> lock(kv_mutex);
+    for (const auto& key : client.hll_stale_keys) {
+        auto it = kv_store.find(key);
+        if (it == kv_store.end() || it->second.is_expired() || it->second.type != ValueType::String) continue;
+        // Count again: a write may have come in since the reply was computed
+        std::string& hll = it->second.value;
+        if (!is_hll(hll) || cache_valid(hll)) continue;
+        Histogram histo = {};
+        if (hll_histogram(hll, histo)) set_cached_card(hll, hll_estimate(histo));
+    }
+    client.hll_stale_keys.clear();
+}
+
+// PFADD key [element ...]
+static std::string cmd_pfadd(const std::vector<std::string>& parts, ClientContext&) {
+    std::string error;
+    std::string* hll = hll_for_write(parts[1], error);
+    if (!error.empty()) return error;
+
+    bool updated = false;
+    if (!hll) {
+        std::string created = hll_header(HLL_SPARSE);
+        sparse_append_run(created, HLL_REGISTERS, 0);
+        hll = &(kv_store[parts[1]] = ValueWithExpiry(created)).value;
+        updated = true;
+    }
+    for (size_t i = 2; i < parts.size(); i++) {
+        int changed = hll_add(*hll, parts[i]);
+        if (changed < 0) return CORRUPT_HLL_ERROR;
+        updated |= changed == 1;
+    }
+    if (updated) invalidate_cache(*hll);
+    return resp_integer(updated);
+}
+
+// PFCOUNT key [key ...]
+static std::string cmd_pfcount(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    Histogram histo = {};
+    if (parts.size() == 2) {
+        const std::string* hll = hll_for_read(parts[1], client, error);
+        if (!hll) return error.empty() ? resp_integer(0) : error;
+        if (cache_valid(*hll)) return resp_integer(cached_card(*hll));
+        if (!hll_histogram(*hll, histo)) return CORRUPT_HLL_ERROR;
+        // The cache is written once the read lock is released
+        client.hll_stale_keys.push_back(parts[1]);
+        return resp_integer(hll_estimate(histo));
+    }
+
+    // Several keys count their union, which leaves every cache alone
+    alignas(32) uint8_t max[HLL_REGISTERS] = {};
+    for (size_t i = 1; i < parts.size(); i++) {
+        const std::string* hll = hll_for_read(parts[i], client, error);
+        if (!error.empty()) return error;
+        if (hll && !hll_max_into(*hll, max)) return CORRUPT_HLL_ERROR;
+    }
+    raw_histogram(max, histo);
+    return resp_integer(hll_estimate(histo));
+}
+
+// PFMERGE destkey [sourcekey ...]
+static std::string cmd_pfmerge(const std::vector<std::string>& parts, ClientContext&) {
+    std::string error;
+    alignas(32) uint8_t max[HLL_REGISTERS] = {};
+    bool any_dense = false;
+    for (size_t i = 1; i < parts.size(); i++) {
+        const std::string* hll = hll_for_write(parts[i], error);
+        if (!error.empty()) return error;
+        if (!hll) continue;
+        any_dense |= is_dense(*hll);
+        if (!hll_max_into(*hll, max)) return CORRUPT_HLL_ERROR;
+    }
+
+    // Stays sparse only if every input was and the result still fits
+    std::string merged;
+    if (!any_dense) merged = sparse_from_raw(max);
+    if (merged.empty() || merged.size() > server_config.hll_sparse_max_bytes) {
+        merged = hll_header(HLL_DENSE);
+        merged.resize(HLL_DENSE_SIZE);
+        dense_from_raw(max, dense_registers(merged));
+    }
+    invalidate_cache(merged);
+
+    if (ValueWithExpiry* dest = lookup_key_write(parts[1])) {
+        dest->value = std::move(merged);
+    } else {
+        kv_store[parts[1]] = ValueWithExpiry(merged);
+    }
+    return "+OK\r\n";
+}
+
+void register_hyperloglog_commands() {
+    register_command({"PFADD", -2, CMD_WRITE, cmd_pfadd, 1, 1, 1});
+    register_command({"PFCOUNT", -2, CMD_READONLY, cmd_pfcount, 1, -1, 1});
+    register_command({"PFMERGE", -2, CMD_WRITE, cmd_pfmerge, 1, -1, 1});
+}
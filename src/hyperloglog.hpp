@@ -0,0 +1,15 @@
+#pragma once
+
+#include "server.hpp"
+
+// HyperLogLogs are plain strings in the Redis layout, so GET, SET, DUMP and
+// RDB files carry them between servers as they are. A 16-byte header ("HYLL",
+// the encoding, and a cached cardinality) is followed by either 16384 packed
+// 6-bit registers (dense, 12 KB) or a run-length encoding of them (sparse)
+// that small counters keep until it grows past hll_sparse_max_bytes.
+
+// Recompute the cached cardinality of keys PFCOUNT found stale under a read
+// lock, queued in client.hll_stale_keys. Takes kv_mutex itself.
+void hll_refresh_cache(ClientContext& client);
+
+void register_hyperloglog_commands();
@@ -0,0 +1,389 @@
+#include "intset.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static size_t width_for(int64_t value) {
+    if (value >= INT16_MIN && value <= INT16_MAX) return 2;
+    if (value >= INT32_MIN && value <= INT32_MAX) return 4;
+    return 8;
+}
+
+static uint32_t read_u32(const std::string& buf, size_t pos) {
+    uint32_t value;
+    std::memcpy(&value, buf.data() + pos, 4);
+    return value;
+}
+
+static void write_u32(std::string& buf, size_t pos, uint32_t value) {
+    std::memcpy(buf.data() + pos, &value, 4);
+}
+
+IntSet::IntSet() : buf_(HEADER_SIZE, '\0') {
+    write_u32(buf_, 0, 2);
+}
+
+size_t IntSet::size() const {
+    return read_u32(buf_, 4);
+}
+
+size_t IntSet::width() const {
+    return read_u32(buf_, 0);
+}
+
+void IntSet::set_size(size_t size) {
+    write_u32(buf_, 4, static_cast<uint32_t>(size));
+}
+
+int64_t IntSet::get(size_t index) const {
+    const char* p = buf_.data() + HEADER_SIZE + index * width();
+    switch (width()) {
+    case 2: {
+        int16_t value;
+        std::memcpy(&value, p, 2);
+        return value;
+    }
+    case 4: {
+        int32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+    default: {
+        int64_t value;
+        std::memcpy(&value, p, 8);
+        return value;
+    }
+    }
+}
+
+void IntSet::set(size_t index, int64_t value) {
+    char* p = buf_.data() + HEADER_SIZE + index * width();
+    switch (width()) {
+    case 2: {
+        int16_t narrow = static_cast<int16_t>(value);
+        std::memcpy(p, &narrow, 2);
+        break;
+    }
+    case 4: {
+        int32_t narrow = static_cast<int32_t>(value);
+        std::memcpy(p, &narrow, 4);
+        break;
+    }
+    default:
+        std::memcpy(p, &value, 8);
+        break;
+    }
+}
+
+bool IntSet::assign(std::string blob) {
+    if (blob.size() < HEADER_SIZE) return false;
+    size_t width = read_u32(blob, 0);
+    size_t size = read_u32(blob, 4);
+    if ((width != 2 && width != 4 && width != 8) || blob.size() != HEADER_SIZE + size * width) return false;
+
+    std::string previous = std::move(buf_);
+    buf_ = std::move(blob);
+    for (size_t i = 1; i < size; i++) {
+        if (get(i - 1) >= get(i)) {
+            buf_ = std::move(previous);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IntSet::search(int64_t value, size_t& pos) const {
+    size_t size = this->size();
+    if (size == 0) {
+        pos = 0;
+        return false;
+    }
+    // Appending in order is the common case for ID sets
+    if (value > get(size - 1)) {
+        pos = size;
+        return false;
+    }
+    if (value < get(0)) {
+        pos = 0;
+        return false;
+    }
+
+    size_t low = 0;
+    size_t high = size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int64_t current = get(mid);
+        if (current == value) {
+            pos = mid;
+            return true;
+        }
+        if (current < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    pos = low;
+    return false;
+}
+
+bool IntSet::contains(int64_t value) const {
+    size_t pos;
+    return width_for(value) <= width() && search(value, pos);
+}
+
+void IntSet::upgrade(size_t width) {
+    size_t size = this->size();
+    std::string old = std::move(buf_);
+    IntSet narrow;
+    narrow.buf_ = std::move(old);
+
+    buf_.assign(HEADER_SIZE + size * width, '\0');
+    write_u32(buf_, 0, static_cast<uint32_t>(width));
+    set_size(size);
+    for (size_t i = 0; i < size; i++) set(i, narrow.get(i));
+}
+
+bool IntSet::add(int64_t value) {
+    if (width_for(value) > width()) {
+        // A value that needs a wider encoding is past one end of the set
+        upgrade(width_for(value));
+        size_t size = this->size();
+        buf_.resize(buf_.size() + width());
+        if (value < 0) {
+            std::memmove(buf_.data() + HEADER_SIZE + width(), buf_.data() + HEADER_SIZE, size * width());
+            set(0, value);
+        } else {
+            set(size, value);
+        }
+        set_size(size + 1);
+        return true;
+    }
+
+    size_t pos;
+    if (search(value, pos)) return false;
+
+    size_t size = this->size();
+    buf_.insert(HEADER_SIZE + pos * width(), width(), '\0');
+    set(pos, value);
+    set_size(size + 1);
+    return true;
+}
+
+bool IntSet::remove(int64_t value) {
+    size_t pos;
+    if (width_for(value) > width() || !search(value, pos)) return false;
+
+    buf_.erase(HEADER_SIZE + pos * width(), width());
+    set_size(size() - 1);
+    return true;
+}
+
+// Intersection kernels over sorted arrays of unique values. out may be
+// null to only count; the count may overshoot limit by less than a block.
+
+template <typename T>
+static size_t intersect_scalar(const T* a, size_t na, const T* b, size_t nb, T* out, size_t limit) {
+    size_t i = 0, j = 0, k = 0;
+    while (i < na && j < nb && k < limit) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            if (out) out[k] = a[i];
+            k++;
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+// For a much smaller a, binary search each of its values in b
+template <typename T>
+static size_t intersect_gallop(const T* a, size_t na, const T* b, size_t nb, T* out, size_t limit) {
+    size_t k = 0;
+    const T* low = b;
+    const T* end = b + nb;
+    for (size_t i = 0; i < na && k < limit && low < end; i++) {
+        low = std::lower_bound(low, end, a[i]);
+        if (low < end && *low == a[i]) {
+            if (out) out[k] = a[i];
+            k++;
+        }
+    }
+    return k;
+}
+
+#if defined(__x86_64__)
+
+// Emit the members of a block flagged in mask
+template <typename T>
+static inline size_t emit_matches(const T* block, unsigned mask, T* out, size_t k) {
+    if (!out) return k + __builtin_popcount(mask);
+    while (mask) {
+        out[k++] = block[__builtin_ctz(mask)];
+        mask &= mask - 1;
+    }
+    return k;
+}
+
+// Compare a block of a against every rotation of a block of b so all pairs
+// are checked at once, then advance whichever block ends lower
+static size_t intersect_sse2_32(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out,
+                                size_t limit) {
+    size_t i = 0, j = 0, k = 0;
+    while (i + 4 <= na && j + 4 <= nb && k < limit) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        __m128i eq = _mm_cmpeq_epi32(va, vb);
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        k = emit_matches(a + i, _mm_movemask_ps(_mm_castsi128_ps(eq)), out, k);
+
+        // Branch free: which side advances is a coin flip on real data
+        int32_t a_max = a[i + 3];
+        int32_t b_max = b[j + 3];
+        i += 4 * (a_max <= b_max);
+        j += 4 * (b_max <= a_max);
+    }
+    if (k >= limit) return k;
+    return k + intersect_scalar(a + i, na - i, b + j, nb - j, out ? out + k : nullptr, limit - k);
+}
+
+__attribute__((target("avx2")))
+static size_t intersect_avx2_32(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out,
+                                size_t limit) {
+    const __m256i rotations[7] = {
+        _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0), _mm256_setr_epi32(2, 3, 4, 5, 6, 7, 0, 1),
+        _mm256_setr_epi32(3, 4, 5, 6, 7, 0, 1, 2), _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3),
+        _mm256_setr_epi32(5, 6, 7, 0, 1, 2, 3, 4), _mm256_setr_epi32(6, 7, 0, 1, 2, 3, 4, 5),
+        _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6),
+    };
+
+    size_t i = 0, j = 0, k = 0;
+    while (i + 8 <= na && j + 8 <= nb && k < limit) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_cmpeq_epi32(va, vb);
+        for (const __m256i& rotation : rotations) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb, rotation)));
+        }
+        k = emit_matches(a + i, _mm256_movemask_ps(_mm256_castsi256_ps(eq)), out, k);
+
+        int32_t a_max = a[i + 7];
+        int32_t b_max = b[j + 7];
+        i += 8 * (a_max <= b_max);
+        j += 8 * (b_max <= a_max);
+    }
+    if (k >= limit) return k;
+    return k + intersect_scalar(a + i, na - i, b + j, nb - j, out ? out + k : nullptr, limit - k);
+}
+
+__attribute__((target("avx2")))
+static size_t intersect_avx2_64(const int64_t* a, size_t na, const int64_t* b, size_t nb, int64_t* out,
+                                size_t limit) {
+    size_t i = 0, j = 0, k = 0;
+    while (i + 4 <= na && j + 4 <= nb && k < limit) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_cmpeq_epi64(va, vb);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+        k = emit_matches(a + i, _mm256_movemask_pd(_mm256_castsi256_pd(eq)), out, k);
+
+        int64_t a_max = a[i + 3];
+        int64_t b_max = b[j + 3];
+        i += 4 * (a_max <= b_max);
+        j += 4 * (b_max <= a_max);
+    }
+    if (k >= limit) return k;
+    return k + intersect_scalar(a + i, na - i, b + j, nb - j, out ? out + k : nullptr, limit - k);
+}
+
+static const bool cpu_has_avx2 = __builtin_cpu_supports("avx2");
+
+#endif
+
+// a is the smaller array
+template <typename T>
+static size_t intersect(const T* a, size_t na, const T* b, size_t nb, T* out, size_t limit) {
+    if (na * 32 < nb) return intersect_gallop(a, na, b, nb, out, limit);
+#if defined(__x86_64__)
+    if constexpr (sizeof(T) == 4) {
+        if (cpu_has_avx2) return intersect_avx2_32(a, na, b, nb, out, limit);
+        return intersect_sse2_32(a, na, b, nb, out, limit);
+    } else if constexpr (sizeof(T) == 8) {
+        if (cpu_has_avx2) return intersect_avx2_64(a, na, b, nb, out, limit);
+    }
+#endif
+    return intersect_scalar(a, na, b, nb, out, limit);
+}
+
+// Intersect at width T, widening narrower sets into copies
+template <typename T>
+static std::vector<int64_t> intersect_all(const std::vector<const IntSet*>& sets, size_t limit, bool count_only,
+                                          size_t& count) {
+    std::vector<std::vector<T>> widened(sets.size());
+    std::vector<const T*> arrays(sets.size());
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (sets[i]->width() == sizeof(T)) {
+            arrays[i] = sets[i]->values<T>();
+            continue;
+        }
+        widened[i].resize(sets[i]->size());
+        for (size_t j = 0; j < sets[i]->size(); j++) widened[i][j] = static_cast<T>(sets[i]->get(j));
+        arrays[i] = widened[i].data();
+    }
+
+    const T* current = arrays[0];
+    size_t current_size = sets[0]->size();
+    std::vector<T> result;
+    for (size_t i = 1; i < sets.size(); i++) {
+        bool last = i + 1 == sets.size();
+        size_t step_limit = last && limit ? limit : SIZE_MAX;
+        T* out = nullptr;
+        if (!(last && count_only)) {
+            result.resize(current_size);
+            out = result.data();
+        }
+        // Results shrink as we go, so the smaller side is always current
+        current_size = std::min(intersect(current, current_size, arrays[i], sets[i]->size(), out, step_limit),
+                                step_limit);
+        current = result.data();
+        if (current_size == 0) break;
+    }
+
+    count = current_size;
+    std::vector<int64_t> members;
+    if (!count_only) members.assign(result.begin(), result.begin() + current_size);
+    return members;
+}
+
+std::vector<int64_t> intset_intersection(std::vector<const IntSet*> sets, size_t limit, bool count_only,
+                                         size_t& count) {
+    count = 0;
+    if (sets.empty()) return {};
+
+    std::sort(sets.begin(), sets.end(), [](const IntSet* a, const IntSet* b) { return a->size() < b->size(); });
+    if (sets.size() == 1) {
+        count = limit ? std::min(limit, sets[0]->size()) : sets[0]->size();
+        std::vector<int64_t> members;
+        if (!count_only) {
+            for (size_t i = 0; i < count; i++) members.push_back(sets[0]->get(i));
+        }
+        return members;
+    }
+
+    size_t width = 4;
+    for (const IntSet* set : sets) width = std::max(width, set->width());
+    if (width == 8) return intersect_all<int64_t>(sets, limit, count_only, count);
+    return intersect_all<int32_t>(sets, limit, count_only, count);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sorted array of unique integers, all stored at the smallest width (16, 32
+// or 64 bits) that holds every member. The layout is the Redis intset, an
+// encoding and a length as u32 LE followed by the values, so buffers go into
+// RDB files and DUMP payloads as they are.
+class IntSet {
+public:
+    IntSet();
+
+    // Adopt a buffer from an RDB file, false if it is malformed
+    bool assign(std::string blob);
+
+    size_t size() const;
+    // Bytes per member
+    size_t width() const;
+    const std::string& data() const { return buf_; }
+
+    int64_t get(size_t index) const;
+    bool contains(int64_t value) const;
+    // False if value was already a member
+    bool add(int64_t value);
+    bool remove(int64_t value);
+
+    // Members as an array of T; only valid when sizeof(T) == width()
+    template <typename T>
+    const T* values() const { return reinterpret_cast<const T*>(buf_.data() + HEADER_SIZE); }
+
+private:
+    static constexpr size_t HEADER_SIZE = 8;
+
+    // Position of value, or where it would be inserted
+    bool search(int64_t value, size_t& pos) const;
+    void set(size_t index, int64_t value);
+    void set_size(size_t size);
+    void upgrade(size_t width);
+
+    std::string buf_;
+};
+
+// Members common to all of sets in ascending order, stopping after limit
+// of them (0 for no limit). With count_only nothing is collected and only
+// the number of common members is returned in count. Pairs of same-width
+// sets are intersected with SSE2/AVX2 where the CPU has them.
+std::vector<int64_t> intset_intersection(std::vector<const IntSet*> sets, size_t limit, bool count_only,
+                                         size_t& count);
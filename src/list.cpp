@@ -0,0 +1,158 @@
+#include "list.hpp"
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+std::unique_ptr<QuickList> make_list() {
+    return std::make_unique<QuickList>(server_config.list_max_listpack_size, server_config.list_compress_depth);
+}
+
+// LPUSH/RPUSH key element [element ...]
+static std::string push_generic(const std::vector<std::string>& parts, bool front) {
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (value && value->type != ValueType::List) return WRONGTYPE_ERROR;
+    if (!value) {
+        value = &(kv_store[parts[1]] = ValueWithExpiry(ValueType::List, make_list()));
+    }
+
+    QuickList& list = value->as<QuickList>();
+    for (size_t i = 2; i < parts.size(); i++) {
+        if (front) {
+            list.push_front(parts[i]);
+        } else {
+            list.push_back(parts[i]);
+        }
+    }
+    return resp_integer(list.size());
+}
+
+static std::string cmd_lpush(const std::vector<std::string>& parts, ClientContext& client) {
+    return push_generic(parts, true);
+}
+
+static std::string cmd_rpush(const std::vector<std::string>& parts, ClientContext& client) {
+    return push_generic(parts, false);
+}
+
+// LPOP/RPOP key [count]
+static std::string pop_generic(const std::vector<std::string>& parts, ClientContext& client, bool front) {
+    if (parts.size() > 3) return "-ERR syntax error\r\n";
+
+    bool has_count = parts.size() == 3;
+    int64_t count = 1;
+    if (has_count && (!string_to_int64(parts[2], count) || count < 0)) {
+        return "-ERR value is out of range, must be positive\r\n";
+    }
+
+    // Popping nothing changes nothing, so replicas don't hear of it
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value) {
+        client.propagate_as.emplace();
+        return has_count ? "*-1\r\n" : resp_null();
+    }
+    if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+    if (count == 0) {
+        client.propagate_as.emplace();
+        return resp_array_header(0);
+    }
+
+    QuickList& list = value->as<QuickList>();
+    std::string reply;
+    std::string element;
+    if (has_count) {
+        count = std::min<int64_t>(count, list.size());
+        reply = resp_array_header(count);
+    }
+    for (int64_t i = 0; i < count; i++) {
+        if (front) {
+            list.pop_front(element);
+        } else {
+            list.pop_back(element);
+        }
+        reply += resp_bulk(element);
+    }
+
+    if (list.size() == 0) kv_store.erase(parts[1]);
+    return reply;
+}
+
+static std::string cmd_lpop(const std::vector<std::string>& parts, ClientContext& client) {
+    return pop_generic(parts, client, true);
+}
+
+static std::string cmd_rpop(const std::vector<std::string>& parts, ClientContext& client) {
+    return pop_generic(parts, client, false);
+}
+
+static std::string cmd_llen(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    if (!value) return resp_integer(0);
+    if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+    return resp_integer(value->as<QuickList>().size());
+}
+
+static std::string cmd_lindex(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t index;
+    if (!string_to_int64(parts[2], index)) return "-ERR value is not an integer or out of range\r\n";
+
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    if (!value) return resp_null();
+    if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+
+    std::string element;
+    if (!value->as<QuickList>().index(index, element)) return resp_null();
+    return resp_bulk(element);
+}
+
+static std::string cmd_lrange(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t start, stop;
+    if (!string_to_int64(parts[2], start) || !string_to_int64(parts[3], stop)) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    if (!value) return resp_array_header(0);
+    if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+
+    const QuickList& list = value->as<QuickList>();
+    if (!normalize_range(start, stop, list.size())) return resp_array_header(0);
+
+    std::string reply = resp_array_header(stop - start + 1);
+    list.for_range(start, stop - start + 1, [&](const ListPackEntry& entry) {
+        reply += resp_bulk(entry);
+    });
+    return reply;
+}
+
+static std::string cmd_ltrim(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t start, stop;
+    if (!string_to_int64(parts[2], start) || !string_to_int64(parts[3], stop)) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value) return "+OK\r\n";
+    if (value->type != ValueType::List) return WRONGTYPE_ERROR;
+
+    QuickList& list = value->as<QuickList>();
+    int64_t len = list.size();
+    if (!normalize_range(start, stop, len)) {
+        kv_store.erase(parts[1]);
+        return "+OK\r\n";
+    }
+    list.remove_back(len - stop - 1);
+    list.remove_front(start);
+    return "+OK\r\n";
+}
+
+void register_list_commands() {
+    register_command({"LPUSH", -3, CMD_WRITE, cmd_lpush, 1, 1, 1});
+    register_command({"RPUSH", -3, CMD_WRITE, cmd_rpush, 1, 1, 1});
+    register_command({"LPOP", -2, CMD_WRITE, cmd_lpop, 1, 1, 1});
+    register_command({"RPOP", -2, CMD_WRITE, cmd_rpop, 1, 1, 1});
+    register_command({"LLEN", 2, CMD_READONLY, cmd_llen, 1, 1, 1});
+    register_command({"LINDEX", 3, CMD_READONLY, cmd_lindex, 1, 1, 1});
+    register_command({"LRANGE", 4, CMD_READONLY, cmd_lrange, 1, 1, 1});
+    register_command({"LTRIM", 4, CMD_WRITE, cmd_ltrim, 1, 1, 1});
+}
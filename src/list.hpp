@@ -0,0 +1,10 @@
+#pragma once
+
+#include <memory>
+
+#include "quicklist.hpp"
+
+// Empty list with the configured node size and compression depth
+std::unique_ptr<QuickList> make_list();
+
+void register_list_commands();
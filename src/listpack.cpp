@@ -0,0 +1,314 @@
+#include "listpack.hpp"
+
+#include <charconv>
+
+#include "resp.hpp"
+#include "util.hpp"
+
+constexpr size_t LP_HEADER_SIZE = 6;        // total bytes (u32) and element count (u16)
+constexpr size_t LP_COUNT_UNKNOWN = 65535;  // count too large for the header
+constexpr unsigned char LP_EOF = 0xFF;
+
+// Encoding byte patterns
+constexpr unsigned char LP_ENC_STR_6 = 0x80;   // 10xxxxxx
+constexpr unsigned char LP_ENC_INT_13 = 0xC0;  // 110xxxxx yyyyyyyy
+constexpr unsigned char LP_ENC_STR_12 = 0xE0;  // 1110xxxx yyyyyyyy
+constexpr unsigned char LP_ENC_STR_32 = 0xF0;
+constexpr unsigned char LP_ENC_INT_16 = 0xF1;
+constexpr unsigned char LP_ENC_INT_24 = 0xF2;
+constexpr unsigned char LP_ENC_INT_32 = 0xF3;
+constexpr unsigned char LP_ENC_INT_64 = 0xF4;
+
+static size_t backlen_size(size_t len) {
+    if (len <= 127) return 1;
+    if (len < 16383) return 2;
+    if (len < 2097151) return 3;
+    if (len < 268435455) return 4;
+    return 5;
+}
+
+// Length of encoding + data, stored 7 bits per byte so it can be read
+// backwards from the byte before the next entry
+static void append_backlen(std::string& out, size_t len) {
+    size_t bytes = backlen_size(len);
+    out.push_back(static_cast<char>(len >> (7 * (bytes - 1))));
+    for (size_t i = 1; i < bytes; i++) {
+        out.push_back(static_cast<char>(((len >> (7 * (bytes - 1 - i))) & 127) | 128));
+    }
+}
+
+static void append_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+static std::string encode_int(int64_t value) {
+    std::string out;
+    if (value >= 0 && value <= 127) {
+        out.push_back(static_cast<char>(value));
+    } else if (value >= -4096 && value <= 4095) {
+        uint64_t raw = value < 0 ? (1 << 13) + value : value;
+        out.push_back(static_cast<char>(LP_ENC_INT_13 | (raw >> 8)));
+        out.push_back(static_cast<char>(raw & 0xff));
+    } else if (value >= INT16_MIN && value <= INT16_MAX) {
+        out.push_back(static_cast<char>(LP_ENC_INT_16));
+        append_le(out, value, 2);
+    } else if (value >= -(1 << 23) && value < (1 << 23)) {
+        out.push_back(static_cast<char>(LP_ENC_INT_24));
+        append_le(out, value, 3);
+    } else if (value >= INT32_MIN && value <= INT32_MAX) {
+        out.push_back(static_cast<char>(LP_ENC_INT_32));
+        append_le(out, value, 4);
+    } else {
+        out.push_back(static_cast<char>(LP_ENC_INT_64));
+        append_le(out, value, 8);
+    }
+    append_backlen(out, out.size());
+    return out;
+}
+
+static std::string encode_entry(std::string_view value) {
+    int64_t integer;
+    if (string_to_int64(value, integer)) return encode_int(integer);
+
+    std::string out;
+    size_t len = value.size();
+    if (len < 64) {
+        out.push_back(static_cast<char>(LP_ENC_STR_6 | len));
+    } else if (len < 4096) {
+        out.push_back(static_cast<char>(LP_ENC_STR_12 | (len >> 8)));
+        out.push_back(static_cast<char>(len & 0xff));
+    } else {
+        out.push_back(static_cast<char>(LP_ENC_STR_32));
+        append_le(out, len, 4);
+    }
+    out.append(value);
+    append_backlen(out, out.size());
+    return out;
+}
+
+// Read a backlen backwards from its last byte, leaves p on its first byte
+static uint64_t read_backlen(const std::string& buf, size_t& p) {
+    uint64_t len = 0;
+    int shift = 0;
+    while (true) {
+        unsigned char b = buf[p];
+        len |= static_cast<uint64_t>(b & 127) << shift;
+        if (!(b & 128) || shift > 28) break;
+        shift += 7;
+        p--;
+    }
+    return len;
+}
+
+static uint64_t read_le(const std::string& buf, size_t pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | static_cast<unsigned char>(buf[pos + i]);
+    return value;
+}
+
+// Size of an entry's encoding and data, 0 for an invalid encoding byte.
+// avail bounds the read of multi-byte string lengths.
+static size_t encoded_size(const std::string& buf, size_t pos, size_t avail) {
+    unsigned char b = buf[pos];
+    if (b < 0x80) return 1;
+    if ((b & 0xC0) == LP_ENC_STR_6) return 1 + (b & 0x3f);
+    if ((b & 0xE0) == LP_ENC_INT_13) return 2;
+    if ((b & 0xF0) == LP_ENC_STR_12) {
+        if (avail < 2) return 0;
+        return 2 + (((b & 0x0f) << 8) | static_cast<unsigned char>(buf[pos + 1]));
+    }
+    switch (b) {
+    case LP_ENC_STR_32:
+        if (avail < 5) return 0;
+        return 5 + read_le(buf, pos + 1, 4);
+    case LP_ENC_INT_16: return 3;
+    case LP_ENC_INT_24: return 4;
+    case LP_ENC_INT_32: return 5;
+    case LP_ENC_INT_64: return 9;
+    default: return 0;
+    }
+}
+
+bool ListPackEntry::equals(std::string_view other) const {
+    if (!is_int) return str == other;
+    int64_t value;
+    return string_to_int64(other, value) && value == integer;
+}
+
+std::string resp_bulk(const ListPackEntry& entry) {
+    return entry.is_int ? resp_bulk(std::to_string(entry.integer)) : resp_bulk(entry.str);
+}
+
+void resp_append_bulk(std::string& out, const ListPackEntry& entry) {
+    if (!entry.is_int) {
+        resp_append_bulk(out, entry.str);
+        return;
+    }
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), entry.integer).ptr;
+    resp_append_bulk(out, std::string_view(digits, end - digits));
+}
+
+ListPack::ListPack() : buf_(LP_HEADER_SIZE, '\0') {
+    buf_.push_back(static_cast<char>(LP_EOF));
+    write_header();
+}
+
+bool ListPack::assign(std::string blob) {
+    if (blob.size() < LP_HEADER_SIZE + 1 || read_le(blob, 0, 4) != blob.size()) return false;
+    if (static_cast<unsigned char>(blob.back()) != LP_EOF) return false;
+
+    size_t count = 0;
+    size_t pos = LP_HEADER_SIZE;
+    size_t end = blob.size() - 1;
+    while (pos < end) {
+        size_t size = encoded_size(blob, pos, end - pos);
+        if (size == 0 || size > end - pos) return false;
+        size_t total = size + backlen_size(size);
+        if (total > end - pos) return false;
+        size_t p = pos + total - 1;
+        if (read_backlen(blob, p) != size || p != pos + size) return false;
+        pos += total;
+        count++;
+    }
+    if (pos != end) return false;
+
+    size_t header_count = read_le(blob, 4, 2);
+    if (header_count != LP_COUNT_UNKNOWN && header_count != count) return false;
+
+    buf_ = std::move(blob);
+    count_ = count;
+    return true;
+}
+
+void ListPack::write_header() {
+    uint64_t total = buf_.size();
+    uint64_t count = count_ < LP_COUNT_UNKNOWN ? count_ : LP_COUNT_UNKNOWN;
+    for (int i = 0; i < 4; i++) buf_[i] = static_cast<char>((total >> (8 * i)) & 0xff);
+    for (int i = 0; i < 2; i++) buf_[4 + i] = static_cast<char>((count >> (8 * i)) & 0xff);
+}
+
+size_t ListPack::entry_length(size_t pos) const {
+    size_t size = encoded_size(buf_, pos, end() - pos);
+    return size + backlen_size(size);
+}
+
+size_t ListPack::first() const {
+    return count_ ? LP_HEADER_SIZE : npos;
+}
+
+size_t ListPack::last() const {
+    return count_ ? prev(end()) : npos;
+}
+
+size_t ListPack::next(size_t pos) const {
+    size_t next = pos + entry_length(pos);
+    return next < end() ? next : npos;
+}
+
+size_t ListPack::prev(size_t pos) const {
+    if (pos <= LP_HEADER_SIZE) return npos;
+
+    size_t p = pos - 1;
+    uint64_t len = read_backlen(buf_, p);
+    return p - len;
+}
+
+size_t ListPack::seek(long index) const {
+    long count = static_cast<long>(count_);
+    if (index < 0) index += count;
+    if (index < 0 || index >= count) return npos;
+
+    size_t pos;
+    if (index < count / 2) {
+        pos = first();
+        while (index-- > 0) pos = next(pos);
+    } else {
+        pos = last();
+        for (long i = count - 1; i > index; i--) pos = prev(pos);
+    }
+    return pos;
+}
+
+ListPackEntry ListPack::get(size_t pos) const {
+    ListPackEntry entry;
+    unsigned char b = buf_[pos];
+
+    if (b < 0x80) {
+        entry.is_int = true;
+        entry.integer = b;
+    } else if ((b & 0xC0) == LP_ENC_STR_6) {
+        entry.str = std::string_view(buf_).substr(pos + 1, b & 0x3f);
+    } else if ((b & 0xE0) == LP_ENC_INT_13) {
+        uint64_t raw = ((b & 0x1f) << 8) | static_cast<unsigned char>(buf_[pos + 1]);
+        entry.is_int = true;
+        entry.integer = raw >= (1 << 12) ? static_cast<int64_t>(raw) - (1 << 13) : static_cast<int64_t>(raw);
+    } else if ((b & 0xF0) == LP_ENC_STR_12) {
+        size_t len = ((b & 0x0f) << 8) | static_cast<unsigned char>(buf_[pos + 1]);
+        entry.str = std::string_view(buf_).substr(pos + 2, len);
+    } else if (b == LP_ENC_STR_32) {
+        entry.str = std::string_view(buf_).substr(pos + 5, read_le(buf_, pos + 1, 4));
+    } else {
+        int bytes = b == LP_ENC_INT_16 ? 2 : b == LP_ENC_INT_24 ? 3 : b == LP_ENC_INT_32 ? 4 : 8;
+        uint64_t raw = read_le(buf_, pos + 1, bytes);
+        // Sign extend from the stored width
+        int unused = 64 - 8 * bytes;
+        entry.is_int = true;
+        entry.integer = unused ? static_cast<int64_t>(raw << unused) >> unused : static_cast<int64_t>(raw);
+    }
+    return entry;
+}
+
+size_t ListPack::insert(size_t pos, std::string_view value) {
+    if (pos == npos) pos = end();
+    buf_.insert(pos, encode_entry(value));
+    count_++;
+    write_header();
+    return pos;
+}
+
+size_t ListPack::insert(size_t pos, int64_t value) {
+    if (pos == npos) pos = end();
+    buf_.insert(pos, encode_int(value));
+    count_++;
+    write_header();
+    return pos;
+}
+
+size_t ListPack::replace(size_t pos, std::string_view value) {
+    buf_.replace(pos, entry_length(pos), encode_entry(value));
+    write_header();
+    return pos;
+}
+
+size_t ListPack::erase(size_t pos, size_t count) {
+    size_t stop = pos;
+    size_t removed = 0;
+    while (removed < count && stop < end()) {
+        stop += entry_length(stop);
+        removed++;
+    }
+    buf_.erase(pos, stop - pos);
+    count_ -= removed;
+    write_header();
+    return pos < end() ? pos : npos;
+}
+
+size_t ListPack::find(size_t pos, std::string_view value, size_t skip) const {
+    int64_t integer;
+    bool value_is_int = string_to_int64(value, integer);
+
+    while (pos != npos) {
+        ListPackEntry entry = get(pos);
+        if (entry.is_int ? value_is_int && entry.integer == integer : entry.str == value) {
+            return pos;
+        }
+        for (size_t i = 0; i <= skip && pos != npos; i++) pos = next(pos);
+    }
+    return npos;
+}
+
+size_t ListPack::entry_size(std::string_view value) {
+    size_t size = value.size() + 5;
+    return size + backlen_size(size);
+}
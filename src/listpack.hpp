@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// One element read out of a listpack. str points into the listpack and is
+// only valid until it is modified.
+struct ListPackEntry {
+    bool is_int = false;
+    int64_t integer = 0;
+    std::string_view str;
+
+    std::string to_string() const { return is_int ? std::to_string(integer) : std::string(str); }
+    // The entry as text, integers formatted into scratch
+    std::string_view text(std::string& scratch) const {
+        if (!is_int) return str;
+        scratch = std::to_string(integer);
+        return scratch;
+    }
+    bool equals(std::string_view other) const;
+};
+
+// Bulk string reply for an entry
+std::string resp_bulk(const ListPackEntry& entry);
+void resp_append_bulk(std::string& out, const ListPackEntry& entry);
+
+// A run of strings and integers packed into one buffer, the building block
+// of the compact list, hash and sorted set encodings. Every entry is
+// followed by its own length so the buffer can be walked from either end.
+// The byte layout is the Redis listpack format, so buffers go into RDB
+// files and DUMP payloads as they are.
+//
+// Entries are addressed by byte offset; offsets are invalidated by any
+// insert or erase before them.
+class ListPack {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    ListPack();
+
+    // Adopt a buffer from an RDB file, false if it is malformed
+    bool assign(std::string blob);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    size_t bytes() const { return buf_.size(); }
+    const std::string& data() const { return buf_; }
+    // Give back the slack left by growing, once no more inserts are expected
+    void shrink_to_fit() { buf_.shrink_to_fit(); }
+    void swap(ListPack& other) {
+        buf_.swap(other.buf_);
+        std::swap(count_, other.count_);
+    }
+
+    // Offsets of entries, npos past either end
+    size_t first() const;
+    size_t last() const;
+    size_t next(size_t pos) const;
+    size_t prev(size_t pos) const;
+    // Entry at index, negative counts from the end
+    size_t seek(long index) const;
+
+    ListPackEntry get(size_t pos) const;
+
+    // Insert before the entry at pos, or append when pos is npos. Returns
+    // the offset of the new entry.
+    size_t insert(size_t pos, std::string_view value);
+    size_t insert(size_t pos, int64_t value);
+    void push_front(std::string_view value) { insert(first(), value); }
+    void push_back(std::string_view value) { insert(npos, value); }
+
+    // Replace the entry at pos in place, returns its (unchanged) offset
+    size_t replace(size_t pos, std::string_view value);
+
+    // Remove count entries starting at pos, returns the offset of the entry
+    // that followed them or npos
+    size_t erase(size_t pos, size_t count = 1);
+
+    // Offset of the first entry from pos on that equals value, looking only
+    // at every (skip + 1)th entry. Used for the keys of key/value layouts.
+    size_t find(size_t pos, std::string_view value, size_t skip = 0) const;
+
+    // Worst-case encoded size of a value, to decide whether it still fits
+    static size_t entry_size(std::string_view value);
+
+private:
+    size_t end() const { return buf_.size() - 1; }
+    size_t entry_length(size_t pos) const;
+    void write_header();
+
+    std::string buf_;
+    size_t count_ = 0;
+};
@@ -0,0 +1,121 @@
+#include "lzf.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+constexpr int LZF_HASH_BITS = 13;
+constexpr size_t LZF_MAX_LITERAL = 32;
+constexpr size_t LZF_MAX_OFFSET = 1 << 13;
+constexpr size_t LZF_MAX_MATCH = (1 << 8) + (1 << 3);
+
+bool lzf_compress(std::string_view in, std::string& out, size_t max_out) {
+    out.resize(max_out);
+    if (max_out == 0) return false;
+
+    // Last position + 1 at which each 3-byte prefix was seen
+    uint32_t table[1 << LZF_HASH_BITS] = {};
+
+    const auto* src = reinterpret_cast<const unsigned char*>(in.data());
+    size_t ip = 0;
+    size_t op = 1;      // out[0] holds the control byte of the first literal run
+    size_t literal = 0;
+
+    auto push_literal = [&]() {
+        if (op >= max_out) return false;
+        out[op++] = static_cast<char>(src[ip++]);
+        if (++literal == LZF_MAX_LITERAL) {
+            out[op - literal - 1] = static_cast<char>(literal - 1);
+            literal = 0;
+            op++;
+        }
+        return true;
+    };
+
+    while (ip + 2 < in.size()) {
+        uint32_t prefix = (src[ip] << 16) | (src[ip + 1] << 8) | src[ip + 2];
+        uint32_t slot = (prefix * 2654435761u) >> (32 - LZF_HASH_BITS);
+        size_t ref = table[slot];
+        table[slot] = static_cast<uint32_t>(ip + 1);
+
+        if (ref != 0) {
+            ref--;
+            size_t offset = ip - ref - 1;
+            if (offset < LZF_MAX_OFFSET && src[ref] == src[ip] && src[ref + 1] == src[ip + 1] &&
+                src[ref + 2] == src[ip + 2]) {
+                size_t max_len = std::min(in.size() - ip, LZF_MAX_MATCH);
+                size_t len = 3;
+                while (len < max_len && src[ref + len] == src[ip + len]) len++;
+
+                // Back reference plus the next run's control byte
+                if (op + 4 > max_out) return false;
+                if (literal > 0) {
+                    out[op - literal - 1] = static_cast<char>(literal - 1);
+                } else {
+                    op--;
+                }
+
+                size_t encoded = len - 2;
+                if (encoded < 7) {
+                    out[op++] = static_cast<char>((offset >> 8) + (encoded << 5));
+                } else {
+                    out[op++] = static_cast<char>((offset >> 8) + (7 << 5));
+                    out[op++] = static_cast<char>(encoded - 7);
+                }
+                out[op++] = static_cast<char>(offset & 0xff);
+
+                literal = 0;
+                op++;
+                ip += len;
+                continue;
+            }
+        }
+        if (!push_literal()) return false;
+    }
+
+    while (ip < in.size()) {
+        if (!push_literal()) return false;
+    }
+
+    if (literal > 0) {
+        out[op - literal - 1] = static_cast<char>(literal - 1);
+    } else {
+        op--;
+    }
+    out.resize(op);
+    return true;
+}
+
+bool lzf_decompress(std::string_view in, std::string& out, size_t out_len) {
+    out.clear();
+    out.reserve(out_len);
+    size_t ip = 0;
+
+    while (ip < in.size()) {
+        unsigned int ctrl = static_cast<unsigned char>(in[ip++]);
+
+        if (ctrl < 32) {
+            size_t run = ctrl + 1;
+            if (ip + run > in.size()) return false;
+            out.append(in, ip, run);
+            ip += run;
+            continue;
+        }
+
+        size_t len = ctrl >> 5;
+        if (len == 7) {
+            if (ip >= in.size()) return false;
+            len += static_cast<unsigned char>(in[ip++]);
+        }
+        if (ip >= in.size()) return false;
+        size_t back = ((ctrl & 0x1f) << 8) + static_cast<unsigned char>(in[ip++]) + 1;
+        if (back > out.size()) return false;
+
+        // Byte by byte since the reference may overlap what we are writing
+        size_t ref = out.size() - back;
+        for (size_t i = 0; i < len + 2; i++) {
+            out.push_back(out[ref + i]);
+        }
+    }
+
+    return out.size() == out_len;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// LZF, the compression Redis uses for long RDB strings and quicklist nodes
+
+// Compress in, false if the result wouldn't be smaller than max_out bytes
+bool lzf_compress(std::string_view in, std::string& out, size_t max_out);
+
+// Decompress an LZF block that expands to exactly out_len bytes
+bool lzf_decompress(std::string_view in, std::string& out, size_t out_len);
@@ -0,0 +1,251 @@
+#include "migrate.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "crc64.hpp"
+#include "multi.hpp"
+#include "net.hpp"
+#include "rdb.hpp"
+#include "replication.hpp"
+#include "resp.hpp"
+#include "server.hpp"
+
+std::string dump_payload(const ValueWithExpiry& value) {
+    RdbWriter writer;
+    writer.write_byte(rdb_object_type(value));
+    writer.write_object(value);
+    writer.write_byte(RDB_VERSION & 0xff);
+    writer.write_byte((RDB_VERSION >> 8) & 0xff);
+
+    uint64_t checksum = writer.checksum();
+    for (int i = 0; i < 8; i++) writer.write_byte((checksum >> (8 * i)) & 0xff);
+    return std::move(writer.buffer());
+}
+
+bool restore_payload(const std::string& payload, ValueWithExpiry& value) {
+    if (payload.size() < 10) return false;
+
+    size_t footer = payload.size() - 10;
+    int version = static_cast<unsigned char>(payload[footer]) |
+        (static_cast<unsigned char>(payload[footer + 1]) << 8);
+    if (version > RDB_VERSION) return false;
+
+    uint64_t expected = 0;
+    for (int i = 7; i >= 0; i--) {
+        expected = (expected << 8) | static_cast<unsigned char>(payload[footer + 2 + i]);
+    }
+    if (expected != crc64(0, payload.data(), footer + 2)) return false;
+
+    RdbReader reader(payload);
+    unsigned char type;
+    if (!reader.read_byte(type) || !reader.read_object(type, value)) return false;
+    return reader.position() == footer;
+}
+
+static std::string cmd_dump(const std::vector<std::string>& parts, ClientContext& client) {
+    auto it = kv_store.find(parts[1]);
+    if (it == kv_store.end() || it->second.is_expired()) return resp_null();
+    return resp_bulk(dump_payload(it->second));
+}
+
+// RESTORE key ttl payload [REPLACE] [ABSTTL] [IDLETIME seconds] [FREQ frequency]
+static std::string cmd_restore(const std::vector<std::string>& parts, ClientContext& client) {
+    long long ttl;
+    try {
+        ttl = std::stoll(parts[2]);
+    } catch (const std::exception& e) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+    if (ttl < 0) return "-ERR Invalid TTL value, must be >= 0\r\n";
+
+    bool replace = false;
+    bool absttl = false;
+    for (size_t i = 4; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "REPLACE") {
+            replace = true;
+        } else if (option == "ABSTTL") {
+            absttl = true;
+        } else if ((option == "IDLETIME" || option == "FREQ") && i + 1 < parts.size()) {
+            // We keep no LRU/LFU metadata, accept and ignore
+            i++;
+        } else {
+            return "-ERR syntax error\r\n";
+        }
+    }
+
+    auto it = kv_store.find(parts[1]);
+    bool exists = it != kv_store.end() && !it->second.is_expired();
+    if (exists && !replace) return "-BUSYKEY Target key name already exists.\r\n";
+
+    ValueWithExpiry value;
+    if (!restore_payload(parts[3], value)) {
+        return "-ERR DUMP payload version or checksum are wrong\r\n";
+    }
+
+    if (it != kv_store.end()) remove_expiry(parts[1], it->second);
+    if (ttl == 0) {
+        kv_store[parts[1]] = std::move(value);
+        return "+OK\r\n";
+    }
+
+    int64_t expire_at = ttl;
+    if (!absttl && __builtin_add_overflow(ttl, unix_now_ms(), &expire_at)) expire_at = INT64_MAX;
+    auto at = unix_ms_to_steady(expire_at);
+    if (at < std::chrono::steady_clock::now()) {
+        if (it != kv_store.end()) kv_store.erase(it);
+        return "+OK\r\n";
+    }
+    set_expiry(parts[1], kv_store[parts[1]] = std::move(value), at);
+    return "+OK\r\n";
+}
+
+// TTL as RESTORE ... ABSTTL takes it: absolute unix ms, 0 for none
+static int64_t absolute_ttl(const ValueWithExpiry& value) {
+    return value.has_expiry ? steady_to_unix_ms(value.expiry) : 0;
+}
+
+bool migrate_send_batch(int fd, const std::vector<std::string>& candidates, MigrationBatch& batch,
+                        bool asking, bool replace) {
+    std::string commands;
+    {
+        std::shared_lock<std::shared_mutex> lock(kv_mutex);
+        for (const auto& key : candidates) {
+            auto it = kv_store.find(key);
+            if (it == kv_store.end() || it->second.is_expired()) continue;
+
+            std::string payload = dump_payload(it->second);
+            int64_t ttl = absolute_ttl(it->second);
+
+            std::vector<std::string> restore = {asking ? "RESTORE-ASKING" : "RESTORE", key, std::to_string(ttl),
+                                                payload, "ABSTTL"};
+            if (replace) restore.push_back("REPLACE");
+            commands += resp_command(restore);
+
+            batch.keys.push_back(key);
+            batch.payloads.push_back(std::move(payload));
+            batch.ttls.push_back(ttl);
+        }
+    }
+
+    return commands.empty() || send_all(fd, commands);
+}
+
+bool migrate_finish_batch(int fd, std::string& buffer, MigrationBatch& batch, bool copy) {
+    std::vector<bool> restored(batch.keys.size(), false);
+    std::string reply;
+    for (size_t i = 0; i < batch.keys.size(); i++) {
+        if (!read_line(fd, buffer, reply)) return false;
+        if (reply.rfind("+OK", 0) == 0) {
+            restored[i] = true;
+        } else if (batch.error.empty()) {
+            batch.error = reply.empty() ? "ERR empty reply" : reply.substr(1);
+        }
+    }
+
+    if (copy) {
+        for (bool ok : restored) batch.moved += ok;
+        return true;
+    }
+
+    std::vector<std::string> del = {"DEL"};
+    std::lock_guard<std::shared_mutex> lock(kv_mutex);
+    for (size_t i = 0; i < batch.keys.size(); i++) {
+        if (!restored[i]) continue;
+
+        auto it = kv_store.find(batch.keys[i]);
+        if (it == kv_store.end()) continue;
+        // An EXPIRE or PERSIST in flight changes only the TTL, which the
+        // payload doesn't carry
+        if (absolute_ttl(it->second) != batch.ttls[i] || dump_payload(it->second) != batch.payloads[i]) {
+            batch.retry.push_back(batch.keys[i]);
+            continue;
+        }
+        kv_store.erase(it);
+        touch_key(batch.keys[i]);
+        del.push_back(batch.keys[i]);
+        batch.moved++;
+    }
+
+    if (del.size() > 1 && !replication_is_replica()) {
+        replication_propagate(del);
+    }
+    return true;
+}
+
+static void set_socket_timeout(int fd, long long timeout_ms) {
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key ...]
+static std::string cmd_migrate(const std::vector<std::string>& parts, ClientContext& client) {
+    if (replication_is_replica() && server_config.replica_read_only) {
+        return "-READONLY You can't write against a read only replica.\r\n";
+    }
+
+    int port;
+    long long db, timeout_ms;
+    try {
+        port = std::stoi(parts[2]);
+        db = std::stoll(parts[4]);
+        timeout_ms = std::stoll(parts[5]);
+    } catch (const std::exception& e) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+    if (db != 0) return "-ERR only database 0 is supported\r\n";
+    if (timeout_ms <= 0) timeout_ms = 1000;
+
+    bool copy = false;
+    bool replace = false;
+    std::vector<std::string> keys;
+    for (size_t i = 6; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "COPY") {
+            copy = true;
+        } else if (option == "REPLACE") {
+            replace = true;
+        } else if (option == "KEYS") {
+            if (!parts[3].empty()) {
+                return "-ERR When using MIGRATE KEYS option, the key argument must be set to the empty string\r\n";
+            }
+            keys.assign(parts.begin() + i + 1, parts.end());
+            break;
+        } else {
+            return "-ERR syntax error\r\n";
+        }
+    }
+    if (keys.empty() && !parts[3].empty()) keys.push_back(parts[3]);
+
+    int fd = connect_tcp(parts[1], port);
+    if (fd < 0) return "-IOERR error or timeout connecting to the client\r\n";
+    set_socket_timeout(fd, timeout_ms);
+
+    MigrationBatch batch;
+    std::string buffer;
+    bool ok = migrate_send_batch(fd, keys, batch, server_config.cluster_enabled, replace) &&
+        migrate_finish_batch(fd, buffer, batch, copy);
+    close(fd);
+
+    if (!ok) return "-IOERR error or timeout reading to target instance\r\n";
+    if (!batch.error.empty()) return "-" + batch.error + "\r\n";
+    if (batch.keys.empty()) return "+NOKEY\r\n";
+    if (!batch.retry.empty()) return "-TRYAGAIN Keys changed while being migrated\r\n";
+    return "+OK\r\n";
+}
+
+void register_migrate_commands() {
+    register_command({"DUMP", 2, CMD_READONLY, cmd_dump, 1, 1, 1});
+    register_command({"RESTORE", -4, CMD_WRITE, cmd_restore, 1, 1, 1});
+    register_command({"RESTORE-ASKING", -4, CMD_WRITE | CMD_ASKING, cmd_restore, 1, 1, 1});
+    // Does its own locking so reads and writes continue while keys are in flight
+    register_command({"MIGRATE", -6, CMD_NO_MULTI, cmd_migrate});
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "store.hpp"
+
+// DUMP payload for a value: RDB type and encoding followed by the RDB
+// version and a CRC64 of everything before it
+std::string dump_payload(const ValueWithExpiry& value);
+
+// Decode a DUMP payload, false if the version or checksum don't match
+bool restore_payload(const std::string& payload, ValueWithExpiry& value);
+
+// One pipelined round trip of RESTORE commands. Keys are serialized under a
+// shared lock, so traffic keeps flowing while they are in flight; once the
+// target confirms, each key is deleted locally under the exclusive lock only
+// if it still holds exactly what was sent, TTL included. Keys written or
+// given a new TTL in the meantime end up in retry for another round.
+struct MigrationBatch {
+    std::vector<std::string> keys;      // keys that existed and were sent
+    std::vector<std::string> payloads;
+    std::vector<int64_t> ttls;          // absolute unix ms as sent, 0 for none
+    std::vector<std::string> retry;
+    size_t moved = 0;
+    std::string error;                  // first error reply from the target
+};
+
+// Serialize candidates that still exist and write their RESTORE commands.
+// Caller holds no kv_mutex.
+bool migrate_send_batch(int fd, const std::vector<std::string>& candidates, MigrationBatch& batch,
+                        bool asking, bool replace);
+
+// Read the replies for a batch and drop the keys that moved, unless copy.
+// Returns false if the connection failed.
+bool migrate_finish_batch(int fd, std::string& buffer, MigrationBatch& batch, bool copy);
+
+void register_migrate_commands();
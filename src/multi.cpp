@@ -0,0 +1,172 @@
+#include "multi.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "replication.hpp"
+#include "resp.hpp"
+#include "server.hpp"
+#include "store.hpp"
+
+// WATCH compares version counters rather than registering itself with
+// each key: a write bumps the counter of every key it names, and EXEC
+// fails if any watched key's counter moved. Keys share counters in
+// stripes by hash, so a counter outlives the key (a key created and
+// deleted again still reads as changed) and writes do no lookups. The
+// price is the odd false conflict between keys in the same stripe, which
+// only costs the client a retry. Guarded by kv_mutex.
+static constexpr size_t VERSION_STRIPES = 1 << 14;
+static uint64_t key_versions[VERSION_STRIPES];
+
+// Clients with at least one watched key; writes skip the counters while
+// there are none
+static std::atomic<size_t> watching_clients{0};
+
+static uint64_t& key_version(std::string_view key) {
+    return key_versions[std::hash<std::string_view>()(key) & (VERSION_STRIPES - 1)];
+}
+
+void touch_key(std::string_view key) {
+    if (watching_clients.load(std::memory_order_relaxed) == 0) return;
+    key_version(key)++;
+}
+
+void touch_keys(const Command& command, const std::vector<std::string>& parts) {
+    if (watching_clients.load(std::memory_order_relaxed) == 0) return;
+    for (size_t pos : command_key_positions(command, parts)) key_version(parts[pos])++;
+}
+
+void touch_all_keys() {
+    for (uint64_t& version : key_versions) version++;
+}
+
+void unwatch_all_keys(ClientContext& client) {
+    if (client.watched.empty()) return;
+    client.watched.clear();
+    watching_clients.fetch_sub(1, std::memory_order_relaxed);
+}
+
+static void reset_multi(ClientContext& client) {
+    client.in_multi = false;
+    client.multi_error = false;
+    client.multi_has_writes = false;
+    client.multi_queue.clear();
+}
+
+// Whether a watched key changed since WATCH. A key that was live then and
+// has expired since counts as changed even if nothing deleted it yet.
+// Caller holds kv_mutex.
+static bool watched_keys_changed(const ClientContext& client) {
+    for (const WatchedKey& watched : client.watched) {
+        if (key_version(watched.key) != watched.version) return true;
+        if (watched.live) {
+            auto it = kv_store.find(watched.key);
+            if (it == kv_store.end() || it->second.is_expired()) return true;
+        }
+    }
+    return false;
+}
+
+std::string multi_queue_command(const Command& command, const std::vector<std::string>& parts,
+                                ClientContext& client) {
+    client.multi_queue.push_back(parts);
+    if (command.flags & (CMD_WRITE | CMD_MAY_WRITE)) client.multi_has_writes = true;
+    return "+QUEUED\r\n";
+}
+
+// MULTI
+static std::string cmd_multi(const std::vector<std::string>& parts, ClientContext& client) {
+    if (client.in_multi) return "-ERR MULTI calls can not be nested\r\n";
+    client.in_multi = true;
+    return "+OK\r\n";
+}
+
+// EXEC: run the queued commands under one hold of kv_mutex, so no other
+// client's command lands between them
+static std::string cmd_exec(const std::vector<std::string>& parts, ClientContext& client) {
+    if (!client.in_multi) return "-ERR EXEC without MULTI\r\n";
+
+    // Our master's transactions are applied command by command as they
+    // arrive, replica_stream holding the lock from MULTI to here
+    if (client.is_master) {
+        reset_multi(client);
+        return "+OK\r\n";
+    }
+
+    std::vector<std::vector<std::string>> queue = std::move(client.multi_queue);
+    bool failed = client.multi_error;
+    bool has_writes = client.multi_has_writes;
+    reset_multi(client);
+    if (failed) {
+        unwatch_all_keys(client);
+        return "-EXECABORT Transaction discarded because of previous errors.\r\n";
+    }
+
+    std::unique_lock<std::shared_mutex> write_lock(kv_mutex, std::defer_lock);
+    std::shared_lock<std::shared_mutex> read_lock(kv_mutex, std::defer_lock);
+    if (has_writes) {
+        write_lock.lock();
+    } else {
+        read_lock.lock();
+    }
+
+    bool changed = watched_keys_changed(client);
+    unwatch_all_keys(client);
+    if (changed) return "*-1\r\n";
+
+    // Replicas get the writes wrapped the same way, to apply them at once
+    bool wrap = has_writes && !replication_is_replica();
+    if (wrap) client.woff = replication_propagate({"MULTI"});
+    client.in_exec = true;
+    std::string reply = resp_array_header(queue.size());
+    for (const auto& queued : queue) reply += handle_command_locked(queued, client);
+    client.in_exec = false;
+    if (wrap) client.woff = replication_propagate({"EXEC"});
+    return reply;
+}
+
+// DISCARD
+static std::string cmd_discard(const std::vector<std::string>& parts, ClientContext& client) {
+    if (!client.in_multi) return "-ERR DISCARD without MULTI\r\n";
+    reset_multi(client);
+    unwatch_all_keys(client);
+    return "+OK\r\n";
+}
+
+// WATCH key [key ...]
+static std::string cmd_watch(const std::vector<std::string>& parts, ClientContext& client) {
+    if (client.in_multi) return "-ERR WATCH inside MULTI is not allowed\r\n";
+
+    // Counted before the first version is read, so no write in between
+    // can skip its counters
+    if (client.watched.empty()) watching_clients.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 1; i < parts.size(); i++) {
+        bool known = std::any_of(client.watched.begin(), client.watched.end(),
+                                 [&](const WatchedKey& watched) { return watched.key == parts[i]; });
+        if (known) continue;
+        auto it = kv_store.find(parts[i]);
+        bool live = it != kv_store.end() && !it->second.is_expired();
+        client.watched.push_back({parts[i], key_version(parts[i]), live});
+    }
+    return "+OK\r\n";
+}
+
+// UNWATCH
+static std::string cmd_unwatch(const std::vector<std::string>& parts, ClientContext& client) {
+    unwatch_all_keys(client);
+    return "+OK\r\n";
+}
+
+void register_multi_commands() {
+    register_command({"MULTI", 1, CMD_NO_QUEUE, cmd_multi});
+    register_command({"EXEC", 1, CMD_NO_QUEUE, cmd_exec});
+    register_command({"DISCARD", 1, CMD_NO_QUEUE, cmd_discard});
+    register_command({"WATCH", -2, CMD_READONLY | CMD_NO_QUEUE, cmd_watch, 1, -1, 1});
+    register_command({"UNWATCH", 1, CMD_NO_SCRIPT, cmd_unwatch});
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "server.hpp"
+
+// Transactions: MULTI, EXEC, DISCARD, WATCH and UNWATCH
+void register_multi_commands();
+
+// Queue a command sent between MULTI and EXEC, returning +QUEUED
+std::string multi_queue_command(const Command& command, const std::vector<std::string>& parts,
+                                ClientContext& client);
+
+// Record that a successful write changed the keys it names, failing the
+// EXEC of any client watching one of them. Costs nothing while no client
+// watches anything. Caller holds kv_mutex exclusively.
+void touch_keys(const Command& command, const std::vector<std::string>& parts);
+void touch_key(std::string_view key);
+
+// Same for every key, for when the whole keyspace is replaced
+void touch_all_keys();
+
+// Forget the client's watched keys, e.g. when it disconnects
+void unwatch_all_keys(ClientContext& client);
@@ -0,0 +1,88 @@
+#include "net.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+bool send_all(int fd, const std::string& data) {
+    return send_all(fd, data.data(), data.size());
+}
+
+bool fill_buffer(int fd, std::string& buffer) {
+    char chunk[16 * 1024];
+    ssize_t bytes_read;
+    do {
+        bytes_read = recv(fd, chunk, sizeof(chunk), 0);
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read <= 0) return false;
+    buffer.append(chunk, bytes_read);
+    return true;
+}
+
+bool read_line(int fd, std::string& buffer, std::string& line) {
+    size_t end;
+    while ((end = buffer.find("\r\n")) == std::string::npos) {
+        if (!fill_buffer(fd, buffer)) return false;
+    }
+    line = buffer.substr(0, end);
+    buffer.erase(0, end + 2);
+    return true;
+}
+
+bool read_exact(int fd, std::string& buffer, size_t len, std::string& out) {
+    while (buffer.size() < len) {
+        if (!fill_buffer(fd, buffer)) return false;
+    }
+    out = buffer.substr(0, len);
+    buffer.erase(0, len);
+    return true;
+}
+
+int connect_tcp(const std::string& host, int port) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* results;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &results) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = results; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            // We pipeline on these links and wait for replies, don't let
+            // Nagle hold back the tail of a batch
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(results);
+    return fd;
+}
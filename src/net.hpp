@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+// Write the whole buffer, retrying on short writes. Returns false once the
+// peer is gone.
+bool send_all(int fd, const char* data, size_t len);
+bool send_all(int fd, const std::string& data);
+
+// Open a TCP connection to host:port, returns -1 on failure
+int connect_tcp(const std::string& host, int port);
+
+// Buffered reads for connections we drive ourselves (master link, MIGRATE).
+// Bytes past what was asked for stay in buffer for the next call.
+bool fill_buffer(int fd, std::string& buffer);
+bool read_line(int fd, std::string& buffer, std::string& line);
+bool read_exact(int fd, std::string& buffer, size_t len, std::string& out);
@@ -0,0 +1,581 @@
+#include "pubsub.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "cluster.hpp"
+#include "net.hpp"
+#include "replication.hpp"
+#include "resp.hpp"
+#include "util.hpp"
+
+// A message frame encoded once and shared by every client it goes to
+using SharedMessage = std::shared_ptr<const std::string>;
+
+// Messages queued for one client past this mean it can't keep up; it is
+// disconnected, like Redis's hard pubsub output buffer limit
+static constexpr size_t PUBSUB_OUTPUT_LIMIT = 32 * 1024 * 1024;
+
+// A subscribed client. Publishers append to pending and signal wake_fd;
+// the client's own thread writes pending out, so its socket keeps a
+// single writer.
+struct Subscriber {
+    int fd;       // the client's socket
+    int wake_fd;
+    std::mutex mutex;  // guards pending, pending_bytes, overflowed and shard_channels
+    std::vector<SharedMessage> pending;
+    size_t pending_bytes = 0;
+    bool overflowed = false;
+    // Also shrinks when this node gives up a slot, from whichever thread
+    // hands it over
+    std::unordered_set<std::string> shard_channels;
+
+    // Changed only by the client's own thread, under pubsub_mutex
+    std::unordered_set<std::string> channels;
+    std::unordered_set<std::string> patterns;
+
+    Subscriber(int socket, int wake) : fd(socket), wake_fd(wake) {}
+    ~Subscriber() { close(wake_fd); }
+};
+
+struct PatternSubscription {
+    std::string text;
+    GlobPattern glob;
+    std::unordered_set<Subscriber*> subscribers;
+
+    explicit PatternSubscription(const std::string& pattern) : text(pattern), glob(pattern) {}
+};
+
+// Pattern subscriptions indexed by their literal prefix. A channel walks
+// its own bytes down the trie and tests only the patterns whose prefix it
+// starts with, so publishing costs nothing for the many patterns that
+// can't match, however many there are.
+class PatternTrie {
+public:
+    void insert(PatternSubscription* pattern) {
+        Node* node = &root_;
+        for (char c : pattern->glob.literal_prefix()) {
+            Node* next = node->child(c);
+            if (!next) {
+                node->children.emplace_back(c, std::make_unique<Node>());
+                next = node->children.back().second.get();
+            }
+            node = next;
+        }
+        node->patterns.push_back(pattern);
+    }
+
+    void erase(PatternSubscription* pattern) { erase(&root_, pattern->glob.literal_prefix(), pattern); }
+
+    // Call visit with each pattern whose prefix channel starts with
+    template <typename F>
+    void for_each_candidate(std::string_view channel, F&& visit) const {
+        const Node* node = &root_;
+        for (size_t i = 0;; i++) {
+            for (PatternSubscription* pattern : node->patterns) visit(pattern);
+            if (i == channel.size()) return;
+            node = node->child(channel[i]);
+            if (!node) return;
+        }
+    }
+
+private:
+    struct Node {
+        std::vector<std::pair<char, std::unique_ptr<Node>>> children;
+        std::vector<PatternSubscription*> patterns;  // whose prefix ends here
+
+        Node* child(char c) const {
+            for (const auto& [byte, node] : children) {
+                if (byte == c) return node.get();
+            }
+            return nullptr;
+        }
+    };
+
+    // Remove pattern under node, pruning branches left empty. True if
+    // node itself is now empty.
+    static bool erase(Node* node, std::string_view rest, PatternSubscription* pattern) {
+        if (rest.empty()) {
+            std::erase(node->patterns, pattern);
+        } else {
+            auto it = std::find_if(node->children.begin(), node->children.end(),
+                                   [&](const auto& child) { return child.first == rest[0]; });
+            if (it != node->children.end() && erase(it->second.get(), rest.substr(1), pattern)) {
+                node->children.erase(it);
+            }
+        }
+        return node->patterns.empty() && node->children.empty();
+    }
+
+    Node root_;
+};
+
+// Subscriptions of all clients. Publishers share the lock, so they fan
+// out in parallel; subscribing and unsubscribing take it exclusively.
+static std::shared_mutex pubsub_mutex;
+static std::unordered_map<std::string, std::unordered_set<Subscriber*>> channel_subscribers;
+static std::unordered_map<std::string, std::unique_ptr<PatternSubscription>> pattern_subscriptions;
+static PatternTrie pattern_trie;
+
+// Shard channels, split by hash slot into stripes with a lock each. A
+// shard channel only ever has traffic on its slot's owner, and SPUBLISH
+// fans out under its own stripe's lock, so busy shard channels neither
+// contend with PUBLISH nor with each other.
+static constexpr size_t SHARD_STRIPES = 64;
+
+struct ShardStripe {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, std::unordered_set<Subscriber*>> channels;
+};
+
+static std::array<ShardStripe, SHARD_STRIPES> shard_stripes;
+
+static ShardStripe& shard_stripe(int slot) { return shard_stripes[static_cast<size_t>(slot) % SHARD_STRIPES]; }
+
+static ShardStripe& shard_stripe(const std::string& channel) { return shard_stripe(key_hash_slot(channel)); }
+
+static void deliver(Subscriber& subscriber, const SharedMessage& message) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(subscriber.mutex);
+        if (subscriber.overflowed) return;
+        if (subscriber.pending_bytes + message->size() > PUBSUB_OUTPUT_LIMIT) {
+            subscriber.overflowed = true;
+            subscriber.pending.clear();
+            // Its thread may be stuck writing to a client that stopped reading
+            shutdown(subscriber.fd, SHUT_RDWR);
+            wake = true;
+        } else {
+            // The thread is already due to wake if something was pending
+            wake = subscriber.pending.empty();
+            subscriber.pending.push_back(message);
+            subscriber.pending_bytes += message->size();
+        }
+    }
+    if (wake) {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = write(subscriber.wake_fd, &one, sizeof(one));
+    }
+}
+
+// Deliver message on channel to its subscribers and to those of matching
+// patterns, returning how many clients got it
+static size_t publish(const std::string& channel, const std::string& message) {
+    std::shared_lock<std::shared_mutex> lock(pubsub_mutex);
+    size_t receivers = 0;
+
+    auto it = channel_subscribers.find(channel);
+    if (it != channel_subscribers.end()) {
+        std::string frame = resp_array_header(3);
+        resp_append_bulk(frame, "message");
+        resp_append_bulk(frame, channel);
+        resp_append_bulk(frame, message);
+        auto shared = std::make_shared<const std::string>(std::move(frame));
+        for (Subscriber* subscriber : it->second) deliver(*subscriber, shared);
+        receivers += it->second.size();
+    }
+
+    pattern_trie.for_each_candidate(channel, [&](const PatternSubscription* pattern) {
+        if (!pattern->glob.matches(channel)) return;
+        std::string frame = resp_array_header(4);
+        resp_append_bulk(frame, "pmessage");
+        resp_append_bulk(frame, pattern->text);
+        resp_append_bulk(frame, channel);
+        resp_append_bulk(frame, message);
+        auto shared = std::make_shared<const std::string>(std::move(frame));
+        for (Subscriber* subscriber : pattern->subscribers) deliver(*subscriber, shared);
+        receivers += pattern->subscribers.size();
+    });
+    return receivers;
+}
+
+// Deliver message on shard channel to its subscribers
+static size_t shard_publish(const std::string& channel, const std::string& message) {
+    ShardStripe& stripe = shard_stripe(channel);
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    auto it = stripe.channels.find(channel);
+    if (it == stripe.channels.end()) return 0;
+
+    std::string frame = resp_array_header(3);
+    resp_append_bulk(frame, "smessage");
+    resp_append_bulk(frame, channel);
+    resp_append_bulk(frame, message);
+    auto shared = std::make_shared<const std::string>(std::move(frame));
+    for (Subscriber* subscriber : it->second) deliver(*subscriber, shared);
+    return it->second.size();
+}
+
+// Channels plus patterns, the count (UN)SUBSCRIBE replies report
+static size_t channel_and_pattern_count(const Subscriber& subscriber) {
+    return subscriber.channels.size() + subscriber.patterns.size();
+}
+
+static size_t shard_channel_count(Subscriber& subscriber) {
+    std::lock_guard<std::mutex> lock(subscriber.mutex);
+    return subscriber.shard_channels.size();
+}
+
+size_t pubsub_subscriptions(const ClientContext& client) {
+    if (!client.subscriber) return 0;
+    return channel_and_pattern_count(*client.subscriber) + shard_channel_count(*client.subscriber);
+}
+
+bool pubsub_wait(ClientContext& client) {
+    Subscriber& subscriber = *client.subscriber;
+    short socket_events = 0;
+    std::vector<SharedMessage> messages;
+    std::string out;
+    while (true) {
+        // Reset the counter before taking pending, so a message queued
+        // after the swap signals again
+        uint64_t count;
+        [[maybe_unused]] ssize_t got = read(subscriber.wake_fd, &count, sizeof(count));
+        {
+            std::lock_guard<std::mutex> lock(subscriber.mutex);
+            if (subscriber.overflowed) {
+                std::cerr << "Client fell behind on pub/sub messages, closing it\n";
+                return false;
+            }
+            messages.swap(subscriber.pending);
+            subscriber.pending_bytes = 0;
+        }
+        if (!messages.empty()) {
+            out.clear();
+            for (const auto& message : messages) out += *message;
+            messages.clear();
+            if (!send_all(client.fd, out)) return false;
+        }
+        if (socket_events) return true;
+
+        struct pollfd fds[2] = {{client.fd, POLLIN, 0}, {subscriber.wake_fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        socket_events = fds[0].revents;
+    }
+}
+
+static Subscriber* subscriber_of(ClientContext& client) {
+    if (!client.subscriber) {
+        int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd < 0) return nullptr;
+        client.subscriber = std::make_shared<Subscriber>(client.fd, wake_fd);
+    }
+    return client.subscriber.get();
+}
+
+// Confirmation of one (un)subscription: its kind, the channel or pattern
+// (null when unsubscribing with nothing subscribed) and the new count
+static std::string subscription_reply(const char* kind, const std::string* name, size_t count) {
+    std::string reply = resp_array_header(3);
+    resp_append_bulk(reply, kind);
+    reply += name ? resp_bulk(*name) : resp_null();
+    reply += resp_integer(static_cast<int64_t>(count));
+    return reply;
+}
+
+// Caller holds pubsub_mutex exclusively
+static void remove_channel(Subscriber& subscriber, const std::string& channel) {
+    auto it = channel_subscribers.find(channel);
+    if (it == channel_subscribers.end()) return;
+    it->second.erase(&subscriber);
+    if (it->second.empty()) channel_subscribers.erase(it);
+}
+
+static void remove_pattern(Subscriber& subscriber, const std::string& pattern) {
+    auto it = pattern_subscriptions.find(pattern);
+    if (it == pattern_subscriptions.end()) return;
+    it->second->subscribers.erase(&subscriber);
+    if (it->second->subscribers.empty()) {
+        pattern_trie.erase(it->second.get());
+        pattern_subscriptions.erase(it);
+    }
+}
+
+// Caller holds the channel's stripe lock exclusively
+static void remove_shard_channel(ShardStripe& stripe, Subscriber& subscriber, const std::string& channel) {
+    auto it = stripe.channels.find(channel);
+    if (it == stripe.channels.end()) return;
+    it->second.erase(&subscriber);
+    if (it->second.empty()) stripe.channels.erase(it);
+}
+
+// Unsubscribe the client from a shard channel, false if it wasn't subscribed
+static bool shard_unsubscribe(Subscriber& subscriber, const std::string& channel) {
+    ShardStripe& stripe = shard_stripe(channel);
+    std::lock_guard<std::shared_mutex> lock(stripe.mutex);
+    {
+        std::lock_guard<std::mutex> subscriber_lock(subscriber.mutex);
+        if (!subscriber.shard_channels.erase(channel)) return false;
+    }
+    remove_shard_channel(stripe, subscriber, channel);
+    return true;
+}
+
+void pubsub_unsubscribe_all(ClientContext& client) {
+    if (!client.subscriber) return;
+    Subscriber& subscriber = *client.subscriber;
+    {
+        std::lock_guard<std::shared_mutex> lock(pubsub_mutex);
+        for (const auto& channel : subscriber.channels) remove_channel(subscriber, channel);
+        for (const auto& pattern : subscriber.patterns) remove_pattern(subscriber, pattern);
+        subscriber.channels.clear();
+        subscriber.patterns.clear();
+    }
+
+    std::vector<std::string> shard_channels;
+    {
+        std::lock_guard<std::mutex> lock(subscriber.mutex);
+        shard_channels.assign(subscriber.shard_channels.begin(), subscriber.shard_channels.end());
+    }
+    for (const auto& channel : shard_channels) shard_unsubscribe(subscriber, channel);
+}
+
+void pubsub_drop_shard_slot(int slot) {
+    ShardStripe& stripe = shard_stripe(slot);
+    std::lock_guard<std::shared_mutex> lock(stripe.mutex);
+    for (auto it = stripe.channels.begin(); it != stripe.channels.end();) {
+        if (key_hash_slot(it->first) != slot) {
+            ++it;
+            continue;
+        }
+        // Tell each subscriber, as if it had sent SUNSUBSCRIBE itself
+        for (Subscriber* subscriber : it->second) {
+            size_t remaining;
+            {
+                std::lock_guard<std::mutex> subscriber_lock(subscriber->mutex);
+                subscriber->shard_channels.erase(it->first);
+                remaining = subscriber->shard_channels.size();
+            }
+            std::string frame = resp_array_header(3);
+            resp_append_bulk(frame, "sunsubscribe");
+            resp_append_bulk(frame, it->first);
+            frame += resp_integer(static_cast<int64_t>(remaining));
+            deliver(*subscriber, std::make_shared<const std::string>(std::move(frame)));
+        }
+        it = stripe.channels.erase(it);
+    }
+}
+
+// SUBSCRIBE channel [channel ...]
+static std::string cmd_subscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    Subscriber* subscriber = subscriber_of(client);
+    if (!subscriber) return "-ERR can't allocate a wakeup descriptor\r\n";
+
+    std::string reply;
+    std::lock_guard<std::shared_mutex> lock(pubsub_mutex);
+    for (size_t i = 1; i < parts.size(); i++) {
+        if (subscriber->channels.insert(parts[i]).second) channel_subscribers[parts[i]].insert(subscriber);
+        reply += subscription_reply("subscribe", &parts[i], channel_and_pattern_count(*subscriber));
+    }
+    return reply;
+}
+
+// PSUBSCRIBE pattern [pattern ...]
+static std::string cmd_psubscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    Subscriber* subscriber = subscriber_of(client);
+    if (!subscriber) return "-ERR can't allocate a wakeup descriptor\r\n";
+
+    std::string reply;
+    std::lock_guard<std::shared_mutex> lock(pubsub_mutex);
+    for (size_t i = 1; i < parts.size(); i++) {
+        if (subscriber->patterns.insert(parts[i]).second) {
+            auto& pattern = pattern_subscriptions[parts[i]];
+            if (!pattern) {
+                pattern = std::make_unique<PatternSubscription>(parts[i]);
+                pattern_trie.insert(pattern.get());
+            }
+            pattern->subscribers.insert(subscriber);
+        }
+        reply += subscription_reply("psubscribe", &parts[i], channel_and_pattern_count(*subscriber));
+    }
+    return reply;
+}
+
+// UNSUBSCRIBE [channel ...] and PUNSUBSCRIBE [pattern ...]: without
+// arguments, from everything subscribed
+static std::string unsubscribe_generic(const std::vector<std::string>& parts, ClientContext& client, bool patterns) {
+    const char* kind = patterns ? "punsubscribe" : "unsubscribe";
+    if (!client.subscriber) return subscription_reply(kind, nullptr, 0);
+    Subscriber& subscriber = *client.subscriber;
+    auto& subscribed = patterns ? subscriber.patterns : subscriber.channels;
+
+    std::vector<std::string> names(parts.begin() + 1, parts.end());
+    if (names.empty()) {
+        if (subscribed.empty()) return subscription_reply(kind, nullptr, channel_and_pattern_count(subscriber));
+        names.assign(subscribed.begin(), subscribed.end());
+    }
+
+    std::string reply;
+    std::lock_guard<std::shared_mutex> lock(pubsub_mutex);
+    for (const auto& name : names) {
+        if (subscribed.erase(name)) patterns ? remove_pattern(subscriber, name) : remove_channel(subscriber, name);
+        reply += subscription_reply(kind, &name, channel_and_pattern_count(subscriber));
+    }
+    return reply;
+}
+
+// UNSUBSCRIBE [channel ...]
+static std::string cmd_unsubscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    return unsubscribe_generic(parts, client, false);
+}
+
+// PUNSUBSCRIBE [pattern ...]
+static std::string cmd_punsubscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    return unsubscribe_generic(parts, client, true);
+}
+
+// SSUBSCRIBE shardchannel [shardchannel ...]
+static std::string cmd_ssubscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    Subscriber* subscriber = subscriber_of(client);
+    if (!subscriber) return "-ERR can't allocate a wakeup descriptor\r\n";
+
+    std::string reply;
+    for (size_t i = 1; i < parts.size(); i++) {
+        ShardStripe& stripe = shard_stripe(parts[i]);
+        std::lock_guard<std::shared_mutex> lock(stripe.mutex);
+        size_t count;
+        {
+            std::lock_guard<std::mutex> subscriber_lock(subscriber->mutex);
+            if (subscriber->shard_channels.insert(parts[i]).second) stripe.channels[parts[i]].insert(subscriber);
+            count = subscriber->shard_channels.size();
+        }
+        reply += subscription_reply("ssubscribe", &parts[i], count);
+    }
+    return reply;
+}
+
+// SUNSUBSCRIBE [shardchannel ...]: without arguments, from every shard
+// channel subscribed
+static std::string cmd_sunsubscribe(const std::vector<std::string>& parts, ClientContext& client) {
+    if (!client.subscriber) return subscription_reply("sunsubscribe", nullptr, 0);
+    Subscriber& subscriber = *client.subscriber;
+
+    std::vector<std::string> names(parts.begin() + 1, parts.end());
+    if (names.empty()) {
+        std::lock_guard<std::mutex> lock(subscriber.mutex);
+        if (subscriber.shard_channels.empty()) return subscription_reply("sunsubscribe", nullptr, 0);
+        names.assign(subscriber.shard_channels.begin(), subscriber.shard_channels.end());
+    }
+
+    std::string reply;
+    for (const auto& name : names) {
+        shard_unsubscribe(subscriber, name);
+        reply += subscription_reply("sunsubscribe", &name, shard_channel_count(subscriber));
+    }
+    return reply;
+}
+
+// PUBLISH channel message
+static std::string cmd_publish(const std::vector<std::string>& parts, ClientContext& client) {
+    size_t receivers = publish(parts[1], parts[2]);
+    // Replicas deliver it to their own subscribers too
+    if (!replication_is_replica()) client.woff = replication_propagate(parts);
+    return resp_integer(static_cast<int64_t>(receivers));
+}
+
+// SPUBLISH shardchannel message
+static std::string cmd_spublish(const std::vector<std::string>& parts, ClientContext& client) {
+    size_t receivers = shard_publish(parts[1], parts[2]);
+    if (!replication_is_replica()) client.woff = replication_propagate(parts);
+    return resp_integer(static_cast<int64_t>(receivers));
+}
+
+// PUBSUB SHARDCHANNELS [pattern] | SHARDNUMSUB [shardchannel ...]
+static std::string pubsub_shard(const std::string& subcommand, const std::vector<std::string>& parts) {
+    if (subcommand == "SHARDCHANNELS") {
+        std::optional<GlobPattern> match;
+        if (parts.size() == 3) match.emplace(parts[2]);
+        std::string items;
+        size_t count = 0;
+        for (ShardStripe& stripe : shard_stripes) {
+            std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+            for (const auto& [channel, subscribers] : stripe.channels) {
+                if (match && !match->matches(channel)) continue;
+                resp_append_bulk(items, channel);
+                count++;
+            }
+        }
+        return resp_array_header(count) + items;
+    }
+
+    std::string reply = resp_array_header((parts.size() - 2) * 2);
+    for (size_t i = 2; i < parts.size(); i++) {
+        ShardStripe& stripe = shard_stripe(parts[i]);
+        std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+        auto it = stripe.channels.find(parts[i]);
+        resp_append_bulk(reply, parts[i]);
+        reply += resp_integer(it == stripe.channels.end() ? 0 : static_cast<int64_t>(it->second.size()));
+    }
+    return reply;
+}
+
+// PUBSUB CHANNELS [pattern] | NUMSUB [channel ...] | NUMPAT |
+// SHARDCHANNELS [pattern] | SHARDNUMSUB [shardchannel ...]
+static std::string cmd_pubsub(const std::vector<std::string>& parts, ClientContext&) {
+    std::string subcommand = to_upper(parts[1]);
+    if ((subcommand == "SHARDCHANNELS" && parts.size() <= 3) || subcommand == "SHARDNUMSUB") {
+        return pubsub_shard(subcommand, parts);
+    }
+
+    std::shared_lock<std::shared_mutex> lock(pubsub_mutex);
+    if (subcommand == "CHANNELS" && parts.size() <= 3) {
+        std::optional<GlobPattern> match;
+        if (parts.size() == 3) match.emplace(parts[2]);
+        std::string items;
+        size_t count = 0;
+        for (const auto& [channel, subscribers] : channel_subscribers) {
+            if (match && !match->matches(channel)) continue;
+            resp_append_bulk(items, channel);
+            count++;
+        }
+        return resp_array_header(count) + items;
+    }
+    if (subcommand == "NUMSUB") {
+        std::string reply = resp_array_header((parts.size() - 2) * 2);
+        for (size_t i = 2; i < parts.size(); i++) {
+            auto it = channel_subscribers.find(parts[i]);
+            resp_append_bulk(reply, parts[i]);
+            reply += resp_integer(it == channel_subscribers.end() ? 0 : static_cast<int64_t>(it->second.size()));
+        }
+        return reply;
+    }
+    if (subcommand == "NUMPAT" && parts.size() == 2) {
+        return resp_integer(static_cast<int64_t>(pattern_subscriptions.size()));
+    }
+    return "-ERR unknown subcommand or wrong number of arguments for '" + parts[1] + "'\r\n";
+}
+
+void register_pubsub_commands() {
+    // Subscribing changes how the connection is served, which a
+    // transaction or a script can't do on the client's behalf
+    unsigned subscribe_flags = CMD_PUBSUB | CMD_NO_MULTI | CMD_NO_SCRIPT;
+    register_command({"SUBSCRIBE", -2, subscribe_flags, cmd_subscribe});
+    register_command({"UNSUBSCRIBE", -1, subscribe_flags, cmd_unsubscribe});
+    register_command({"PSUBSCRIBE", -2, subscribe_flags, cmd_psubscribe});
+    register_command({"PUNSUBSCRIBE", -1, subscribe_flags, cmd_punsubscribe});
+    register_command({"SSUBSCRIBE", -2, subscribe_flags | CMD_SHARD_CHANNEL, cmd_ssubscribe, 1, -1, 1});
+    register_command({"SUNSUBSCRIBE", -1, subscribe_flags | CMD_SHARD_CHANNEL, cmd_sunsubscribe, 1, -1, 1});
+    register_command({"PUBLISH", 3, 0, cmd_publish});
+    register_command({"SPUBLISH", 3, CMD_SHARD_CHANNEL, cmd_spublish, 1, 1, 1});
+    register_command({"PUBSUB", -2, 0, cmd_pubsub});
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+#include "server.hpp"
+
+// Publish/subscribe: SUBSCRIBE, UNSUBSCRIBE, PSUBSCRIBE, PUNSUBSCRIBE,
+// PUBLISH and PUBSUB, and for shard channels SSUBSCRIBE, SUNSUBSCRIBE and
+// SPUBLISH
+void register_pubsub_commands();
+
+// Channels and patterns the client is subscribed to. While there are any
+// it may only run commands flagged CMD_PUBSUB.
+size_t pubsub_subscriptions(const ClientContext& client);
+
+// For a subscribed client's thread instead of blocking in recv: wait until
+// the socket is readable, writing out messages published to the client in
+// the meantime. False once the connection should be closed, because a
+// write failed or the client fell too far behind.
+bool pubsub_wait(ClientContext& client);
+
+// Drop all of the client's subscriptions, when it disconnects
+void pubsub_unsubscribe_all(ClientContext& client);
+
+// Unsubscribe everyone from the shard channels of a slot this node no
+// longer owns, telling them with a sunsubscribe message
+void pubsub_drop_shard_slot(int slot);
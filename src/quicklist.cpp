@@ -0,0 +1,243 @@
+#include "quicklist.hpp"
+
+#include <algorithm>
+
+#include "lzf.hpp"
+
+// Node size limits for fill -1 to -5
+constexpr size_t QUICKLIST_FILL_BYTES[] = {4096, 8192, 16384, 32768, 65536};
+// Even count-bounded nodes don't grow past this
+constexpr size_t QUICKLIST_SIZE_SAFETY_LIMIT = 8192;
+// Not worth compressing below this, or for a gain of less than a few bytes
+constexpr size_t QUICKLIST_MIN_COMPRESS_BYTES = 48;
+constexpr size_t QUICKLIST_MIN_COMPRESS_GAIN = 8;
+
+QuickList::QuickList(int fill, int compress_depth) :
+    fill_(fill == 0 ? 1 : std::max(fill, -5)), compress_depth_(std::max(compress_depth, 0)) {}
+
+bool QuickList::node_has_room(const Node& node, std::string_view value) const {
+    if (node.count == 0) return true;
+
+    size_t bytes = node.raw_bytes + ListPack::entry_size(value);
+    if (fill_ > 0) {
+        return node.count < static_cast<size_t>(fill_) && bytes <= QUICKLIST_SIZE_SAFETY_LIMIT;
+    }
+    return bytes <= QUICKLIST_FILL_BYTES[-fill_ - 1];
+}
+
+void QuickList::compress(Node& node) {
+    if (!node.compressed.empty() || node.raw_bytes < QUICKLIST_MIN_COMPRESS_BYTES) return;
+
+    std::string out;
+    if (!lzf_compress(node.entries.data(), out, node.raw_bytes - QUICKLIST_MIN_COMPRESS_GAIN)) return;
+    out.shrink_to_fit();
+    node.compressed = std::move(out);
+    // Swap rather than assign so the old buffer is actually freed
+    ListPack().swap(node.entries);
+}
+
+void QuickList::decompress(Node& node) {
+    if (node.compressed.empty()) return;
+
+    std::string raw;
+    lzf_decompress(node.compressed, raw, node.raw_bytes);
+    node.entries.assign(std::move(raw));
+    std::string().swap(node.compressed);
+}
+
+const ListPack& QuickList::node_entries(const Node& node, ListPack& scratch) const {
+    if (node.compressed.empty()) return node.entries;
+
+    std::string raw;
+    lzf_decompress(node.compressed, raw, node.raw_bytes);
+    scratch.assign(std::move(raw));
+    return scratch;
+}
+
+void QuickList::compress_interior() {
+    if (compress_depth_ == 0) return;
+
+    size_t depth = compress_depth_;
+    auto front = nodes_.begin();
+    auto back = nodes_.rbegin();
+    for (size_t i = 0; i < depth && i < nodes_.size(); i++, ++front, ++back) {
+        decompress(*front);
+        decompress(*back);
+    }
+    // Only the nodes just inside the raw ends can have changed state
+    if (nodes_.size() > 2 * depth) {
+        compress(*front);
+        compress(*back);
+    }
+}
+
+void QuickList::push_front(std::string_view value) {
+    bool new_node = nodes_.empty() || !node_has_room(nodes_.front(), value);
+    if (new_node) {
+        if (!nodes_.empty()) nodes_.front().entries.shrink_to_fit();
+        nodes_.emplace_front();
+    }
+
+    Node& node = nodes_.front();
+    decompress(node);
+    node.entries.push_front(value);
+    node.count++;
+    node.raw_bytes = node.entries.bytes();
+    count_++;
+
+    if (new_node) compress_interior();
+}
+
+void QuickList::push_back(std::string_view value) {
+    bool new_node = nodes_.empty() || !node_has_room(nodes_.back(), value);
+    if (new_node) {
+        if (!nodes_.empty()) nodes_.back().entries.shrink_to_fit();
+        nodes_.emplace_back();
+    }
+
+    Node& node = nodes_.back();
+    decompress(node);
+    node.entries.push_back(value);
+    node.count++;
+    node.raw_bytes = node.entries.bytes();
+    count_++;
+
+    if (new_node) compress_interior();
+}
+
+bool QuickList::pop_front(std::string& out) {
+    if (nodes_.empty()) return false;
+
+    Node& node = nodes_.front();
+    decompress(node);
+    size_t pos = node.entries.first();
+    out = node.entries.get(pos).to_string();
+    node.entries.erase(pos);
+    node.count--;
+    node.raw_bytes = node.entries.bytes();
+    count_--;
+
+    if (node.count == 0) {
+        nodes_.pop_front();
+        compress_interior();
+    }
+    return true;
+}
+
+bool QuickList::pop_back(std::string& out) {
+    if (nodes_.empty()) return false;
+
+    Node& node = nodes_.back();
+    decompress(node);
+    size_t pos = node.entries.last();
+    out = node.entries.get(pos).to_string();
+    node.entries.erase(pos);
+    node.count--;
+    node.raw_bytes = node.entries.bytes();
+    count_--;
+
+    if (node.count == 0) {
+        nodes_.pop_back();
+        compress_interior();
+    }
+    return true;
+}
+
+QuickList::NodeIter QuickList::find_node(size_t index, size_t& offset) const {
+    // Walk from whichever end is closer
+    if (index < count_ / 2) {
+        for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
+            if (index < it->count) {
+                offset = index;
+                return it;
+            }
+            index -= it->count;
+        }
+        return nodes_.end();
+    }
+
+    size_t from_back = count_ - 1 - index;
+    for (auto it = nodes_.end(); it != nodes_.begin();) {
+        --it;
+        if (from_back < it->count) {
+            offset = it->count - 1 - from_back;
+            return it;
+        }
+        from_back -= it->count;
+    }
+    return nodes_.end();
+}
+
+bool QuickList::index(long index, std::string& out) const {
+    long count = static_cast<long>(count_);
+    if (index < 0) index += count;
+    if (index < 0 || index >= count) return false;
+
+    size_t offset;
+    NodeIter it = find_node(index, offset);
+    ListPack scratch;
+    const ListPack& entries = node_entries(*it, scratch);
+    out = entries.get(entries.seek(offset)).to_string();
+    return true;
+}
+
+void QuickList::remove_front(size_t n) {
+    n = std::min(n, count_);
+    while (n > 0) {
+        Node& node = nodes_.front();
+        if (node.count <= n) {
+            n -= node.count;
+            count_ -= node.count;
+            nodes_.pop_front();
+            continue;
+        }
+        decompress(node);
+        node.entries.erase(node.entries.first(), n);
+        node.count -= n;
+        node.raw_bytes = node.entries.bytes();
+        count_ -= n;
+        n = 0;
+    }
+    compress_interior();
+}
+
+void QuickList::remove_back(size_t n) {
+    n = std::min(n, count_);
+    while (n > 0) {
+        Node& node = nodes_.back();
+        if (node.count <= n) {
+            n -= node.count;
+            count_ -= node.count;
+            nodes_.pop_back();
+            continue;
+        }
+        decompress(node);
+        node.entries.erase(node.entries.seek(node.count - n), n);
+        node.count -= n;
+        node.raw_bytes = node.entries.bytes();
+        count_ -= n;
+        n = 0;
+    }
+    compress_interior();
+}
+
+void QuickList::append_node(ListPack entries) {
+    if (entries.empty()) return;
+
+    Node& node = nodes_.emplace_back();
+    node.count = entries.size();
+    node.raw_bytes = entries.bytes();
+    node.entries = std::move(entries);
+    count_ += node.count;
+    compress_interior();
+}
+
+size_t QuickList::memory_usage() const {
+    size_t bytes = sizeof(*this);
+    for (const Node& node : nodes_) {
+        // List node links plus the buffers
+        bytes += sizeof(Node) + 2 * sizeof(void*);
+        bytes += node.entries.data().capacity() + node.compressed.capacity();
+    }
+    return bytes;
+}
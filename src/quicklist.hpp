@@ -0,0 +1,96 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <string_view>
+
+#include "listpack.hpp"
+#include "store.hpp"
+
+// A list as a doubly linked list of listpack nodes, which keeps pushes and
+// pops at either end O(1) while storing elements densely. fill bounds each
+// node like list-max-listpack-size: a positive value is an entry count, -1
+// to -5 mean 4 to 64 KB. Nodes further than compress_depth from both ends
+// are kept LZF compressed, since queues mostly touch their ends.
+class QuickList : public DataObject {
+public:
+    QuickList(int fill, int compress_depth);
+
+    size_t size() const { return count_; }
+    size_t node_count() const { return nodes_.size(); }
+
+    void push_front(std::string_view value);
+    void push_back(std::string_view value);
+    bool pop_front(std::string& out);
+    bool pop_back(std::string& out);
+
+    // Element at index, negative counts from the end
+    bool index(long index, std::string& out) const;
+
+    // Call visit with each of count elements starting at index start
+    template <typename F>
+    void for_range(size_t start, size_t count, F&& visit) const;
+
+    // Drop elements from either end, for LTRIM
+    void remove_front(size_t n);
+    void remove_back(size_t n);
+
+    // Append a whole node, for loading RDB files
+    void append_node(ListPack entries);
+
+    // Call visit with each node's listpack in order, for saving RDB files
+    template <typename F>
+    void for_each_node(F&& visit) const;
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return "quicklist"; }
+
+private:
+    struct Node {
+        ListPack entries;        // empty while the node is compressed
+        std::string compressed;  // LZF of the listpack bytes
+        size_t count = 0;
+        size_t raw_bytes = 0;    // size of the uncompressed listpack
+    };
+    using NodeIter = std::list<Node>::const_iterator;
+
+    bool node_has_room(const Node& node, std::string_view value) const;
+    // Node holding element index, and the element's offset inside it
+    NodeIter find_node(size_t index, size_t& offset) const;
+    // Entries of a node, decompressed into scratch if needed
+    const ListPack& node_entries(const Node& node, ListPack& scratch) const;
+
+    void compress(Node& node);
+    void decompress(Node& node);
+    // Keep compress_depth nodes at each end raw and the rest compressed
+    void compress_interior();
+
+    std::list<Node> nodes_;
+    size_t count_ = 0;
+    int fill_;
+    int compress_depth_;
+};
+
+template <typename F>
+void QuickList::for_range(size_t start, size_t count, F&& visit) const {
+    if (start >= count_ || count == 0) return;
+
+    ListPack scratch;
+    size_t offset;
+    for (NodeIter it = find_node(start, offset); it != nodes_.end() && count > 0; ++it) {
+        const ListPack& entries = node_entries(*it, scratch);
+        for (size_t pos = entries.seek(offset); pos != ListPack::npos && count > 0; pos = entries.next(pos)) {
+            visit(entries.get(pos));
+            count--;
+        }
+        offset = 0;
+    }
+}
+
+template <typename F>
+void QuickList::for_each_node(F&& visit) const {
+    ListPack scratch;
+    for (const Node& node : nodes_) {
+        visit(node_entries(node, scratch));
+    }
+}
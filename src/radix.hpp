@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Ordered map from fixed-length byte keys to values, as a radix tree with
+// compressed edges: each node holds the run of bytes shared by everything
+// under it, so keys with long common prefixes, like the big-endian stream
+// IDs it is used for, cost a few short hops instead of a comparison per
+// byte. Keys of one tree must all have the same length, which keeps values
+// on leaves only.
+//
+// Leaves never move once created, so pointers to values stay valid until
+// their key is erased. Iterators are invalidated by any insert or erase.
+template <typename V>
+class RadixTree {
+    struct Node {
+        std::string prefix;                           // bytes consumed on the way into this node
+        std::vector<std::unique_ptr<Node>> children;  // ordered by their first prefix byte
+        V value{};
+        bool leaf = false;
+    };
+
+public:
+    class Iterator {
+    public:
+        bool valid() const { return !path_.empty(); }
+        std::string_view key() const { return key_; }
+        V& value() const { return current()->value; }
+
+        void next() { step(true); }
+        void prev() { step(false); }
+
+    private:
+        friend class RadixTree;
+
+        Node* current() const {
+            const auto& [node, index] = path_.back();
+            return node->children[index].get();
+        }
+
+        // Walk down from node to its first or last leaf
+        void descend(Node* node, bool first) {
+            while (!node->leaf) {
+                size_t index = first ? 0 : node->children.size() - 1;
+                path_.emplace_back(node, index);
+                node = node->children[index].get();
+                key_ += node->prefix;
+            }
+        }
+
+        void step(bool forward) {
+            while (!path_.empty()) {
+                auto& [node, index] = path_.back();
+                key_.resize(key_.size() - node->children[index]->prefix.size());
+                if (forward ? index + 1 < node->children.size() : index > 0) {
+                    forward ? index++ : index--;
+                    Node* child = node->children[index].get();
+                    key_ += child->prefix;
+                    descend(child, forward);
+                    return;
+                }
+                path_.pop_back();
+            }
+        }
+
+        // Position at the last key <= target (floor) or the first key >=
+        // target, within the subtree of node whose prefix matched so far
+        bool seek(Node* node, std::string_view target, size_t depth, bool floor) {
+            size_t count = node->children.size();
+            for (size_t n = 0; n < count; n++) {
+                size_t index = floor ? count - 1 - n : n;
+                Node* child = node->children[index].get();
+                int cmp = std::memcmp(child->prefix.data(), target.data() + depth, child->prefix.size());
+                if (floor ? cmp > 0 : cmp < 0) continue;
+
+                path_.emplace_back(node, index);
+                key_ += child->prefix;
+                if (cmp != 0) {
+                    // The whole subtree is on the wanted side of the target
+                    descend(child, !floor);
+                    return true;
+                }
+                if (child->leaf || seek(child, target, depth + child->prefix.size(), floor)) return true;
+                key_.resize(key_.size() - child->prefix.size());
+                path_.pop_back();
+            }
+            return false;
+        }
+
+        std::vector<std::pair<Node*, size_t>> path_;  // parent and child index of each level
+        std::string key_;
+    };
+
+    RadixTree() : root_(std::make_unique<Node>()) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Value for key, default-constructed if it was missing
+    V& operator[](std::string_view key) {
+        Node* node = root_.get();
+        size_t depth = 0;
+        while (true) {
+            auto& children = node->children;
+            size_t index = 0;
+            while (index < children.size() &&
+                   static_cast<unsigned char>(children[index]->prefix[0]) < static_cast<unsigned char>(key[depth])) {
+                index++;
+            }
+            if (index == children.size() || children[index]->prefix[0] != key[depth]) {
+                auto leaf = std::make_unique<Node>();
+                leaf->prefix = key.substr(depth);
+                leaf->leaf = true;
+                Node* inserted = leaf.get();
+                children.insert(children.begin() + index, std::move(leaf));
+                size_++;
+                return inserted->value;
+            }
+
+            Node* child = children[index].get();
+            std::string_view rest = key.substr(depth);
+            size_t common = 0;
+            while (common < child->prefix.size() && child->prefix[common] == rest[common]) common++;
+            if (common == child->prefix.size()) {
+                if (child->leaf) return child->value;
+                node = child;
+                depth += common;
+                continue;
+            }
+
+            // Split the edge where the keys diverge
+            auto split = std::make_unique<Node>();
+            split->prefix = child->prefix.substr(0, common);
+            auto leaf = std::make_unique<Node>();
+            leaf->prefix = rest.substr(common);
+            leaf->leaf = true;
+            Node* inserted = leaf.get();
+            child->prefix.erase(0, common);
+            bool leaf_first = static_cast<unsigned char>(leaf->prefix[0]) < static_cast<unsigned char>(child->prefix[0]);
+            split->children.push_back(std::move(leaf_first ? leaf : children[index]));
+            split->children.push_back(std::move(leaf_first ? children[index] : leaf));
+            children[index] = std::move(split);
+            size_++;
+            return inserted->value;
+        }
+    }
+
+    V* find(std::string_view key) {
+        Node* node = root_.get();
+        size_t depth = 0;
+        while (true) {
+            Node* next = nullptr;
+            for (const auto& child : node->children) {
+                if (child->prefix[0] == key[depth]) {
+                    next = child.get();
+                    break;
+                }
+            }
+            if (!next || key.compare(depth, next->prefix.size(), next->prefix) != 0) return nullptr;
+            if (next->leaf) return &next->value;
+            depth += next->prefix.size();
+            node = next;
+        }
+    }
+    const V* find(std::string_view key) const { return const_cast<RadixTree*>(this)->find(key); }
+
+    bool erase(std::string_view key) {
+        Node* parent = nullptr;
+        size_t parent_index = 0;
+        Node* node = root_.get();
+        size_t depth = 0;
+        while (true) {
+            size_t index = 0;
+            while (index < node->children.size() && node->children[index]->prefix[0] != key[depth]) index++;
+            if (index == node->children.size()) return false;
+            Node* child = node->children[index].get();
+            if (key.compare(depth, child->prefix.size(), child->prefix) != 0) return false;
+            if (!child->leaf) {
+                parent = node;
+                parent_index = index;
+                node = child;
+                depth += child->prefix.size();
+                continue;
+            }
+
+            node->children.erase(node->children.begin() + index);
+            size_--;
+            // A branch left with one child folds into it. The child keeps its
+            // node, so a surviving leaf's value does not move.
+            if (parent && node->children.size() == 1) {
+                std::unique_ptr<Node> only = std::move(node->children[0]);
+                only->prefix.insert(0, node->prefix);
+                parent->children[parent_index] = std::move(only);
+            }
+            return true;
+        }
+    }
+
+    void clear() {
+        root_ = std::make_unique<Node>();
+        size_ = 0;
+    }
+
+    Iterator begin() const {
+        Iterator it;
+        if (!empty()) it.descend(root_.get(), true);
+        return it;
+    }
+    Iterator last() const {
+        Iterator it;
+        if (!empty()) it.descend(root_.get(), false);
+        return it;
+    }
+    // First key >= key
+    Iterator lower_bound(std::string_view key) const {
+        Iterator it;
+        it.seek(root_.get(), key, 0, false);
+        return it;
+    }
+    // Last key <= key
+    Iterator floor(std::string_view key) const {
+        Iterator it;
+        it.seek(root_.get(), key, 0, true);
+        return it;
+    }
+
+    // Bytes held by the tree structure itself, not counting what values own
+    size_t memory_usage() const { return node_bytes(root_.get()); }
+
+private:
+    static size_t node_bytes(const Node* node) {
+        size_t bytes = sizeof(Node) + node->children.capacity() * sizeof(void*);
+        if (node->prefix.capacity() > 15) bytes += node->prefix.capacity() + 1;
+        for (const auto& child : node->children) bytes += node_bytes(child.get());
+        return bytes;
+    }
+
+    std::unique_ptr<Node> root_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,850 @@
+#include "rdb.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bloom.hpp"
+#include "crc64.hpp"
+#include "hash.hpp"
+#include "list.hpp"
+#include "lzf.hpp"
+#include "multi.hpp"
+#include "server.hpp"
+#include "set.hpp"
+#include "stream.hpp"
+#include "zset.hpp"
+
+// Special string encodings signalled by the top two length bits being 11
+enum RdbEncoding : unsigned char {
+    RDB_ENC_INT8 = 0,
+    RDB_ENC_INT16 = 1,
+    RDB_ENC_INT32 = 2,
+    RDB_ENC_LZF = 3,
+};
+
+constexpr size_t RDB_FLUSH_BYTES = 64 * 1024;
+
+// Module type IDs pack nine name characters, six bits each, above a
+// 10-bit encoding version
+static constexpr uint64_t module_type_id(const char* name, unsigned encver) {
+    constexpr std::string_view charset = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    uint64_t id = 0;
+    for (int i = 0; i < 9; i++) id = (id << 6) | charset.find(name[i]);
+    return (id << 10) | encver;
+}
+
+// Bloom and cuckoo filters are saved as module values under names of our
+// own: their layouts are not RedisBloom's, so a Redis running that module
+// must refuse them rather than misread them
+static constexpr uint64_t BLOOM_MODULE_ID = module_type_id("redcpp-bf", 1);
+static constexpr uint64_t CUCKOO_MODULE_ID = module_type_id("redcpp-cf", 1);
+
+void RdbWriter::maybe_flush() {
+    if (sink_ && out_.size() >= RDB_FLUSH_BYTES) {
+        flush();
+    }
+}
+
+bool RdbWriter::flush() {
+    if (!sink_ || out_.empty()) return ok_;
+
+    flushed_crc_ = crc64(flushed_crc_, out_.data(), out_.size());
+    ok_ = ok_ && sink_(out_.data(), out_.size());
+    out_.clear();
+    return ok_;
+}
+
+uint64_t RdbWriter::checksum() const {
+    return crc64(flushed_crc_, out_.data(), out_.size());
+}
+
+void RdbWriter::write_byte(unsigned char byte) {
+    out_.push_back(static_cast<char>(byte));
+}
+
+void RdbWriter::write_raw(const void* data, size_t len) {
+    out_.append(static_cast<const char*>(data), len);
+}
+
+void RdbWriter::write_length(uint64_t len) {
+    if (len < (1 << 6)) {
+        write_byte(static_cast<unsigned char>(len));
+    } else if (len < (1 << 14)) {
+        write_byte(static_cast<unsigned char>(0x40 | (len >> 8)));
+        write_byte(static_cast<unsigned char>(len & 0xff));
+    } else if (len <= UINT32_MAX) {
+        write_byte(0x80);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            write_byte(static_cast<unsigned char>((len >> shift) & 0xff));
+        }
+    } else {
+        write_byte(0x81);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            write_byte(static_cast<unsigned char>((len >> shift) & 0xff));
+        }
+    }
+}
+
+void RdbWriter::write_string(const std::string& str) {
+    // Small integers are stored in their binary form like Redis does
+    if (!str.empty() && str.size() <= 11) {
+        int64_t value;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (ec == std::errc() && ptr == str.data() + str.size() && std::to_string(value) == str) {
+            if (value >= INT8_MIN && value <= INT8_MAX) {
+                write_byte(0xC0 | RDB_ENC_INT8);
+                write_byte(static_cast<unsigned char>(value));
+                return;
+            }
+            if (value >= INT16_MIN && value <= INT16_MAX) {
+                write_byte(0xC0 | RDB_ENC_INT16);
+                for (int i = 0; i < 2; i++) write_byte((value >> (8 * i)) & 0xff);
+                return;
+            }
+            if (value >= INT32_MIN && value <= INT32_MAX) {
+                write_byte(0xC0 | RDB_ENC_INT32);
+                for (int i = 0; i < 4; i++) write_byte((value >> (8 * i)) & 0xff);
+                return;
+            }
+        }
+    }
+
+    write_length(str.size());
+    write_raw(str.data(), str.size());
+}
+
+void RdbWriter::write_object(const ValueWithExpiry& value) {
+    switch (value.type) {
+    case ValueType::String: {
+        std::string scratch;
+        write_string(value.string_for_read(scratch));
+        break;
+    }
+    case ValueType::List: {
+        const QuickList& list = value.as<QuickList>();
+        write_length(list.node_count());
+        list.for_each_node([&](const ListPack& entries) {
+            write_length(RDB_QUICKLIST_PACKED);
+            write_string(entries.data());
+        });
+        break;
+    }
+    case ValueType::Hash: {
+        const HashObject& hash = value.as<HashObject>();
+        if (hash.is_listpack()) {
+            write_string(hash.listpack().data());
+            break;
+        }
+        write_length(hash.size());
+        hash.for_each([&](const ListPackEntry& field, const ListPackEntry& field_value) {
+            write_string(field.to_string());
+            write_string(field_value.to_string());
+        });
+        break;
+    }
+    case ValueType::Set: {
+        const SetObject& set = value.as<SetObject>();
+        if (set.is_intset()) {
+            write_string(set.intset().data());
+            break;
+        }
+        write_length(set.size());
+        set.for_each([&](const ListPackEntry& member) { write_string(member.to_string()); });
+        break;
+    }
+    case ValueType::ZSet: {
+        const ZSetObject& zset = value.as<ZSetObject>();
+        if (zset.is_listpack()) {
+            write_string(zset.listpack().data());
+            break;
+        }
+        // Highest first, so loading inserts each member at the head
+        write_length(zset.size());
+        zset.for_range(0, zset.size(), true, [&](const ListPackEntry& member, double score) {
+            write_string(member.to_string());
+            write_raw(&score, sizeof(score));
+        });
+        break;
+    }
+    case ValueType::Stream: {
+        const StreamObject& stream = value.as<StreamObject>();
+        write_length(stream.blocks().size());
+        for (auto it = stream.blocks().begin(); it.valid(); it.next()) {
+            write_string(std::string(it.key()));
+            write_string(it.value().data());
+        }
+        write_length(stream.size());
+        for (StreamID id : {stream.last_id(), stream.first_id(), stream.max_deleted_id()}) {
+            write_length(id.ms);
+            write_length(id.seq);
+        }
+        write_length(stream.entries_added());
+
+        write_length(stream.groups().size());
+        for (const auto& [name, group] : stream.groups()) {
+            write_string(name);
+            write_length(group->last_id.ms);
+            write_length(group->last_id.seq);
+            write_length(static_cast<uint64_t>(group->entries_read));
+            write_length(group->pending.size());
+            for (auto it = group->pending.begin(); it.valid(); it.next()) {
+                write_raw(it.key().data(), it.key().size());
+                write_millis(it.value()->delivery_time);
+                write_length(it.value()->delivery_count);
+            }
+            write_length(group->consumers.size());
+            for (const auto& [consumer_name, consumer] : group->consumers) {
+                write_string(consumer_name);
+                write_millis(consumer->seen_time);
+                write_millis(consumer->active_time);
+                write_length(consumer->pending.size());
+                for (auto it = consumer->pending.begin(); it.valid(); it.next()) {
+                    write_raw(it.key().data(), it.key().size());
+                }
+            }
+        }
+        break;
+    }
+    case ValueType::Bloom: {
+        const BloomObject& bloom = value.as<BloomObject>();
+        write_length(BLOOM_MODULE_ID);
+        write_module_uint(bloom.expansion());
+        write_module_uint(bloom.layers().size());
+        for (const BloomObject::Layer& layer : bloom.layers()) {
+            write_module_uint(layer.capacity);
+            write_module_uint(layer.items);
+            write_module_double(layer.error_rate);
+            write_module_uint(layer.hashes);
+            write_module_string(layer.blocks.data(), layer.blocks.size() * sizeof(BloomBlock));
+            maybe_flush();
+        }
+        write_length(RDB_MODULE_OPCODE_EOF);
+        break;
+    }
+    case ValueType::Cuckoo: {
+        const CuckooObject& cuckoo = value.as<CuckooObject>();
+        write_length(CUCKOO_MODULE_ID);
+        write_module_uint(cuckoo.max_iterations());
+        write_module_uint(cuckoo.expansion());
+        write_module_uint(cuckoo.items());
+        write_module_uint(cuckoo.deletes());
+        write_module_uint(cuckoo.tables().size());
+        for (const CuckooObject::Table& table : cuckoo.tables()) {
+            write_module_string(table.buckets.data(), table.buckets.size() * sizeof(uint64_t));
+            maybe_flush();
+        }
+        write_length(RDB_MODULE_OPCODE_EOF);
+        break;
+    }
+    }
+}
+
+void RdbWriter::write_module_uint(uint64_t value) {
+    write_length(RDB_MODULE_OPCODE_UINT);
+    write_length(value);
+}
+
+void RdbWriter::write_module_double(double value) {
+    write_length(RDB_MODULE_OPCODE_DOUBLE);
+    write_raw(&value, sizeof(value));
+}
+
+void RdbWriter::write_module_string(const void* data, size_t len) {
+    write_length(RDB_MODULE_OPCODE_STRING);
+    write_length(len);
+    write_raw(data, len);
+}
+
+void RdbWriter::write_millis(int64_t ms) {
+    for (int i = 0; i < 8; i++) write_byte((ms >> (8 * i)) & 0xff);
+}
+
+bool RdbReader::read_byte(unsigned char& byte) {
+    if (pos_ >= data_.size()) return false;
+    byte = static_cast<unsigned char>(data_[pos_++]);
+    return true;
+}
+
+bool RdbReader::read_raw(void* out, size_t len) {
+    if (data_.size() - pos_ < len) return false;
+    data_.copy(static_cast<char*>(out), len, pos_);
+    pos_ += len;
+    return true;
+}
+
+bool RdbReader::read_length(uint64_t& len, bool* encoded) {
+    if (encoded) *encoded = false;
+
+    unsigned char first;
+    if (!read_byte(first)) return false;
+
+    switch (first >> 6) {
+    case 0:
+        len = first & 0x3f;
+        return true;
+    case 1: {
+        unsigned char second;
+        if (!read_byte(second)) return false;
+        len = (static_cast<uint64_t>(first & 0x3f) << 8) | second;
+        return true;
+    }
+    case 2: {
+        int bytes = first == 0x80 ? 4 : first == 0x81 ? 8 : 0;
+        if (bytes == 0) return false;
+        len = 0;
+        for (int i = 0; i < bytes; i++) {
+            unsigned char b;
+            if (!read_byte(b)) return false;
+            len = (len << 8) | b;
+        }
+        return true;
+    }
+    default:
+        if (!encoded) return false;
+        *encoded = true;
+        len = first & 0x3f;
+        return true;
+    }
+}
+
+bool RdbReader::read_string(std::string& str) {
+    uint64_t len;
+    bool encoded;
+    if (!read_length(len, &encoded)) return false;
+
+    if (!encoded) {
+        if (data_.size() - pos_ < len) return false;
+        str.assign(data_, pos_, len);
+        pos_ += len;
+        return true;
+    }
+
+    if (len == RDB_ENC_LZF) {
+        uint64_t compressed_len, raw_len;
+        if (!read_length(compressed_len) || !read_length(raw_len)) return false;
+        if (data_.size() - pos_ < compressed_len) return false;
+        std::string compressed(data_, pos_, compressed_len);
+        pos_ += compressed_len;
+        return lzf_decompress(compressed, str, raw_len);
+    }
+
+    int bytes = len == RDB_ENC_INT8 ? 1 : len == RDB_ENC_INT16 ? 2 : len == RDB_ENC_INT32 ? 4 : 0;
+    if (bytes == 0) return false;
+
+    uint32_t raw = 0;
+    for (int i = 0; i < bytes; i++) {
+        unsigned char b;
+        if (!read_byte(b)) return false;
+        raw |= static_cast<uint32_t>(b) << (8 * i);
+    }
+
+    int64_t value;
+    if (bytes == 1) value = static_cast<int8_t>(raw);
+    else if (bytes == 2) value = static_cast<int16_t>(raw);
+    else value = static_cast<int32_t>(raw);
+    str = std::to_string(value);
+    return true;
+}
+
+bool RdbReader::read_list(unsigned char type, ValueWithExpiry& value) {
+    std::unique_ptr<QuickList> list = make_list();
+    uint64_t len;
+    if (!read_length(len)) return false;
+
+    for (uint64_t i = 0; i < len; i++) {
+        std::string str;
+        if (type == RDB_TYPE_LIST) {
+            if (!read_string(str)) return false;
+            list->push_back(str);
+            continue;
+        }
+
+        uint64_t container;
+        if (!read_length(container) || !read_string(str)) return false;
+        if (container == RDB_QUICKLIST_PLAIN) {
+            list->push_back(str);
+            continue;
+        }
+        ListPack entries;
+        if (container != RDB_QUICKLIST_PACKED || !entries.assign(std::move(str))) return false;
+        list->append_node(std::move(entries));
+    }
+
+    if (list->size() == 0) return false;
+    value.type = ValueType::List;
+    value.object = std::move(list);
+    return true;
+}
+
+bool RdbReader::read_hash(unsigned char type, ValueWithExpiry& value) {
+    std::unique_ptr<HashObject> hash = make_hash();
+
+    if (type == RDB_TYPE_HASH_LISTPACK) {
+        std::string blob;
+        ListPack entries;
+        if (!read_string(blob) || !entries.assign(std::move(blob)) || !hash->assign(std::move(entries))) {
+            return false;
+        }
+    } else {
+        uint64_t len;
+        if (!read_length(len)) return false;
+        for (uint64_t i = 0; i < len; i++) {
+            std::string field, field_value;
+            if (!read_string(field) || !read_string(field_value)) return false;
+            hash->set(field, field_value);
+        }
+    }
+
+    if (hash->size() == 0) return false;
+    value.type = ValueType::Hash;
+    value.object = std::move(hash);
+    return true;
+}
+
+bool RdbReader::read_set(unsigned char type, ValueWithExpiry& value) {
+    std::unique_ptr<SetObject> set = make_set();
+
+    if (type == RDB_TYPE_SET_INTSET) {
+        std::string blob;
+        IntSet ints;
+        if (!read_string(blob) || !ints.assign(std::move(blob))) return false;
+        set->assign(std::move(ints));
+    } else if (type == RDB_TYPE_SET_LISTPACK) {
+        std::string blob;
+        ListPack entries;
+        if (!read_string(blob) || !entries.assign(std::move(blob))) return false;
+        for (size_t pos = entries.first(); pos != ListPack::npos; pos = entries.next(pos)) {
+            set->add(entries.get(pos).to_string());
+        }
+    } else {
+        uint64_t len;
+        if (!read_length(len)) return false;
+        for (uint64_t i = 0; i < len; i++) {
+            std::string member;
+            if (!read_string(member)) return false;
+            set->add(member);
+        }
+    }
+
+    if (set->size() == 0) return false;
+    value.type = ValueType::Set;
+    value.object = std::move(set);
+    return true;
+}
+
+bool RdbReader::read_zset(unsigned char type, ValueWithExpiry& value) {
+    std::unique_ptr<ZSetObject> zset = make_zset();
+
+    if (type == RDB_TYPE_ZSET_LISTPACK) {
+        std::string blob;
+        ListPack entries;
+        if (!read_string(blob) || !entries.assign(std::move(blob)) || !zset->assign(std::move(entries))) {
+            return false;
+        }
+    } else {
+        uint64_t len;
+        if (!read_length(len)) return false;
+        for (uint64_t i = 0; i < len; i++) {
+            std::string member;
+            double score;
+            if (!read_string(member) || !read_raw(&score, sizeof(score)) || std::isnan(score)) return false;
+            zset->set(member, score);
+        }
+    }
+
+    if (zset->size() == 0) return false;
+    value.type = ValueType::ZSet;
+    value.object = std::move(zset);
+    return true;
+}
+
+bool RdbReader::read_stream_id(uint64_t& ms, uint64_t& seq) {
+    return read_length(ms) && read_length(seq);
+}
+
+bool RdbReader::read_millis(int64_t& ms) {
+    unsigned char bytes[8];
+    if (!read_raw(bytes, sizeof(bytes))) return false;
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | bytes[i];
+    ms = static_cast<int64_t>(value);
+    return true;
+}
+
+// Streams as Redis 5 (LISTPACKS), 7.0 (_2) and 7.2 (_3) write them. The
+// older ones lack some metadata, which is filled in as Redis does.
+bool RdbReader::read_stream(unsigned char type, ValueWithExpiry& value) {
+    std::unique_ptr<StreamObject> stream = make_stream();
+
+    uint64_t blocks;
+    if (!read_length(blocks)) return false;
+    for (uint64_t i = 0; i < blocks; i++) {
+        std::string key, blob;
+        ListPack block;
+        if (!read_string(key) || !read_string(blob) || !block.assign(std::move(blob)) ||
+            !stream->load_block(key, std::move(block))) {
+            return false;
+        }
+    }
+
+    uint64_t length, entries_added = 0;
+    StreamID last_id, first_id, max_deleted_id;
+    if (!read_length(length) || !read_stream_id(last_id.ms, last_id.seq)) return false;
+    if (type >= RDB_TYPE_STREAM_LISTPACKS_2) {
+        if (!read_stream_id(first_id.ms, first_id.seq) || !read_stream_id(max_deleted_id.ms, max_deleted_id.seq) ||
+            !read_length(entries_added)) {
+            return false;
+        }
+    } else {
+        entries_added = length;
+        if (!stream->blocks().empty()) first_id = StreamID::decode(stream->blocks().begin().key().data());
+    }
+    stream->load_metadata(length, last_id, first_id, max_deleted_id, entries_added);
+
+    uint64_t groups;
+    if (!read_length(groups)) return false;
+    for (uint64_t i = 0; i < groups; i++) {
+        std::string name;
+        StreamID group_last_id;
+        uint64_t entries_read = static_cast<uint64_t>(-1);
+        if (!read_string(name) || !read_stream_id(group_last_id.ms, group_last_id.seq)) return false;
+        if (type >= RDB_TYPE_STREAM_LISTPACKS_2 && !read_length(entries_read)) return false;
+        StreamGroup* group = stream->create_group(name, group_last_id, static_cast<int64_t>(entries_read));
+        if (!group) return false;
+
+        uint64_t pending;
+        if (!read_length(pending)) return false;
+        for (uint64_t j = 0; j < pending; j++) {
+            char key[StreamID::ENCODED_SIZE];
+            auto nack = std::make_unique<StreamNack>();
+            if (!read_raw(key, sizeof(key)) || !read_millis(nack->delivery_time) ||
+                !read_length(nack->delivery_count)) {
+                return false;
+            }
+            group->pending[std::string_view(key, sizeof(key))] = std::move(nack);
+        }
+
+        uint64_t consumers;
+        if (!read_length(consumers)) return false;
+        for (uint64_t j = 0; j < consumers; j++) {
+            std::string consumer_name;
+            bool created;
+            if (!read_string(consumer_name)) return false;
+            StreamConsumer* consumer = group->consumer(consumer_name, true, &created);
+            if (!created || !read_millis(consumer->seen_time)) return false;
+            consumer->active_time = consumer->seen_time;
+            if (type >= RDB_TYPE_STREAM_LISTPACKS_3 && !read_millis(consumer->active_time)) return false;
+
+            // Each of these must be in the group's list and not owned yet
+            uint64_t owned;
+            if (!read_length(owned)) return false;
+            for (uint64_t k = 0; k < owned; k++) {
+                char key[StreamID::ENCODED_SIZE];
+                if (!read_raw(key, sizeof(key))) return false;
+                std::string_view id(key, sizeof(key));
+                std::unique_ptr<StreamNack>* nack = group->pending.find(id);
+                if (!nack || (*nack)->consumer) return false;
+                (*nack)->consumer = consumer;
+                consumer->pending[id] = nack->get();
+            }
+        }
+        for (auto it = group->pending.begin(); it.valid(); it.next()) {
+            if (!it.value()->consumer) return false;
+        }
+    }
+
+    value.type = ValueType::Stream;
+    value.object = std::move(stream);
+    return true;
+}
+
+bool RdbReader::read_module_uint(uint64_t& value) {
+    uint64_t opcode;
+    return read_length(opcode) && opcode == RDB_MODULE_OPCODE_UINT && read_length(value);
+}
+
+bool RdbReader::read_module_double(double& value) {
+    uint64_t opcode;
+    return read_length(opcode) && opcode == RDB_MODULE_OPCODE_DOUBLE && read_raw(&value, sizeof(value));
+}
+
+bool RdbReader::read_module_string(std::string& str) {
+    uint64_t opcode;
+    return read_length(opcode) && opcode == RDB_MODULE_OPCODE_STRING && read_string(str);
+}
+
+// Module values of the types this server implements itself
+bool RdbReader::read_module(ValueWithExpiry& value) {
+    uint64_t id;
+    if (!read_length(id)) return false;
+
+    std::string blob;
+    if (id == BLOOM_MODULE_ID) {
+        uint64_t expansion, layers;
+        if (!read_module_uint(expansion) || expansion > UINT32_MAX || !read_module_uint(layers) || layers == 0) {
+            return false;
+        }
+        auto bloom = std::make_unique<BloomObject>(static_cast<uint32_t>(expansion));
+        for (uint64_t i = 0; i < layers; i++) {
+            BloomObject::Layer layer;
+            uint64_t hashes;
+            if (!read_module_uint(layer.capacity) || !read_module_uint(layer.items) ||
+                !read_module_double(layer.error_rate) || !read_module_uint(hashes) || !read_module_string(blob) ||
+                blob.size() % sizeof(BloomBlock) != 0) {
+                return false;
+            }
+            layer.hashes = static_cast<uint32_t>(std::min<uint64_t>(hashes, UINT32_MAX));
+            layer.blocks.resize(blob.size() / sizeof(BloomBlock));
+            std::memcpy(layer.blocks.data(), blob.data(), blob.size());
+            if (!bloom->load_layer(std::move(layer))) return false;
+        }
+        value.type = ValueType::Bloom;
+        value.object = std::move(bloom);
+    } else if (id == CUCKOO_MODULE_ID) {
+        uint64_t max_iterations, expansion, items, deletes, tables;
+        if (!read_module_uint(max_iterations) || max_iterations > UINT32_MAX || !read_module_uint(expansion) ||
+            expansion > UINT32_MAX || !read_module_uint(items) || !read_module_uint(deletes) ||
+            !read_module_uint(tables) || tables == 0) {
+            return false;
+        }
+        auto cuckoo = std::make_unique<CuckooObject>(static_cast<uint32_t>(max_iterations),
+                                                     static_cast<uint32_t>(expansion));
+        for (uint64_t i = 0; i < tables; i++) {
+            CuckooObject::Table table;
+            if (!read_module_string(blob) || blob.size() % sizeof(uint64_t) != 0) return false;
+            table.buckets.resize(blob.size() / sizeof(uint64_t));
+            std::memcpy(table.buckets.data(), blob.data(), blob.size());
+            if (!cuckoo->load_table(std::move(table))) return false;
+        }
+        cuckoo->load_counters(items, deletes);
+        value.type = ValueType::Cuckoo;
+        value.object = std::move(cuckoo);
+    } else {
+        return false;
+    }
+
+    uint64_t eof;
+    return read_length(eof) && eof == RDB_MODULE_OPCODE_EOF;
+}
+
+bool RdbReader::read_object(unsigned char type, ValueWithExpiry& value) {
+    switch (type) {
+    case RDB_TYPE_STRING:
+        return read_string(value.value);
+    case RDB_TYPE_LIST:
+    case RDB_TYPE_LIST_QUICKLIST_2:
+        return read_list(type, value);
+    case RDB_TYPE_HASH:
+    case RDB_TYPE_HASH_LISTPACK:
+        return read_hash(type, value);
+    case RDB_TYPE_SET:
+    case RDB_TYPE_SET_INTSET:
+    case RDB_TYPE_SET_LISTPACK:
+        return read_set(type, value);
+    case RDB_TYPE_ZSET_2:
+    case RDB_TYPE_ZSET_LISTPACK:
+        return read_zset(type, value);
+    case RDB_TYPE_STREAM_LISTPACKS:
+    case RDB_TYPE_STREAM_LISTPACKS_2:
+    case RDB_TYPE_STREAM_LISTPACKS_3:
+        return read_stream(type, value);
+    case RDB_TYPE_MODULE_2:
+        return read_module(value);
+    default:
+        return false;
+    }
+}
+
+unsigned char rdb_object_type(const ValueWithExpiry& value) {
+    switch (value.type) {
+    case ValueType::String: return RDB_TYPE_STRING;
+    case ValueType::List: return RDB_TYPE_LIST_QUICKLIST_2;
+    case ValueType::Hash:
+        return value.as<HashObject>().is_listpack() ? RDB_TYPE_HASH_LISTPACK : RDB_TYPE_HASH;
+    case ValueType::Set:
+        return value.as<SetObject>().is_intset() ? RDB_TYPE_SET_INTSET : RDB_TYPE_SET;
+    case ValueType::ZSet:
+        return value.as<ZSetObject>().is_listpack() ? RDB_TYPE_ZSET_LISTPACK : RDB_TYPE_ZSET_2;
+    case ValueType::Stream: return RDB_TYPE_STREAM_LISTPACKS_3;
+    case ValueType::Bloom:
+    case ValueType::Cuckoo: return RDB_TYPE_MODULE_2;
+    }
+    return RDB_TYPE_STRING;
+}
+
+bool rdb_write_snapshot(RdbWriter& writer) {
+    char header[16];
+    int header_len = std::snprintf(header, sizeof(header), "REDIS%04d", RDB_VERSION);
+    writer.write_raw(header, header_len);
+
+    writer.write_byte(RDB_OPCODE_AUX);
+    writer.write_string("redis-ver");
+    writer.write_string("7.2.0");
+    writer.write_byte(RDB_OPCODE_AUX);
+    writer.write_string("redis-bits");
+    writer.write_string("64");
+
+    size_t expires = 0;
+    for (const auto& [key, value] : kv_store) {
+        if (value.has_expiry) expires++;
+    }
+
+    writer.write_byte(RDB_OPCODE_SELECTDB);
+    writer.write_length(0);
+    writer.write_byte(RDB_OPCODE_RESIZEDB);
+    writer.write_length(kv_store.size());
+    writer.write_length(expires);
+
+    for (const auto& [key, value] : kv_store) {
+        if (value.is_expired()) continue;
+
+        if (value.has_expiry) {
+            int64_t unix_ms = steady_to_unix_ms(value.expiry);
+            writer.write_byte(RDB_OPCODE_EXPIRETIME_MS);
+            writer.write_millis(unix_ms);
+        }
+        writer.write_byte(rdb_object_type(value));
+        writer.write_string(key);
+        writer.write_object(value);
+
+        writer.maybe_flush();
+        if (!writer.ok()) return false;
+    }
+
+    writer.write_byte(RDB_OPCODE_EOF);
+    uint64_t checksum = writer.checksum();
+    for (int i = 0; i < 8; i++) writer.write_byte((checksum >> (8 * i)) & 0xff);
+
+    return writer.flush();
+}
+
+std::string rdb_serialize() {
+    RdbWriter writer;
+    rdb_write_snapshot(writer);
+    return std::move(writer.buffer());
+}
+
+bool rdb_load(const std::string& data) {
+    if (data.size() < 9 || data.compare(0, 5, "REDIS") != 0) return false;
+
+    RdbReader reader(data);
+    char header[9];
+    reader.read_raw(header, sizeof(header));
+
+    Keyspace loaded;
+    Dict<std::monostate> loaded_expires;
+    bool has_expiry = false;
+    int64_t expiry_ms = 0;
+
+    while (true) {
+        unsigned char type;
+        if (!reader.read_byte(type)) return false;
+
+        if (type == RDB_OPCODE_EOF) {
+            break;
+        }
+        if (type == RDB_OPCODE_AUX) {
+            std::string aux_key, aux_value;
+            if (!reader.read_string(aux_key) || !reader.read_string(aux_value)) return false;
+            continue;
+        }
+        if (type == RDB_OPCODE_SELECTDB) {
+            uint64_t db;
+            if (!reader.read_length(db)) return false;
+            continue;
+        }
+        if (type == RDB_OPCODE_RESIZEDB) {
+            uint64_t db_size, expires_size;
+            if (!reader.read_length(db_size) || !reader.read_length(expires_size)) return false;
+            loaded.reserve(db_size);
+            continue;
+        }
+        if (type == RDB_OPCODE_EXPIRETIME_MS || type == RDB_OPCODE_EXPIRETIME) {
+            unsigned char raw[8];
+            int bytes = type == RDB_OPCODE_EXPIRETIME_MS ? 8 : 4;
+            if (!reader.read_raw(raw, bytes)) return false;
+            uint64_t when = 0;
+            for (int i = bytes - 1; i >= 0; i--) when = (when << 8) | raw[i];
+            expiry_ms = type == RDB_OPCODE_EXPIRETIME_MS ? static_cast<int64_t>(when)
+                                                         : static_cast<int64_t>(when) * 1000;
+            has_expiry = true;
+            continue;
+        }
+
+        std::string key;
+        if (!reader.read_string(key)) return false;
+
+        ValueWithExpiry value;
+        if (!reader.read_object(type, value)) return false;
+        if (has_expiry) {
+            value.has_expiry = true;
+            value.expiry = unix_ms_to_steady(expiry_ms);
+            has_expiry = false;
+        }
+        if (!value.is_expired()) {
+            if (value.has_expiry) loaded_expires.try_emplace(key);
+            loaded[key] = std::move(value);
+        }
+    }
+
+    // Version 5+ files end with a checksum, zero means it was disabled
+    unsigned char raw[8];
+    if (reader.read_raw(raw, sizeof(raw))) {
+        uint64_t expected = 0;
+        for (int i = 7; i >= 0; i--) expected = (expected << 8) | raw[i];
+        if (expected != 0 && expected != crc64(0, data.data(), reader.position() - 8)) {
+            return false;
+        }
+    }
+
+    kv_store = std::move(loaded);
+    kv_expires = std::move(loaded_expires);
+    touch_all_keys();
+    return true;
+}
+
+std::string rdb_path() {
+    return server_config.dir + "/" + server_config.dbfilename;
+}
+
+bool rdb_load_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return rdb_load(data);
+}
+
+pid_t rdb_background_save(const std::string& path) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    // Child: the keyspace is a copy-on-write snapshot from here on
+    std::string data = rdb_serialize();
+    std::string tmp_path = path + ".tmp-" + std::to_string(getpid());
+
+    FILE* file = std::fopen(tmp_path.c_str(), "wb");
+    if (!file) _exit(1);
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = std::fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    std::fclose(file);
+
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        _exit(1);
+    }
+    _exit(0);
+}
+
+bool rdb_wait_child(pid_t pid) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
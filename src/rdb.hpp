@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+
+#include "store.hpp"
+
+// Opcodes and value types from the RDB file format
+enum RdbOpcode : unsigned char {
+    RDB_OPCODE_AUX = 0xFA,
+    RDB_OPCODE_RESIZEDB = 0xFB,
+    RDB_OPCODE_EXPIRETIME_MS = 0xFC,
+    RDB_OPCODE_EXPIRETIME = 0xFD,
+    RDB_OPCODE_SELECTDB = 0xFE,
+    RDB_OPCODE_EOF = 0xFF,
+};
+
+enum RdbType : unsigned char {
+    RDB_TYPE_STRING = 0,
+    RDB_TYPE_LIST = 1,
+    RDB_TYPE_SET = 2,
+    RDB_TYPE_HASH = 4,
+    RDB_TYPE_ZSET_2 = 5,
+    RDB_TYPE_MODULE_2 = 7,
+    RDB_TYPE_SET_INTSET = 11,
+    RDB_TYPE_STREAM_LISTPACKS = 15,
+    RDB_TYPE_HASH_LISTPACK = 16,
+    RDB_TYPE_ZSET_LISTPACK = 17,
+    RDB_TYPE_LIST_QUICKLIST_2 = 18,
+    RDB_TYPE_STREAM_LISTPACKS_2 = 19,
+    RDB_TYPE_SET_LISTPACK = 20,
+    RDB_TYPE_STREAM_LISTPACKS_3 = 21,
+};
+
+// Field tags inside a RDB_TYPE_MODULE_2 value
+enum RdbModuleOpcode : unsigned char {
+    RDB_MODULE_OPCODE_EOF = 0,
+    RDB_MODULE_OPCODE_UINT = 2,
+    RDB_MODULE_OPCODE_DOUBLE = 4,
+    RDB_MODULE_OPCODE_STRING = 5,
+};
+
+// Quicklist node containers in RDB_TYPE_LIST_QUICKLIST_2
+enum RdbQuicklistContainer : unsigned char {
+    RDB_QUICKLIST_PLAIN = 1,   // a single element stored as is
+    RDB_QUICKLIST_PACKED = 2,  // a listpack
+};
+
+constexpr int RDB_VERSION = 11;
+
+class RdbWriter {
+public:
+    // Receives output in chunks, returns false to abort the dump
+    using Sink = std::function<bool(const char* data, size_t len)>;
+
+    RdbWriter() = default;
+    explicit RdbWriter(Sink sink) : sink_(std::move(sink)) {}
+
+    void write_byte(unsigned char byte);
+    void write_raw(const void* data, size_t len);
+    void write_length(uint64_t len);
+    void write_string(const std::string& str);
+    // Unix milliseconds as 8 little-endian bytes
+    void write_millis(int64_t ms);
+    // Fields of a module value, each preceded by its RdbModuleOpcode
+    void write_module_uint(uint64_t value);
+    void write_module_double(double value);
+    void write_module_string(const void* data, size_t len);
+
+    // Encoded value without its type byte, see rdb_object_type
+    void write_object(const ValueWithExpiry& value);
+
+    // With a sink, hand the buffered bytes over once enough have piled up
+    void maybe_flush();
+    bool flush();
+
+    // CRC64 of everything written so far
+    uint64_t checksum() const;
+
+    bool ok() const { return ok_; }
+    std::string& buffer() { return out_; }
+
+private:
+    std::string out_;
+    Sink sink_;
+    uint64_t flushed_crc_ = 0;
+    bool ok_ = true;
+};
+
+class RdbReader {
+public:
+    explicit RdbReader(const std::string& data) : data_(data) {}
+
+    bool read_byte(unsigned char& byte);
+    bool read_raw(void* out, size_t len);
+    bool read_length(uint64_t& len, bool* encoded = nullptr);
+    bool read_string(std::string& str);
+
+    // Decode a value of the given type; expiry is filled in by the caller
+    bool read_object(unsigned char type, ValueWithExpiry& value);
+
+    size_t position() const { return pos_; }
+
+private:
+    bool read_list(unsigned char type, ValueWithExpiry& value);
+    bool read_hash(unsigned char type, ValueWithExpiry& value);
+    bool read_set(unsigned char type, ValueWithExpiry& value);
+    bool read_zset(unsigned char type, ValueWithExpiry& value);
+    bool read_stream(unsigned char type, ValueWithExpiry& value);
+    bool read_stream_id(uint64_t& ms, uint64_t& seq);
+    bool read_module(ValueWithExpiry& value);
+    bool read_module_uint(uint64_t& value);
+    bool read_module_double(double& value);
+    bool read_module_string(std::string& str);
+    bool read_millis(int64_t& ms);
+
+    const std::string& data_;
+    size_t pos_ = 0;
+};
+
+// RDB type byte that precedes a value of this kind
+unsigned char rdb_object_type(const ValueWithExpiry& value);
+
+// Write a complete RDB image of the keyspace. Caller holds kv_mutex, or is
+// a forked child with its own copy of it.
+bool rdb_write_snapshot(RdbWriter& writer);
+
+// Serialize the whole keyspace into memory. Caller holds kv_mutex.
+std::string rdb_serialize();
+
+// Replace the keyspace with the contents of an RDB payload. Caller holds kv_mutex.
+bool rdb_load(const std::string& data);
+
+// dir/dbfilename from the server config
+std::string rdb_path();
+
+bool rdb_load_file(const std::string& path);
+
+// Fork a child that writes a snapshot to path and exits. Caller holds
+// kv_mutex (shared is enough) so the child sees a consistent keyspace. Returns the child pid or
+// -1 if the fork failed.
+pid_t rdb_background_save(const std::string& path);
+
+// Reap a child started by rdb_background_save, true if it saved successfully
+bool rdb_wait_child(pid_t pid);
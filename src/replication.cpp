@@ -0,0 +1,903 @@
+#include "replication.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <poll.h>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "net.hpp"
+#include "rdb.hpp"
+#include "resp.hpp"
+#include "store.hpp"
+
+// A replica attached to this server
+struct ReplicaLink {
+    int fd = -1;
+    std::string ip;
+    int listening_port = 0;
+    bool capa_eof = false;
+    uint64_t sent_offset = 0;  // stream bytes already written to the socket
+    uint64_t ack_offset = 0;   // last offset confirmed with REPLCONF ACK
+    std::chrono::steady_clock::time_point ack_time = std::chrono::steady_clock::now();
+    bool online = false;       // initial sync finished, streaming
+    bool closed = false;
+    std::thread sender;
+};
+
+constexpr size_t REPL_SEND_CHUNK = 64 * 1024;
+constexpr size_t RDB_EOF_MARK_SIZE = 40;
+constexpr int DISKLESS_WRITE_TIMEOUT_MS = 60 * 1000;
+constexpr auto REPL_ACK_PERIOD = std::chrono::seconds(1);
+
+// Replication state, guarded by repl_mutex. Lock order is kv_mutex before repl_mutex.
+static std::mutex repl_mutex;
+static std::condition_variable repl_cv;
+static std::string master_replid;
+static std::string master_replid2(40, '0');
+static int64_t second_replid_offset = -1;
+static std::unique_ptr<ReplicationBacklog> backlog;
+static std::list<std::shared_ptr<ReplicaLink>> replicas;
+
+// Replica side: the master we follow and the thread that talks to it
+static std::string master_host;
+static int master_port = 0;
+static int master_fd = -1;
+static bool master_link_up = false;
+static uint64_t master_generation = 0;
+static uint64_t sync_full = 0;
+static uint64_t sync_partial_ok = 0;
+static uint64_t sync_partial_err = 0;
+static std::atomic<bool> replica_mode{false};
+
+// Only one snapshot child runs at a time; disk-based syncs also read back
+// the file that child wrote
+static std::mutex bgsave_mutex;
+
+// Replicas sharing one diskless snapshot. The first replica to arrive waits
+// out repl_diskless_sync_delay, then forks for everyone who joined meanwhile.
+struct DisklessBatch {
+    std::vector<std::shared_ptr<ReplicaLink>> links;
+    std::vector<bool> ok;
+    uint64_t offset = 0;
+    bool done = false;
+};
+
+static std::shared_ptr<DisklessBatch> pending_batch;
+
+void ReplicationBacklog::append(const char* data, size_t len) {
+    size_t size = buf_.size();
+
+    // Only the tail of a write larger than the whole buffer can survive
+    if (len > size) {
+        offset_ += len - size;
+        data += len - size;
+        len = size;
+        histlen_ = 0;
+    }
+
+    while (len > 0) {
+        size_t idx = offset_ % size;
+        size_t chunk = std::min(len, size - idx);
+        std::memcpy(&buf_[idx], data, chunk);
+        offset_ += chunk;
+        data += chunk;
+        len -= chunk;
+        histlen_ = std::min<uint64_t>(histlen_ + chunk, size);
+    }
+}
+
+void ReplicationBacklog::reset(uint64_t offset) {
+    offset_ = offset;
+    histlen_ = 0;
+}
+
+bool ReplicationBacklog::read_from(uint64_t from, std::string& out, size_t max_len) const {
+    if (from < first_offset() || from > offset_) return false;
+
+    size_t len = std::min<uint64_t>(offset_ - from, max_len);
+    out.resize(len);
+
+    size_t size = buf_.size();
+    size_t copied = 0;
+    while (copied < len) {
+        size_t idx = (from + copied) % size;
+        size_t chunk = std::min(len - copied, size - idx);
+        std::memcpy(&out[copied], &buf_[idx], chunk);
+        copied += chunk;
+    }
+    return true;
+}
+
+static std::string generate_replid() {
+    static const char hex[] = "0123456789abcdef";
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
+
+    std::string id(40, '0');
+    for (char& c : id) {
+        c = hex[gen() % 16];
+    }
+    return id;
+}
+
+void replication_init() {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    master_replid = generate_replid();
+    backlog = std::make_unique<ReplicationBacklog>(server_config.repl_backlog_size);
+}
+
+// Caller holds repl_mutex
+static void feed_backlog(const char* data, size_t len) {
+    backlog->append(data, len);
+    if (!replicas.empty()) {
+        repl_cv.notify_all();
+    }
+}
+
+uint64_t replication_propagate(const std::vector<std::string>& parts) {
+    std::string payload = resp_command(parts);
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    feed_backlog(payload.data(), payload.size());
+    return backlog->offset();
+}
+
+bool replication_is_replica() {
+    return replica_mode.load(std::memory_order_relaxed);
+}
+
+// Drop every attached replica so it reconnects and resyncs. Caller holds repl_mutex.
+static void disconnect_replicas() {
+    for (auto& link : replicas) {
+        link->closed = true;
+        shutdown(link->fd, SHUT_RDWR);
+    }
+    replicas.clear();
+    repl_cv.notify_all();
+}
+
+// Snapshot the keyspace to disk in a child, then ship the file. The offset is
+// taken under kv_mutex at fork time so it matches the snapshot exactly.
+static bool send_full_sync(const std::shared_ptr<ReplicaLink>& link) {
+    std::lock_guard<std::mutex> save_lock(bgsave_mutex);
+
+    std::string path = rdb_path();
+    std::string replid;
+    uint64_t offset;
+    pid_t pid;
+    {
+        std::shared_lock<std::shared_mutex> kv_lock(kv_mutex);
+        {
+            std::lock_guard<std::mutex> lock(repl_mutex);
+            replid = master_replid;
+            offset = backlog->offset();
+        }
+        pid = rdb_background_save(path);
+    }
+
+    if (pid < 0 || !rdb_wait_child(pid)) {
+        std::cerr << "Background save for replica sync failed\n";
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::string rdb((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.good() && !file.eof()) return false;
+
+    std::string header = "+FULLRESYNC " + replid + " " + std::to_string(offset) + "\r\n"
+        + "$" + std::to_string(rdb.size()) + "\r\n";
+    if (!send_all(link->fd, header) || !send_all(link->fd, rdb)) return false;
+
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    link->sent_offset = offset;
+    return true;
+}
+
+// Write one chunk to every live replica socket in the batch, interleaving
+// with poll so a slow replica doesn't hold up the others. Runs in the
+// snapshot child; MSG_DONTWAIT keeps the shared sockets in blocking mode for
+// the parent.
+static bool write_to_replicas(const std::vector<int>& fds, std::vector<bool>& alive,
+                              const char* data, size_t len) {
+    std::vector<size_t> written(fds.size(), 0);
+    std::vector<struct pollfd> pfds;
+    std::vector<size_t> index;
+
+    while (true) {
+        pfds.clear();
+        index.clear();
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (alive[i] && written[i] < len) {
+                pfds.push_back({fds[i], POLLOUT, 0});
+                index.push_back(i);
+            }
+        }
+        if (pfds.empty()) break;
+
+        int ready = poll(pfds.data(), pfds.size(), DISKLESS_WRITE_TIMEOUT_MS);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) {
+            for (size_t i : index) alive[i] = false;
+            break;
+        }
+
+        for (size_t j = 0; j < pfds.size(); j++) {
+            if (pfds[j].revents == 0) continue;
+            size_t i = index[j];
+            ssize_t sent = send(fds[i], data + written[i], len - written[i], MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent > 0) {
+                written[i] += sent;
+            } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                alive[i] = false;
+            }
+        }
+    }
+
+    for (bool a : alive) {
+        if (a) return true;
+    }
+    return false;
+}
+
+// Fork once for the whole batch; the child serializes the keyspace straight
+// into every replica socket and reports per-replica success through a pipe.
+static void run_diskless_transfer(DisklessBatch& batch) {
+    std::lock_guard<std::mutex> save_lock(bgsave_mutex);
+
+    size_t count = batch.links.size();
+    batch.ok.assign(count, false);
+
+    int status_pipe[2];
+    if (pipe(status_pipe) != 0) return;
+
+    std::string mark = generate_replid();
+    std::vector<int> fds;
+    std::vector<bool> alive;
+    pid_t pid;
+    {
+        std::shared_lock<std::shared_mutex> kv_lock(kv_mutex);
+        std::string replid;
+        {
+            std::lock_guard<std::mutex> lock(repl_mutex);
+            replid = master_replid;
+            batch.offset = backlog->offset();
+        }
+
+        // Size is unknown up front, so the payload is framed by a random mark
+        std::string header = "+FULLRESYNC " + replid + " " + std::to_string(batch.offset) + "\r\n"
+            + "$EOF:" + mark + "\r\n";
+        for (const auto& link : batch.links) {
+            fds.push_back(link->fd);
+            alive.push_back(send_all(link->fd, header));
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            close(status_pipe[0]);
+            RdbWriter writer([&](const char* data, size_t len) {
+                return write_to_replicas(fds, alive, data, len);
+            });
+            if (rdb_write_snapshot(writer)) {
+                write_to_replicas(fds, alive, mark.data(), mark.size());
+            }
+
+            std::string status(count, '0');
+            for (size_t i = 0; i < count; i++) {
+                if (alive[i]) status[i] = '1';
+            }
+            bool reported = write(status_pipe[1], status.data(), status.size()) == static_cast<ssize_t>(count);
+            _exit(reported ? 0 : 1);
+        }
+    }
+
+    close(status_pipe[1]);
+    if (pid < 0) {
+        close(status_pipe[0]);
+        std::cerr << "Fork for diskless sync failed\n";
+        return;
+    }
+    std::cout << "Streaming diskless snapshot to " << count << " replica(s)\n";
+
+    std::string status(count, '0');
+    size_t got = 0;
+    while (got < count) {
+        ssize_t n = read(status_pipe[0], &status[got], count - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    close(status_pipe[0]);
+
+    if (rdb_wait_child(pid) && got == count) {
+        for (size_t i = 0; i < count; i++) {
+            batch.ok[i] = status[i] == '1';
+        }
+    }
+}
+
+static bool send_full_sync_diskless(const std::shared_ptr<ReplicaLink>& link) {
+    std::shared_ptr<DisklessBatch> batch;
+    size_t index;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        if (!pending_batch) {
+            pending_batch = std::make_shared<DisklessBatch>();
+            leader = true;
+        }
+        batch = pending_batch;
+        index = batch->links.size();
+        batch->links.push_back(link);
+    }
+
+    if (leader) {
+        std::this_thread::sleep_for(std::chrono::seconds(server_config.repl_diskless_sync_delay));
+        {
+            // Replicas arriving from now on start the next batch
+            std::lock_guard<std::mutex> lock(repl_mutex);
+            pending_batch.reset();
+        }
+
+        run_diskless_transfer(*batch);
+
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        batch->done = true;
+        repl_cv.notify_all();
+    }
+
+    std::unique_lock<std::mutex> lock(repl_mutex);
+    repl_cv.wait(lock, [&] { return batch->done; });
+    if (!batch->ok[index]) return false;
+    link->sent_offset = batch->offset;
+    return true;
+}
+
+// Per-replica thread: optional full sync, then stream the backlog from the
+// replica's offset as it grows
+static void replica_sender(std::shared_ptr<ReplicaLink> link, bool full_sync) {
+    bool synced = true;
+    if (full_sync) {
+        // Replicas that can't parse an EOF-marked payload get the disk-based path
+        synced = server_config.repl_diskless_sync && link->capa_eof
+            ? send_full_sync_diskless(link)
+            : send_full_sync(link);
+    }
+
+    std::unique_lock<std::mutex> lock(repl_mutex);
+    if (synced) {
+        link->online = true;
+        std::string chunk;
+
+        while (true) {
+            repl_cv.wait(lock, [&] { return link->closed || backlog->offset() > link->sent_offset; });
+            if (link->closed) break;
+
+            if (!backlog->read_from(link->sent_offset, chunk, REPL_SEND_CHUNK)) {
+                std::cerr << "Replica fell out of the replication backlog, dropping it\n";
+                break;
+            }
+
+            lock.unlock();
+            bool ok = send_all(link->fd, chunk);
+            lock.lock();
+            if (!ok) break;
+            link->sent_offset += chunk.size();
+        }
+    }
+
+    link->closed = true;
+    shutdown(link->fd, SHUT_RDWR);
+}
+
+void replication_replica_disconnected(ClientContext& client) {
+    std::shared_ptr<ReplicaLink> link = client.replica_link;
+    if (!link) return;
+
+    {
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        link->closed = true;
+        replicas.remove(link);
+    }
+    repl_cv.notify_all();
+    shutdown(link->fd, SHUT_RDWR);
+
+    if (link->sender.joinable()) {
+        link->sender.join();
+    }
+    client.replica_link.reset();
+}
+
+static std::string peer_ip(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) return "?";
+
+    char ip[INET6_ADDRSTRLEN] = "?";
+    if (addr.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in*>(&addr)->sin_addr, ip, sizeof(ip));
+    } else if (addr.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_addr, ip, sizeof(ip));
+    }
+    return ip;
+}
+
+// PSYNC replid offset, where offset is the first stream byte the replica is missing (1-based)
+static std::string cmd_psync(const std::vector<std::string>& parts, ClientContext& client) {
+    if (client.is_master || client.is_replica) {
+        return "-ERR PSYNC not allowed on this connection\r\n";
+    }
+
+    long long psync_offset;
+    try {
+        psync_offset = std::stoll(parts[2]);
+    } catch (const std::exception& e) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+
+    auto link = std::make_shared<ReplicaLink>();
+    link->fd = client.fd;
+    link->ip = peer_ip(client.fd);
+    link->listening_port = client.listening_port;
+    link->capa_eof = client.capa_eof;
+
+    bool partial = false;
+    std::string replid;
+    {
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        if (replication_is_replica() && !master_link_up) {
+            return "-NOMASTERLINK Can't SYNC while not connected with my master\r\n";
+        }
+
+        const std::string& requested = parts[1];
+        bool known_history = requested == master_replid ||
+            (requested == master_replid2 && psync_offset <= second_replid_offset);
+        if (known_history && psync_offset > 0) {
+            uint64_t start = psync_offset - 1;
+            if (start >= backlog->first_offset() && start <= backlog->offset()) {
+                partial = true;
+                link->sent_offset = start;
+            }
+        }
+
+        replid = master_replid;
+        replicas.push_back(link);
+        if (partial) {
+            sync_partial_ok++;
+        } else {
+            sync_full++;
+            if (requested != "?") sync_partial_err++;
+        }
+    }
+
+    client.is_replica = true;
+    client.replica_link = link;
+
+    // The reply has to hit the socket before the sender starts streaming
+    if (partial && !send_all(client.fd, "+CONTINUE " + replid + "\r\n")) {
+        return "";
+    }
+    link->sender = std::thread(replica_sender, link, !partial);
+    return "";
+}
+
+static std::string cmd_replconf(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string option = to_upper(parts[1]);
+
+    if (option == "ACK" && parts.size() >= 3) {
+        // Replicas acknowledge silently
+        if (client.replica_link) {
+            try {
+                uint64_t offset = std::stoull(parts[2]);
+                std::lock_guard<std::mutex> lock(repl_mutex);
+                ReplicaLink& link = *client.replica_link;
+                link.ack_offset = std::max(link.ack_offset, offset);
+                link.ack_time = std::chrono::steady_clock::now();
+            } catch (const std::exception& e) {
+            }
+            // Wake clients blocked in WAIT
+            repl_cv.notify_all();
+        }
+        return "";
+    }
+    if (option == "GETACK") {
+        if (!client.is_master) return "";
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        client.force_reply = true;
+        return resp_array({"REPLCONF", "ACK", std::to_string(backlog->offset())});
+    }
+
+    // Handshake options come in pairs, e.g. REPLCONF capa eof capa psync2
+    if (parts.size() % 2 == 0) return "-ERR syntax error\r\n";
+    for (size_t i = 1; i < parts.size(); i += 2) {
+        std::string name = to_upper(parts[i]);
+        if (name == "LISTENING-PORT") {
+            try {
+                client.listening_port = std::stoi(parts[i + 1]);
+            } catch (const std::exception& e) {
+                return "-ERR value is not an integer or out of range\r\n";
+            }
+        } else if (name == "CAPA" && to_upper(parts[i + 1]) == "EOF") {
+            client.capa_eof = true;
+        }
+    }
+    return "+OK\r\n";
+}
+
+// Read a diskless payload terminated by mark, only rescanning the bytes that
+// could complete a mark split across reads
+static bool read_until_mark(int fd, std::string& buffer, const std::string& mark, std::string& out) {
+    size_t from = 0;
+    size_t end;
+    while ((end = buffer.find(mark, from)) == std::string::npos) {
+        from = buffer.size() >= mark.size() ? buffer.size() - mark.size() + 1 : 0;
+        if (!fill_buffer(fd, buffer)) return false;
+    }
+    out = buffer.substr(0, end);
+    buffer.erase(0, end + mark.size());
+    return true;
+}
+
+static bool master_link_current(uint64_t generation) {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    return generation == master_generation;
+}
+
+static bool send_handshake_command(int fd, std::string& buffer, const std::vector<std::string>& parts,
+                                   std::string& reply) {
+    return send_all(fd, resp_command(parts)) && read_line(fd, buffer, reply);
+}
+
+// Handshake with the master and either load its snapshot or continue from
+// our own offset
+static bool replica_sync(int fd, std::string& buffer) {
+    std::string reply;
+    if (!send_handshake_command(fd, buffer, {"PING"}, reply)) return false;
+    if (!send_handshake_command(fd, buffer, {"REPLCONF", "listening-port", std::to_string(server_config.port)}, reply)) {
+        return false;
+    }
+    if (!send_handshake_command(fd, buffer, {"REPLCONF", "capa", "eof", "capa", "psync2"}, reply)) return false;
+
+    std::string replid;
+    uint64_t next_offset;
+    {
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        replid = master_replid;
+        next_offset = backlog->offset() + 1;
+    }
+    if (!send_handshake_command(fd, buffer, {"PSYNC", replid, std::to_string(next_offset)}, reply)) {
+        return false;
+    }
+
+    if (reply.rfind("+FULLRESYNC ", 0) == 0) {
+        std::istringstream iss(reply.substr(12));
+        std::string new_replid;
+        uint64_t offset;
+        if (!(iss >> new_replid >> offset)) return false;
+
+        // The master may send newlines as keepalives while it is snapshotting
+        std::string header;
+        do {
+            if (!read_line(fd, buffer, header)) return false;
+            header.erase(0, header.find_first_not_of('\n'));
+        } while (header.empty());
+        if (header[0] != '$') return false;
+
+        std::string rdb;
+        if (header.rfind("$EOF:", 0) == 0) {
+            std::string mark = header.substr(5);
+            if (mark.size() != RDB_EOF_MARK_SIZE) return false;
+            if (!read_until_mark(fd, buffer, mark, rdb)) return false;
+        } else if (!read_exact(fd, buffer, std::stoull(header.substr(1)), rdb)) {
+            return false;
+        }
+
+        std::lock_guard<std::shared_mutex> kv_lock(kv_mutex);
+        if (!rdb_load(rdb)) {
+            std::cerr << "Failed to load RDB from master\n";
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        master_replid = new_replid;
+        master_replid2 = std::string(40, '0');
+        second_replid_offset = -1;
+        backlog->reset(offset);
+        disconnect_replicas();
+        std::cout << "Full resync from master: " << new_replid << ":" << offset << "\n";
+        return true;
+    }
+
+    if (reply.rfind("+CONTINUE", 0) == 0) {
+        std::string new_replid = reply.size() > 10 ? reply.substr(10) : "";
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        if (!new_replid.empty() && new_replid != master_replid) {
+            master_replid2 = master_replid;
+            second_replid_offset = backlog->offset() + 1;
+            master_replid = new_replid;
+            disconnect_replicas();
+        }
+        std::cout << "Partial resync from master at offset " << backlog->offset() << "\n";
+        return true;
+    }
+
+    std::cerr << "Unexpected reply to PSYNC: " << reply << "\n";
+    return false;
+}
+
+static bool send_ack(int fd) {
+    uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(repl_mutex);
+        offset = backlog->offset();
+    }
+    return send_all(fd, resp_command({"REPLCONF", "ACK", std::to_string(offset)}));
+}
+
+// Apply the master's command stream and forward the exact bytes into our own
+// backlog, so our offset tracks the master's and sub-replicas can PSYNC.
+// Our offset is acknowledged every REPL_ACK_PERIOD and on REPLCONF GETACK.
+static void replica_stream(int fd, std::string& buffer, uint64_t generation) {
+    ClientContext master_client;
+    master_client.fd = fd;
+    master_client.is_master = true;
+
+    std::vector<std::string> parts;
+    size_t consumed;
+    auto last_ack = std::chrono::steady_clock::time_point();
+    // Held from a MULTI to its EXEC, so readers never see half a
+    // transaction. The master writes both in one go, so this is rarely
+    // held across a wait for more input.
+    std::unique_lock<std::shared_mutex> kv_lock(kv_mutex, std::defer_lock);
+
+    while (master_link_current(generation)) {
+        size_t pos = 0;
+        ParseResult result;
+        while ((result = parse_resp(buffer, pos, parts, consumed)) == ParseResult::Complete) {
+            const char* raw = buffer.data() + pos;
+            pos += consumed;
+
+            master_client.force_reply = false;
+            std::string reply;
+            {
+                if (!kv_lock.owns_lock()) kv_lock.lock();
+                if (!parts.empty()) {
+                    reply = handle_command_locked(parts, master_client);
+                }
+                std::lock_guard<std::mutex> lock(repl_mutex);
+                feed_backlog(raw, consumed);
+            }
+            if (!master_client.in_multi) kv_lock.unlock();
+
+            master_client.expired_keys.clear();
+            if (master_client.force_reply && !send_all(fd, reply)) return;
+        }
+        buffer.erase(0, pos);
+
+        if (result == ParseResult::Error) {
+            std::cerr << "Protocol error in replication stream\n";
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_ack >= REPL_ACK_PERIOD) {
+            if (!send_ack(fd)) return;
+            last_ack = now;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(REPL_ACK_PERIOD).count();
+        if (poll(&pfd, 1, wait_ms) == 0) continue;
+        if (!fill_buffer(fd, buffer)) return;
+    }
+}
+
+static void replica_main(uint64_t generation, std::string host, int port) {
+    while (master_link_current(generation)) {
+        int fd = connect_tcp(host, port);
+        if (fd < 0) {
+            std::cerr << "Unable to connect to master " << host << ":" << port << "\n";
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(repl_mutex);
+            if (generation != master_generation) {
+                close(fd);
+                return;
+            }
+            master_fd = fd;
+        }
+
+        std::string buffer;
+        if (replica_sync(fd, buffer)) {
+            {
+                std::lock_guard<std::mutex> lock(repl_mutex);
+                master_link_up = generation == master_generation;
+            }
+            replica_stream(fd, buffer, generation);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(repl_mutex);
+            if (master_fd == fd) {
+                master_fd = -1;
+                master_link_up = false;
+            }
+        }
+        close(fd);
+
+        if (master_link_current(generation)) {
+            std::cerr << "Lost connection to master, retrying\n";
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+void replication_set_master(const std::string& host, int port) {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    if (replica_mode && host == master_host && port == master_port) return;
+
+    master_host = host;
+    master_port = port;
+    master_generation++;
+    if (master_fd >= 0) shutdown(master_fd, SHUT_RDWR);
+    master_fd = -1;
+    master_link_up = false;
+    replica_mode = true;
+
+    // Sub-replicas must follow our new history from scratch
+    disconnect_replicas();
+
+    std::thread(replica_main, master_generation, host, port).detach();
+}
+
+// Promote to master, keeping the old history reachable through replid2
+static void replication_unset_master() {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    if (!replica_mode) return;
+
+    master_host.clear();
+    master_port = 0;
+    master_generation++;
+    if (master_fd >= 0) shutdown(master_fd, SHUT_RDWR);
+    master_fd = -1;
+    master_link_up = false;
+    replica_mode = false;
+
+    master_replid2 = master_replid;
+    second_replid_offset = backlog->offset() + 1;
+    master_replid = generate_replid();
+    disconnect_replicas();
+}
+
+static std::string cmd_replicaof(const std::vector<std::string>& parts, ClientContext& client) {
+    if (client.is_master) return "";
+
+    if (to_upper(parts[1]) == "NO" && to_upper(parts[2]) == "ONE") {
+        replication_unset_master();
+        return "+OK\r\n";
+    }
+
+    int port;
+    try {
+        port = std::stoi(parts[2]);
+    } catch (const std::exception& e) {
+        return "-ERR Invalid master port\r\n";
+    }
+    replication_set_master(parts[1], port);
+    return "+OK\r\n";
+}
+
+// WAIT numreplicas timeout: block until that many replicas acknowledged the
+// offset of this client's last write, or the timeout (ms, 0 = forever) hits
+static std::string cmd_wait(const std::vector<std::string>& parts, ClientContext& client) {
+    if (replication_is_replica()) {
+        return "-ERR WAIT cannot be used with replica instances\r\n";
+    }
+
+    long long numreplicas, timeout_ms;
+    try {
+        numreplicas = std::stoll(parts[1]);
+        timeout_ms = std::stoll(parts[2]);
+    } catch (const std::exception& e) {
+        return "-ERR value is not an integer or out of range\r\n";
+    }
+    if (timeout_ms < 0) return "-ERR timeout is negative\r\n";
+
+    std::unique_lock<std::mutex> lock(repl_mutex);
+    auto acked = [&] {
+        long long count = 0;
+        for (const auto& link : replicas) {
+            if (link->online && link->ack_offset >= client.woff) count++;
+        }
+        return count;
+    };
+
+    if (acked() >= numreplicas) {
+        return resp_integer(acked());
+    }
+
+    // Ask for fresh offsets instead of waiting for the periodic ACKs
+    std::string getack = resp_command({"REPLCONF", "GETACK", "*"});
+    feed_backlog(getack.data(), getack.size());
+
+    auto enough = [&] { return acked() >= numreplicas; };
+    // Past some 35000 years now + timeout would overflow the steady clock,
+    // so a timeout that long waits forever like 0
+    constexpr long long forever_ms = 1LL << 50;
+    if (timeout_ms == 0 || timeout_ms >= forever_ms) {
+        repl_cv.wait(lock, enough);
+    } else {
+        repl_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), enough);
+    }
+    return resp_integer(acked());
+}
+
+// READONLY / READWRITE: per-connection opt-in to reads served by a replica
+static std::string cmd_readonly(const std::vector<std::string>& parts, ClientContext& client) {
+    client.readonly = to_upper(parts[0]) == "READONLY";
+    return "+OK\r\n";
+}
+
+std::string replication_info() {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    std::ostringstream info;
+
+    info << "# Replication\r\n";
+    info << "role:" << (replica_mode ? "slave" : "master") << "\r\n";
+    if (replica_mode) {
+        info << "master_host:" << master_host << "\r\n";
+        info << "master_port:" << master_port << "\r\n";
+        info << "master_link_status:" << (master_link_up ? "up" : "down") << "\r\n";
+        info << "slave_repl_offset:" << backlog->offset() << "\r\n";
+    }
+
+    info << "connected_slaves:" << replicas.size() << "\r\n";
+    int index = 0;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& link : replicas) {
+        auto lag = std::chrono::duration_cast<std::chrono::seconds>(now - link->ack_time).count();
+        info << "slave" << index++ << ":ip=" << link->ip << ",port=" << link->listening_port
+             << ",state=" << (link->online ? "online" : "wait_bgsave")
+             << ",offset=" << link->ack_offset << ",lag=" << lag << "\r\n";
+    }
+
+    info << "master_replid:" << master_replid << "\r\n";
+    info << "master_replid2:" << master_replid2 << "\r\n";
+    info << "master_repl_offset:" << backlog->offset() << "\r\n";
+    info << "second_repl_offset:" << second_replid_offset << "\r\n";
+    info << "repl_backlog_active:1\r\n";
+    info << "repl_backlog_size:" << backlog->size() << "\r\n";
+    info << "repl_backlog_first_byte_offset:" << backlog->first_offset() + 1 << "\r\n";
+    info << "repl_backlog_histlen:" << backlog->histlen() << "\r\n";
+    return info.str();
+}
+
+std::string replication_stats() {
+    std::lock_guard<std::mutex> lock(repl_mutex);
+    return "# Stats\r\nsync_full:" + std::to_string(sync_full) + "\r\nsync_partial_ok:" +
+           std::to_string(sync_partial_ok) + "\r\nsync_partial_err:" + std::to_string(sync_partial_err) + "\r\n";
+}
+
+void register_replication_commands() {
+    register_command({"REPLICAOF", 3, CMD_NO_MULTI, cmd_replicaof});
+    register_command({"SLAVEOF", 3, CMD_NO_MULTI, cmd_replicaof});
+    register_command({"REPLCONF", -2, CMD_NO_MULTI, cmd_replconf});
+    register_command({"PSYNC", 3, CMD_NO_MULTI, cmd_psync});
+    register_command({"WAIT", 3, CMD_NO_MULTI, cmd_wait});
+    register_command({"READONLY", 1, 0, cmd_readonly});
+    register_command({"READWRITE", 1, 0, cmd_readonly});
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+
+// Fixed-size circular buffer holding the most recent bytes of the
+// replication stream. Offsets are absolute stream positions, so a byte at
+// offset p lives at buf_[p % size].
+class ReplicationBacklog {
+public:
+    explicit ReplicationBacklog(size_t size) : buf_(size) {}
+
+    void append(const char* data, size_t len);
+
+    // Drop the history and continue numbering the stream from offset
+    void reset(uint64_t offset);
+
+    // Total bytes ever written to the stream (master_repl_offset)
+    uint64_t offset() const { return offset_; }
+    uint64_t histlen() const { return histlen_; }
+    uint64_t first_offset() const { return offset_ - histlen_; }
+    size_t size() const { return buf_.size(); }
+
+    // Copy up to max_len bytes starting at stream offset from. Returns false
+    // when that part of the stream has already been overwritten.
+    bool read_from(uint64_t from, std::string& out, size_t max_len) const;
+
+private:
+    std::vector<char> buf_;
+    uint64_t offset_ = 0;
+    uint64_t histlen_ = 0;
+};
+
+// Pick a replication ID and allocate the backlog, called once at startup
+void replication_init();
+
+// Append a write command to the stream sent to replicas and return the new
+// stream offset. Called by the dispatcher with kv_mutex held exclusively so
+// the stream order matches apply order.
+uint64_t replication_propagate(const std::vector<std::string>& parts);
+
+// True while this server follows a master and rejects client writes
+bool replication_is_replica();
+
+// Connect to a master and keep following it, as for REPLICAOF host port
+void replication_set_master(const std::string& host, int port);
+
+// Called from the client thread when a replica connection goes away
+void replication_replica_disconnected(ClientContext& client);
+
+// Body of INFO replication
+std::string replication_info();
+
+// The sync counters of INFO stats: full syncs served, and PSYNCs that
+// continued or had to fall back to a full sync
+std::string replication_stats();
@@ -0,0 +1,127 @@
+#include "resp.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <sstream>
+
+// Read a CRLF-terminated integer that follows a type byte at buffer[pos]
+static ParseResult read_length(const std::string& buffer, size_t& pos, long long& value) {
+    size_t end = buffer.find("\r\n", pos);
+    if (end == std::string::npos) return ParseResult::Incomplete;
+
+    auto [ptr, ec] = std::from_chars(buffer.data() + pos + 1, buffer.data() + end, value);
+    if (ec != std::errc() || ptr != buffer.data() + end) return ParseResult::Error;
+
+    pos = end + 2;
+    return ParseResult::Complete;
+}
+
+ParseResult parse_resp(const std::string& buffer, size_t start,
+                       std::vector<std::string>& parts, size_t& consumed) {
+    parts.clear();
+    if (start >= buffer.size()) return ParseResult::Incomplete;
+
+    size_t pos = start;
+
+    // Inline command, e.g. "PING\r\n" typed into telnet
+    if (buffer[pos] != '*') {
+        size_t end = buffer.find("\r\n", pos);
+        if (end == std::string::npos) return ParseResult::Incomplete;
+
+        std::istringstream iss(buffer.substr(pos, end - pos));
+        std::string word;
+        while (iss >> word) {
+            parts.push_back(word);
+        }
+        consumed = end + 2 - start;
+        return ParseResult::Complete;
+    }
+
+    long long array_len;
+    ParseResult result = read_length(buffer, pos, array_len);
+    if (result != ParseResult::Complete) return result;
+
+    for (long long i = 0; i < array_len; i++) {
+        if (pos >= buffer.size()) return ParseResult::Incomplete;
+        if (buffer[pos] != '$') return ParseResult::Error;
+
+        long long bulk_len;
+        result = read_length(buffer, pos, bulk_len);
+        if (result != ParseResult::Complete) return result;
+        if (bulk_len < 0) return ParseResult::Error;
+
+        if (buffer.size() < pos + bulk_len + 2) return ParseResult::Incomplete;
+        parts.emplace_back(buffer, pos, bulk_len);
+        pos += bulk_len + 2;
+    }
+
+    consumed = pos - start;
+    return ParseResult::Complete;
+}
+
+std::string resp_simple(const std::string& str) {
+    return "+" + str + "\r\n";
+}
+
+std::string resp_error(const std::string& msg) {
+    return "-" + msg + "\r\n";
+}
+
+std::string resp_bulk(std::string_view str) {
+    std::string out;
+    resp_append_bulk(out, str);
+    return out;
+}
+
+std::string resp_null() {
+    return "$-1\r\n";
+}
+
+std::string resp_integer(int64_t value) {
+    return ":" + std::to_string(value) + "\r\n";
+}
+
+std::string resp_array_header(size_t len) {
+    return "*" + std::to_string(len) + "\r\n";
+}
+
+std::string resp_array(const std::vector<std::string>& items) {
+    size_t bytes = 16;
+    for (const auto& item : items) bytes += item.size() + 16;
+    std::string out;
+    out.reserve(bytes);
+    out += resp_array_header(items.size());
+    for (const auto& item : items) {
+        resp_append_bulk(out, item);
+    }
+    return out;
+}
+
+void resp_append_bulk(std::string& out, std::string_view str) {
+    size_t old = out.size();
+    // "$", up to 20 digits, CRLF, the payload, CRLF
+    out.resize_and_overwrite(old + str.size() + 25, [&](char* buf, size_t) {
+        char* p = buf + old;
+        *p++ = '$';
+        p = std::to_chars(p, p + 20, str.size()).ptr;
+        *p++ = '\r';
+        *p++ = '\n';
+        p = std::copy(str.begin(), str.end(), p);
+        *p++ = '\r';
+        *p++ = '\n';
+        return p - buf;
+    });
+}
+
+std::string resp_command(const std::vector<std::string>& parts) {
+    return resp_array(parts);
+}
+
+std::string to_upper(const std::string& str) {
+    std::string upper = str;
+    for (char& c : upper) {
+        c = toupper(static_cast<unsigned char>(c));
+    }
+    return upper;
+}
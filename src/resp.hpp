@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Result of trying to parse one command out of a connection buffer
+enum class ParseResult {
+    Complete,
+    Incomplete,
+    Error
+};
+
+// Parse one RESP array of bulk strings (or an inline command) starting at
+// buffer[start]. On success fills parts and sets consumed to the number of
+// bytes the command occupied, which replication uses to track offsets.
+ParseResult parse_resp(const std::string& buffer, size_t start,
+                       std::vector<std::string>& parts, size_t& consumed);
+
+// Reply encoders
+std::string resp_simple(const std::string& str);
+std::string resp_error(const std::string& msg);
+std::string resp_bulk(std::string_view str);
+std::string resp_null();
+std::string resp_integer(int64_t value);
+std::string resp_array_header(size_t len);
+std::string resp_array(const std::vector<std::string>& items);
+
+// Append a bulk string to a reply under construction, for replies with many
+// elements where a temporary string per element would dominate
+void resp_append_bulk(std::string& out, std::string_view str);
+
+// Encode a command the way clients send it, used for the replication stream
+std::string resp_command(const std::vector<std::string>& parts);
+
+// Convert string to uppercase for case-insensitive comparison
+std::string to_upper(const std::string& str);
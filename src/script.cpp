@@ -0,0 +1,935 @@
+#include "script.hpp"
+
+extern "C" {
+#include <lauxlib.h>
+#include <lua.h>
+#include <lualib.h>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "replication.hpp"
+#include "resp.hpp"
+#include "server.hpp"
+#include "sha1.hpp"
+#include "util.hpp"
+
+// Lua unwinds errors with longjmp, which skips C++ destructors. Functions
+// called from Lua therefore raise only once no object with a destructor is
+// alive in their frame, handing error messages up from helpers on the
+// Lua stack.
+
+// Script sources by the SHA1 of their text, for EVALSHA. Each interpreter
+// compiles a script the first time it runs it.
+static std::mutex script_mutex;
+static std::unordered_map<std::string, std::string> script_sources;
+
+// A Lua state runs one script at a time, and EVAL_RO runs under the shared
+// lock alongside other scripts, so each running script takes a state of
+// its own from this pool. SCRIPT FLUSH retires every state, dropping their
+// compiled scripts with them.
+static std::mutex pool_mutex;
+static std::vector<lua_State*> idle_interpreters;
+static uint64_t pool_generation = 0;  // guarded by pool_mutex
+
+// Registry entries of each state
+static const char* const COMPILED_SCRIPTS = "redis_scripts";  // sha -> function
+static const char* const SCRIPT_GLOBALS = "redis_globals";    // the table behind the read-only _G
+static const char* const READONLY_TABLES = "redis_readonly";  // set of the read-only views
+
+// Replies nest at most this deep on the way back to the client
+static constexpr int MAX_REPLY_DEPTH = 200;
+
+// Heap of one Lua state, so a runaway script fails with "not enough memory"
+// rather than exhausting the server's
+static constexpr size_t MAX_SCRIPT_MEMORY = size_t(1) << 30;
+
+// A state going back to the pool with more heap than this is collected in
+// full first, so garbage from one big script isn't kept until the next
+static constexpr size_t IDLE_SCRIPT_MEMORY = size_t(64) << 20;
+
+// Instructions between checks of the script's deadline and of SCRIPT KILL
+static constexpr int HOOK_INTERVAL = 100000;
+
+static const char* const SCRIPT_KILLED_ERROR = "Script killed by user with SCRIPT KILL...";
+
+// Where a script stands for SCRIPT KILL. The first write and a kill race
+// for RUNNING, so a killed script never wrote and leaves the dataset as it
+// found it, and a script that wrote always runs to the end.
+enum ScriptState : int { SCRIPT_RUNNING, SCRIPT_WROTE, SCRIPT_KILLED };
+
+// State of one EVAL shared by the redis.* functions
+struct ScriptCall {
+    ClientContext& client;
+    bool read_only;  // EVAL_RO and EVALSHA_RO
+    std::chrono::steady_clock::time_point deadline;
+    bool wrapped = false;             // MULTI went to replicas ahead of the first write
+    std::atomic<bool> busy{false};    // past lua-time-limit, so SCRIPT KILL may stop it
+    std::atomic<int> state{SCRIPT_RUNNING};
+};
+
+// The script running on this thread, for the redis.* functions and the hook
+static thread_local ScriptCall* current_call = nullptr;
+
+// Every script in flight, for SCRIPT KILL
+static std::mutex running_mutex;
+static std::vector<ScriptCall*> running_scripts;
+
+// Lua 5.2 moved the globals table into the registry and took coroutine and
+// unpack out of the base library. Redis embeds 5.1; these paper over the
+// difference for builds against a newer Lua.
+static void open_library(lua_State* lua, const char* name, lua_CFunction open) {
+#if LUA_VERSION_NUM >= 502
+    luaL_requiref(lua, name, open, 1);
+    lua_pop(lua, 1);
+#else
+    lua_pushcfunction(lua, open);
+    lua_pushstring(lua, name);
+    lua_call(lua, 1, 0);
+#endif
+}
+
+static void push_globals_table(lua_State* lua) {
+#if LUA_VERSION_NUM >= 502
+    lua_rawgeti(lua, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+    lua_pushvalue(lua, LUA_GLOBALSINDEX);
+#endif
+}
+
+// Pops a table and makes it the globals of code loaded from now on
+static void replace_globals_table(lua_State* lua) {
+#if LUA_VERSION_NUM >= 502
+    lua_rawseti(lua, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+    lua_replace(lua, LUA_GLOBALSINDEX);
+#endif
+}
+
+// A string or number argument as a command sees it. Numbers print the way
+// Lua 5.1 prints them, which scripts written for Redis expect: 10/2 is "5".
+static bool to_argument(lua_State* lua, int index, std::string& out) {
+    int type = lua_type(lua, index);
+    if (type == LUA_TSTRING) {
+        size_t len;
+        const char* text = lua_tolstring(lua, index, &len);
+        out.assign(text, len);
+        return true;
+    }
+    if (type != LUA_TNUMBER) return false;
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(lua, index)) {
+        out = std::to_string(lua_tointeger(lua, index));
+        return true;
+    }
+#endif
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.14g", static_cast<double>(lua_tonumber(lua, index)));
+    out = buffer;
+    return true;
+}
+
+static void push_status_table(lua_State* lua, const char* field, const std::string& text) {
+    lua_createtable(lua, 0, 1);
+    lua_pushstring(lua, field);
+    lua_pushlstring(lua, text.data(), text.size());
+    lua_rawset(lua, -3);
+}
+
+// Decode the reply at reply[pos] onto the Lua stack the way Redis hands
+// replies to scripts: integers as numbers, nulls as false, status and error
+// replies as {ok=...} and {err=...} tables
+static void push_reply(lua_State* lua, const std::string& reply, size_t& pos) {
+    size_t end = reply.find("\r\n", pos);
+    char type = reply[pos];
+    std::string line = reply.substr(pos + 1, end - pos - 1);
+    pos = end + 2;
+
+    int64_t len = 0;
+    switch (type) {
+    case '+':
+        push_status_table(lua, "ok", line);
+        return;
+    case '-':
+        push_status_table(lua, "err", line);
+        return;
+    case ':':
+        string_to_int64(line, len);
+        lua_pushinteger(lua, static_cast<lua_Integer>(len));
+        return;
+    case '$':
+        string_to_int64(line, len);
+        if (len < 0) break;
+        lua_pushlstring(lua, reply.data() + pos, len);
+        pos += len + 2;
+        return;
+    case '*':
+        string_to_int64(line, len);
+        if (len < 0) break;
+        lua_checkstack(lua, 3);
+        lua_createtable(lua, static_cast<int>(len), 0);
+        for (int64_t i = 0; i < len; i++) {
+            push_reply(lua, reply, pos);
+            lua_rawseti(lua, -2, static_cast<int>(i + 1));
+        }
+        return;
+    }
+    lua_pushboolean(lua, 0);
+}
+
+// Error text for a reply line, with CR and LF flattened to spaces
+static std::string error_line(const std::string& text) {
+    std::string line = text;
+    std::replace(line.begin(), line.end(), '\r', ' ');
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    return line;
+}
+
+// The string field name of the table at index, if it has one
+static bool string_field(lua_State* lua, int index, const char* name, std::string& out) {
+    lua_pushstring(lua, name);
+    lua_rawget(lua, index < 0 ? index - 1 : index);
+    bool found = lua_type(lua, -1) == LUA_TSTRING;
+    if (found) to_argument(lua, -1, out);
+    lua_pop(lua, 1);
+    return found;
+}
+
+// Encode the value at index as a reply: numbers truncate to integers, true
+// is 1, false and nil are null, and a table is an array up to its first nil
+// unless it has an err or ok field
+static void lua_to_reply(lua_State* lua, int index, std::string& out, int depth) {
+    switch (lua_type(lua, index)) {
+    case LUA_TNUMBER: {
+#if LUA_VERSION_NUM >= 503
+        if (lua_isinteger(lua, index)) {
+            out += resp_integer(lua_tointeger(lua, index));
+            return;
+        }
+#endif
+        double number = lua_tonumber(lua, index);
+        int64_t integer = std::isnan(number)                ? 0
+                          : number >= 9223372036854775807.0 ? INT64_MAX
+                          : number <= -9223372036854775808.0 ? INT64_MIN
+                                                             : static_cast<int64_t>(number);
+        out += resp_integer(integer);
+        return;
+    }
+    case LUA_TSTRING: {
+        size_t len;
+        const char* text = lua_tolstring(lua, index, &len);
+        resp_append_bulk(out, std::string_view(text, len));
+        return;
+    }
+    case LUA_TBOOLEAN:
+        out += lua_toboolean(lua, index) ? ":1\r\n" : resp_null();
+        return;
+    case LUA_TTABLE: {
+        if (depth > MAX_REPLY_DEPTH || !lua_checkstack(lua, 2)) {
+            out += "-ERR reached lua stack limit\r\n";
+            return;
+        }
+        std::string text;
+        if (string_field(lua, index, "err", text)) {
+            out += "-" + error_line(text) + "\r\n";
+            return;
+        }
+        if (string_field(lua, index, "ok", text)) {
+            out += "+" + error_line(text) + "\r\n";
+            return;
+        }
+        int table = index < 0 ? lua_gettop(lua) + index + 1 : index;
+        int length = 0;
+        while (true) {
+            lua_rawgeti(lua, table, length + 1);
+            bool end = lua_isnil(lua, -1);
+            lua_pop(lua, 1);
+            if (end) break;
+            length++;
+        }
+        out += resp_array_header(length);
+        for (int i = 1; i <= length; i++) {
+            lua_rawgeti(lua, table, i);
+            lua_to_reply(lua, -1, out, depth + 1);
+            lua_pop(lua, 1);
+        }
+        return;
+    }
+    default:
+        out += resp_null();
+        return;
+    }
+}
+
+// Reply to a script that raised the error at the top of the stack: a table
+// from redis.call or redis.error_reply keeps its error code, anything else
+// is an ERR
+static std::string script_error_reply(lua_State* lua, const std::string& sha) {
+    std::string message;
+    if (lua_type(lua, -1) == LUA_TTABLE && string_field(lua, -1, "err", message)) {
+        return "-" + error_line(message) + "\r\n";
+    }
+    if (!to_argument(lua, -1, message)) message = "unknown error";
+    return "-ERR " + error_line(message) + " script: " + sha + "\r\n";
+}
+
+// redis.call and redis.pcall: run a command straight through the command
+// table, with kv_mutex already held by EVAL. Returns the number of results
+// pushed, or -1 with an error on the stack for the caller to raise: a
+// failing command's {err=...} table from call, or a message for bad
+// arguments. pcall returns the table instead.
+static int redis_call_generic(lua_State* lua, bool raise) {
+    ScriptCall& call = *current_call;
+    auto fail = [&](const std::string& reply) {
+        // reply is "-CODE message\r\n"
+        push_status_table(lua, "err", reply.substr(1, reply.size() - 3));
+        return raise ? -1 : 1;
+    };
+
+    int argc = lua_gettop(lua);
+    if (argc == 0) {
+        lua_pushstring(lua, "Please specify at least one argument for this redis lib call");
+        return -1;
+    }
+    std::vector<std::string> parts(argc);
+    for (int i = 0; i < argc; i++) {
+        if (!to_argument(lua, i + 1, parts[i])) {
+            lua_pushstring(lua, "Lua redis lib command arguments must be strings or integers");
+            return -1;
+        }
+    }
+
+    std::string error;
+    const Command* command = lookup_command(parts, error);
+    if (!command) return fail(error);
+    if (command->flags & (CMD_NO_SCRIPT | CMD_NO_MULTI | CMD_NO_QUEUE)) {
+        return fail("-ERR This Redis command is not allowed from script\r\n");
+    }
+
+    // EVAL itself isn't a write, so a script that only reads runs on a
+    // read-only replica and the writes are refused one by one here
+    ClientContext& client = call.client;
+    bool is_write = command->flags & CMD_WRITE;
+    if (is_write && call.read_only) return fail("-ERR Write commands are not allowed from read-only scripts.\r\n");
+    if (is_write && !client.is_master && replication_is_replica() && server_config.replica_read_only) {
+        return fail("-READONLY You can't write against a read only replica.\r\n");
+    }
+    // The first write makes the script unkillable. A kill that got there
+    // first wins, and the write never happens; pcall can't catch that.
+    int expected = SCRIPT_RUNNING;
+    if (is_write && !call.state.compare_exchange_strong(expected, SCRIPT_WROTE) && expected == SCRIPT_KILLED) {
+        lua_pushstring(lua, SCRIPT_KILLED_ERROR);
+        return -1;
+    }
+
+    // Replicas get the script's writes wrapped in MULTI/EXEC, so they
+    // apply them as one transaction
+    if (is_write && !call.wrapped && !client.in_exec && !replication_is_replica()) {
+        client.woff = replication_propagate({"MULTI"});
+        call.wrapped = true;
+    }
+
+    std::string reply;
+    try {
+        reply = handle_command_locked(parts, client);
+    } catch (const std::exception& e) {
+        // An exception must not unwind through the Lua interpreter
+        reply = "-ERR " + error_line(e.what()) + "\r\n";
+    }
+    if (!reply.empty() && reply[0] == '-') return fail(reply);
+    size_t pos = 0;
+    push_reply(lua, reply, pos);
+    return 1;
+}
+
+static int lua_redis_call(lua_State* lua) {
+    int results = redis_call_generic(lua, true);
+    return results < 0 ? lua_error(lua) : results;
+}
+
+static int lua_redis_pcall(lua_State* lua) {
+    int results = redis_call_generic(lua, false);
+    return results < 0 ? lua_error(lua) : results;
+}
+
+static int lua_redis_error_reply(lua_State* lua) {
+    if (lua_gettop(lua) != 1 || lua_type(lua, 1) != LUA_TSTRING) {
+        return luaL_error(lua, "wrong number or type of arguments");
+    }
+    const char* text = lua_tostring(lua, 1);
+    lua_createtable(lua, 0, 1);
+    lua_pushstring(lua, "err");
+    lua_pushstring(lua, text[0] == '-' ? text + 1 : text);
+    lua_rawset(lua, -3);
+    return 1;
+}
+
+static int lua_redis_status_reply(lua_State* lua) {
+    if (lua_gettop(lua) != 1 || lua_type(lua, 1) != LUA_TSTRING) {
+        return luaL_error(lua, "wrong number or type of arguments");
+    }
+    lua_createtable(lua, 0, 1);
+    lua_pushstring(lua, "ok");
+    lua_pushvalue(lua, 1);
+    lua_rawset(lua, -3);
+    return 1;
+}
+
+static void push_sha1hex(lua_State* lua) {
+    std::string data;
+    to_argument(lua, 1, data);
+    std::string sha = sha1_hex(data);
+    lua_pushlstring(lua, sha.data(), sha.size());
+}
+
+static int lua_redis_sha1hex(lua_State* lua) {
+    if (lua_gettop(lua) != 1) return luaL_error(lua, "wrong number of arguments");
+    push_sha1hex(lua);
+    return 1;
+}
+
+static void write_log(lua_State* lua, int level) {
+    std::string line, word;
+    for (int i = 2; i <= lua_gettop(lua); i++) {
+        if (i > 2) line += ' ';
+        if (to_argument(lua, i, word)) line += word;
+    }
+    (level == 3 ? std::cerr : std::cout) << "Script: " << line << "\n";
+}
+
+static int lua_redis_log(lua_State* lua) {
+    if (lua_gettop(lua) < 2) return luaL_error(lua, "redis.log() requires two arguments or more.");
+    if (lua_type(lua, 1) != LUA_TNUMBER) return luaL_error(lua, "First argument must be a number (log level).");
+    lua_Integer level = lua_tointeger(lua, 1);
+    if (level < 0 || level > 3) return luaL_error(lua, "Invalid debug level.");
+    // Debug and verbose messages are dropped, as at the default loglevel
+    if (level >= 2) write_log(lua, static_cast<int>(level));
+    return 0;
+}
+
+static const luaL_Reg redis_functions[] = {
+    {"call", lua_redis_call},
+    {"pcall", lua_redis_pcall},
+    {"error_reply", lua_redis_error_reply},
+    {"status_reply", lua_redis_status_reply},
+    {"sha1hex", lua_redis_sha1hex},
+    {"log", lua_redis_log},
+    {nullptr, nullptr},
+};
+
+// The bit library Redis bundles (LuaBitOp): operations on numbers taken
+// modulo 2^32 and returned as signed 32-bit values
+static uint32_t bit_arg(lua_State* lua, int index) {
+    double number = luaL_checknumber(lua, index);
+    if (!std::isfinite(number)) return 0;
+    return static_cast<uint32_t>(static_cast<int64_t>(std::fmod(number, 4294967296.0)));
+}
+
+static int push_bits(lua_State* lua, uint32_t bits) {
+    lua_pushinteger(lua, static_cast<int32_t>(bits));
+    return 1;
+}
+
+static int bit_tobit(lua_State* lua) { return push_bits(lua, bit_arg(lua, 1)); }
+static int bit_bnot(lua_State* lua) { return push_bits(lua, ~bit_arg(lua, 1)); }
+
+static int bit_band(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1);
+    for (int i = 2; i <= lua_gettop(lua); i++) bits &= bit_arg(lua, i);
+    return push_bits(lua, bits);
+}
+
+static int bit_bor(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1);
+    for (int i = 2; i <= lua_gettop(lua); i++) bits |= bit_arg(lua, i);
+    return push_bits(lua, bits);
+}
+
+static int bit_bxor(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1);
+    for (int i = 2; i <= lua_gettop(lua); i++) bits ^= bit_arg(lua, i);
+    return push_bits(lua, bits);
+}
+
+static int bit_lshift(lua_State* lua) { return push_bits(lua, bit_arg(lua, 1) << (bit_arg(lua, 2) & 31)); }
+static int bit_rshift(lua_State* lua) { return push_bits(lua, bit_arg(lua, 1) >> (bit_arg(lua, 2) & 31)); }
+
+static int bit_arshift(lua_State* lua) {
+    return push_bits(lua, static_cast<uint32_t>(static_cast<int32_t>(bit_arg(lua, 1)) >> (bit_arg(lua, 2) & 31)));
+}
+
+static int bit_rol(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1), n = bit_arg(lua, 2) & 31;
+    return push_bits(lua, (bits << n) | (bits >> ((32 - n) & 31)));
+}
+
+static int bit_ror(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1), n = bit_arg(lua, 2) & 31;
+    return push_bits(lua, (bits >> n) | (bits << ((32 - n) & 31)));
+}
+
+static int bit_bswap(lua_State* lua) { return push_bits(lua, __builtin_bswap32(bit_arg(lua, 1))); }
+
+static int bit_tohex(lua_State* lua) {
+    uint32_t bits = bit_arg(lua, 1);
+    lua_Integer digits = luaL_optinteger(lua, 2, 8);
+    const char* alphabet = digits < 0 ? "0123456789ABCDEF" : "0123456789abcdef";
+    if (digits < 0) digits = -digits;
+    if (digits > 8) digits = 8;
+    char buffer[8];
+    for (lua_Integer i = digits - 1; i >= 0; i--, bits >>= 4) buffer[i] = alphabet[bits & 15];
+    lua_pushlstring(lua, buffer, static_cast<size_t>(digits));
+    return 1;
+}
+
+static const luaL_Reg bit_functions[] = {
+    {"tobit", bit_tobit},   {"bnot", bit_bnot},     {"band", bit_band},       {"bor", bit_bor},
+    {"bxor", bit_bxor},     {"lshift", bit_lshift}, {"rshift", bit_rshift},   {"arshift", bit_arshift},
+    {"rol", bit_rol},       {"ror", bit_ror},       {"bswap", bit_bswap},     {"tohex", bit_tohex},
+    {nullptr, nullptr},
+};
+
+static void push_library(lua_State* lua, const luaL_Reg* functions) {
+    lua_newtable(lua);
+    for (; functions->name; functions++) {
+        lua_pushcfunction(lua, functions->func);
+        lua_setfield(lua, -2, functions->name);
+    }
+}
+
+// Scripts share a state with the scripts that ran on it before, so they
+// see the globals and libraries only through read-only views
+static int readonly_error(lua_State* lua) { return luaL_error(lua, "Attempt to modify a readonly table"); }
+
+static int missing_global(lua_State* lua) {
+    return luaL_error(lua, "Script attempted to access nonexistent global variable '%s'",
+                      lua_type(lua, 2) == LUA_TSTRING ? lua_tostring(lua, 2) : "?");
+}
+
+// rawset, refusing the read-only views
+static int protected_rawset(lua_State* lua) {
+    luaL_checktype(lua, 1, LUA_TTABLE);
+    luaL_checkany(lua, 2);
+    luaL_checkany(lua, 3);
+    lua_getfield(lua, LUA_REGISTRYINDEX, READONLY_TABLES);
+    lua_pushvalue(lua, 1);
+    lua_rawget(lua, -2);
+    if (lua_toboolean(lua, -1)) return luaL_error(lua, "Attempt to modify a readonly table");
+    lua_settop(lua, 3);
+    lua_rawset(lua, 1);
+    return 1;
+}
+
+// Push an empty table that reads through to the table at index and refuses
+// writes
+static void push_readonly_view(lua_State* lua, int index) {
+    if (index < 0) index = lua_gettop(lua) + index + 1;
+    lua_newtable(lua);
+    lua_createtable(lua, 0, 3);
+    lua_pushvalue(lua, index);
+    lua_setfield(lua, -2, "__index");
+    lua_pushcfunction(lua, readonly_error);
+    lua_setfield(lua, -2, "__newindex");
+    lua_pushboolean(lua, 0);
+    lua_setfield(lua, -2, "__metatable");
+    lua_setmetatable(lua, -2);
+
+    lua_getfield(lua, LUA_REGISTRYINDEX, READONLY_TABLES);
+    lua_pushvalue(lua, -2);
+    lua_pushboolean(lua, 1);
+    lua_rawset(lua, -3);
+    lua_pop(lua, 1);
+}
+
+// Allocator of a Lua state, counting its heap in ud against the limit
+static void* script_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    size_t& used = *static_cast<size_t*>(ud);
+    size_t old = ptr ? osize : 0;
+    if (nsize == 0) {
+        std::free(ptr);
+        used -= old;
+        return nullptr;
+    }
+    if (nsize > old && used - old + nsize > MAX_SCRIPT_MEMORY) return nullptr;
+    void* block = std::realloc(ptr, nsize);
+    if (block) used = used - old + nsize;
+    return block;
+}
+
+static void close_interpreter(lua_State* lua) {
+    void* used;
+    lua_getallocf(lua, &used);
+    lua_close(lua);
+    delete static_cast<size_t*>(used);
+}
+
+// A state with the libraries Redis gives scripts: base without file access,
+// table, string, math, coroutine, bit and redis
+static lua_State* new_interpreter() {
+    size_t* used = new size_t(0);
+    lua_State* lua = lua_newstate(script_alloc, used);
+    if (!lua) {
+        delete used;
+        return nullptr;
+    }
+
+    open_library(lua, "_G", luaopen_base);
+    open_library(lua, LUA_TABLIBNAME, luaopen_table);
+    open_library(lua, LUA_STRLIBNAME, luaopen_string);
+    open_library(lua, LUA_MATHLIBNAME, luaopen_math);
+#if LUA_VERSION_NUM >= 502
+    open_library(lua, LUA_COLIBNAME, luaopen_coroutine);
+#endif
+
+    lua_newtable(lua);
+    lua_setfield(lua, LUA_REGISTRYINDEX, COMPILED_SCRIPTS);
+    lua_newtable(lua);
+    lua_setfield(lua, LUA_REGISTRYINDEX, READONLY_TABLES);
+
+    push_globals_table(lua);
+    int globals = lua_gettop(lua);
+    lua_pushvalue(lua, globals);
+    lua_setfield(lua, LUA_REGISTRYINDEX, SCRIPT_GLOBALS);
+
+    // getfenv and setfenv would reach past the read-only globals
+    for (const char* name : {"loadfile", "dofile", "getfenv", "setfenv"}) {
+        lua_pushnil(lua);
+        lua_setfield(lua, globals, name);
+    }
+#if LUA_VERSION_NUM >= 502
+    lua_getfield(lua, globals, LUA_TABLIBNAME);
+    lua_getfield(lua, -1, "unpack");
+    lua_setfield(lua, globals, "unpack");
+    lua_pop(lua, 1);
+    lua_getfield(lua, globals, "load");
+    lua_setfield(lua, globals, "loadstring");
+#endif
+    lua_pushcfunction(lua, protected_rawset);
+    lua_setfield(lua, globals, "rawset");
+
+    push_library(lua, bit_functions);
+    lua_setfield(lua, globals, "bit");
+    push_library(lua, redis_functions);
+    const char* levels[] = {"LOG_DEBUG", "LOG_VERBOSE", "LOG_NOTICE", "LOG_WARNING"};
+    for (int i = 0; i < 4; i++) {
+        lua_pushinteger(lua, i);
+        lua_setfield(lua, -2, levels[i]);
+    }
+    lua_setfield(lua, globals, "redis");
+
+    for (const char* name : {LUA_TABLIBNAME, LUA_STRLIBNAME, LUA_MATHLIBNAME, LUA_COLIBNAME, "bit", "redis"}) {
+        lua_getfield(lua, globals, name);
+        push_readonly_view(lua, -1);
+        lua_setfield(lua, globals, name);
+        lua_pop(lua, 1);
+    }
+    // Strings index the real string library through their metatable
+    lua_pushliteral(lua, "");
+    lua_getmetatable(lua, -1);
+    lua_pushboolean(lua, 0);
+    lua_setfield(lua, -2, "__metatable");
+    lua_pop(lua, 2);
+
+    // The globals scripts see are an empty view of the real ones, which
+    // raise on a missing name
+    push_readonly_view(lua, globals);
+    lua_pushvalue(lua, -1);
+    lua_setfield(lua, globals, "_G");
+    replace_globals_table(lua);
+    lua_newtable(lua);
+    lua_pushcfunction(lua, missing_global);
+    lua_setfield(lua, -2, "__index");
+    lua_setmetatable(lua, globals);
+    lua_settop(lua, 0);
+    return lua;
+}
+
+static lua_State* acquire_interpreter(uint64_t& generation) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        generation = pool_generation;
+        if (!idle_interpreters.empty()) {
+            lua_State* lua = idle_interpreters.back();
+            idle_interpreters.pop_back();
+            return lua;
+        }
+    }
+    return new_interpreter();
+}
+
+static void release_interpreter(lua_State* lua, uint64_t generation) {
+    void* used;
+    lua_getallocf(lua, &used);
+    if (*static_cast<size_t*>(used) > IDLE_SCRIPT_MEMORY) lua_gc(lua, LUA_GCCOLLECT, 0);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (generation == pool_generation) {
+            idle_interpreters.push_back(lua);
+            return;
+        }
+    }
+    close_interpreter(lua);
+}
+
+// An interpreter from the pool for the length of a scope
+class InterpreterLease {
+public:
+    InterpreterLease() : lua_(acquire_interpreter(generation_)) {}
+    ~InterpreterLease() {
+        if (lua_) release_interpreter(lua_, generation_);
+    }
+    InterpreterLease(const InterpreterLease&) = delete;
+    InterpreterLease& operator=(const InterpreterLease&) = delete;
+
+    lua_State* get() const { return lua_; }
+
+private:
+    uint64_t generation_;
+    lua_State* lua_;
+};
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+// Push the function for the script with this sha, compiling it on the
+// state's first run of it from source, or from the sources of scripts
+// already loaded when source is null. Fails with the error reply.
+static bool push_script(lua_State* lua, const std::string& sha, const std::string* source, std::string& error) {
+    lua_getfield(lua, LUA_REGISTRYINDEX, COMPILED_SCRIPTS);
+    lua_pushlstring(lua, sha.data(), sha.size());
+    lua_rawget(lua, -2);
+    if (lua_type(lua, -1) == LUA_TFUNCTION) {
+        lua_remove(lua, -2);
+        return true;
+    }
+    lua_pop(lua, 1);
+
+    std::string loaded;
+    if (!source) {
+        std::lock_guard<std::mutex> lock(script_mutex);
+        auto it = script_sources.find(sha);
+        if (it == script_sources.end()) {
+            lua_pop(lua, 1);
+            error = "-NOSCRIPT No matching script. Please use EVAL.\r\n";
+            return false;
+        }
+        loaded = it->second;
+        source = &loaded;
+    }
+
+    if (luaL_loadbuffer(lua, source->data(), source->size(), "@user_script") != 0) {
+        error = "-ERR Error compiling script (new function): " + error_line(lua_tostring(lua, -1)) + "\r\n";
+        lua_pop(lua, 2);
+        return false;
+    }
+    if (source != &loaded) {
+        std::lock_guard<std::mutex> lock(script_mutex);
+        script_sources.try_emplace(sha, *source);
+    }
+    lua_pushlstring(lua, sha.data(), sha.size());
+    lua_pushvalue(lua, -2);
+    lua_rawset(lua, -4);
+    lua_remove(lua, -2);
+    return true;
+}
+
+// Set KEYS or ARGV to parts[begin, end)
+static void set_script_array(lua_State* lua, const char* name, const std::vector<std::string>& parts, size_t begin,
+                             size_t end) {
+    lua_getfield(lua, LUA_REGISTRYINDEX, SCRIPT_GLOBALS);
+    lua_pushstring(lua, name);
+    lua_createtable(lua, static_cast<int>(end - begin), 0);
+    for (size_t i = begin; i < end; i++) {
+        lua_pushlstring(lua, parts[i].data(), parts[i].size());
+        lua_rawseti(lua, -2, static_cast<int>(i - begin + 1));
+    }
+    lua_rawset(lua, -3);
+    lua_pop(lua, 1);
+}
+
+// Count hook. A script past its deadline keeps running, since stopping it
+// would leave half its writes behind; it is logged and marked busy so
+// SCRIPT KILL can stop it if it hasn't written. Once killed, the error is
+// raised again at every instruction, so pcall can't swallow it.
+static void script_hook(lua_State* lua, lua_Debug*) {
+    ScriptCall* call = current_call;
+    if (!call) return;
+    if (call->state == SCRIPT_KILLED) {
+        lua_sethook(lua, script_hook, LUA_MASKCOUNT, 1);
+        lua_pushstring(lua, SCRIPT_KILLED_ERROR);
+        lua_error(lua);
+    }
+    if (!call->busy && std::chrono::steady_clock::now() >= call->deadline) {
+        call->busy = true;
+        std::cerr << "Slow script detected: still in execution after " << server_config.lua_time_limit
+                  << " milliseconds. You can try killing the script using the SCRIPT KILL command.\n";
+    }
+}
+
+// Positions of the keys of EVAL and friends, after numkeys
+static std::vector<size_t> eval_keys(const std::vector<std::string>& parts) {
+    std::vector<size_t> positions;
+    int64_t numkeys;
+    if (!string_to_int64(parts[2], numkeys) || numkeys < 0 || numkeys > static_cast<int64_t>(parts.size()) - 3) {
+        return positions;
+    }
+    for (int64_t i = 0; i < numkeys; i++) positions.push_back(3 + i);
+    return positions;
+}
+
+static std::string eval_generic(const std::vector<std::string>& parts, ClientContext& client, bool by_sha,
+                                bool read_only) {
+    int64_t numkeys;
+    if (!string_to_int64(parts[2], numkeys)) return "-ERR value is not an integer or out of range\r\n";
+    if (numkeys < 0) return "-ERR Number of keys can't be negative\r\n";
+    if (numkeys > static_cast<int64_t>(parts.size()) - 3) {
+        return "-ERR Number of keys can't be greater than number of args\r\n";
+    }
+
+    InterpreterLease interpreter;
+    lua_State* lua = interpreter.get();
+    if (!lua) return "-ERR Can't create a Lua interpreter\r\n";
+    std::string sha = by_sha ? lowercase(parts[1]) : sha1_hex(parts[1]);
+    std::string error;
+    if (!push_script(lua, sha, by_sha ? nullptr : &parts[1], error)) return error;
+
+    size_t first_arg = 3 + static_cast<size_t>(numkeys);
+    set_script_array(lua, "KEYS", parts, 3, first_arg);
+    set_script_array(lua, "ARGV", parts, first_arg, parts.size());
+
+    auto deadline = server_config.lua_time_limit > 0
+                        ? std::chrono::steady_clock::now() + std::chrono::milliseconds(server_config.lua_time_limit)
+                        : std::chrono::steady_clock::time_point::max();
+    ScriptCall call{client, read_only, deadline};
+    current_call = &call;
+    {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        running_scripts.push_back(&call);
+    }
+    lua_sethook(lua, script_hook, LUA_MASKCOUNT, HOOK_INTERVAL);
+    int status = lua_pcall(lua, 0, 1, 0);
+    {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        std::erase(running_scripts, &call);
+    }
+    current_call = nullptr;
+
+    std::string reply;
+    if (status == 0) {
+        lua_to_reply(lua, -1, reply, 0);
+    } else {
+        reply = script_error_reply(lua, sha);
+    }
+    lua_settop(lua, 0);
+
+    if (call.wrapped) client.woff = replication_propagate({"EXEC"});
+    // Replicas get the commands the script ran rather than the script, so
+    // its effects replay exactly
+    client.propagate_as.emplace();
+    return reply;
+}
+
+// EVAL script numkeys [key ...] [arg ...]
+static std::string cmd_eval(const std::vector<std::string>& parts, ClientContext& client) {
+    return eval_generic(parts, client, false, false);
+}
+
+// EVALSHA sha1 numkeys [key ...] [arg ...]
+static std::string cmd_evalsha(const std::vector<std::string>& parts, ClientContext& client) {
+    return eval_generic(parts, client, true, false);
+}
+
+// EVAL_RO script numkeys [key ...] [arg ...]
+static std::string cmd_eval_ro(const std::vector<std::string>& parts, ClientContext& client) {
+    return eval_generic(parts, client, false, true);
+}
+
+// EVALSHA_RO sha1 numkeys [key ...] [arg ...]
+static std::string cmd_evalsha_ro(const std::vector<std::string>& parts, ClientContext& client) {
+    return eval_generic(parts, client, true, true);
+}
+
+// SCRIPT LOAD script | EXISTS sha1 [sha1 ...] | FLUSH [ASYNC|SYNC] | KILL
+static std::string cmd_script(const std::vector<std::string>& parts, ClientContext&) {
+    std::string subcommand = to_upper(parts[1]);
+    if (subcommand == "LOAD" && parts.size() == 3) {
+        // Compiling checks the syntax and leaves the script ready in one state
+        InterpreterLease interpreter;
+        lua_State* lua = interpreter.get();
+        if (!lua) return "-ERR Can't create a Lua interpreter\r\n";
+        std::string sha = sha1_hex(parts[2]);
+        std::string error;
+        if (!push_script(lua, sha, &parts[2], error)) return error;
+        lua_settop(lua, 0);
+        return resp_bulk(sha);
+    }
+    if (subcommand == "EXISTS" && parts.size() >= 3) {
+        std::string reply = resp_array_header(parts.size() - 2);
+        std::lock_guard<std::mutex> lock(script_mutex);
+        for (size_t i = 2; i < parts.size(); i++) reply += resp_integer(script_sources.count(lowercase(parts[i])));
+        return reply;
+    }
+    if (subcommand == "FLUSH" && parts.size() <= 3) {
+        if (parts.size() == 3) {
+            std::string mode = to_upper(parts[2]);
+            if (mode != "ASYNC" && mode != "SYNC") return "-ERR SCRIPT FLUSH only support SYNC|ASYNC option\r\n";
+        }
+        {
+            std::lock_guard<std::mutex> lock(script_mutex);
+            script_sources.clear();
+        }
+        // Running scripts finish normally and their states are closed after
+        std::vector<lua_State*> retired;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            pool_generation++;
+            retired.swap(idle_interpreters);
+        }
+        for (lua_State* lua : retired) close_interpreter(lua);
+        return "+OK\r\n";
+    }
+    if (subcommand == "KILL" && parts.size() == 2) {
+        // SCRIPT takes no lock, so this runs while a busy script holds kv_mutex
+        bool busy = false, killed = false;
+        std::lock_guard<std::mutex> lock(running_mutex);
+        for (ScriptCall* call : running_scripts) {
+            if (!call->busy) continue;
+            busy = true;
+            int expected = SCRIPT_RUNNING;
+            if (call->state.compare_exchange_strong(expected, SCRIPT_KILLED) || expected == SCRIPT_KILLED) {
+                killed = true;
+            }
+        }
+        if (killed) return "+OK\r\n";
+        if (busy) {
+            return "-UNKILLABLE Sorry the script already executed write commands against the dataset. You can "
+                   "either wait the script termination or kill the server in a hard way using the SHUTDOWN "
+                   "NOSAVE command.\r\n";
+        }
+        return "-NOTBUSY No scripts in execution right now.\r\n";
+    }
+    return "-ERR unknown subcommand or wrong number of arguments for '" + parts[1] + "'\r\n";
+}
+
+void register_script_commands() {
+    unsigned flags = CMD_NO_SCRIPT;
+    register_command({"EVAL", -3, CMD_MAY_WRITE | flags, cmd_eval, 0, 0, 0, eval_keys});
+    register_command({"EVALSHA", -3, CMD_MAY_WRITE | flags, cmd_evalsha, 0, 0, 0, eval_keys});
+    register_command({"EVAL_RO", -3, CMD_READONLY | flags, cmd_eval_ro, 0, 0, 0, eval_keys});
+    register_command({"EVALSHA_RO", -3, CMD_READONLY | flags, cmd_evalsha_ro, 0, 0, 0, eval_keys});
+    register_command({"SCRIPT", -2, flags, cmd_script});
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Server-side scripting: EVAL, EVALSHA, their read-only variants EVAL_RO
+// and EVALSHA_RO, and SCRIPT LOAD, EXISTS, FLUSH and KILL. Scripts are
+// Lua, run by the Lua library with the redis.call bridge in script.cpp.
+void register_script_commands();
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "store.hpp"
+#include "util.hpp"
+
+// Settings taken from the command line, e.g. --port 6380 --replicaof "localhost 6379"
+struct ServerConfig {
+    int port = 6379;
+    std::string dir = ".";
+    std::string dbfilename = "dump.rdb";
+    std::string master_host;
+    int master_port = 0;
+    size_t repl_backlog_size = 1024 * 1024;
+    bool repl_diskless_sync = false;   // stream full syncs straight to replica sockets
+    int repl_diskless_sync_delay = 5;  // seconds to wait for more replicas to share a snapshot
+    bool replica_read_only = true;     // reject client writes while following a master
+    bool cluster_enabled = false;
+    std::string cluster_config_file = "nodes.conf";  // static cluster topology
+    std::string cluster_node_id;       // which node in the topology we are
+    int list_max_listpack_size = -2;   // entries per list node, or -1..-5 for 4..64 KB
+    int list_compress_depth = 0;       // list nodes kept uncompressed at each end, 0 = off
+    size_t hash_max_listpack_entries = 128;  // past these a hash becomes a hash table
+    size_t hash_max_listpack_value = 64;
+    size_t set_max_intset_entries = 512;     // past this an integer set becomes a hash set
+    size_t zset_max_listpack_entries = 128;  // past these a sorted set becomes a skiplist
+    size_t zset_max_listpack_value = 64;
+    bool zset_use_btree = false;             // large sorted sets use a B+tree rather than a skiplist
+    size_t stream_node_max_bytes = 4096;     // a stream block is closed past these, 0 = no limit
+    size_t stream_node_max_entries = 100;
+    size_t hll_sparse_max_bytes = 3000;      // a sparse HyperLogLog turns dense past this
+    int lua_time_limit = 5000;               // ms before a script counts as busy for SCRIPT KILL, 0 = never
+};
+
+extern ServerConfig server_config;
+
+struct ReplicaLink;
+struct Subscriber;
+struct BlockedClient;
+
+// A key under WATCH: its version counter then, and whether it held a live
+// value, so that expiring in the meantime counts as a change
+struct WatchedKey {
+    std::string key;
+    uint64_t version;
+    bool live;
+};
+
+// Per-connection state threaded through command handlers
+struct ClientContext {
+    int fd = -1;
+    bool is_master = false;    // link to our master: apply writes, reply only when forced
+    bool is_replica = false;   // replica connection after PSYNC
+    bool force_reply = false;  // set by a handler to answer the master anyway
+    int listening_port = 0;    // announced by a replica via REPLCONF
+    bool capa_eof = false;     // replica accepts EOF-marked RDB payloads of unknown size
+    bool readonly = false;     // READONLY: fine with possibly stale reads from a replica
+    bool asking = false;       // ASKING: next command may touch a slot we are importing
+    uint64_t woff = 0;         // replication offset after this client's last write, for WAIT
+    std::vector<std::string> expired_keys;  // found expired under a read lock, deleted afterwards
+    std::vector<std::string> hll_stale_keys;  // counted by PFCOUNT under a read lock, cached afterwards
+    // Set by a write handler whose effect depends on more than its arguments
+    // (XADD with an automatic ID): these go to replicas instead of the command
+    std::optional<std::vector<std::vector<std::string>>> propagate_as;
+    std::shared_ptr<ReplicaLink> replica_link;
+    bool in_multi = false;           // between MULTI and EXEC or DISCARD
+    bool multi_error = false;        // a command was rejected while queueing, EXEC aborts
+    bool multi_has_writes = false;   // some queued command is a write
+    std::vector<std::vector<std::string>> multi_queue;
+    std::vector<WatchedKey> watched;
+    bool in_exec = false;            // running EXEC's queue, whose writes replicas get wrapped already
+    std::shared_ptr<Subscriber> subscriber;  // once the client has subscribed to something
+    bool may_block = false;                  // running a CMD_BLOCKING command outside MULTI and scripts
+    std::shared_ptr<BlockedClient> blocked;  // once a blocking command has had to wait
+};
+
+enum CommandFlags : unsigned {
+    CMD_WRITE = 1 << 0,     // modifies the keyspace, propagated to replicas
+    CMD_READONLY = 1 << 1,  // reads the keyspace
+    CMD_ASKING = 1 << 2,    // implies ASKING, for commands sent by a migrating node
+    CMD_NO_QUEUE = 1 << 3,  // runs at once between MULTI and EXEC rather than being queued
+    CMD_NO_MULTI = 1 << 4,  // refused inside MULTI, e.g. because it takes kv_mutex itself
+    CMD_NO_SCRIPT = 1 << 5, // refused from scripts
+    CMD_PUBSUB = 1 << 6,    // allowed while the client is subscribed to channels
+    CMD_SHARD_CHANNEL = 1 << 7,  // its keys are shard channels, routed by slot like keys
+    CMD_BLOCKING = 1 << 8,  // may wait for another client to write one of its keys
+    CMD_MAY_WRITE = 1 << 9, // locks like a write, but only the commands it runs count as writes, e.g. EVAL
+};
+
+using CommandHandler = std::string (*)(const std::vector<std::string>& parts, ClientContext& client);
+
+// Key positions of commands whose keys depend on the arguments, e.g. numkeys
+using KeysFunction = std::vector<size_t> (*)(const std::vector<std::string>& parts);
+
+struct Command {
+    std::string name;
+    int arity;  // exact argument count including the name, or -N for at least N
+    unsigned flags;
+    CommandHandler handler;
+    int first_key = 0;  // position of the first key argument, 0 if there are none
+    int last_key = 0;   // position of the last key, negative counts from the end
+    int key_step = 0;
+    KeysFunction get_keys = nullptr;  // overrides first/last/step when set
+};
+
+// Positions of the key arguments of a command, used for cluster routing
+std::vector<size_t> command_key_positions(const Command& command, const std::vector<std::string>& parts);
+
+// Commands are registered by each module at startup. Handlers for keyspace
+// commands run with kv_mutex already held by the dispatcher: shared for
+// CMD_READONLY, exclusive for CMD_WRITE and CMD_MAY_WRITE. Read handlers must not modify
+// kv_store; expired keys go to client.expired_keys instead.
+void register_command(const Command& command);
+
+// The spec of the command in parts[0], checking its arity; nullptr with the
+// error reply in error if there is no such command
+const Command* lookup_command(const std::vector<std::string>& parts, std::string& error);
+
+std::string handle_command(const std::vector<std::string>& parts, ClientContext& client);
+
+// Same as handle_command for a caller that already holds kv_mutex
+std::string handle_command_locked(const std::vector<std::string>& parts, ClientContext& client);
+
+// Live value of a key for a read handler, nullptr if there is none. Expired
+// keys are queued on the client and deleted once the read lock is released.
+ValueWithExpiry* lookup_key_read(const std::string& key, ClientContext& client);
+
+// Same for write handlers under the exclusive lock; expired keys are
+// dropped on the spot so the handler can create the key afresh.
+ValueWithExpiry* lookup_key_write(const std::string& key);
+
+// Arguments shared by SCAN, HSCAN, SSCAN and ZSCAN
+struct ScanArgs {
+    uint64_t cursor = 0;
+    size_t count = 10;                 // entries to visit per call, roughly
+    std::optional<GlobPattern> match;
+    std::optional<std::string> type;   // SCAN only
+    bool novalues = false;             // HSCAN only
+};
+
+// Parse "cursor [MATCH pattern] [COUNT count]" from parts[first] on, plus
+// TYPE for SCAN and NOVALUES for HSCAN. Empty on success, else the error.
+std::string parse_scan_args(const std::vector<std::string>& parts, size_t first, ScanArgs& args);
+
+// Take Dict::scan steps from args.cursor until about args.count entries
+// were visited, calling step(cursor, visit) for each. Like Redis it also
+// stops after ten times count buckets, so one call does bounded work even
+// on a sparse table. Returns the cursor to continue from, 0 when done.
+template <typename Step, typename F>
+uint64_t scan_bounded(const ScanArgs& args, Step&& step, F&& visit) {
+    uint64_t cursor = args.cursor;
+    size_t visited = 0;
+    size_t buckets = args.count > SIZE_MAX / 10 ? SIZE_MAX : args.count * 10;
+    do {
+        cursor = step(cursor, [&](const auto&... entry) {
+            visited++;
+            visit(entry...);
+        });
+    } while (cursor != 0 && visited < args.count && --buckets > 0);
+    return cursor;
+}
+
+// Reply of a scan: the next cursor, then count items already encoded
+std::string scan_reply(uint64_t cursor, size_t count, const std::string& items);
+
+inline constexpr const char* WRONGTYPE_ERROR =
+    "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n";
+
+void register_replication_commands();
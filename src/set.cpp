@@ -0,0 +1,292 @@
+#include "set.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+SetObject::SetObject(size_t max_intset_entries) : max_intset_entries_(max_intset_entries) {}
+
+void SetObject::convert() {
+    auto table = std::make_unique<Dict<std::monostate>>();
+    table->reserve(ints_.size());
+    for (size_t i = 0; i < ints_.size(); i++) {
+        table->try_emplace(std::to_string(ints_.get(i)));
+    }
+    table_ = std::move(table);
+    ints_ = IntSet();
+}
+
+bool SetObject::contains(const std::string& member) const {
+    if (table_) return table_->count(member) > 0;
+
+    int64_t value;
+    return string_to_int64(member, value) && ints_.contains(value);
+}
+
+bool SetObject::add(const std::string& member) {
+    if (!table_) {
+        int64_t value;
+        if (string_to_int64(member, value)) {
+            if (ints_.contains(value)) return false;
+            if (ints_.size() < max_intset_entries_) return ints_.add(value);
+        }
+        convert();
+    }
+    return table_->try_emplace(member).second;
+}
+
+bool SetObject::remove(const std::string& member) {
+    if (table_) {
+        if (!table_->erase(member)) return false;
+        table_->shrink();
+        return true;
+    }
+
+    int64_t value;
+    return string_to_int64(member, value) && ints_.remove(value);
+}
+
+void SetObject::assign(IntSet ints) {
+    ints_ = std::move(ints);
+    if (ints_.size() > max_intset_entries_) convert();
+}
+
+size_t SetObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + string_heap_bytes(ints_.data());
+    if (table_) {
+        bytes += sizeof(*table_) + table_->bucket_count() * sizeof(void*);
+        for (const auto& [member, unused] : *table_) {
+            // Node: next pointer, cached hash, the string
+            bytes += sizeof(void*) + sizeof(size_t) + sizeof(std::string) + string_heap_bytes(member);
+        }
+    }
+    return bytes;
+}
+
+std::unique_ptr<SetObject> make_set() {
+    return std::make_unique<SetObject>(server_config.set_max_intset_entries);
+}
+
+// Sets stored at keys for a read. Missing keys come back as nullptr; a key
+// of another type fails the whole lookup with WRONGTYPE.
+static bool sets_for_read(const std::vector<std::string>& parts, size_t first, size_t last, ClientContext& client,
+                          std::vector<const SetObject*>& sets) {
+    for (size_t i = first; i <= last; i++) {
+        ValueWithExpiry* value = lookup_key_read(parts[i], client);
+        if (value && value->type != ValueType::Set) return false;
+        sets.push_back(value ? &value->as<SetObject>() : nullptr);
+    }
+    return true;
+}
+
+static std::string members_reply(const std::vector<std::string>& members) {
+    std::string reply = resp_array_header(members.size());
+    for (const auto& member : members) reply += resp_bulk(member);
+    return reply;
+}
+
+// SADD key member [member ...]
+static std::string cmd_sadd(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (value && value->type != ValueType::Set) return WRONGTYPE_ERROR;
+    if (!value) {
+        value = &(kv_store[parts[1]] = ValueWithExpiry(ValueType::Set, make_set()));
+    }
+
+    SetObject& set = value->as<SetObject>();
+    int64_t added = 0;
+    for (size_t i = 2; i < parts.size(); i++) {
+        added += set.add(parts[i]);
+    }
+    return resp_integer(added);
+}
+
+// SREM key member [member ...]
+static std::string cmd_srem(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value) return resp_integer(0);
+    if (value->type != ValueType::Set) return WRONGTYPE_ERROR;
+
+    SetObject& set = value->as<SetObject>();
+    int64_t removed = 0;
+    for (size_t i = 2; i < parts.size(); i++) {
+        removed += set.remove(parts[i]);
+    }
+    if (set.size() == 0) kv_store.erase(parts[1]);
+    return resp_integer(removed);
+}
+
+static std::string cmd_sismember(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, 1, client, sets)) return WRONGTYPE_ERROR;
+    return resp_integer(sets[0] && sets[0]->contains(parts[2]));
+}
+
+static std::string cmd_scard(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, 1, client, sets)) return WRONGTYPE_ERROR;
+    return resp_integer(sets[0] ? sets[0]->size() : 0);
+}
+
+static std::string cmd_smembers(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, 1, client, sets)) return WRONGTYPE_ERROR;
+    if (!sets[0]) return resp_array_header(0);
+
+    std::string reply = resp_array_header(sets[0]->size());
+    sets[0]->for_each([&](const ListPackEntry& member) { reply += resp_bulk(member); });
+    return reply;
+}
+
+// Members common to all sets, up to limit (0 for all). All-intset inputs
+// go through the sorted SIMD intersection; otherwise the smallest set is
+// walked and probed against the others.
+static std::vector<std::string> intersect_sets(std::vector<const SetObject*> sets, size_t limit, bool count_only,
+                                               size_t& count) {
+    count = 0;
+    for (const SetObject* set : sets) {
+        if (!set) return {};
+    }
+
+    bool all_intsets = std::all_of(sets.begin(), sets.end(), [](const SetObject* set) { return set->is_intset(); });
+    std::vector<std::string> members;
+    if (all_intsets) {
+        std::vector<const IntSet*> ints;
+        for (const SetObject* set : sets) ints.push_back(&set->intset());
+        for (int64_t member : intset_intersection(ints, limit, count_only, count)) {
+            members.push_back(std::to_string(member));
+        }
+        return members;
+    }
+
+    std::sort(sets.begin(), sets.end(), [](const SetObject* a, const SetObject* b) { return a->size() < b->size(); });
+    std::string member;
+    sets[0]->for_each([&](const ListPackEntry& entry) {
+        if (limit && count >= limit) return;
+        member = entry.to_string();
+        for (size_t i = 1; i < sets.size(); i++) {
+            if (!sets[i]->contains(member)) return;
+        }
+        count++;
+        if (!count_only) members.push_back(member);
+    });
+    return members;
+}
+
+// SINTER key [key ...]
+static std::string cmd_sinter(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, parts.size() - 1, client, sets)) return WRONGTYPE_ERROR;
+
+    size_t count;
+    return members_reply(intersect_sets(sets, 0, false, count));
+}
+
+// SINTERCARD numkeys key [key ...] [LIMIT limit]
+static std::string cmd_sintercard(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t numkeys;
+    if (!string_to_int64(parts[1], numkeys) || numkeys <= 0) {
+        return "-ERR numkeys should be greater than 0\r\n";
+    }
+    if (static_cast<size_t>(numkeys) > parts.size() - 2) {
+        return "-ERR Number of keys can't be greater than number of args\r\n";
+    }
+
+    int64_t limit = 0;
+    size_t next = 2 + numkeys;
+    if (next < parts.size()) {
+        if (to_upper(parts[next]) != "LIMIT" || next + 2 != parts.size()) return "-ERR syntax error\r\n";
+        if (!string_to_int64(parts[next + 1], limit) || limit < 0) return "-ERR LIMIT can't be negative\r\n";
+    }
+
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 2, 1 + numkeys, client, sets)) return WRONGTYPE_ERROR;
+
+    size_t count;
+    intersect_sets(sets, limit, true, count);
+    return resp_integer(count);
+}
+
+static std::vector<size_t> sintercard_keys(const std::vector<std::string>& parts) {
+    std::vector<size_t> positions;
+    int64_t numkeys;
+    if (!string_to_int64(parts[1], numkeys)) return positions;
+    for (int64_t i = 0; i < numkeys && static_cast<size_t>(2 + i) < parts.size(); i++) {
+        positions.push_back(2 + i);
+    }
+    return positions;
+}
+
+// SUNION key [key ...]
+static std::string cmd_sunion(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, parts.size() - 1, client, sets)) return WRONGTYPE_ERROR;
+
+    std::unordered_set<std::string> members;
+    for (const SetObject* set : sets) {
+        if (!set) continue;
+        set->for_each([&](const ListPackEntry& member) { members.insert(member.to_string()); });
+    }
+    return members_reply(std::vector<std::string>(members.begin(), members.end()));
+}
+
+// SDIFF key [key ...]: members of the first set in none of the others
+static std::string cmd_sdiff(const std::vector<std::string>& parts, ClientContext& client) {
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, parts.size() - 1, client, sets)) return WRONGTYPE_ERROR;
+    if (!sets[0]) return resp_array_header(0);
+
+    std::vector<std::string> members;
+    std::string member;
+    sets[0]->for_each([&](const ListPackEntry& entry) {
+        member = entry.to_string();
+        for (size_t i = 1; i < sets.size(); i++) {
+            if (sets[i] && sets[i]->contains(member)) return;
+        }
+        members.push_back(member);
+    });
+    return members_reply(members);
+}
+
+// SSCAN key cursor [MATCH pattern] [COUNT count]
+static std::string cmd_sscan(const std::vector<std::string>& parts, ClientContext& client) {
+    ScanArgs args;
+    std::string error = parse_scan_args(parts, 2, args);
+    if (!error.empty()) return error;
+    std::vector<const SetObject*> sets;
+    if (!sets_for_read(parts, 1, 1, client, sets)) return WRONGTYPE_ERROR;
+    const SetObject* set = sets[0];
+    if (!set) return scan_reply(0, 0, "");
+
+    std::string items, scratch;
+    size_t count = 0;
+    auto visit = [&](const ListPackEntry& member) {
+        if (args.match && !args.match->matches(member.text(scratch))) return;
+        resp_append_bulk(items, member);
+        count++;
+    };
+
+    // An intset is small enough to return whole
+    if (set->is_intset()) {
+        set->for_each(visit);
+        return scan_reply(0, count, items);
+    }
+    uint64_t cursor = scan_bounded(args, [&](uint64_t at, const auto& step) { return set->scan(at, step); }, visit);
+    return scan_reply(cursor, count, items);
+}
+
+void register_set_commands() {
+    register_command({"SADD", -3, CMD_WRITE, cmd_sadd, 1, 1, 1});
+    register_command({"SREM", -3, CMD_WRITE, cmd_srem, 1, 1, 1});
+    register_command({"SISMEMBER", 3, CMD_READONLY, cmd_sismember, 1, 1, 1});
+    register_command({"SCARD", 2, CMD_READONLY, cmd_scard, 1, 1, 1});
+    register_command({"SMEMBERS", 2, CMD_READONLY, cmd_smembers, 1, 1, 1});
+    register_command({"SINTER", -2, CMD_READONLY, cmd_sinter, 1, -1, 1});
+    register_command({"SINTERCARD", -3, CMD_READONLY, cmd_sintercard, 0, 0, 0, sintercard_keys});
+    register_command({"SUNION", -2, CMD_READONLY, cmd_sunion, 1, -1, 1});
+    register_command({"SDIFF", -2, CMD_READONLY, cmd_sdiff, 1, -1, 1});
+    register_command({"SSCAN", -3, CMD_READONLY, cmd_sscan, 1, 1, 1});
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+
+#include "dict.hpp"
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "store.hpp"
+
+// A set of integers stays an intset, a sorted array that can be binary
+// searched and intersected with SIMD. The first member that isn't an
+// integer, or growing past max_intset_entries, turns it into a hash set.
+class SetObject : public DataObject {
+public:
+    explicit SetObject(size_t max_intset_entries);
+
+    size_t size() const { return table_ ? table_->size() : ints_.size(); }
+    bool is_intset() const { return !table_; }
+    const IntSet& intset() const { return ints_; }
+
+    bool contains(const std::string& member) const;
+    // False if member was already there
+    bool add(const std::string& member);
+    bool remove(const std::string& member);
+
+    // Call visit with each member as a listpack entry
+    template <typename F>
+    void for_each(F&& visit) const;
+    // One step of a cursor scan over the hash set encoding, visiting
+    // members like for_each; see Dict::scan
+    template <typename F>
+    uint64_t scan(uint64_t cursor, F&& visit) const;
+
+    // Adopt an intset loaded from RDB, converting it if it is over the limit
+    void assign(IntSet ints);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return table_ ? "hashtable" : "intset"; }
+
+private:
+    void convert();
+
+    IntSet ints_;
+    std::unique_ptr<Dict<std::monostate>> table_;  // members as keys
+    size_t max_intset_entries_;
+};
+
+template <typename F>
+void SetObject::for_each(F&& visit) const {
+    ListPackEntry entry;
+    if (!table_) {
+        entry.is_int = true;
+        for (size_t i = 0; i < ints_.size(); i++) {
+            entry.integer = ints_.get(i);
+            visit(entry);
+        }
+        return;
+    }
+    for (const auto& [member, unused] : *table_) {
+        entry.str = member;
+        visit(entry);
+    }
+}
+
+template <typename F>
+uint64_t SetObject::scan(uint64_t cursor, F&& visit) const {
+    ListPackEntry entry;
+    return table_->scan(cursor, [&](const auto& member) {
+        entry.str = member.first;
+        visit(entry);
+    });
+}
+
+// Empty set with the configured intset limit
+std::unique_ptr<SetObject> make_set();
+
+void register_set_commands();
@@ -0,0 +1,74 @@
+#include "sha1.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+// FIPS 180-4: 512-bit blocks, 80 rounds over a 16-word rolling schedule
+static void sha1_block(uint32_t state[5], const unsigned char* block) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = uint32_t(block[4 * i]) << 24 | uint32_t(block[4 * i + 1]) << 16 |
+               uint32_t(block[4 * i + 2]) << 8 | uint32_t(block[4 * i + 3]);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        if (i >= 16) {
+            w[i & 15] = std::rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = std::rotl(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+std::string sha1_hex(std::string_view data) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) {
+        sha1_block(state, reinterpret_cast<const unsigned char*>(data.data()) + i);
+    }
+
+    // The tail, a 1 bit, zeros, and the length in bits, in one or two blocks
+    unsigned char tail[128] = {};
+    size_t rest = data.size() - full;
+    std::memcpy(tail, data.data() + full, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = uint64_t(data.size()) * 8;
+    for (int i = 0; i < 8; i++) tail[tail_len - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+    for (size_t i = 0; i < tail_len; i += 64) sha1_block(state, tail + i);
+
+    static const char hex[] = "0123456789abcdef";
+    std::string digest(40, '0');
+    for (int i = 0; i < 20; i++) {
+        unsigned char byte = static_cast<unsigned char>(state[i / 4] >> (24 - 8 * (i % 4)));
+        digest[2 * i] = hex[byte >> 4];
+        digest[2 * i + 1] = hex[byte & 15];
+    }
+    return digest;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// SHA-1 of data as 40 lowercase hex digits, the name scripts are cached
+// under for EVALSHA
+std::string sha1_hex(std::string_view data);
@@ -0,0 +1,174 @@
+#include "skiplist.hpp"
+
+#include <new>
+#include <random>
+
+// Element order: by score, then by member bytes
+static bool node_less(const SkipList::Node& node, double score, std::string_view member) {
+    return node.score < score || (node.score == score && std::string_view(*node.member) < member);
+}
+
+SkipList::SkipList() : header_(make_node(MAX_HEIGHT, 0, nullptr)) {
+    for (int i = 0; i < MAX_HEIGHT; i++) header_->level()[i] = {nullptr, 0};
+}
+
+SkipList::~SkipList() {
+    Node* node = header_;
+    while (node) {
+        Node* next = node->next();
+        free_node(node);
+        node = next;
+    }
+}
+
+SkipList::Node* SkipList::make_node(int height, double score, const std::string* member) {
+    void* memory = ::operator new(sizeof(Node) + height * sizeof(Level));
+    return new (memory) Node{member, score, nullptr, height};
+}
+
+void SkipList::free_node(Node* node) {
+    node->~Node();
+    ::operator delete(node);
+}
+
+int SkipList::random_height() {
+    // Each pair of zero bits is one more level, p = 1/4 per level
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    int height = 1 + __builtin_ctzll(rng() | (1ULL << 62)) / 2;
+    return height < MAX_HEIGHT ? height : MAX_HEIGHT;
+}
+
+void SkipList::link(Node* node) {
+    Node* update[MAX_HEIGHT];
+    size_t rank[MAX_HEIGHT];
+
+    Node* x = header_;
+    for (int i = height_ - 1; i >= 0; i--) {
+        rank[i] = i == height_ - 1 ? 0 : rank[i + 1];
+        while (x->level()[i].forward && node_less(*x->level()[i].forward, node->score, *node->member)) {
+            rank[i] += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+        update[i] = x;
+    }
+
+    if (node->height > height_) {
+        for (int i = height_; i < node->height; i++) {
+            rank[i] = 0;
+            update[i] = header_;
+            update[i]->level()[i].span = length_;
+        }
+        height_ = node->height;
+    }
+
+    for (int i = 0; i < node->height; i++) {
+        node->level()[i].forward = update[i]->level()[i].forward;
+        update[i]->level()[i].forward = node;
+        // The new node splits the span of the link it was put behind
+        node->level()[i].span = update[i]->level()[i].span - (rank[0] - rank[i]);
+        update[i]->level()[i].span = rank[0] - rank[i] + 1;
+    }
+    // Links above the node now skip one more element
+    for (int i = node->height; i < height_; i++) {
+        update[i]->level()[i].span++;
+    }
+
+    node->backward = update[0] == header_ ? nullptr : update[0];
+    if (node->next()) {
+        node->next()->backward = node;
+    } else {
+        tail_ = node;
+    }
+    length_++;
+}
+
+void SkipList::unlink(Node* node, Node** update) {
+    for (int i = 0; i < height_; i++) {
+        if (update[i]->level()[i].forward == node) {
+            update[i]->level()[i].span += node->level()[i].span - 1;
+            update[i]->level()[i].forward = node->level()[i].forward;
+        } else {
+            update[i]->level()[i].span--;
+        }
+    }
+    if (node->next()) {
+        node->next()->backward = node->backward;
+    } else {
+        tail_ = node->backward;
+    }
+    while (height_ > 1 && !header_->level()[height_ - 1].forward) height_--;
+    length_--;
+}
+
+SkipList::Node* SkipList::find_path(double score, std::string_view member, Node** update) const {
+    Node* x = header_;
+    for (int i = height_ - 1; i >= 0; i--) {
+        while (x->level()[i].forward && node_less(*x->level()[i].forward, score, member)) {
+            x = x->level()[i].forward;
+        }
+        update[i] = x;
+    }
+    x = x->next();
+    if (!x || x->score != score || *x->member != member) return nullptr;
+    return x;
+}
+
+void SkipList::insert(double score, const std::string* member) {
+    Node* node = make_node(random_height(), score, member);
+    levels_ += node->height;
+    link(node);
+}
+
+bool SkipList::erase(double score, std::string_view member) {
+    Node* update[MAX_HEIGHT];
+    Node* node = find_path(score, member, update);
+    if (!node) return false;
+    unlink(node, update);
+    levels_ -= node->height;
+    free_node(node);
+    return true;
+}
+
+void SkipList::update_score(double current, std::string_view member, double score) {
+    Node* update[MAX_HEIGHT];
+    Node* node = find_path(current, member, update);
+    if (!node) return;
+
+    // Still between its neighbours: only the score changes
+    Node* prev = node->prev();
+    Node* next = node->next();
+    if ((!prev || node_less(*prev, score, member)) && (!next || !node_less(*next, score, member))) {
+        node->score = score;
+        return;
+    }
+    unlink(node, update);
+    node->score = score;
+    link(node);
+}
+
+size_t SkipList::rank(double score, std::string_view member) const {
+    return count_before([&](double other_score, std::string_view other) {
+        return other_score < score || (other_score == score && other < member);
+    });
+}
+
+SkipList::Node* SkipList::at_rank(size_t rank) const {
+    if (rank >= length_) return nullptr;
+
+    // Spans count from the header, so the element at rank r is r + 1 away
+    size_t traversed = 0;
+    Node* x = header_;
+    for (int i = height_ - 1; i >= 0; i--) {
+        while (x->level()[i].forward && traversed + x->level()[i].span <= rank + 1) {
+            traversed += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+        if (traversed == rank + 1) return x;
+    }
+    return nullptr;
+}
+
+size_t SkipList::memory_usage() const {
+    return sizeof(*this) + sizeof(Node) + MAX_HEIGHT * sizeof(Level) + length_ * sizeof(Node) +
+        levels_ * sizeof(Level);
+}
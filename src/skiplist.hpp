@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Members ordered by (score, member), where every forward link records how
+// many elements it skips. Summing spans on the way down gives the rank of
+// any element, and walking down by span finds the element at a rank, both
+// in O(log n). Node heights are drawn with p = 1/4 as in Redis.
+//
+// Members are owned by the sorted set's member -> score map; nodes point
+// at its keys.
+class SkipList {
+public:
+    static constexpr int MAX_HEIGHT = 32;
+
+    struct Node;
+    struct Level {
+        Node* forward;
+        size_t span;
+    };
+    // Allocated with its levels right behind it
+    struct Node {
+        const std::string* member;
+        double score;
+        Node* backward;
+        int height;
+
+        Level* level() { return reinterpret_cast<Level*>(this + 1); }
+        const Level* level() const { return reinterpret_cast<const Level*>(this + 1); }
+        Node* next() const { return level()[0].forward; }
+        Node* prev() const { return backward; }
+    };
+
+    SkipList();
+    ~SkipList();
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    size_t size() const { return length_; }
+    Node* first() const { return header_->level()[0].forward; }
+    Node* last() const { return tail_; }
+
+    // Insert a member that is not in the list yet
+    void insert(double score, const std::string* member);
+    bool erase(double score, std::string_view member);
+    // Move a member to a new score, in place when its neighbours allow it
+    void update_score(double current, std::string_view member, double score);
+
+    // 0-based rank of a member known to be in the list
+    size_t rank(double score, std::string_view member) const;
+    // Node at a 0-based rank, nullptr past the end
+    Node* at_rank(size_t rank) const;
+
+    // Number of elements for which before(score, member) holds. before must
+    // be true for a prefix of the list and false after it, e.g. score < bound.
+    template <typename F>
+    size_t count_before(F&& before) const;
+
+    size_t memory_usage() const;
+
+private:
+    static Node* make_node(int height, double score, const std::string* member);
+    static void free_node(Node* node);
+    static int random_height();
+
+    void link(Node* node);
+    void unlink(Node* node, Node** update);
+    // Last node before (score, member) on every level
+    Node* find_path(double score, std::string_view member, Node** update) const;
+
+    Node* header_;
+    Node* tail_ = nullptr;
+    int height_ = 1;
+    size_t length_ = 0;
+    size_t levels_ = 0;  // across all nodes, for memory_usage
+};
+
+template <typename F>
+size_t SkipList::count_before(F&& before) const {
+    size_t rank = 0;
+    const Node* x = header_;
+    for (int i = height_ - 1; i >= 0; i--) {
+        while (x->level()[i].forward && before(x->level()[i].forward->score, *x->level()[i].forward->member)) {
+            rank += x->level()[i].span;
+            x = x->level()[i].forward;
+        }
+    }
+    return rank;
+}
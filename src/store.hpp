@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <variant>
+
+#include "dict.hpp"
+
+// Kinds of values in the keyspace, as reported by TYPE
+enum class ValueType : unsigned char {
+    String,
+    List,
+    Hash,
+    Set,
+    ZSet,
+    Stream,
+    Bloom,
+    Cuckoo,
+};
+
+const char* value_type_name(ValueType type);
+
+// Base for values other than plain strings. Each type module derives its
+// own and stores it in ValueWithExpiry::object.
+struct DataObject {
+    virtual ~DataObject() = default;
+
+    // Bytes owned by the object, for MEMORY USAGE
+    virtual size_t memory_usage() const = 0;
+
+    // Internal representation, for OBJECT ENCODING
+    virtual const char* encoding() const = 0;
+};
+
+// Heap bytes behind a std::string, nothing while it fits the inline buffer
+inline size_t string_heap_bytes(const std::string& str) {
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+// Structure to hold value and expiry time
+struct ValueWithExpiry {
+    ValueType type = ValueType::String;
+    std::string value;                   // payload of strings
+    std::unique_ptr<DataObject> object;  // payload of every other type
+    std::chrono::time_point<std::chrono::steady_clock> expiry;
+    bool has_expiry = false;
+    // A string used as a counter is held as the number itself, so INCR
+    // neither parses nor formats it; value is left empty meanwhile
+    bool is_integer = false;
+    int64_t integer = 0;
+
+    ValueWithExpiry() = default;
+
+    ValueWithExpiry(std::string val) :
+        value(std::move(val)), has_expiry(false) {}
+
+    ValueWithExpiry(ValueType type, std::unique_ptr<DataObject> obj) :
+        type(type), object(std::move(obj)), has_expiry(false) {}
+
+    void set_integer(int64_t number) {
+        std::string().swap(value);
+        is_integer = true;
+        integer = number;
+    }
+
+    // Bytes of a string for a writer about to edit them, giving up the
+    // integer encoding
+    std::string& string_for_write() {
+        if (is_integer) {
+            value = std::to_string(integer);
+            is_integer = false;
+        }
+        return value;
+    }
+
+    // Bytes of a string for a reader, which must leave the value alone:
+    // integers are formatted into scratch
+    const std::string& string_for_read(std::string& scratch) const {
+        if (!is_integer) return value;
+        scratch = std::to_string(integer);
+        return scratch;
+    }
+
+    template <typename T>
+    T& as() { return static_cast<T&>(*object); }
+    template <typename T>
+    const T& as() const { return static_cast<const T&>(*object); }
+
+    bool is_expired() const {
+        if (!has_expiry) return false;
+        return std::chrono::steady_clock::now() > expiry;
+    }
+};
+
+using Keyspace = Dict<ValueWithExpiry>;
+
+// Global key-value store. Readers share kv_mutex, writers take it exclusively.
+extern Keyspace kv_store;
+extern std::shared_mutex kv_mutex;
+
+// Names of the keys that have an expiry, so active expiry walks these
+// rather than the whole keyspace. The time itself stays in the value,
+// where every lookup already is. Each key with an expiry is listed; a name
+// can linger after its key was deleted or overwritten without one, until
+// active expiry next reaches it and drops it.
+extern Dict<std::monostate> kv_expires;
+
+// Give a key's value an expiry, listing the key in kv_expires
+inline void set_expiry(const std::string& key, ValueWithExpiry& value,
+                       std::chrono::steady_clock::time_point at) {
+    if (!value.has_expiry) kv_expires.try_emplace(key);
+    value.expiry = at;
+    value.has_expiry = true;
+}
+
+inline void remove_expiry(const std::string& key, ValueWithExpiry& value) {
+    if (value.has_expiry) kv_expires.erase(key);
+    value.has_expiry = false;
+}
+
+// Expiry times are kept on the steady clock, so TTLs don't move when the
+// wall clock is set; RDB files and the wire use unix milliseconds. Both
+// directions go through one pair of clock readings taken at startup, so a
+// time converted to the steady clock and back comes out unchanged.
+struct ClockAnchor {
+    std::chrono::steady_clock::time_point steady;
+    int64_t unix_ms;
+};
+
+inline const ClockAnchor& clock_anchor() {
+    static const ClockAnchor anchor{
+        std::chrono::steady_clock::now(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()};
+    return anchor;
+}
+
+inline int64_t steady_to_unix_ms(std::chrono::steady_clock::time_point at) {
+    const ClockAnchor& anchor = clock_anchor();
+    return anchor.unix_ms + std::chrono::floor<std::chrono::milliseconds>(at - anchor.steady).count();
+}
+
+inline std::chrono::steady_clock::time_point unix_ms_to_steady(int64_t unix_ms) {
+    // Clamped to some 35000 years either way, well inside what the steady
+    // clock's nanoseconds can hold
+    constexpr int64_t limit = int64_t(1) << 50;
+    const ClockAnchor& anchor = clock_anchor();
+    int64_t delta = std::clamp(unix_ms, anchor.unix_ms - limit, anchor.unix_ms + limit) - anchor.unix_ms;
+    return anchor.steady + std::chrono::milliseconds(delta);
+}
+
+inline int64_t unix_now_ms() {
+    return steady_to_unix_ms(std::chrono::steady_clock::now());
+}
@@ -0,0 +1,1292 @@
+#include "stream.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+
+#include "blocking.hpp"
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+void StreamID::encode(char* out) const {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<char>(ms >> (56 - 8 * i));
+        out[8 + i] = static_cast<char>(seq >> (56 - 8 * i));
+    }
+}
+
+StreamID StreamID::decode(const char* in) {
+    StreamID id;
+    for (int i = 0; i < 8; i++) {
+        id.ms = (id.ms << 8) | static_cast<unsigned char>(in[i]);
+        id.seq = (id.seq << 8) | static_cast<unsigned char>(in[8 + i]);
+    }
+    return id;
+}
+
+bool StreamID::increment() {
+    if (seq != UINT64_MAX) {
+        seq++;
+        return true;
+    }
+    if (ms == UINT64_MAX) return false;
+    ms++;
+    seq = 0;
+    return true;
+}
+
+bool StreamID::decrement() {
+    if (seq != 0) {
+        seq--;
+        return true;
+    }
+    if (ms == 0) return false;
+    ms--;
+    seq = UINT64_MAX;
+    return true;
+}
+
+// Encoded form of an ID as a radix tree key
+struct StreamKey {
+    char bytes[StreamID::ENCODED_SIZE];
+
+    explicit StreamKey(StreamID id) { id.encode(bytes); }
+    operator std::string_view() const { return std::string_view(bytes, sizeof(bytes)); }
+};
+
+StreamConsumer* StreamGroup::consumer(std::string_view name, bool create, bool* created) {
+    if (created) *created = false;
+    auto it = consumers.find(name);
+    if (it != consumers.end()) return it->second.get();
+    if (!create) return nullptr;
+
+    auto consumer = std::make_unique<StreamConsumer>();
+    consumer->name = name;
+    if (created) *created = true;
+    return consumers.emplace(consumer->name, std::move(consumer)).first->second.get();
+}
+
+size_t StreamGroup::delete_consumer(std::string_view name) {
+    auto it = consumers.find(name);
+    if (it == consumers.end()) return 0;
+    StreamConsumer& consumer = *it->second;
+    size_t count = consumer.pending.size();
+    for (auto entry = consumer.pending.begin(); entry.valid(); entry.next()) pending.erase(entry.key());
+    consumers.erase(it);
+    return count;
+}
+
+StreamNack* StreamGroup::assign(StreamID id, StreamConsumer* to, int64_t now) {
+    StreamKey key(id);
+    std::unique_ptr<StreamNack>& nack = pending[key];
+    if (!nack) {
+        nack = std::make_unique<StreamNack>();
+    } else if (nack->consumer != to) {
+        nack->consumer->pending.erase(key);
+    }
+    nack->consumer = to;
+    nack->delivery_time = now;
+    to->pending[key] = nack.get();
+    return nack.get();
+}
+
+bool StreamGroup::ack(StreamID id) {
+    StreamKey key(id);
+    std::unique_ptr<StreamNack>* nack = pending.find(key);
+    if (!nack) return false;
+    (*nack)->consumer->pending.erase(key);
+    pending.erase(key);
+    return true;
+}
+
+StreamObject::StreamObject(size_t max_block_bytes, size_t max_block_entries) :
+    max_block_bytes_(max_block_bytes), max_block_entries_(max_block_entries) {}
+
+// An entry of a block, decoded starting from its flags
+struct BlockEntry {
+    int64_t flags = 0;
+    StreamID id;
+    size_t field_count = 0;
+    size_t fields = 0;  // offset of the first value, or first field/value pair
+};
+
+static void decode_entry(const ListPack& block, StreamID master, size_t master_field_count, size_t pos,
+                         BlockEntry& entry) {
+    entry.flags = block.get(pos).integer;
+    pos = block.next(pos);
+    entry.id.ms = master.ms + static_cast<uint64_t>(block.get(pos).integer);
+    pos = block.next(pos);
+    entry.id.seq = master.seq + static_cast<uint64_t>(block.get(pos).integer);
+    pos = block.next(pos);
+    if (entry.flags & StreamObject::ENTRY_SAMEFIELDS) {
+        entry.field_count = master_field_count;
+    } else {
+        entry.field_count = block.get(pos).integer;
+        pos = block.next(pos);
+    }
+    entry.fields = pos;
+}
+
+// Offset of the entry after a decoded one, npos at the end of the block
+static size_t skip_entry(const ListPack& block, const BlockEntry& entry) {
+    size_t pos = entry.fields;
+    size_t values = entry.flags & StreamObject::ENTRY_SAMEFIELDS ? entry.field_count : 2 * entry.field_count;
+    for (size_t i = 0; i < values; i++) pos = block.next(pos);
+    return block.next(pos);  // past the lp-count
+}
+
+// Offset of the first entry after the master entry
+static size_t block_first_entry(const ListPack& block, size_t& master_field_count) {
+    size_t pos = block.next(block.next(block.first()));
+    master_field_count = block.get(pos).integer;
+    for (size_t i = 0; i <= master_field_count; i++) pos = block.next(pos);
+    return block.next(pos);  // past the master terminator
+}
+
+// ID of the last entry in a block, live or deleted
+static StreamID block_last_id(const ListPack& block, StreamID master) {
+    size_t pos = block.last();
+    for (int64_t n = block.get(pos).integer; n > 0; n--) pos = block.prev(pos);
+    size_t ms = block.next(pos);
+    StreamID id;
+    id.ms = master.ms + static_cast<uint64_t>(block.get(ms).integer);
+    id.seq = master.seq + static_cast<uint64_t>(block.get(block.next(ms)).integer);
+    return id;
+}
+
+ListPack* StreamObject::tail_block(StreamID& master) {
+    if (!tail_ && !blocks_.empty()) {
+        auto it = blocks_.last();
+        tail_ = &it.value();
+        tail_master_ = StreamID::decode(it.key().data());
+    }
+    master = tail_master_;
+    return tail_;
+}
+
+void StreamObject::append(StreamID id, std::span<const std::string> fields) {
+    size_t field_count = fields.size() / 2;
+    size_t payload = 0;
+    for (const std::string& part : fields) payload += part.size();
+
+    StreamID master;
+    ListPack* block = tail_block(master);
+    if (block) {
+        size_t header = block->first();
+        int64_t live = block->get(header).integer;
+        int64_t deleted = block->get(block->next(header)).integer;
+        // Deleted entries still take up room, count them too
+        if ((max_block_bytes_ && block->bytes() + payload >= max_block_bytes_) ||
+            (max_block_entries_ && static_cast<size_t>(live + deleted) >= max_block_entries_)) {
+            block = nullptr;
+        } else {
+            block->replace(header, std::to_string(live + 1));
+        }
+    }
+    if (!block) {
+        block = &blocks_[StreamKey(id)];
+        block->insert(ListPack::npos, int64_t{1});
+        block->insert(ListPack::npos, int64_t{0});
+        block->insert(ListPack::npos, static_cast<int64_t>(field_count));
+        for (size_t i = 0; i < field_count; i++) block->push_back(fields[2 * i]);
+        block->insert(ListPack::npos, int64_t{0});
+        tail_ = block;
+        tail_master_ = master = id;
+    }
+
+    // Only the values are stored when the fields match the master entry's
+    size_t pos = block->next(block->next(block->first()));
+    bool same_fields = static_cast<size_t>(block->get(pos).integer) == field_count;
+    for (size_t i = 0; same_fields && i < field_count; i++) {
+        pos = block->next(pos);
+        same_fields = block->get(pos).equals(fields[2 * i]);
+    }
+
+    block->insert(ListPack::npos, same_fields ? ENTRY_SAMEFIELDS : int64_t{0});
+    block->insert(ListPack::npos, static_cast<int64_t>(id.ms - master.ms));
+    block->insert(ListPack::npos, static_cast<int64_t>(id.seq - master.seq));
+    if (same_fields) {
+        for (size_t i = 0; i < field_count; i++) block->push_back(fields[2 * i + 1]);
+    } else {
+        block->insert(ListPack::npos, static_cast<int64_t>(field_count));
+        for (const std::string& part : fields) block->push_back(part);
+    }
+    // Elements of the entry before this one, to walk blocks backwards
+    block->insert(ListPack::npos, static_cast<int64_t>(same_fields ? field_count + 3 : 2 * field_count + 4));
+
+    if (length_ == 0) first_id_ = id;
+    length_++;
+    entries_added_++;
+    last_id_ = id;
+}
+
+size_t StreamObject::trim(const Trim& trim) {
+    size_t removed = 0;
+    while (!blocks_.empty()) {
+        if (!trim.by_minid && length_ <= trim.maxlen) break;
+        if (trim.limit && removed >= trim.limit) break;
+
+        auto it = blocks_.begin();
+        ListPack& block = it.value();
+        StreamID master = StreamID::decode(it.key().data());
+        size_t header = block.first();
+        size_t live = block.get(header).integer;
+
+        bool whole = trim.by_minid ? block_last_id(block, master) < trim.minid : length_ - live >= trim.maxlen;
+        if (whole) {
+            if (trim.limit && removed + live > trim.limit) break;
+            length_ -= live;
+            removed += live;
+            if (&block == tail_) tail_ = nullptr;
+            blocks_.erase(it.key());
+            continue;
+        }
+        // Approximate trimming stops short rather than split a block
+        if (trim.approx) break;
+
+        // Flag entries as deleted from the front of the block until the cut.
+        // Flags are small integers, so rewriting one keeps every offset.
+        size_t deleted = block.get(block.next(header)).integer;
+        size_t master_field_count;
+        size_t pos = block_first_entry(block, master_field_count);
+        while (pos != ListPack::npos) {
+            BlockEntry entry;
+            decode_entry(block, master, master_field_count, pos, entry);
+            if (!(entry.flags & ENTRY_DELETED)) {
+                if (trim.by_minid ? entry.id >= trim.minid : length_ <= trim.maxlen) break;
+                block.replace(pos, std::to_string(entry.flags | ENTRY_DELETED));
+                live--;
+                deleted++;
+                length_--;
+                removed++;
+            }
+            pos = skip_entry(block, entry);
+        }
+
+        if (live == 0) {
+            if (&block == tail_) tail_ = nullptr;
+            blocks_.erase(it.key());
+        } else {
+            block.replace(block.next(header), std::to_string(deleted));
+            block.replace(header, std::to_string(live));
+        }
+        break;
+    }
+
+    if (removed) update_first_id();
+    return removed;
+}
+
+void StreamObject::update_first_id() {
+    StreamIterator it(*this, StreamID(), StreamID::max(), false);
+    first_id_ = it.next() ? it.id() : StreamID();
+}
+
+bool StreamObject::contains(StreamID id) const {
+    StreamIterator it(*this, id, id, false);
+    return it.next();
+}
+
+StreamGroup* StreamObject::group(std::string_view name) {
+    auto it = groups_.find(name);
+    return it == groups_.end() ? nullptr : it->second.get();
+}
+
+const StreamGroup* StreamObject::group(std::string_view name) const {
+    auto it = groups_.find(name);
+    return it == groups_.end() ? nullptr : it->second.get();
+}
+
+StreamGroup* StreamObject::create_group(const std::string& name, StreamID last_id, int64_t entries_read) {
+    auto [it, added] = groups_.try_emplace(name);
+    if (!added) return nullptr;
+    it->second = std::make_unique<StreamGroup>();
+    it->second->last_id = last_id;
+    it->second->entries_read = entries_read;
+    return it->second.get();
+}
+
+bool StreamObject::destroy_group(std::string_view name) {
+    auto it = groups_.find(name);
+    if (it == groups_.end()) return false;
+    groups_.erase(it);
+    return true;
+}
+
+bool StreamObject::load_block(std::string_view key, ListPack block) {
+    if (key.size() != StreamID::ENCODED_SIZE || block.empty() || blocks_.find(key)) return false;
+
+    // Check the layout once here so that iteration can trust it
+    size_t pos = block.first();
+    auto integer = [&](int64_t& value) {
+        if (pos == ListPack::npos) return false;
+        ListPackEntry entry = block.get(pos);
+        value = entry.integer;
+        pos = block.next(pos);
+        return entry.is_int;
+    };
+    auto skip = [&](int64_t count) {
+        for (; count > 0; count--) {
+            if (pos == ListPack::npos) return false;
+            pos = block.next(pos);
+        }
+        return true;
+    };
+
+    int64_t live, deleted, master_fields, terminator;
+    if (!integer(live) || !integer(deleted) || !integer(master_fields) || live <= 0 || deleted < 0 ||
+        master_fields < 0 || !skip(master_fields) || !integer(terminator) || terminator != 0) {
+        return false;
+    }
+    int64_t seen_live = 0, seen_deleted = 0;
+    while (pos != ListPack::npos) {
+        int64_t flags, ms, seq, fields, count;
+        if (!integer(flags) || !integer(ms) || !integer(seq)) return false;
+        int64_t elements = 3 + master_fields;
+        if (!(flags & ENTRY_SAMEFIELDS)) {
+            if (!integer(fields) || fields < 0 || !skip(2 * fields)) return false;
+            elements = 2 * fields + 4;
+        } else if (!skip(master_fields)) {
+            return false;
+        }
+        if (!integer(count) || count != elements) return false;
+        (flags & ENTRY_DELETED ? seen_deleted : seen_live)++;
+    }
+    if (seen_live != live || seen_deleted != deleted) return false;
+
+    blocks_[key].swap(block);
+    tail_ = nullptr;
+    return true;
+}
+
+void StreamObject::load_metadata(size_t length, StreamID last_id, StreamID first_id, StreamID max_deleted_id,
+                                 uint64_t entries_added) {
+    length_ = length;
+    last_id_ = last_id;
+    first_id_ = first_id;
+    max_deleted_id_ = max_deleted_id;
+    entries_added_ = entries_added;
+}
+
+size_t StreamObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + blocks_.memory_usage();
+    for (auto it = blocks_.begin(); it.valid(); it.next()) bytes += it.value().data().capacity();
+    for (const auto& [name, group] : groups_) {
+        bytes += sizeof(StreamGroup) + name.size() + group->pending.memory_usage() +
+                 group->pending.size() * sizeof(StreamNack);
+        for (const auto& [consumer_name, consumer] : group->consumers) {
+            bytes += sizeof(StreamConsumer) + consumer_name.size() + consumer->pending.memory_usage();
+        }
+    }
+    return bytes;
+}
+
+StreamIterator::StreamIterator(const StreamObject& stream, StreamID start, StreamID end, bool reverse) :
+    start_(start), end_(end), reverse_(reverse) {
+    if (start > end) {
+        done_ = true;
+        return;
+    }
+    // The block holding the first ID of the walk starts at or before it
+    block_ = stream.blocks_.floor(StreamKey(reverse ? end : start));
+    if (!block_.valid() && !reverse) block_ = stream.blocks_.begin();
+}
+
+bool StreamIterator::load_block() {
+    if (!block_.valid()) return false;
+    lp_ = &block_.value();
+    master_id_ = StreamID::decode(block_.key().data());
+    first_entry_ = block_first_entry(*lp_, master_field_count_);
+    master_fields_ = lp_->next(lp_->next(lp_->next(lp_->first())));
+    pos_ = reverse_ ? lp_->last() : first_entry_;
+    return true;
+}
+
+void StreamIterator::read_entry(size_t flags_pos) {
+    BlockEntry entry;
+    decode_entry(*lp_, master_id_, master_field_count_, flags_pos, entry);
+    id_ = entry.id;
+    flags_ = entry.flags;
+    field_count_ = entry.field_count;
+    fields_ = entry.fields;
+    if (!reverse_) pos_ = skip_entry(*lp_, entry);
+}
+
+bool StreamIterator::next() {
+    while (!done_) {
+        if (!lp_ && !load_block()) break;
+        if (pos_ == ListPack::npos) {
+            lp_ = nullptr;
+            if (reverse_) {
+                block_.prev();
+            } else {
+                block_.next();
+            }
+            continue;
+        }
+
+        size_t flags_pos = pos_;
+        if (reverse_) {
+            // pos_ is the entry's lp-count, the number of elements before it
+            for (int64_t n = lp_->get(pos_).integer; n > 0; n--) flags_pos = lp_->prev(flags_pos);
+            pos_ = flags_pos == first_entry_ ? ListPack::npos : lp_->prev(flags_pos);
+        }
+        read_entry(flags_pos);
+
+        if (flags_ & StreamObject::ENTRY_DELETED) continue;
+        if (reverse_ ? id_ > end_ : id_ < start_) continue;
+        if (reverse_ ? id_ < start_ : id_ > end_) break;
+        return true;
+    }
+    done_ = true;
+    return false;
+}
+
+std::unique_ptr<StreamObject> make_stream() {
+    return std::make_unique<StreamObject>(server_config.stream_node_max_bytes, server_config.stream_node_max_entries);
+}
+
+static constexpr const char* INVALID_ID_ERROR = "-ERR Invalid stream ID specified as stream command argument\r\n";
+static constexpr const char* SYNTAX_ERROR = "-ERR syntax error\r\n";
+static constexpr const char* NOT_INTEGER_ERROR = "-ERR value is not an integer or out of range\r\n";
+
+static int64_t unix_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool parse_u64(std::string_view str, uint64_t& value) {
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return !str.empty() && ec == std::errc() && ptr == str.data() + str.size();
+}
+
+// "ms-seq", or just "ms" with the sequence taken as missing_seq
+static bool parse_stream_id(std::string_view arg, uint64_t missing_seq, StreamID& id) {
+    size_t dash = arg.find('-');
+    if (dash == std::string_view::npos) {
+        id.seq = missing_seq;
+        return parse_u64(arg, id.ms);
+    }
+    return parse_u64(arg.substr(0, dash), id.ms) && parse_u64(arg.substr(dash + 1), id.seq);
+}
+
+// Range endpoint: an ID, "-" or "+" for the ends, "(" in front to exclude it
+static bool parse_range_id(std::string_view arg, bool is_end, StreamID& id, std::string& error) {
+    bool exclusive = arg.size() > 1 && arg[0] == '(';
+    if (exclusive) arg.remove_prefix(1);
+
+    if (arg == "-") {
+        id = StreamID();
+    } else if (arg == "+") {
+        id = StreamID::max();
+    } else if (!parse_stream_id(arg, is_end ? UINT64_MAX : 0, id)) {
+        error = INVALID_ID_ERROR;
+        return false;
+    }
+    if (exclusive && !(is_end ? id.decrement() : id.increment())) {
+        error = is_end ? "-ERR invalid end ID for the interval\r\n" : "-ERR invalid start ID for the interval\r\n";
+        return false;
+    }
+    return true;
+}
+
+// Stream at key for a write, created if missing unless create is false.
+// Sets error on a type mismatch.
+static StreamObject* stream_for_write(const std::string& key, bool create, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (value && value->type != ValueType::Stream) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value) {
+        if (!create) return nullptr;
+        value = &(kv_store[key] = ValueWithExpiry(ValueType::Stream, make_stream()));
+    }
+    return &value->as<StreamObject>();
+}
+
+static const StreamObject* stream_for_read(const std::string& key, ClientContext& client, std::string& error) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::Stream) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->as<StreamObject>();
+}
+
+// Bulk string of an ID, formatted straight into the reply
+static void append_id(std::string& out, StreamID id) {
+    char digits[48];
+    char* end = std::to_chars(digits, digits + 20, id.ms).ptr;
+    end = std::to_chars(std::copy_n("-", 1, end), digits + sizeof(digits), id.seq).ptr;
+    resp_append_bulk(out, std::string_view(digits, end - digits));
+}
+
+// The iterator's current entry as [id, [field, value, ...]]
+static void append_entry(std::string& out, const StreamIterator& it) {
+    out += "*2\r\n";
+    append_id(out, it.id());
+    out += resp_array_header(2 * it.field_count());
+    it.for_each_field([&](const ListPackEntry& field, const ListPackEntry& value) {
+        resp_append_bulk(out, field);
+        resp_append_bulk(out, value);
+    });
+}
+
+// Append up to count entries of a range (0 for all), returns how many
+static size_t append_range(std::string& out, const StreamObject& stream, StreamID start, StreamID end, bool reverse,
+                           size_t count) {
+    StreamIterator it(stream, start, end, reverse);
+    size_t n = 0;
+    while ((count == 0 || n < count) && it.next()) {
+        append_entry(out, it);
+        n++;
+    }
+    return n;
+}
+
+// Trimming and XADD options, as parsed from the arguments
+struct AddTrimArgs {
+    StreamObject::Trim trim;
+    bool trimming = false;  // MAXLEN or MINID was given
+    bool limit_given = false;
+    bool no_mkstream = false;
+};
+
+// [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold [LIMIT count]] from parts[i]
+// on, stopping at the first argument that is none of these. NOMKSTREAM is
+// only taken for XADD.
+static bool parse_add_trim_args(const std::vector<std::string>& parts, size_t& i, bool xadd, AddTrimArgs& args,
+                                std::string& error) {
+    while (i < parts.size()) {
+        std::string option = to_upper(parts[i]);
+        bool more = i + 1 < parts.size();
+        if (xadd && option == "NOMKSTREAM") {
+            args.no_mkstream = true;
+            i++;
+        } else if ((option == "MAXLEN" || option == "MINID") && more) {
+            bool by_minid = option == "MINID";
+            if (args.trimming && args.trim.by_minid != by_minid) {
+                error = "-ERR syntax error, MAXLEN and MINID options at the same time are not compatible\r\n";
+                return false;
+            }
+            args.trimming = true;
+            args.trim.by_minid = by_minid;
+            i++;
+            if ((parts[i] == "~" || parts[i] == "=") && i + 1 < parts.size()) {
+                args.trim.approx = parts[i] == "~";
+                i++;
+            }
+            if (by_minid) {
+                if (!parse_stream_id(parts[i], 0, args.trim.minid)) {
+                    error = INVALID_ID_ERROR;
+                    return false;
+                }
+            } else {
+                int64_t maxlen;
+                if (!string_to_int64(parts[i], maxlen)) {
+                    error = NOT_INTEGER_ERROR;
+                    return false;
+                }
+                if (maxlen < 0) {
+                    error = "-ERR The MAXLEN argument must be >= 0.\r\n";
+                    return false;
+                }
+                args.trim.maxlen = maxlen;
+            }
+            i++;
+        } else if (option == "LIMIT" && more) {
+            int64_t limit;
+            if (!string_to_int64(parts[i + 1], limit)) {
+                error = NOT_INTEGER_ERROR;
+                return false;
+            }
+            if (limit < 0) {
+                error = "-ERR The LIMIT argument must be >= 0.\r\n";
+                return false;
+            }
+            args.trim.limit = limit;
+            args.limit_given = true;
+            i += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (args.limit_given && !args.trim.approx) {
+        error = "-ERR syntax error, LIMIT cannot be used without the special ~ option\r\n";
+        return false;
+    }
+    // Approximate trims do a bounded amount of work per call by default
+    if (args.trim.approx && !args.limit_given) {
+        size_t entries = server_config.stream_node_max_entries;
+        args.trim.limit = entries ? 100 * entries : 10000;
+    }
+    return true;
+}
+
+// XADD key [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold [LIMIT count]] *|id field value [field value ...]
+static std::string cmd_xadd(const std::vector<std::string>& parts, ClientContext& client) {
+    AddTrimArgs args;
+    size_t i = 2;
+    std::string error;
+    if (!parse_add_trim_args(parts, i, true, args, error)) return error;
+    if (i >= parts.size() || parts.size() - i < 3 || (parts.size() - i - 1) % 2 != 0) {
+        return "-ERR wrong number of arguments for 'xadd' command\r\n";
+    }
+
+    // "*" picks the whole ID, "ms-*" just the sequence
+    const std::string& id_arg = parts[i];
+    bool auto_ms = id_arg == "*";
+    bool auto_seq = !auto_ms && id_arg.size() > 2 && id_arg.ends_with("-*");
+    StreamID id;
+    if (auto_seq) {
+        if (!parse_u64(std::string_view(id_arg).substr(0, id_arg.size() - 2), id.ms)) return INVALID_ID_ERROR;
+    } else if (!auto_ms) {
+        if (!parse_stream_id(id_arg, 0, id)) return INVALID_ID_ERROR;
+        if (id == StreamID()) return "-ERR The ID specified in XADD must be greater than 0-0\r\n";
+    }
+
+    StreamObject* stream = stream_for_write(parts[1], !args.no_mkstream, error);
+    if (!stream) {
+        if (!error.empty()) return error;
+        client.propagate_as.emplace();
+        return resp_null();
+    }
+
+    StreamID last = stream->last_id();
+    if (auto_ms) {
+        id.ms = std::max<uint64_t>(unix_time_ms(), last.ms);
+        if (id.ms == last.ms) {
+            id = last;
+            if (!id.increment()) return "-ERR The stream has exhausted the last possible ID, unable to add more items\r\n";
+        }
+    } else if (auto_seq && id.ms == last.ms && last.seq != UINT64_MAX) {
+        id.seq = last.seq + 1;
+    }
+    if (id <= last) return "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n";
+
+    stream->append(id, std::span(parts).subspan(i + 1));
+    if (args.trimming) stream->trim(args.trim);
+
+    std::string reply;
+    append_id(reply, id);
+    // Replicas must store the same ID, not pick their own
+    if (auto_ms || auto_seq) {
+        std::vector<std::string> rewritten = parts;
+        rewritten[i] = id.to_string();
+        client.propagate_as.emplace().push_back(std::move(rewritten));
+    }
+    return reply;
+}
+
+// XTRIM key MAXLEN|MINID [=|~] threshold [LIMIT count]
+static std::string cmd_xtrim(const std::vector<std::string>& parts, ClientContext&) {
+    AddTrimArgs args;
+    size_t i = 2;
+    std::string error;
+    if (!parse_add_trim_args(parts, i, false, args, error)) return error;
+    if (i != parts.size() || !args.trimming) return SYNTAX_ERROR;
+
+    StreamObject* stream = stream_for_write(parts[1], false, error);
+    if (!stream) return error.empty() ? resp_integer(0) : error;
+    return resp_integer(stream->trim(args.trim));
+}
+
+// XLEN key
+static std::string cmd_xlen(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const StreamObject* stream = stream_for_read(parts[1], client, error);
+    if (!stream) return error.empty() ? resp_integer(0) : error;
+    return resp_integer(stream->size());
+}
+
+// XRANGE key start end [COUNT count], and XREVRANGE key end start [COUNT count]
+static std::string xrange_generic(const std::vector<std::string>& parts, ClientContext& client, bool reverse) {
+    StreamID start, end;
+    std::string error;
+    if (!parse_range_id(parts[reverse ? 3 : 2], false, start, error) ||
+        !parse_range_id(parts[reverse ? 2 : 3], true, end, error)) {
+        return error;
+    }
+
+    int64_t count = -1;
+    if (parts.size() > 4) {
+        if (parts.size() != 6 || to_upper(parts[4]) != "COUNT") return SYNTAX_ERROR;
+        if (!string_to_int64(parts[5], count)) return NOT_INTEGER_ERROR;
+        if (count < 0) count = 0;
+    }
+
+    const StreamObject* stream = stream_for_read(parts[1], client, error);
+    if (!stream) return error.empty() ? resp_array_header(0) : error;
+    if (count == 0) return resp_array_header(0);
+
+    std::string entries;
+    size_t n = append_range(entries, *stream, start, end, reverse, count < 0 ? 0 : count);
+    return resp_array_header(n) + entries;
+}
+
+static std::string cmd_xrange(const std::vector<std::string>& parts, ClientContext& client) {
+    return xrange_generic(parts, client, false);
+}
+
+static std::string cmd_xrevrange(const std::vector<std::string>& parts, ClientContext& client) {
+    return xrange_generic(parts, client, true);
+}
+
+// Options of XREAD and XREADGROUP up to their list of keys and IDs
+struct ReadArgs {
+    int64_t count = 0;
+    int64_t block = -1;  // BLOCK milliseconds, 0 for ever
+    bool noack = false;
+    std::string group;
+    std::string consumer;
+    size_t keys = 0;  // index of the first key
+    size_t streams = 0;
+};
+
+static bool parse_read_args(const std::vector<std::string>& parts, bool xreadgroup, ReadArgs& args,
+                            std::string& error) {
+    for (size_t i = 1; i < parts.size();) {
+        std::string option = to_upper(parts[i]);
+        bool more = i + 1 < parts.size();
+        if (option == "COUNT" && more) {
+            if (!string_to_int64(parts[i + 1], args.count)) {
+                error = NOT_INTEGER_ERROR;
+                return false;
+            }
+            if (args.count < 0) args.count = 0;
+            i += 2;
+        } else if (option == "BLOCK" && more) {
+            int64_t timeout;
+            if (!string_to_int64(parts[i + 1], timeout)) {
+                error = "-ERR timeout is not an integer or out of range\r\n";
+                return false;
+            }
+            if (timeout < 0) {
+                error = "-ERR timeout is negative\r\n";
+                return false;
+            }
+            args.block = timeout;
+            i += 2;
+        } else if (option == "STREAMS" && more) {
+            args.keys = i + 1;
+            size_t rest = parts.size() - args.keys;
+            if (rest % 2 != 0) {
+                error = xreadgroup ? "-ERR Unbalanced 'xreadgroup' list of streams: for each stream key an ID or "
+                                     "'>' must be specified.\r\n"
+                                   : "-ERR Unbalanced 'xread' list of streams: for each stream key an ID or '$' "
+                                     "must be specified.\r\n";
+                return false;
+            }
+            args.streams = rest / 2;
+            break;
+        } else if (option == "GROUP" && i + 2 < parts.size()) {
+            if (!xreadgroup) {
+                error = "-ERR The GROUP option is only supported by XREADGROUP. You called XREAD instead.\r\n";
+                return false;
+            }
+            args.group = parts[i + 1];
+            args.consumer = parts[i + 2];
+            i += 3;
+        } else if (xreadgroup && option == "NOACK") {
+            args.noack = true;
+            i++;
+        } else {
+            error = SYNTAX_ERROR;
+            return false;
+        }
+    }
+
+    if (args.streams == 0) {
+        error = SYNTAX_ERROR;
+        return false;
+    }
+    if (xreadgroup && args.group.empty()) {
+        error = "-ERR Missing GROUP option for XREADGROUP\r\n";
+        return false;
+    }
+    return true;
+}
+
+static std::vector<size_t> xread_keys(const std::vector<std::string>& parts) {
+    std::vector<size_t> positions;
+    ReadArgs args;
+    std::string error;
+    if (!parse_read_args(parts, to_upper(parts[0]) == "XREADGROUP", args, error)) return positions;
+    for (size_t i = 0; i < args.streams; i++) positions.push_back(args.keys + i);
+    return positions;
+}
+
+// [key, [entry, ...]] for one stream of an XREAD reply
+static void append_stream_reply(std::string& out, const std::string& key, size_t count, const std::string& entries) {
+    out += "*2\r\n";
+    resp_append_bulk(out, key);
+    out += resp_array_header(count);
+    out += entries;
+}
+
+// XREAD [COUNT count] [BLOCK milliseconds] STREAMS key [key ...] id [id ...]
+static std::string cmd_xread(const std::vector<std::string>& parts, ClientContext& client) {
+    ReadArgs args;
+    std::string error;
+    if (!parse_read_args(parts, false, args, error)) return error;
+
+    std::vector<const StreamObject*> streams;
+    std::vector<StreamID> ids(args.streams);
+    for (size_t i = 0; i < args.streams; i++) {
+        const StreamObject* stream = stream_for_read(parts[args.keys + i], client, error);
+        if (!error.empty()) return error;
+        streams.push_back(stream);
+
+        const std::string& id_arg = parts[args.keys + args.streams + i];
+        if (id_arg == "$") {
+            if (stream) ids[i] = stream->last_id();
+        } else if (id_arg == ">") {
+            return "-ERR The > ID can be specified only when calling XREADGROUP using the GROUP <group> "
+                   "<consumer> option.\r\n";
+        } else if (!parse_stream_id(id_arg, 0, ids[i])) {
+            return INVALID_ID_ERROR;
+        }
+    }
+
+    std::string body;
+    size_t replied = 0;
+    for (size_t i = 0; i < args.streams; i++) {
+        // Entries strictly after the given ID
+        StreamID start = ids[i];
+        if (!streams[i] || !start.increment()) continue;
+        std::string entries;
+        size_t n = append_range(entries, *streams[i], start, StreamID::max(), false, args.count);
+        if (n == 0) continue;
+        append_stream_reply(body, parts[args.keys + i], n, entries);
+        replied++;
+    }
+    if (replied == 0) {
+        if (args.block >= 0) {
+            // Wait for entries after the IDs read from now, even where
+            // they were given as $
+            std::vector<std::string> retry = parts;
+            for (size_t i = 0; i < args.streams; i++) retry[args.keys + args.streams + i] = ids[i].to_string();
+            std::vector<std::string> keys(parts.begin() + args.keys, parts.begin() + args.keys + args.streams);
+            block_on_keys(client, keys, args.block, true, std::move(retry));
+        }
+        return "*-1\r\n";
+    }
+    return resp_array_header(replied) + body;
+}
+
+// How a replica records an entry handed to a consumer: a forced claim
+// that sets the pending entry to exactly the master's state
+static std::vector<std::string> claim_command(const std::string& key, const std::string& group_name,
+                                              const StreamGroup& group, const std::string& consumer, StreamID id,
+                                              const StreamNack& nack) {
+    return {"XCLAIM", key, group_name, consumer, "0", id.to_string(), "TIME", std::to_string(nack.delivery_time),
+            "RETRYCOUNT", std::to_string(nack.delivery_count), "FORCE", "JUSTID", "LASTID",
+            group.last_id.to_string()};
+}
+
+// XREADGROUP GROUP group consumer [COUNT count] [BLOCK milliseconds] [NOACK] STREAMS key [key ...] id [id ...]
+static std::string cmd_xreadgroup(const std::vector<std::string>& parts, ClientContext& client) {
+    ReadArgs args;
+    std::string error;
+    if (!parse_read_args(parts, true, args, error)) return error;
+
+    // Check every stream and group before delivering anything
+    std::vector<StreamObject*> streams;
+    std::vector<StreamGroup*> groups;
+    std::vector<StreamID> ids(args.streams);
+    std::vector<bool> new_entries(args.streams);
+    for (size_t i = 0; i < args.streams; i++) {
+        const std::string& key = parts[args.keys + i];
+        StreamObject* stream = stream_for_write(key, false, error);
+        if (!error.empty()) return error;
+        StreamGroup* group = stream ? stream->group(args.group) : nullptr;
+        if (!group) {
+            return "-NOGROUP No such key '" + key + "' or consumer group '" + args.group +
+                   "' in XREADGROUP with GROUP option\r\n";
+        }
+        streams.push_back(stream);
+        groups.push_back(group);
+
+        const std::string& id_arg = parts[args.keys + args.streams + i];
+        if (id_arg == ">") {
+            new_entries[i] = true;
+        } else if (id_arg == "$") {
+            return "-ERR The $ ID is meaningless in the context of XREADGROUP: you want to read the history of this "
+                   "consumer by specifying a proper ID, or use the > ID to get new messages. The $ ID would just "
+                   "return an empty result set.\r\n";
+        } else if (!parse_stream_id(id_arg, 0, ids[i])) {
+            return INVALID_ID_ERROR;
+        }
+    }
+
+    int64_t now = unix_time_ms();
+    auto& propagate = client.propagate_as.emplace();
+    std::string body;
+    size_t replied = 0;
+    for (size_t i = 0; i < args.streams; i++) {
+        const std::string& key = parts[args.keys + i];
+        StreamObject& stream = *streams[i];
+        StreamGroup& group = *groups[i];
+        bool created;
+        StreamConsumer* consumer = group.consumer(args.consumer, true, &created);
+        consumer->seen_time = now;
+        if (created) propagate.push_back({"XGROUP", "CREATECONSUMER", key, args.group, args.consumer});
+
+        std::string entries;
+        size_t n = 0;
+        if (new_entries[i]) {
+            StreamID start = group.last_id;
+            StreamIterator it(stream, start, StreamID::max(), false);
+            // Skip the last delivered entry itself
+            while ((args.count == 0 || n < static_cast<size_t>(args.count)) && it.next()) {
+                if (it.id() == start) continue;
+                group.last_id = it.id();
+                if (group.entries_read != -1) group.entries_read++;
+                append_entry(entries, it);
+                n++;
+                if (args.noack) continue;
+                StreamNack* nack = group.assign(it.id(), consumer, now);
+                nack->delivery_count = 1;
+                propagate.push_back(claim_command(key, args.group, group, args.consumer, it.id(), *nack));
+            }
+            if (n == 0) continue;
+            consumer->active_time = now;
+            if (args.noack) {
+                propagate.push_back({"XGROUP", "SETID", key, args.group, group.last_id.to_string(), "ENTRIESREAD",
+                                     std::to_string(group.entries_read)});
+            }
+        } else {
+            // History: this consumer's pending entries after the ID. Entries
+            // deleted from the stream since come back with no fields.
+            StreamID start = ids[i];
+            if (start.increment()) {
+                for (auto it = consumer->pending.lower_bound(StreamKey(start));
+                     it.valid() && (args.count == 0 || n < static_cast<size_t>(args.count)); it.next()) {
+                    StreamID id = StreamID::decode(it.key().data());
+                    StreamIterator entry(stream, id, id, false);
+                    if (entry.next()) {
+                        append_entry(entries, entry);
+                        it.value()->delivery_time = now;
+                        it.value()->delivery_count++;
+                    } else {
+                        entries += "*2\r\n";
+                        append_id(entries, id);
+                        entries += "*-1\r\n";
+                    }
+                    n++;
+                }
+            }
+        }
+        append_stream_reply(body, key, n, entries);
+        replied++;
+    }
+    // Only reads of new entries get here with nothing, and those wait for
+    // them. Each entry goes to one consumer of the group.
+    if (replied == 0) {
+        if (args.block >= 0) {
+            std::vector<std::string> keys(parts.begin() + args.keys, parts.begin() + args.keys + args.streams);
+            block_on_keys(client, keys, args.block, false);
+        }
+        return "*-1\r\n";
+    }
+    return resp_array_header(replied) + body;
+}
+
+// XACK key group id [id ...]
+static std::string cmd_xack(const std::vector<std::string>& parts, ClientContext&) {
+    std::vector<StreamID> ids(parts.size() - 3);
+    for (size_t i = 3; i < parts.size(); i++) {
+        if (!parse_stream_id(parts[i], 0, ids[i - 3])) return INVALID_ID_ERROR;
+    }
+
+    std::string error;
+    StreamObject* stream = stream_for_write(parts[1], false, error);
+    if (!stream) return error.empty() ? resp_integer(0) : error;
+    StreamGroup* group = stream->group(parts[2]);
+    if (!group) return resp_integer(0);
+
+    int64_t acked = 0;
+    for (StreamID id : ids) acked += group->ack(id);
+    return resp_integer(acked);
+}
+
+static std::string no_group_error(const std::string& key, const std::string& group) {
+    return "-NOGROUP No such key '" + key + "' or consumer group '" + group + "'\r\n";
+}
+
+// XPENDING key group [[IDLE min-idle-time] start end count [consumer]]
+static std::string cmd_xpending(const std::vector<std::string>& parts, ClientContext& client) {
+    bool extended = parts.size() > 3;
+    int64_t min_idle = 0;
+    size_t i = 3;
+    if (extended && to_upper(parts[3]) == "IDLE") {
+        if (parts.size() < 8) return SYNTAX_ERROR;
+        if (!string_to_int64(parts[4], min_idle)) return NOT_INTEGER_ERROR;
+        i = 5;
+    }
+
+    StreamID start, end;
+    int64_t count = 0;
+    std::string error;
+    if (extended) {
+        if (parts.size() < i + 3 || parts.size() > i + 4) return SYNTAX_ERROR;
+        if (!parse_range_id(parts[i], false, start, error) || !parse_range_id(parts[i + 1], true, end, error)) {
+            return error;
+        }
+        if (!string_to_int64(parts[i + 2], count)) return NOT_INTEGER_ERROR;
+        if (count < 0) count = 0;
+    }
+
+    const StreamObject* stream = stream_for_read(parts[1], client, error);
+    if (!error.empty()) return error;
+    const StreamGroup* group = stream ? stream->group(parts[2]) : nullptr;
+    if (!group) return no_group_error(parts[1], parts[2]);
+
+    if (!extended) {
+        if (group->pending.empty()) return "*4\r\n:0\r\n$-1\r\n$-1\r\n*-1\r\n";
+        std::string reply = resp_array_header(4) + resp_integer(group->pending.size());
+        append_id(reply, StreamID::decode(group->pending.begin().key().data()));
+        append_id(reply, StreamID::decode(group->pending.last().key().data()));
+        std::string consumers;
+        size_t with_pending = 0;
+        for (const auto& [name, consumer] : group->consumers) {
+            if (consumer->pending.empty()) continue;
+            consumers += "*2\r\n";
+            resp_append_bulk(consumers, name);
+            resp_append_bulk(consumers, std::to_string(consumer->pending.size()));
+            with_pending++;
+        }
+        return reply + resp_array_header(with_pending) + consumers;
+    }
+
+    // The group's pending entries, or just those of one consumer
+    const RadixTree<StreamNack*>* owned = nullptr;
+    if (parts.size() == i + 4) {
+        auto it = group->consumers.find(parts[i + 3]);
+        if (it == group->consumers.end()) return resp_array_header(0);
+        owned = &it->second->pending;
+    }
+
+    int64_t now = unix_time_ms();
+    std::string entries;
+    int64_t n = 0;
+    auto visit = [&](std::string_view key, const StreamNack& nack) {
+        int64_t idle = std::max<int64_t>(now - nack.delivery_time, 0);
+        if (idle < min_idle) return;
+        entries += "*4\r\n";
+        append_id(entries, StreamID::decode(key.data()));
+        resp_append_bulk(entries, nack.consumer->name);
+        entries += resp_integer(idle);
+        entries += resp_integer(nack.delivery_count);
+        n++;
+    };
+    StreamKey end_encoded(end);
+    std::string_view end_key = end_encoded;
+    if (owned) {
+        for (auto it = owned->lower_bound(StreamKey(start)); it.valid() && n < count && it.key() <= end_key;
+             it.next()) {
+            visit(it.key(), *it.value());
+        }
+    } else {
+        for (auto it = group->pending.lower_bound(StreamKey(start)); it.valid() && n < count && it.key() <= end_key;
+             it.next()) {
+            visit(it.key(), *it.value());
+        }
+    }
+    return resp_array_header(n) + entries;
+}
+
+// XCLAIM key group consumer min-idle-time id [id ...] [IDLE ms] [TIME unix-time-milliseconds]
+//        [RETRYCOUNT count] [FORCE] [JUSTID] [LASTID lastid]
+static std::string cmd_xclaim(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t min_idle;
+    if (!string_to_int64(parts[4], min_idle)) return "-ERR Invalid min-idle-time argument for XCLAIM\r\n";
+    if (min_idle < 0) min_idle = 0;
+
+    // IDs run up to the first argument that is not one
+    std::vector<StreamID> ids;
+    size_t i = 5;
+    for (StreamID id; i < parts.size() && parse_stream_id(parts[i], 0, id); i++) ids.push_back(id);
+
+    int64_t now = unix_time_ms();
+    int64_t delivery_time = -1;
+    int64_t retry_count = -1;
+    bool force = false;
+    bool justid = false;
+    bool has_last_id = false;
+    StreamID last_id;
+    for (; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        bool more = i + 1 < parts.size();
+        if (option == "FORCE") {
+            force = true;
+        } else if (option == "JUSTID") {
+            justid = true;
+        } else if ((option == "IDLE" || option == "TIME") && more) {
+            int64_t value;
+            if (!string_to_int64(parts[++i], value)) return NOT_INTEGER_ERROR;
+            delivery_time = option == "IDLE" ? now - value : value;
+        } else if (option == "RETRYCOUNT" && more) {
+            if (!string_to_int64(parts[++i], retry_count)) return NOT_INTEGER_ERROR;
+        } else if (option == "LASTID" && more) {
+            if (!parse_stream_id(parts[++i], 0, last_id)) return INVALID_ID_ERROR;
+            has_last_id = true;
+        } else {
+            return "-ERR Unrecognized XCLAIM option '" + parts[i] + "'\r\n";
+        }
+    }
+    // Times in the future, or before the epoch, mean now
+    if (delivery_time < 0 || delivery_time > now) delivery_time = now;
+
+    std::string error;
+    StreamObject* stream = stream_for_write(parts[1], false, error);
+    if (!error.empty()) return error;
+    StreamGroup* group = stream ? stream->group(parts[2]) : nullptr;
+    if (!group) return no_group_error(parts[1], parts[2]);
+
+    auto& propagate = client.propagate_as.emplace();
+    bool moved_last_id = has_last_id && last_id > group->last_id;
+    if (moved_last_id) group->last_id = last_id;
+
+    bool created;
+    StreamConsumer* consumer = group->consumer(parts[3], true, &created);
+    consumer->seen_time = now;
+    if (created) propagate.push_back({"XGROUP", "CREATECONSUMER", parts[1], parts[2], parts[3]});
+
+    std::string entries;
+    size_t n = 0;
+    for (StreamID id : ids) {
+        std::unique_ptr<StreamNack>* pending = group->pending.find(StreamKey(id));
+        bool exists = stream->contains(id);
+        if (!pending) {
+            // Never delivered, so there is no idle time to check
+            if (!force || !exists) continue;
+        } else if (!exists) {
+            // Deleted from the stream meanwhile, nothing left to claim
+            group->ack(id);
+            propagate.push_back({"XACK", parts[1], parts[2], id.to_string()});
+            continue;
+        } else if (min_idle && now - (*pending)->delivery_time < min_idle) {
+            continue;
+        }
+
+        StreamNack* nack = group->assign(id, consumer, delivery_time);
+        if (retry_count >= 0) {
+            nack->delivery_count = retry_count;
+        } else if (!justid && pending) {
+            nack->delivery_count++;
+        }
+        consumer->active_time = now;
+        propagate.push_back(claim_command(parts[1], parts[2], *group, parts[3], id, *nack));
+
+        if (justid) {
+            append_id(entries, id);
+        } else {
+            StreamIterator it(*stream, id, id, false);
+            it.next();
+            append_entry(entries, it);
+        }
+        n++;
+    }
+    if (moved_last_id && n == 0) {
+        propagate.push_back({"XGROUP", "SETID", parts[1], parts[2], group->last_id.to_string(), "ENTRIESREAD",
+                             std::to_string(group->entries_read)});
+    }
+    return resp_array_header(n) + entries;
+}
+
+// XGROUP CREATE key group id|$ [MKSTREAM] [ENTRIESREAD entries-read]
+// XGROUP SETID key group id|$ [ENTRIESREAD entries-read]
+// XGROUP DESTROY key group
+// XGROUP CREATECONSUMER key group consumer
+// XGROUP DELCONSUMER key group consumer
+static std::string cmd_xgroup(const std::vector<std::string>& parts, ClientContext&) {
+    std::string sub = to_upper(parts[1]);
+    size_t argc = parts.size();
+    bool create = sub == "CREATE";
+    bool setid = sub == "SETID";
+    if (!create && !setid && sub != "DESTROY" && sub != "CREATECONSUMER" && sub != "DELCONSUMER") {
+        return "-ERR unknown subcommand '" + parts[1] + "'. Try XGROUP HELP.\r\n";
+    }
+    bool arity_ok = create ? argc >= 5 && argc <= 8 : setid ? argc >= 5 && argc <= 7 : sub == "DESTROY" ? argc == 4
+                                                                                                           : argc == 5;
+    if (!arity_ok) {
+        std::string name = sub;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return "-ERR wrong number of arguments for 'xgroup|" + name + "' command\r\n";
+    }
+
+    bool mkstream = false;
+    int64_t entries_read = -1;
+    if (create || setid) {
+        for (size_t i = 5; i < argc; i++) {
+            std::string option = to_upper(parts[i]);
+            if (create && option == "MKSTREAM") {
+                mkstream = true;
+            } else if (option == "ENTRIESREAD" && i + 1 < argc) {
+                if (!string_to_int64(parts[++i], entries_read)) return NOT_INTEGER_ERROR;
+                if (entries_read < -1) return "-ERR value for ENTRIESREAD must be positive or -1\r\n";
+            } else {
+                return SYNTAX_ERROR;
+            }
+        }
+    }
+
+    std::string error;
+    StreamObject* stream = stream_for_write(parts[2], mkstream, error);
+    if (!stream) {
+        if (!error.empty()) return error;
+        return "-ERR The XGROUP subcommand requires the key to exist. Note that for CREATE you may want to use the "
+               "MKSTREAM option to create an empty stream automatically.\r\n";
+    }
+
+    const std::string& group_name = parts[3];
+    if (create || setid) {
+        StreamID id;
+        if (parts[4] == "$") {
+            id = stream->last_id();
+            if (entries_read == -1) entries_read = stream->entries_added();
+        } else if (!parse_stream_id(parts[4], 0, id)) {
+            return INVALID_ID_ERROR;
+        }
+        if (create) {
+            if (!stream->create_group(group_name, id, entries_read)) {
+                return "-BUSYGROUP Consumer Group name already exists\r\n";
+            }
+            return resp_simple("OK");
+        }
+        StreamGroup* group = stream->group(group_name);
+        if (!group) return "-NOGROUP No such consumer group '" + group_name + "' for key name '" + parts[2] + "'\r\n";
+        group->last_id = id;
+        group->entries_read = entries_read;
+        return resp_simple("OK");
+    }
+    if (sub == "DESTROY") return resp_integer(stream->destroy_group(group_name));
+
+    StreamGroup* group = stream->group(group_name);
+    if (!group) return "-NOGROUP No such consumer group '" + group_name + "' for key name '" + parts[2] + "'\r\n";
+    if (sub == "CREATECONSUMER") {
+        bool created;
+        group->consumer(parts[4], true, &created)->seen_time = unix_time_ms();
+        return resp_integer(created);
+    }
+    return resp_integer(group->delete_consumer(parts[4]));
+}
+
+void register_stream_commands() {
+    register_command({"XADD", -5, CMD_WRITE, cmd_xadd, 1, 1, 1});
+    register_command({"XTRIM", -4, CMD_WRITE, cmd_xtrim, 1, 1, 1});
+    register_command({"XLEN", 2, CMD_READONLY, cmd_xlen, 1, 1, 1});
+    register_command({"XRANGE", -4, CMD_READONLY, cmd_xrange, 1, 1, 1});
+    register_command({"XREVRANGE", -4, CMD_READONLY, cmd_xrevrange, 1, 1, 1});
+    register_command({"XREAD", -4, CMD_READONLY | CMD_BLOCKING, cmd_xread, 0, 0, 0, xread_keys});
+    register_command({"XREADGROUP", -7, CMD_WRITE | CMD_BLOCKING, cmd_xreadgroup, 0, 0, 0, xread_keys});
+    register_command({"XACK", -4, CMD_WRITE, cmd_xack, 1, 1, 1});
+    register_command({"XPENDING", -3, CMD_READONLY, cmd_xpending, 1, 1, 1});
+    register_command({"XCLAIM", -6, CMD_WRITE, cmd_xclaim, 1, 1, 1});
+    register_command({"XGROUP", -2, CMD_WRITE, cmd_xgroup, 2, 2, 1});
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "listpack.hpp"
+#include "radix.hpp"
+#include "store.hpp"
+
+// Entry ID: milliseconds and a sequence number within them
+struct StreamID {
+    uint64_t ms = 0;
+    uint64_t seq = 0;
+
+    static constexpr size_t ENCODED_SIZE = 16;
+
+    auto operator<=>(const StreamID&) const = default;
+
+    std::string to_string() const { return std::to_string(ms) + "-" + std::to_string(seq); }
+
+    // Big-endian ms then seq, so encoded IDs sort like the IDs themselves
+    void encode(char* out) const;
+    static StreamID decode(const char* in);
+
+    // Step to the following or preceding ID, false past either end
+    bool increment();
+    bool decrement();
+
+    static StreamID max() { return {UINT64_MAX, UINT64_MAX}; }
+};
+
+struct StreamConsumer;
+
+// Pending entry: delivered to a consumer of a group but not acknowledged
+struct StreamNack {
+    int64_t delivery_time = 0;  // unix ms of the last delivery
+    uint64_t delivery_count = 1;
+    StreamConsumer* consumer = nullptr;
+};
+
+struct StreamConsumer {
+    std::string name;
+    int64_t seen_time = 0;     // last time it used the group
+    int64_t active_time = -1;  // last time it was handed entries, -1 if never
+    RadixTree<StreamNack*> pending;  // its share of the group's entries
+};
+
+struct StreamGroup {
+    StreamID last_id;         // last entry delivered to the group
+    int64_t entries_read = 0;  // entries delivered so far, -1 if unknown
+    // Owns the pending entries; consumers point at theirs
+    RadixTree<std::unique_ptr<StreamNack>> pending;
+    std::map<std::string, std::unique_ptr<StreamConsumer>, std::less<>> consumers;
+
+    // Consumer by name, created if missing when create is set
+    StreamConsumer* consumer(std::string_view name, bool create, bool* created = nullptr);
+    // Drop a consumer and its pending entries, returns how many it had
+    size_t delete_consumer(std::string_view name);
+
+    // Hand an entry to a consumer, taking it from its current owner
+    StreamNack* assign(StreamID id, StreamConsumer* to, int64_t now);
+    bool ack(StreamID id);
+};
+
+// An append-only log of entries with increasing IDs. Entries are packed
+// into listpacks of up to max_block_bytes bytes or max_block_entries
+// entries, held in a radix tree keyed by the ID of each block's first
+// entry. A block begins with a master entry naming the fields of that
+// first entry; later entries store their IDs as deltas from it and, when
+// they have the same fields, only their values. The layout is the Redis
+// one, so blocks go into RDB files as they are.
+//
+// Appends touch only the last block; a range scan seeks to one block and
+// then walks listpacks front to back. Deleted entries stay in their block
+// flagged as such until the whole block goes.
+class StreamObject : public DataObject {
+public:
+    // Flags of each entry in a block
+    enum EntryFlags : int64_t {
+        ENTRY_DELETED = 1 << 0,
+        ENTRY_SAMEFIELDS = 1 << 1,
+    };
+
+    // How XADD and XTRIM cut a stream down, from its oldest entries on
+    struct Trim {
+        bool by_minid = false;  // drop entries below minid rather than past maxlen
+        size_t maxlen = 0;
+        StreamID minid;
+        bool approx = false;    // only whole blocks, at most limit entries
+        size_t limit = 0;       // 0 for no limit
+    };
+
+    StreamObject(size_t max_block_bytes, size_t max_block_entries);
+
+    size_t size() const { return length_; }
+    StreamID last_id() const { return last_id_; }
+    StreamID first_id() const { return first_id_; }
+    StreamID max_deleted_id() const { return max_deleted_id_; }
+    uint64_t entries_added() const { return entries_added_; }
+
+    // Append an entry from alternating fields and values. id must be above
+    // last_id().
+    void append(StreamID id, std::span<const std::string> fields);
+
+    // Returns the number of entries removed
+    size_t trim(const Trim& trim);
+
+    // Whether an entry with this ID is in the stream and not deleted
+    bool contains(StreamID id) const;
+
+    StreamGroup* group(std::string_view name);
+    const StreamGroup* group(std::string_view name) const;
+    // nullptr if a group of that name exists
+    StreamGroup* create_group(const std::string& name, StreamID last_id, int64_t entries_read);
+    bool destroy_group(std::string_view name);
+    const std::map<std::string, std::unique_ptr<StreamGroup>, std::less<>>& groups() const { return groups_; }
+
+    // Raw access for RDB: blocks keyed by encoded master ID
+    const RadixTree<ListPack>& blocks() const { return blocks_; }
+    // Adopt a block loaded from RDB, false if it is malformed
+    bool load_block(std::string_view key, ListPack block);
+    void load_metadata(size_t length, StreamID last_id, StreamID first_id, StreamID max_deleted_id,
+                       uint64_t entries_added);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return "stream"; }
+
+private:
+    friend class StreamIterator;
+
+    ListPack* tail_block(StreamID& master);
+    void update_first_id();
+
+    RadixTree<ListPack> blocks_;
+    ListPack* tail_ = nullptr;  // last block, cached for appends
+    StreamID tail_master_;
+    size_t length_ = 0;
+    StreamID last_id_;
+    StreamID first_id_;
+    StreamID max_deleted_id_;
+    uint64_t entries_added_ = 0;
+    std::map<std::string, std::unique_ptr<StreamGroup>, std::less<>> groups_;
+    size_t max_block_bytes_;
+    size_t max_block_entries_;
+};
+
+// Walks the live entries of a stream between two IDs, inclusive, in
+// either direction. The stream must not change while it is in use.
+class StreamIterator {
+public:
+    StreamIterator(const StreamObject& stream, StreamID start, StreamID end, bool reverse);
+
+    // Move to the next entry, false once the range is exhausted
+    bool next();
+
+    StreamID id() const { return id_; }
+    size_t field_count() const { return field_count_; }
+
+    // Call visit(field, value) for each field of the current entry
+    template <typename F>
+    void for_each_field(F&& visit) const;
+
+private:
+    bool load_block();
+    void read_entry(size_t flags_pos);
+
+    RadixTree<ListPack>::Iterator block_;
+    const ListPack* lp_ = nullptr;
+    StreamID master_id_;
+    size_t master_field_count_ = 0;
+    size_t master_fields_ = 0;  // offset of the first master field
+    size_t first_entry_ = 0;    // offset of the first entry after the master entry
+    size_t pos_ = ListPack::npos;  // next entry forward, or lp-count of the next one in reverse
+
+    StreamID start_, end_;
+    bool reverse_;
+    bool done_ = false;
+
+    StreamID id_;
+    int64_t flags_ = 0;
+    size_t field_count_ = 0;
+    size_t fields_ = 0;  // offset of the first value, or first field/value pair
+};
+
+template <typename F>
+void StreamIterator::for_each_field(F&& visit) const {
+    size_t pos = fields_;
+    if (flags_ & StreamObject::ENTRY_SAMEFIELDS) {
+        size_t field = master_fields_;
+        for (size_t i = 0; i < field_count_; i++) {
+            visit(lp_->get(field), lp_->get(pos));
+            field = lp_->next(field);
+            pos = lp_->next(pos);
+        }
+        return;
+    }
+    for (size_t i = 0; i < field_count_; i++) {
+        size_t value = lp_->next(pos);
+        visit(lp_->get(pos), lp_->get(value));
+        pos = lp_->next(value);
+    }
+}
+
+// Empty stream with the configured block limits
+std::unique_ptr<StreamObject> make_stream();
+
+void register_stream_commands();
@@ -0,0 +1,415 @@
+#include "string.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "store.hpp"
+#include "util.hpp"
+
+static constexpr const char* NOT_INTEGER_ERROR = "-ERR value is not an integer or out of range\r\n";
+static constexpr const char* NOT_FLOAT_ERROR = "-ERR value is not a valid float\r\n";
+
+static constexpr const char* SYNTAX_ERROR = "-ERR syntax error\r\n";
+
+// Strings stop at 512 MB like in Redis
+static constexpr size_t MAX_STRING_SIZE = size_t(512) * 1024 * 1024;
+static constexpr const char* STRING_SIZE_ERROR =
+    "-ERR string exceeds maximum allowed size (proto-max-bulk-len)\r\n";
+
+// Options of SET, and the expiry options GETEX shares with it
+struct SetArgs {
+    bool nx = false;
+    bool xx = false;
+    bool get = false;
+    bool keep_ttl = false;
+    bool persist = false;    // GETEX only
+    bool has_expiry = false;
+    int64_t expire_at = 0;   // unix milliseconds
+};
+
+// Parse the options from parts[3] (SET) or parts[2] (GETEX) on in a single
+// pass, turning relative expiries into absolute ones. Empty on success,
+// else the error reply.
+static std::string parse_set_args(const std::vector<std::string>& parts, bool getex, SetArgs& args) {
+    for (size_t i = getex ? 2 : 3; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (!getex && option == "NX" && !args.xx) {
+            args.nx = true;
+        } else if (!getex && option == "XX" && !args.nx) {
+            args.xx = true;
+        } else if (!getex && option == "GET") {
+            args.get = true;
+        } else if (!getex && option == "KEEPTTL" && !args.has_expiry) {
+            args.keep_ttl = true;
+        } else if (getex && option == "PERSIST" && !args.has_expiry) {
+            args.persist = true;
+        } else if ((option == "EX" || option == "PX" || option == "EXAT" || option == "PXAT") &&
+                   !args.has_expiry && !args.keep_ttl && !args.persist && i + 1 < parts.size()) {
+            int64_t when;
+            if (!string_to_int64(parts[++i], when)) return NOT_INTEGER_ERROR;
+            bool seconds = option == "EX" || option == "EXAT";
+            bool relative = option == "EX" || option == "PX";
+            if (when <= 0 || (seconds && __builtin_mul_overflow(when, 1000, &when)) ||
+                (relative && __builtin_add_overflow(when, unix_now_ms(), &when))) {
+                return "-ERR invalid expire time in '" + parts[0] + "' command\r\n";
+            }
+            args.has_expiry = true;
+            args.expire_at = when;
+        } else {
+            return SYNTAX_ERROR;
+        }
+    }
+    return "";
+}
+
+// SET key value [NX | XX] [GET] [EX seconds | PX milliseconds |
+//     EXAT unix-time-seconds | PXAT unix-time-milliseconds | KEEPTTL]
+static std::string cmd_set(const std::vector<std::string>& parts, ClientContext& client) {
+    SetArgs args;
+    std::string error = parse_set_args(parts, false, args);
+    if (!error.empty()) return error;
+
+    ValueWithExpiry* old = lookup_key_write(parts[1]);
+    std::string reply = "+OK\r\n";
+    if (args.get) {
+        if (old && old->type != ValueType::String) return WRONGTYPE_ERROR;
+        std::string scratch;
+        reply = old ? resp_bulk(old->string_for_read(scratch)) : resp_null();
+    }
+    if ((args.nx && old) || (args.xx && !old)) {
+        client.propagate_as.emplace();
+        return args.get ? reply : resp_null();
+    }
+
+    bool keep_ttl = args.keep_ttl && old && old->has_expiry;
+    ValueWithExpiry value(parts[2]);
+    if (keep_ttl) {
+        // The key stays listed in kv_expires
+        value.expiry = old->expiry;
+        value.has_expiry = true;
+    } else if (old) {
+        remove_expiry(parts[1], *old);
+    }
+    ValueWithExpiry& entry = old ? (*old = std::move(value)) : kv_store.emplace(parts[1], std::move(value)).first->second;
+    if (args.has_expiry) set_expiry(parts[1], entry, unix_ms_to_steady(args.expire_at));
+
+    // Replicas get the outcome: an absolute expiry, and no condition or GET
+    if (parts.size() > 3) {
+        std::vector<std::string> rewritten = {"SET", parts[1], parts[2]};
+        if (args.has_expiry) {
+            rewritten.insert(rewritten.end(), {"PXAT", std::to_string(args.expire_at)});
+        } else if (keep_ttl) {
+            rewritten.push_back("KEEPTTL");
+        }
+        client.propagate_as.emplace().push_back(std::move(rewritten));
+    }
+    return reply;
+}
+
+static std::string cmd_get(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_read(parts[1], client);
+    if (!value) return "$-1\r\n"; // Redis null response
+    if (value->type != ValueType::String) return WRONGTYPE_ERROR;
+    std::string scratch;
+    return resp_bulk(value->string_for_read(scratch));
+}
+
+// GETEX key [EX seconds | PX milliseconds | EXAT unix-time-seconds |
+//     PXAT unix-time-milliseconds | PERSIST]
+static std::string cmd_getex(const std::vector<std::string>& parts, ClientContext& client) {
+    SetArgs args;
+    std::string error = parse_set_args(parts, true, args);
+    if (!error.empty()) return error;
+
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value) {
+        client.propagate_as.emplace();
+        return resp_null();
+    }
+    if (value->type != ValueType::String) return WRONGTYPE_ERROR;
+
+    std::string scratch;
+    const std::string& text = value->string_for_read(scratch);
+    std::string reply = resp_bulk(text);
+    // Replicas get only the change of expiry, not the value again
+    auto& propagate = client.propagate_as.emplace();
+    if (args.has_expiry) {
+        set_expiry(parts[1], *value, unix_ms_to_steady(args.expire_at));
+        propagate.push_back({"PEXPIREAT", parts[1], std::to_string(args.expire_at)});
+    } else if (args.persist && value->has_expiry) {
+        remove_expiry(parts[1], *value);
+        propagate.push_back({"PERSIST", parts[1]});
+    }
+    return reply;
+}
+
+// GETDEL key
+static std::string cmd_getdel(const std::vector<std::string>& parts, ClientContext& client) {
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (!value) {
+        client.propagate_as.emplace();
+        return resp_null();
+    }
+    if (value->type != ValueType::String) return WRONGTYPE_ERROR;
+
+    std::string scratch;
+    std::string reply = resp_bulk(value->string_for_read(scratch));
+    remove_expiry(parts[1], *value);
+    kv_store.erase(parts[1]);
+    client.propagate_as.emplace().push_back({"DEL", parts[1]});
+    return reply;
+}
+
+// Make room for a string to reach size bytes. Past its capacity the buffer
+// grows geometrically, doubling up to 1 MB and by half beyond, so a key
+// built up by many small appends is copied a logarithmic number of times
+// rather than once per append.
+static void reserve_string(std::string& str, size_t size) {
+    if (size <= str.capacity()) return;
+    size_t grown = str.capacity() < 1024 * 1024 ? 2 * str.capacity() : str.capacity() + str.capacity() / 2;
+    str.reserve(std::min(std::max(size, grown), MAX_STRING_SIZE));
+}
+
+// APPEND key value
+static std::string cmd_append(const std::vector<std::string>& parts, ClientContext& client) {
+    const std::string& tail = parts[2];
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (value && value->type != ValueType::String) return WRONGTYPE_ERROR;
+    size_t size = value ? value->string_for_write().size() : 0;
+    if (size + tail.size() > MAX_STRING_SIZE) return STRING_SIZE_ERROR;
+
+    std::string& str = value ? value->value : kv_store[parts[1]].value;
+    reserve_string(str, size + tail.size());
+    str.append(tail);
+    return resp_integer(str.size());
+}
+
+// SETRANGE key offset value
+static std::string cmd_setrange(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t offset;
+    if (!string_to_int64(parts[2], offset) || offset < 0) return "-ERR offset is out of range\r\n";
+    const std::string& patch = parts[3];
+
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    if (value && value->type != ValueType::String) return WRONGTYPE_ERROR;
+    // Nothing to write leaves the key alone, and doesn't create it
+    if (patch.empty()) {
+        client.propagate_as.emplace();
+        std::string scratch;
+        return resp_integer(value ? value->string_for_read(scratch).size() : 0);
+    }
+    if (static_cast<uint64_t>(offset) + patch.size() > MAX_STRING_SIZE) return STRING_SIZE_ERROR;
+
+    std::string& str = value ? value->string_for_write() : kv_store[parts[1]].value;
+    size_t end = offset + patch.size();
+    if (str.size() < end) {
+        reserve_string(str, end);
+        str.resize(end);
+    }
+    std::memcpy(str.data() + offset, patch.data(), patch.size());
+    return resp_integer(str.size());
+}
+
+// Hash every key of a batch and start loading the first entry of its
+// bucket, so the lookups that follow find most of their nodes in cache
+// instead of taking one miss after another
+static void prefetch_keys(const std::vector<std::string>& parts, size_t step) {
+    for (size_t i = 1; i < parts.size(); i += step) kv_store.prefetch(parts[i]);
+}
+
+// MGET key [key ...]
+//
+// One command, one lock acquisition and one reply for the whole batch.
+// All keys are looked up before any of the reply is built, prefetching each
+// payload as its key is found, so the misses on the value buffers overlap
+// with the remaining lookups too.
+static std::string cmd_mget(const std::vector<std::string>& parts, ClientContext& client) {
+    prefetch_keys(parts, 1);
+    size_t count = parts.size() - 1;
+    std::vector<const ValueWithExpiry*> values(count);
+    size_t reply_size = 16;
+    for (size_t i = 0; i < count; i++) {
+        ValueWithExpiry* value = lookup_key_read(parts[i + 1], client);
+        // Keys holding other types read as missing rather than failing the batch
+        if (!value || value->type != ValueType::String) {
+            reply_size += 5;
+            continue;
+        }
+        __builtin_prefetch(value->value.data());
+        values[i] = value;
+        reply_size += value->value.size() + 16;
+    }
+
+    std::string reply;
+    reply.reserve(reply_size);
+    reply += resp_array_header(count);
+    std::string scratch;
+    for (const ValueWithExpiry* value : values) {
+        if (value) {
+            resp_append_bulk(reply, value->string_for_read(scratch));
+        } else {
+            reply += "$-1\r\n";
+        }
+    }
+    return reply;
+}
+
+// MSET key value [key value ...]
+static std::string cmd_mset(const std::vector<std::string>& parts, ClientContext& client) {
+    if (parts.size() % 2 == 0) return "-ERR wrong number of arguments for '" + parts[0] + "' command\r\n";
+
+    // Grow the table once up front rather than rehashing partway through
+    kv_store.reserve(kv_store.size() + parts.size() / 2);
+    prefetch_keys(parts, 2);
+    for (size_t i = 1; i < parts.size(); i += 2) {
+        auto [it, inserted] = kv_store.try_emplace(parts[i], parts[i + 1]);
+        if (!inserted) {
+            remove_expiry(parts[i], it->second);
+            it->second = ValueWithExpiry(parts[i + 1]);
+        }
+    }
+    return "+OK\r\n";
+}
+
+// MSETNX key value [key value ...]: all or nothing, set only if none exist
+static std::string cmd_msetnx(const std::vector<std::string>& parts, ClientContext& client) {
+    if (parts.size() % 2 == 0) return "-ERR wrong number of arguments for '" + parts[0] + "' command\r\n";
+
+    prefetch_keys(parts, 2);
+    for (size_t i = 1; i < parts.size(); i += 2) {
+        if (lookup_key_write(parts[i])) {
+            client.propagate_as.emplace();
+            return resp_integer(0);
+        }
+    }
+
+    kv_store.reserve(kv_store.size() + parts.size() / 2);
+    for (size_t i = 1; i < parts.size(); i += 2) {
+        kv_store.insert_or_assign(parts[i], ValueWithExpiry(parts[i + 1]));
+    }
+    return resp_integer(1);
+}
+
+// The counter held by key for INCR and friends, a missing key starting at
+// 0. A string holding a number is converted to the integer encoding on its
+// first increment, so the ones after it skip parsing altogether.
+static int64_t* counter_for_write(const std::string& key, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (!value) {
+        value = &kv_store[key];
+        value->set_integer(0);
+        return &value->integer;
+    }
+    if (value->type != ValueType::String) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value->is_integer) {
+        int64_t integer;
+        if (!string_to_int64(value->value, integer)) {
+            error = NOT_INTEGER_ERROR;
+            return nullptr;
+        }
+        value->set_integer(integer);
+    }
+    return &value->integer;
+}
+
+static std::string increment_by(const std::string& key, int64_t delta) {
+    std::string error;
+    int64_t* counter = counter_for_write(key, error);
+    if (!counter) return error;
+
+    int64_t result;
+    if (__builtin_add_overflow(*counter, delta, &result)) {
+        return "-ERR increment or decrement would overflow\r\n";
+    }
+    *counter = result;
+    return resp_integer(result);
+}
+
+// INCR key
+static std::string cmd_incr(const std::vector<std::string>& parts, ClientContext& client) {
+    return increment_by(parts[1], 1);
+}
+
+// DECR key
+static std::string cmd_decr(const std::vector<std::string>& parts, ClientContext& client) {
+    return increment_by(parts[1], -1);
+}
+
+// INCRBY key increment
+static std::string cmd_incrby(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t delta;
+    if (!string_to_int64(parts[2], delta)) return NOT_INTEGER_ERROR;
+    return increment_by(parts[1], delta);
+}
+
+// DECRBY key decrement
+static std::string cmd_decrby(const std::vector<std::string>& parts, ClientContext& client) {
+    int64_t delta;
+    if (!string_to_int64(parts[2], delta)) return NOT_INTEGER_ERROR;
+    if (delta == INT64_MIN) return "-ERR decrement would overflow\r\n";
+    return increment_by(parts[1], -delta);
+}
+
+// Shortest text that reads back as the same double, in plain notation
+// like Redis uses rather than with an exponent
+static std::string float_to_string(double value) {
+    char buf[512];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed);
+    return std::string(buf, ptr);
+}
+
+// INCRBYFLOAT key increment
+//
+// The result is stored as its shortest round-tripping text, so a replica
+// applying the same command to the same text computes the same double.
+static std::string cmd_incrbyfloat(const std::vector<std::string>& parts, ClientContext& client) {
+    double delta;
+    if (!string_to_double(parts[2], delta)) return NOT_FLOAT_ERROR;
+
+    ValueWithExpiry* value = lookup_key_write(parts[1]);
+    double current = 0;
+    if (value) {
+        if (value->type != ValueType::String) return WRONGTYPE_ERROR;
+        if (value->is_integer) {
+            current = static_cast<double>(value->integer);
+        } else if (!string_to_double(value->value, current)) {
+            return NOT_FLOAT_ERROR;
+        }
+    }
+
+    double result = current + delta;
+    if (!std::isfinite(result)) return "-ERR increment would produce NaN or Infinity\r\n";
+
+    if (!value) value = &kv_store[parts[1]];
+    value->is_integer = false;
+    value->value = float_to_string(result);
+    return resp_bulk(value->value);
+}
+
+void register_string_commands() {
+    register_command({"SET", -3, CMD_WRITE, cmd_set, 1, 1, 1});
+    register_command({"GET", 2, CMD_READONLY, cmd_get, 1, 1, 1});
+    register_command({"GETEX", -2, CMD_WRITE, cmd_getex, 1, 1, 1});
+    register_command({"GETDEL", 2, CMD_WRITE, cmd_getdel, 1, 1, 1});
+    register_command({"APPEND", 3, CMD_WRITE, cmd_append, 1, 1, 1});
+    register_command({"SETRANGE", 4, CMD_WRITE, cmd_setrange, 1, 1, 1});
+    register_command({"MGET", -2, CMD_READONLY, cmd_mget, 1, -1, 1});
+    register_command({"MSET", -3, CMD_WRITE, cmd_mset, 1, -1, 2});
+    register_command({"MSETNX", -3, CMD_WRITE, cmd_msetnx, 1, -1, 2});
+    register_command({"INCR", 2, CMD_WRITE, cmd_incr, 1, 1, 1});
+    register_command({"DECR", 2, CMD_WRITE, cmd_decr, 1, 1, 1});
+    register_command({"INCRBY", 3, CMD_WRITE, cmd_incrby, 1, 1, 1});
+    register_command({"DECRBY", 3, CMD_WRITE, cmd_decrby, 1, 1, 1});
+    register_command({"INCRBYFLOAT", 3, CMD_WRITE, cmd_incrbyfloat, 1, 1, 1});
+}
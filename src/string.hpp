@@ -0,0 +1,6 @@
+#pragma once
+
+// Commands on plain string values: SET, GET and their variants (GETEX,
+// GETDEL, APPEND, SETRANGE), the multi-key MGET, MSET and MSETNX, and the
+// INCR family of counters.
+void register_string_commands();
@@ -0,0 +1,179 @@
+#include "util.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+bool string_to_int64(std::string_view str, int64_t& value) {
+    if (str.empty() || str.size() > 20) return false;
+
+    size_t digits = str[0] == '-' ? 1 : 0;
+    if (digits == str.size()) return false;
+    // No leading zeros and no "-0", so the string round-trips exactly
+    if (str[digits] == '0' && str.size() > 1) return false;
+
+    auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+// Longest float text accepted, as in Redis. Plain notation, which
+// INCRBYFLOAT stores, runs to about 330 characters for extreme doubles.
+static constexpr size_t MAX_DOUBLE_CHARS = 5 * 1024;
+
+bool string_to_double(std::string_view str, double& value) {
+    if (str.empty() || str.size() > MAX_DOUBLE_CHARS || std::isspace(static_cast<unsigned char>(str[0]))) {
+        return false;
+    }
+
+    // strtod needs a terminator; most values fit the stack buffer
+    char small[257];
+    std::string large;
+    char* buf = small;
+    if (str.size() < sizeof(small)) {
+        std::memcpy(small, str.data(), str.size());
+        small[str.size()] = '\0';
+    } else {
+        large.assign(str);
+        buf = large.data();
+    }
+    char* end;
+    errno = 0;
+    value = std::strtod(buf, &end);
+    if (end != buf + str.size() || std::isnan(value)) return false;
+    // Overflow and underflow are errors, a literal "inf" sets no errno
+    return !(errno == ERANGE && (std::isinf(value) || value == 0));
+}
+
+std::string double_to_string(double value) {
+    char buf[32];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    return std::string(buf, ptr);
+}
+
+bool normalize_range(int64_t& start, int64_t& stop, int64_t len) {
+    if (start < 0) start += len;
+    if (stop < 0) stop += len;
+    if (start < 0) start = 0;
+    if (stop >= len) stop = len - 1;
+    return start <= stop && start < len;
+}
+
+uint64_t murmur_hash64a(std::string_view data, uint64_t seed) {
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ULL;
+    constexpr int r = 47;
+    uint64_t h = seed ^ (data.size() * m);
+
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    const uint8_t* end = p + (data.size() & ~size_t(7));
+    for (; p != end; p += 8) {
+        uint64_t k;
+        std::memcpy(&k, p, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    size_t tail = data.size() & 7;
+    if (tail) {
+        for (size_t i = tail; i-- > 0;) h ^= uint64_t(p[i]) << (8 * i);
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+GlobPattern::GlobPattern(std::string_view pattern) {
+    size_t i = 0;
+    for (; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (c == '*' || c == '?' || c == '[') break;
+        // A trailing backslash stands for itself
+        if (c == '\\' && i + 1 < pattern.size()) c = pattern[++i];
+        prefix_ += c;
+    }
+    rest_ = pattern.substr(i);
+    literal_ = rest_.empty();
+}
+
+// Whether c matches the single-character token at pattern[p], setting
+// next to the position after the token
+static bool glob_match_one(std::string_view pattern, size_t p, char c, size_t& next) {
+    if (pattern[p] == '?') {
+        next = p + 1;
+        return true;
+    }
+    if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+        next = p + 2;
+        return pattern[p + 1] == c;
+    }
+    if (pattern[p] != '[') {
+        next = p + 1;
+        return pattern[p] == c;
+    }
+
+    // A class runs to the next unescaped ], or to the end of the pattern
+    p++;
+    bool negate = p < pattern.size() && pattern[p] == '^';
+    if (negate) p++;
+    bool found = false;
+    for (; p < pattern.size() && pattern[p] != ']'; p++) {
+        if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+            found |= pattern[++p] == c;
+        } else if (p + 2 < pattern.size() && pattern[p + 1] == '-') {
+            auto lo = static_cast<unsigned char>(pattern[p]);
+            auto hi = static_cast<unsigned char>(pattern[p + 2]);
+            if (lo > hi) std::swap(lo, hi);
+            found |= static_cast<unsigned char>(c) >= lo && static_cast<unsigned char>(c) <= hi;
+            p += 2;
+        } else {
+            found |= pattern[p] == c;
+        }
+    }
+    next = p < pattern.size() ? p + 1 : p;
+    return found != negate;
+}
+
+// Every token but * consumes exactly one character, so on a mismatch it is
+// enough to let the most recent * absorb one more character and retry
+// from there: linear in the string for each *, never exponential.
+static bool glob_match(std::string_view pattern, std::string_view str) {
+    size_t p = 0, s = 0;
+    size_t star_p = std::string_view::npos, star_s = 0;
+    while (s < str.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            while (p < pattern.size() && pattern[p] == '*') p++;
+            if (p == pattern.size()) return true;
+            star_p = p;
+            star_s = s;
+            continue;
+        }
+        size_t next;
+        if (p < pattern.size() && glob_match_one(pattern, p, str[s], next)) {
+            p = next;
+            s++;
+            continue;
+        }
+        if (star_p == std::string_view::npos) return false;
+        p = star_p;
+        s = ++star_s;
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
+
+bool GlobPattern::matches(std::string_view str) const {
+    if (str.size() < prefix_.size() || std::memcmp(str.data(), prefix_.data(), prefix_.size()) != 0) {
+        return false;
+    }
+    if (literal_) return str.size() == prefix_.size();
+    return glob_match(rest_, str.substr(prefix_.size()));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Parse a decimal integer the way Redis does for arguments: no sign other
+// than '-', no leading zeros, so the string round-trips exactly. Listpacks
+// store exactly these strings as integers.
+bool string_to_int64(std::string_view str, int64_t& value);
+
+// Parse a score or float argument: anything strtod takes, including
+// "inf" and "-inf", but not NaN, whitespace or trailing junk
+bool string_to_double(std::string_view str, double& value);
+
+// Shortest string that parses back to the same double
+std::string double_to_string(double value);
+
+// Clamp a start/stop index pair, negative counting from the end, to a
+// sequence of len elements. False if nothing is left.
+bool normalize_range(int64_t& start, int64_t& stop, int64_t len);
+
+// MurmurHash64A, the hash Redis uses for HyperLogLogs
+uint64_t murmur_hash64a(std::string_view data, uint64_t seed);
+
+// A glob-style pattern as SCAN MATCH takes it: * and ? wildcards, [abc]
+// and [a-z] classes negated by ^, and \ escaping the next character.
+// The literal text before the first wildcard is split off and compared up
+// front, so a pattern like "user:42:*" rejects most strings with one
+// memcmp and a pattern without wildcards is a plain comparison.
+class GlobPattern {
+public:
+    explicit GlobPattern(std::string_view pattern);
+
+    bool matches(std::string_view str) const;
+    // Matches exactly one string, literal_prefix()
+    bool is_literal() const { return literal_; }
+    const std::string& literal_prefix() const { return prefix_; }
+
+private:
+    std::string prefix_;  // unescaped
+    std::string rest_;    // the pattern from the first wildcard on
+    bool literal_;
+};
@@ -0,0 +1,624 @@
+#include "zset.hpp"
+
+#include <cmath>
+
+#include "resp.hpp"
+#include "server.hpp"
+#include "util.hpp"
+
+ZSetObject::ZSetObject(size_t max_entries, size_t max_value, bool use_btree) :
+    max_entries_(max_entries), max_value_(max_value), use_btree_(use_btree) {}
+
+double ZSetObject::listpack_score(size_t pos) const {
+    ListPackEntry entry = entries_.get(pos);
+    if (entry.is_int) return static_cast<double>(entry.integer);
+    double score = 0;
+    string_to_double(entry.str, score);
+    return score;
+}
+
+void ZSetObject::index_insert(double score, const std::string* member) {
+    if (tree_) {
+        tree_->insert(score, member);
+    } else {
+        list_->insert(score, member);
+    }
+}
+
+void ZSetObject::index_erase(double score, std::string_view member) {
+    if (tree_) {
+        tree_->erase(score, member);
+    } else {
+        list_->erase(score, member);
+    }
+}
+
+void ZSetObject::convert() {
+    auto dict = std::make_unique<Dict<double>>();
+    dict->reserve(size());
+    if (use_btree_) {
+        tree_ = std::make_unique<BPlusTree>();
+    } else {
+        list_ = std::make_unique<SkipList>();
+    }
+    // Highest first, so each skiplist insert lands right behind the header
+    for_range(0, size(), true, [&](const ListPackEntry& member, double score) {
+        auto it = dict->emplace(member.to_string(), score).first;
+        index_insert(score, &it->first);
+    });
+    dict_ = std::move(dict);
+    ListPack().swap(entries_);
+}
+
+bool ZSetObject::score(const std::string& member, double& score) const {
+    if (dict_) {
+        auto it = dict_->find(member);
+        if (it == dict_->end()) return false;
+        score = it->second;
+        return true;
+    }
+
+    size_t pos = entries_.find(entries_.first(), member, 1);
+    if (pos == ListPack::npos) return false;
+    score = listpack_score(entries_.next(pos));
+    return true;
+}
+
+bool ZSetObject::set(const std::string& member, double score) {
+    if (!dict_) {
+        size_t pos = entries_.find(entries_.first(), member, 1);
+        bool added = pos == ListPack::npos;
+        if (!added) {
+            if (listpack_score(entries_.next(pos)) == score) return false;
+            entries_.erase(pos, 2);
+        }
+
+        if (!added || (size() < max_entries_ && member.size() <= max_value_)) {
+            // Insert in front of the first element that sorts after it
+            size_t at = entries_.first();
+            while (at != ListPack::npos) {
+                double other = listpack_score(entries_.next(at));
+                if (other > score || (other == score && entries_.get(at).to_string() > member)) break;
+                at = entries_.next(entries_.next(at));
+            }
+            at = entries_.insert(at, member);
+            entries_.insert(entries_.next(at), double_to_string(score));
+            return added;
+        }
+        convert();
+    }
+
+    auto [it, added] = dict_->try_emplace(member, score);
+    if (added) {
+        index_insert(score, &it->first);
+        return true;
+    }
+    if (it->second == score) return false;
+
+    if (tree_) {
+        tree_->erase(it->second, member);
+        tree_->insert(score, &it->first);
+    } else {
+        list_->update_score(it->second, member, score);
+    }
+    it->second = score;
+    return false;
+}
+
+bool ZSetObject::erase(const std::string& member) {
+    if (dict_) {
+        auto it = dict_->find(member);
+        if (it == dict_->end()) return false;
+        // The index points at the key, drop it from there first
+        index_erase(it->second, member);
+        dict_->erase(it);
+        dict_->shrink();
+        return true;
+    }
+
+    size_t pos = entries_.find(entries_.first(), member, 1);
+    if (pos == ListPack::npos) return false;
+    entries_.erase(pos, 2);
+    return true;
+}
+
+bool ZSetObject::rank(const std::string& member, size_t& rank) const {
+    if (dict_) {
+        auto it = dict_->find(member);
+        if (it == dict_->end()) return false;
+        rank = tree_ ? tree_->rank(it->second, member) : list_->rank(it->second, member);
+        return true;
+    }
+
+    rank = 0;
+    for (size_t pos = entries_.first(); pos != ListPack::npos; pos = entries_.next(entries_.next(pos)), rank++) {
+        if (entries_.get(pos).equals(member)) return true;
+    }
+    return false;
+}
+
+size_t ZSetObject::count_by_score(double score, bool or_equal) const {
+    auto before = [&](double other) { return or_equal ? other <= score : other < score; };
+    if (dict_) {
+        return index_count_before([&](double other, std::string_view) { return before(other); });
+    }
+
+    size_t count = 0;
+    for (size_t pos = entries_.first(); pos != ListPack::npos; pos = entries_.next(entries_.next(pos))) {
+        if (!before(listpack_score(entries_.next(pos)))) break;
+        count++;
+    }
+    return count;
+}
+
+size_t ZSetObject::count_by_lex(std::string_view member, bool or_equal) const {
+    auto before = [&](std::string_view other) { return or_equal ? other <= member : other < member; };
+    if (dict_) {
+        return index_count_before([&](double, std::string_view other) { return before(other); });
+    }
+
+    size_t count = 0;
+    for (size_t pos = entries_.first(); pos != ListPack::npos; pos = entries_.next(entries_.next(pos))) {
+        if (!before(entries_.get(pos).to_string())) break;
+        count++;
+    }
+    return count;
+}
+
+bool ZSetObject::assign(ListPack entries) {
+    if (entries.size() % 2 != 0) return false;
+
+    entries_ = std::move(entries);
+    bool too_big = size() > max_entries_;
+    for (size_t pos = entries_.first(); pos != ListPack::npos; pos = entries_.next(entries_.next(pos))) {
+        ListPackEntry score = entries_.get(entries_.next(pos));
+        double unused;
+        if (!score.is_int && !string_to_double(score.str, unused)) return false;
+        if (entries_.get(pos).str.size() > max_value_) too_big = true;
+    }
+    if (too_big) convert();
+    return true;
+}
+
+size_t ZSetObject::memory_usage() const {
+    size_t bytes = sizeof(*this) + entries_.data().capacity();
+    if (dict_) {
+        bytes += tree_ ? tree_->memory_usage() : list_->memory_usage();
+        // Map node: next pointer, the pair, cached hash
+        bytes += sizeof(*dict_) + dict_->bucket_count() * sizeof(void*);
+        bytes += dict_->size() * (sizeof(void*) + sizeof(size_t) + sizeof(std::pair<const std::string, double>));
+        for (const auto& [member, score] : *dict_) bytes += string_heap_bytes(member);
+    }
+    return bytes;
+}
+
+std::unique_ptr<ZSetObject> make_zset() {
+    return std::make_unique<ZSetObject>(server_config.zset_max_listpack_entries, server_config.zset_max_listpack_value,
+                                        server_config.zset_use_btree);
+}
+
+// Sorted set at key for a write, created if missing unless create is false.
+// Sets error on a type mismatch.
+static ZSetObject* zset_for_write(const std::string& key, bool create, std::string& error) {
+    ValueWithExpiry* value = lookup_key_write(key);
+    if (value && value->type != ValueType::ZSet) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    if (!value) {
+        if (!create) return nullptr;
+        value = &(kv_store[key] = ValueWithExpiry(ValueType::ZSet, make_zset()));
+    }
+    return &value->as<ZSetObject>();
+}
+
+static const ZSetObject* zset_for_read(const std::string& key, ClientContext& client, std::string& error) {
+    ValueWithExpiry* value = lookup_key_read(key, client);
+    if (!value) return nullptr;
+    if (value->type != ValueType::ZSet) {
+        error = WRONGTYPE_ERROR;
+        return nullptr;
+    }
+    return &value->as<ZSetObject>();
+}
+
+static std::string score_reply(double score) {
+    return resp_bulk(double_to_string(score));
+}
+
+// A score range endpoint: "(" makes it exclusive, "-inf" and "+inf" work
+struct ScoreBound {
+    double value;
+    bool exclusive;
+};
+
+static bool parse_score_bound(const std::string& arg, ScoreBound& bound) {
+    bound.exclusive = !arg.empty() && arg[0] == '(';
+    return string_to_double(std::string_view(arg).substr(bound.exclusive), bound.value);
+}
+
+// A lex range endpoint: "[member" or "(member", or "-" and "+" for the ends
+struct LexBound {
+    std::string value;
+    bool exclusive = false;
+    int infinity = 0;
+};
+
+static bool parse_lex_bound(const std::string& arg, LexBound& bound) {
+    if (arg == "-" || arg == "+") {
+        bound.infinity = arg == "-" ? -1 : 1;
+        return true;
+    }
+    if (arg.empty() || (arg[0] != '[' && arg[0] != '(')) return false;
+    bound.exclusive = arg[0] == '(';
+    bound.value = arg.substr(1);
+    return true;
+}
+
+// Ranks [start, end) of the members inside a score range
+static void score_range_ranks(const ZSetObject& zset, const ScoreBound& min, const ScoreBound& max, size_t& start,
+                              size_t& end) {
+    start = zset.count_by_score(min.value, min.exclusive);
+    end = zset.count_by_score(max.value, !max.exclusive);
+    if (end < start) end = start;
+}
+
+static size_t lex_count(const ZSetObject& zset, const LexBound& bound, bool or_equal) {
+    if (bound.infinity) return bound.infinity < 0 ? 0 : zset.size();
+    return zset.count_by_lex(bound.value, or_equal);
+}
+
+enum ZAddFlags : unsigned {
+    ZADD_NX = 1 << 0,
+    ZADD_XX = 1 << 1,
+    ZADD_GT = 1 << 2,
+    ZADD_LT = 1 << 3,
+    ZADD_CH = 1 << 4,
+    ZADD_INCR = 1 << 5,
+};
+
+// Score/member pairs from parts[first] on, applied with ZADD semantics
+static std::string zadd_generic(const std::vector<std::string>& parts, size_t first, unsigned flags) {
+    if (first >= parts.size() || (parts.size() - first) % 2 != 0) return "-ERR syntax error\r\n";
+    if ((flags & ZADD_NX) && (flags & ZADD_XX)) {
+        return "-ERR XX and NX options at the same time are not compatible\r\n";
+    }
+    if (((flags & ZADD_GT) && (flags & ZADD_LT)) || ((flags & ZADD_NX) && (flags & (ZADD_GT | ZADD_LT)))) {
+        return "-ERR GT, LT, and/or NX options at the same time are not compatible\r\n";
+    }
+    if ((flags & ZADD_INCR) && parts.size() - first != 2) {
+        return "-ERR INCR option supports a single increment-element pair\r\n";
+    }
+
+    std::vector<double> scores;
+    for (size_t i = first; i < parts.size(); i += 2) {
+        double score;
+        if (!string_to_double(parts[i], score)) return "-ERR value is not a valid float\r\n";
+        scores.push_back(score);
+    }
+
+    std::string error;
+    ZSetObject* zset = zset_for_write(parts[1], !(flags & ZADD_XX), error);
+    if (!zset) {
+        if (!error.empty()) return error;
+        return (flags & ZADD_INCR) ? resp_null() : resp_integer(0);
+    }
+
+    int64_t added = 0;
+    int64_t updated = 0;
+    bool applied = false;
+    double result = 0;
+    for (size_t i = 0; i < scores.size(); i++) {
+        const std::string& member = parts[first + 2 * i + 1];
+        double score = scores[i];
+        double current;
+        if (zset->score(member, current)) {
+            if (flags & ZADD_NX) continue;
+            if (flags & ZADD_INCR) {
+                score += current;
+                if (std::isnan(score)) {
+                    error = "-ERR resulting score is not a number (NaN)\r\n";
+                    break;
+                }
+            }
+            if (((flags & ZADD_GT) && score <= current) || ((flags & ZADD_LT) && score >= current)) continue;
+            if (score != current) {
+                zset->set(member, score);
+                updated++;
+            }
+        } else {
+            if (flags & ZADD_XX) continue;
+            zset->set(member, score);
+            added++;
+        }
+        applied = true;
+        result = score;
+    }
+
+    if (zset->size() == 0) kv_store.erase(parts[1]);
+    if (!error.empty()) return error;
+    if (flags & ZADD_INCR) return applied ? score_reply(result) : resp_null();
+    return resp_integer((flags & ZADD_CH) ? added + updated : added);
+}
+
+// ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+static std::string cmd_zadd(const std::vector<std::string>& parts, ClientContext& client) {
+    unsigned flags = 0;
+    size_t i = 2;
+    for (; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "NX") {
+            flags |= ZADD_NX;
+        } else if (option == "XX") {
+            flags |= ZADD_XX;
+        } else if (option == "GT") {
+            flags |= ZADD_GT;
+        } else if (option == "LT") {
+            flags |= ZADD_LT;
+        } else if (option == "CH") {
+            flags |= ZADD_CH;
+        } else if (option == "INCR") {
+            flags |= ZADD_INCR;
+        } else {
+            break;
+        }
+    }
+    return zadd_generic(parts, i, flags);
+}
+
+// ZINCRBY key increment member
+static std::string cmd_zincrby(const std::vector<std::string>& parts, ClientContext& client) {
+    return zadd_generic(parts, 2, ZADD_INCR);
+}
+
+// ZREM key member [member ...]
+static std::string cmd_zrem(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    ZSetObject* zset = zset_for_write(parts[1], false, error);
+    if (!zset) return error.empty() ? resp_integer(0) : error;
+
+    int64_t removed = 0;
+    for (size_t i = 2; i < parts.size(); i++) {
+        removed += zset->erase(parts[i]);
+    }
+    if (zset->size() == 0) kv_store.erase(parts[1]);
+    return resp_integer(removed);
+}
+
+static std::string cmd_zscore(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_null() : error;
+
+    double score;
+    if (!zset->score(parts[2], score)) return resp_null();
+    return score_reply(score);
+}
+
+static std::string cmd_zcard(const std::vector<std::string>& parts, ClientContext& client) {
+    std::string error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_integer(0) : error;
+    return resp_integer(zset->size());
+}
+
+// ZRANK/ZREVRANK key member [WITHSCORE]
+static std::string rank_generic(const std::vector<std::string>& parts, ClientContext& client, bool reverse) {
+    bool with_score = false;
+    if (parts.size() == 4) {
+        if (to_upper(parts[3]) != "WITHSCORE") return "-ERR syntax error\r\n";
+        with_score = true;
+    } else if (parts.size() > 4) {
+        return "-ERR syntax error\r\n";
+    }
+
+    std::string error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_null() : error;
+
+    size_t rank;
+    if (!zset->rank(parts[2], rank)) return resp_null();
+    if (reverse) rank = zset->size() - 1 - rank;
+    if (!with_score) return resp_integer(rank);
+
+    double score;
+    zset->score(parts[2], score);
+    return resp_array_header(2) + resp_integer(rank) + score_reply(score);
+}
+
+static std::string cmd_zrank(const std::vector<std::string>& parts, ClientContext& client) {
+    return rank_generic(parts, client, false);
+}
+
+static std::string cmd_zrevrank(const std::vector<std::string>& parts, ClientContext& client) {
+    return rank_generic(parts, client, true);
+}
+
+// ZCOUNT key min max
+static std::string cmd_zcount(const std::vector<std::string>& parts, ClientContext& client) {
+    ScoreBound min, max;
+    if (!parse_score_bound(parts[2], min) || !parse_score_bound(parts[3], max)) {
+        return "-ERR min or max is not a float\r\n";
+    }
+
+    std::string error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_integer(0) : error;
+
+    size_t start, end;
+    score_range_ranks(*zset, min, max, start, end);
+    return resp_integer(end - start);
+}
+
+// ZPOPMIN/ZPOPMAX key [count]
+static std::string pop_generic(const std::vector<std::string>& parts, bool max) {
+    if (parts.size() > 3) return "-ERR syntax error\r\n";
+    int64_t count = 1;
+    if (parts.size() == 3 && (!string_to_int64(parts[2], count) || count < 0)) {
+        return "-ERR value is out of range, must be positive\r\n";
+    }
+
+    std::string error;
+    ZSetObject* zset = zset_for_write(parts[1], false, error);
+    if (!zset) return error.empty() ? resp_array_header(0) : error;
+
+    size_t n = std::min<size_t>(count, zset->size());
+    std::vector<std::string> members;
+    std::string reply = resp_array_header(2 * n);
+    size_t start = max ? zset->size() - n : 0;
+    zset->for_range(start, start + n, max, [&](const ListPackEntry& member, double score) {
+        members.push_back(member.to_string());
+        reply += resp_bulk(member) + score_reply(score);
+    });
+
+    for (const auto& member : members) zset->erase(member);
+    if (zset->size() == 0) kv_store.erase(parts[1]);
+    return reply;
+}
+
+static std::string cmd_zpopmin(const std::vector<std::string>& parts, ClientContext& client) {
+    return pop_generic(parts, false);
+}
+
+static std::string cmd_zpopmax(const std::vector<std::string>& parts, ClientContext& client) {
+    return pop_generic(parts, true);
+}
+
+// ZRANGE key start stop [BYSCORE | BYLEX] [REV] [LIMIT offset count] [WITHSCORES]
+//
+// Every form comes down to a run of ranks [start, end) in ascending order,
+// which is then walked from either end. With REV the score and lex
+// bounds are given max first.
+static std::string cmd_zrange(const std::vector<std::string>& parts, ClientContext& client) {
+    enum { BY_RANK, BY_SCORE, BY_LEX } by = BY_RANK;
+    bool reverse = false;
+    bool with_scores = false;
+    bool has_limit = false;
+    int64_t offset = 0;
+    int64_t limit = -1;
+    for (size_t i = 4; i < parts.size(); i++) {
+        std::string option = to_upper(parts[i]);
+        if (option == "BYSCORE" && by == BY_RANK) {
+            by = BY_SCORE;
+        } else if (option == "BYLEX" && by == BY_RANK) {
+            by = BY_LEX;
+        } else if (option == "REV") {
+            reverse = true;
+        } else if (option == "WITHSCORES") {
+            with_scores = true;
+        } else if (option == "LIMIT" && i + 2 < parts.size()) {
+            if (!string_to_int64(parts[i + 1], offset) || !string_to_int64(parts[i + 2], limit)) {
+                return "-ERR value is not an integer or out of range\r\n";
+            }
+            has_limit = true;
+            i += 2;
+        } else {
+            return "-ERR syntax error\r\n";
+        }
+    }
+    if (has_limit && by == BY_RANK) {
+        return "-ERR syntax error, LIMIT is only supported in combination with either BYSCORE or BYLEX\r\n";
+    }
+    if (with_scores && by == BY_LEX) {
+        return "-ERR syntax error, WITHSCORES not supported in combination with BYLEX\r\n";
+    }
+
+    const std::string& low = reverse && by != BY_RANK ? parts[3] : parts[2];
+    const std::string& high = reverse && by != BY_RANK ? parts[2] : parts[3];
+    int64_t first_index = 0, last_index = 0;
+    ScoreBound min_score, max_score;
+    LexBound min_lex, max_lex;
+    if (by == BY_RANK) {
+        if (!string_to_int64(low, first_index) || !string_to_int64(high, last_index)) {
+            return "-ERR value is not an integer or out of range\r\n";
+        }
+    } else if (by == BY_SCORE) {
+        if (!parse_score_bound(low, min_score) || !parse_score_bound(high, max_score)) {
+            return "-ERR min or max is not a float\r\n";
+        }
+    } else if (!parse_lex_bound(low, min_lex) || !parse_lex_bound(high, max_lex)) {
+        return "-ERR min or max not valid string range item\r\n";
+    }
+
+    std::string error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? resp_array_header(0) : error;
+
+    size_t size = zset->size();
+    size_t start = 0, end = 0;
+    if (by == BY_RANK) {
+        if (normalize_range(first_index, last_index, size)) {
+            // Indexes count from the top with REV
+            start = reverse ? size - 1 - last_index : first_index;
+            end = reverse ? size - first_index : last_index + 1;
+        }
+    } else if (by == BY_SCORE) {
+        score_range_ranks(*zset, min_score, max_score, start, end);
+    } else {
+        start = lex_count(*zset, min_lex, min_lex.exclusive);
+        end = std::max(start, lex_count(*zset, max_lex, !max_lex.exclusive));
+    }
+
+    if (offset < 0) return resp_array_header(0);
+    size_t skip = std::min<size_t>(offset, end - start);
+    if (reverse) {
+        end -= skip;
+    } else {
+        start += skip;
+    }
+    if (limit >= 0 && end - start > static_cast<size_t>(limit)) {
+        if (reverse) {
+            start = end - limit;
+        } else {
+            end = start + limit;
+        }
+    }
+
+    std::string reply = resp_array_header((end - start) * (with_scores ? 2 : 1));
+    zset->for_range(start, end, reverse, [&](const ListPackEntry& member, double score) {
+        reply += resp_bulk(member);
+        if (with_scores) reply += score_reply(score);
+    });
+    return reply;
+}
+
+// ZSCAN key cursor [MATCH pattern] [COUNT count]
+static std::string cmd_zscan(const std::vector<std::string>& parts, ClientContext& client) {
+    ScanArgs args;
+    std::string error = parse_scan_args(parts, 2, args);
+    if (!error.empty()) return error;
+    const ZSetObject* zset = zset_for_read(parts[1], client, error);
+    if (!zset) return error.empty() ? scan_reply(0, 0, "") : error;
+
+    std::string items, scratch;
+    size_t count = 0;
+    auto visit = [&](const ListPackEntry& member, double score) {
+        if (args.match && !args.match->matches(member.text(scratch))) return;
+        resp_append_bulk(items, member);
+        resp_append_bulk(items, double_to_string(score));
+        count += 2;
+    };
+
+    // A listpack is small enough to return whole
+    if (zset->is_listpack()) {
+        zset->for_range(0, zset->size(), false, visit);
+        return scan_reply(0, count, items);
+    }
+    uint64_t cursor = scan_bounded(args, [&](uint64_t at, const auto& step) { return zset->scan(at, step); }, visit);
+    return scan_reply(cursor, count, items);
+}
+
+void register_zset_commands() {
+    register_command({"ZADD", -4, CMD_WRITE, cmd_zadd, 1, 1, 1});
+    register_command({"ZINCRBY", 4, CMD_WRITE, cmd_zincrby, 1, 1, 1});
+    register_command({"ZREM", -3, CMD_WRITE, cmd_zrem, 1, 1, 1});
+    register_command({"ZSCORE", 3, CMD_READONLY, cmd_zscore, 1, 1, 1});
+    register_command({"ZCARD", 2, CMD_READONLY, cmd_zcard, 1, 1, 1});
+    register_command({"ZRANK", -3, CMD_READONLY, cmd_zrank, 1, 1, 1});
+    register_command({"ZREVRANK", -3, CMD_READONLY, cmd_zrevrank, 1, 1, 1});
+    register_command({"ZCOUNT", 4, CMD_READONLY, cmd_zcount, 1, 1, 1});
+    register_command({"ZPOPMIN", -2, CMD_WRITE, cmd_zpopmin, 1, 1, 1});
+    register_command({"ZPOPMAX", -2, CMD_WRITE, cmd_zpopmax, 1, 1, 1});
+    register_command({"ZRANGE", -4, CMD_READONLY, cmd_zrange, 1, 1, 1});
+    register_command({"ZSCAN", -3, CMD_READONLY, cmd_zscan, 1, 1, 1});
+}
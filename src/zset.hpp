@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "bplustree.hpp"
+#include "dict.hpp"
+#include "listpack.hpp"
+#include "skiplist.hpp"
+#include "store.hpp"
+
+// A sorted set is a listpack of alternating members and scores, kept in
+// order, while it is small. Past max_entries members or a member longer
+// than max_value bytes it becomes a hash map from member to score plus an
+// ordered index for ranks and ranges: a skiplist, or a B+tree when
+// use_btree is set. The index points at the map's keys, so each member is
+// stored once.
+class ZSetObject : public DataObject {
+public:
+    ZSetObject(size_t max_entries, size_t max_value, bool use_btree);
+
+    size_t size() const { return dict_ ? dict_->size() : entries_.size() / 2; }
+    bool is_listpack() const { return !dict_; }
+    const ListPack& listpack() const { return entries_; }
+
+    bool score(const std::string& member, double& score) const;
+    // Add a member or move it to a new score, true if it was added
+    bool set(const std::string& member, double score);
+    bool erase(const std::string& member);
+
+    // 0-based rank in ascending order, false if member is missing
+    bool rank(const std::string& member, size_t& rank) const;
+    // Number of members scoring below score, or up to it with or_equal
+    size_t count_by_score(double score, bool or_equal) const;
+    // Number of members that sort before member, or up to it with or_equal.
+    // Only meaningful when all members share one score.
+    size_t count_by_lex(std::string_view member, bool or_equal) const;
+
+    // Call visit(member, score) for the ranks in [start, end), from the
+    // highest down when reverse
+    template <typename F>
+    void for_range(size_t start, size_t end, bool reverse, F&& visit) const;
+    // Call visit(score, member) for the ranks in [start, end) in ascending
+    // order, where member() fetches the member. For scans that filter on
+    // scores: the skiplist and B+tree keep members out of line, and each
+    // one not fetched is a cache miss saved.
+    template <typename F>
+    void for_range_scores(size_t start, size_t end, F&& visit) const;
+    // One step of a cursor scan over the hash map encoding, calling
+    // visit(member, score) in hash order; see Dict::scan
+    template <typename F>
+    uint64_t scan(uint64_t cursor, F&& visit) const;
+
+    // Adopt a listpack loaded from RDB, converting it if it is over the limits
+    bool assign(ListPack entries);
+
+    size_t memory_usage() const override;
+    const char* encoding() const override { return tree_ ? "btree" : list_ ? "skiplist" : "listpack"; }
+
+private:
+    void convert();
+    double listpack_score(size_t pos) const;
+    // Add to or remove from whichever index is in use
+    void index_insert(double score, const std::string* member);
+    void index_erase(double score, std::string_view member);
+    template <typename F>
+    size_t index_count_before(F&& before) const;
+
+    ListPack entries_;
+    std::unique_ptr<Dict<double>> dict_;
+    std::unique_ptr<SkipList> list_;
+    std::unique_ptr<BPlusTree> tree_;
+    size_t max_entries_;
+    size_t max_value_;
+    bool use_btree_;
+};
+
+template <typename F>
+void ZSetObject::for_range(size_t start, size_t end, bool reverse, F&& visit) const {
+    if (start >= end) return;
+
+    if (!dict_) {
+        size_t pos = entries_.seek(2 * (reverse ? end - 1 : start));
+        for (size_t n = end - start; n > 0; n--) {
+            visit(entries_.get(pos), listpack_score(entries_.next(pos)));
+            if (n > 1) pos = reverse ? entries_.prev(entries_.prev(pos)) : entries_.next(entries_.next(pos));
+        }
+        return;
+    }
+
+    ListPackEntry member;
+    if (tree_) {
+        BPlusTree::Cursor cursor = tree_->at_rank(reverse ? end - 1 : start);
+        for (size_t n = end - start; n > 0 && cursor.valid(); n--) {
+            member.str = cursor.member();
+            visit(member, cursor.score());
+            if (reverse) {
+                cursor.prev();
+            } else {
+                cursor.next();
+            }
+        }
+        return;
+    }
+
+    const SkipList::Node* node = list_->at_rank(reverse ? end - 1 : start);
+    for (size_t n = end - start; n > 0 && node; n--) {
+        member.str = *node->member;
+        visit(member, node->score);
+        node = reverse ? node->prev() : node->next();
+    }
+}
+
+template <typename F>
+void ZSetObject::for_range_scores(size_t start, size_t end, F&& visit) const {
+    if (start >= end) return;
+
+    if (!dict_) {
+        size_t pos = entries_.seek(2 * start);
+        for (size_t n = end - start; n > 0; n--) {
+            size_t score_pos = entries_.next(pos);
+            visit(listpack_score(score_pos), [&] { return entries_.get(pos); });
+            if (n > 1) pos = entries_.next(score_pos);
+        }
+        return;
+    }
+
+    if (tree_) {
+        BPlusTree::Cursor cursor = tree_->at_rank(start);
+        for (size_t n = end - start; n > 0 && cursor.valid(); n--) {
+            visit(cursor.score(), [&] { return ListPackEntry{false, 0, cursor.member()}; });
+            cursor.next();
+        }
+        return;
+    }
+
+    const SkipList::Node* node = list_->at_rank(start);
+    for (size_t n = end - start; n > 0 && node; n--) {
+        visit(node->score, [&] { return ListPackEntry{false, 0, *node->member}; });
+        node = node->next();
+    }
+}
+
+template <typename F>
+uint64_t ZSetObject::scan(uint64_t cursor, F&& visit) const {
+    ListPackEntry member;
+    return dict_->scan(cursor, [&](const auto& entry) {
+        member.str = entry.first;
+        visit(member, entry.second);
+    });
+}
+
+template <typename F>
+size_t ZSetObject::index_count_before(F&& before) const {
+    return tree_ ? tree_->count_before(before) : list_->count_before(before);
+}
+
+// Empty sorted set with the configured conversion thresholds
+std::unique_ptr<ZSetObject> make_zset();
+
+void register_zset_commands();
@@ -0,0 +1,67 @@
+// INCRBYFLOAT stores its result in plain notation, which runs to hundreds
+// of characters for very small and very large doubles. Every value it
+// stores must read back, both for the next INCRBYFLOAT and for a client.
+//
+// Usage: incrbyfloat_test <path to server binary>
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "resp_client.hpp"
+#include "server_process.hpp"
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) throw std::runtime_error("line " + std::to_string(__LINE__) + ": " #cond);   \
+    } while (0)
+
+// Apply each increment in turn to a fresh key, checking every reply reads
+// back as the double the client would compute
+static void round_trip(RespClient& client, const std::string& key, const std::vector<std::string>& increments) {
+    double expected = 0;
+    for (const auto& increment : increments) {
+        RespReply reply = client.call({"INCRBYFLOAT", key, increment});
+        if (reply.is_error()) throw std::runtime_error(key + " += " + increment + ": " + reply.str);
+        expected += std::strtod(increment.c_str(), nullptr);
+        CHECK(std::strtod(reply.str.c_str(), nullptr) == expected);
+        CHECK(client.call({"GET", key}).str == reply.str);
+    }
+}
+
+static void run(const std::string& binary, const std::filesystem::path& dir) {
+    ServerProcess server(binary, free_port(), dir);
+    RespClient client(server.port());
+
+    round_trip(client, "small", {"1e-300", "0", "1e-300"});
+    round_trip(client, "smallest", {"4.9406564584124654e-324", "0"});
+    round_trip(client, "large", {"1e300", "1", "1"});
+    round_trip(client, "largest", {"1.7976931348623157e308", "0", "-1e308"});
+    // A small stored value plus 1 still parses, and rounds to 1
+    round_trip(client, "mixed", {"1e-300", "1"});
+    CHECK(client.call({"GET", "mixed"}).str == "1");
+
+    // Input past the limit is still refused
+    CHECK(client.call({"INCRBYFLOAT", "small", std::string(6000, '1')}).is_error());
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <server binary>\n";
+        return 2;
+    }
+    std::filesystem::path dir = make_temp_dir("incrbyfloat-test");
+    try {
+        run(argv[1], dir);
+        std::cout << "incrbyfloat test passed\n";
+    } catch (const std::exception& e) {
+        std::cerr << "incrbyfloat test failed: " << e.what() << "\n";
+        std::cerr << "server log kept in " << dir << "\n";
+        return 1;
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
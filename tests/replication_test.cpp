@@ -0,0 +1,169 @@
+// Master and replica on loopback: full sync, partial resync after the link
+// drops, and WAIT. The replica reaches its master through a proxy the test
+// can cut, which looks like a network blip to both ends.
+//
+// Usage: replication_test <path to server binary>
+
+#include <poll.h>
+
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "resp_client.hpp"
+#include "server_process.hpp"
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) throw std::runtime_error("line " + std::to_string(__LINE__) + ": " #cond);   \
+    } while (0)
+
+// Forwards connections from its own port to target's, until cut
+class Proxy {
+public:
+    explicit Proxy(int target) : target_(target), port_(free_port()) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port_));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 16) < 0) {
+            throw std::runtime_error("proxy can't listen");
+        }
+        acceptor_ = std::thread([this] { accept_loop(); });
+    }
+
+    ~Proxy() {
+        stopping_ = true;
+        shutdown(listen_fd_, SHUT_RDWR);
+        close(listen_fd_);
+        acceptor_.join();
+        cut();
+        for (auto& pump : pumps_) pump.join();
+    }
+
+    int port() const { return port_; }
+
+    // Drop every forwarded connection; new ones are still accepted
+    void cut() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int fd : open_fds_) shutdown(fd, SHUT_RDWR);
+    }
+
+private:
+    void accept_loop() {
+        while (!stopping_) {
+            int client = accept(listen_fd_, nullptr, nullptr);
+            if (client < 0) continue;
+            int server = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(target_));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (connect(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+                close(client);
+                close(server);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_fds_.push_back(client);
+            open_fds_.push_back(server);
+            pumps_.emplace_back([this, client, server] { pump(client, server); });
+        }
+    }
+
+    void pump(int a, int b) {
+        char chunk[16384];
+        struct pollfd fds[2] = {{a, POLLIN, 0}, {b, POLLIN, 0}};
+        while (poll(fds, 2, -1) > 0) {
+            bool open = true;
+            for (int i = 0; i < 2 && open; i++) {
+                if (!fds[i].revents) continue;
+                ssize_t n = recv(fds[i].fd, chunk, sizeof(chunk), 0);
+                open = n > 0 && send(fds[1 - i].fd, chunk, static_cast<size_t>(n), MSG_NOSIGNAL) == n;
+            }
+            if (!open) break;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::erase(open_fds_, a);
+        std::erase(open_fds_, b);
+        close(a);
+        close(b);
+    }
+
+    int target_;
+    int port_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::vector<int> open_fds_;
+    std::vector<std::thread> pumps_;
+    std::thread acceptor_;
+};
+
+static std::string info(RespClient& client) { return client.call({"INFO"}).str; }
+
+static void run(const std::string& binary, const std::filesystem::path& dir) {
+    std::filesystem::create_directories(dir / "master");
+    std::filesystem::create_directories(dir / "replica");
+    ServerProcess master(binary, free_port(), dir / "master");
+    RespClient m(master.port());
+
+    // Data from before the replica exists arrives through the full sync
+    CHECK(m.call({"SET", "a", "1"}).str == "OK");
+    CHECK(m.call({"SET", "b", "hello world"}).str == "OK");
+    CHECK(m.call({"SET", "ttl", "x", "PX", "100000"}).str == "OK");
+
+    Proxy proxy(master.port());
+    ServerProcess replica(binary, free_port(), dir / "replica",
+                          {"--replicaof", "127.0.0.1 " + std::to_string(proxy.port())});
+    RespClient r(replica.port());
+    CHECK(eventually([&] { return info_field(info(r), "master_link_status") == "up"; }));
+    CHECK(r.call({"GET", "b"}).str == "hello world");
+    CHECK(r.call({"PTTL", "ttl"}).integer > 0);
+    CHECK(info_field(info(m), "sync_full") == "1");
+
+    // Then the stream, with WAIT counting the replica's acknowledgement
+    CHECK(m.call({"SET", "c", "3"}).str == "OK");
+    CHECK(m.call({"WAIT", "1", "5000"}).integer == 1);
+    CHECK(r.call({"GET", "c"}).str == "3");
+    // Asking for more replicas than there are waits out the timeout
+    CHECK(m.call({"WAIT", "2", "100"}).integer == 1);
+    CHECK(r.call({"SET", "c", "4"}).is_error());
+
+    // A blip: writes made while the link is down come from the backlog
+    proxy.cut();
+    CHECK(eventually([&] { return info_field(info(m), "connected_slaves") == "0"; }));
+    for (int i = 0; i < 100; i++) CHECK(m.call({"SET", "k" + std::to_string(i), std::to_string(i)}).str == "OK");
+    CHECK(eventually([&] { return r.call({"GET", "k99"}).str == "99"; }));
+    std::string master_info = info(m);
+    CHECK(info_field(master_info, "sync_partial_ok") == "1");
+    CHECK(info_field(master_info, "sync_full") == "1");
+    CHECK(info_field(info(r), "master_repl_offset") == info_field(master_info, "master_repl_offset"));
+    CHECK(m.call({"WAIT", "1", "5000"}).integer == 1);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: " << argv[0] << " <server binary>\n";
+        return 2;
+    }
+    std::filesystem::path dir = make_temp_dir("replication-test");
+    try {
+        run(argv[1], dir);
+        std::cout << "replication test passed\n";
+    } catch (const std::exception& e) {
+        std::cerr << "replication test failed: " << e.what() << "\n";
+        std::cerr << "server logs kept in " << dir << "\n";
+        return 1;
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
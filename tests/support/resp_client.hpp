@@ -0,0 +1,150 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A reply as the client reads it. Errors and statuses keep their text
+// without the leading '-' or '+'.
+struct RespReply {
+    enum class Type { Status, Error, Integer, Bulk, Null, Array };
+
+    Type type = Type::Null;
+    std::string str;
+    int64_t integer = 0;
+    std::vector<RespReply> elements;
+
+    bool is_null() const { return type == Type::Null; }
+    bool is_error() const { return type == Type::Error; }
+};
+
+// Blocking RESP client for the loopback tests and benchmarks. Throws
+// std::runtime_error when the connection fails, so a broken server fails
+// the test rather than hanging it.
+class RespClient {
+public:
+    explicit RespClient(int port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            if (fd_ >= 0) close(fd_);
+            throw std::runtime_error("can't connect to port " + std::to_string(port));
+        }
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    RespClient(const RespClient&) = delete;
+    RespClient& operator=(const RespClient&) = delete;
+    ~RespClient() { close(fd_); }
+
+    static void encode(std::string& out, const std::vector<std::string>& parts) {
+        out += "*" + std::to_string(parts.size()) + "\r\n";
+        for (const auto& part : parts) {
+            out += "$" + std::to_string(part.size()) + "\r\n";
+            out += part;
+            out += "\r\n";
+        }
+    }
+
+    void send_raw(const std::string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t n = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) throw std::runtime_error("send failed");
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void send(const std::vector<std::string>& parts) {
+        std::string out;
+        encode(out, parts);
+        send_raw(out);
+    }
+
+    RespReply read() {
+        std::string line = read_line();
+        RespReply reply;
+        std::string rest = line.substr(1);
+        switch (line[0]) {
+        case '+':
+            reply.type = RespReply::Type::Status;
+            reply.str = rest;
+            return reply;
+        case '-':
+            reply.type = RespReply::Type::Error;
+            reply.str = rest;
+            return reply;
+        case ':':
+            reply.type = RespReply::Type::Integer;
+            reply.integer = std::stoll(rest);
+            return reply;
+        case '$': {
+            int64_t len = std::stoll(rest);
+            if (len < 0) return reply;
+            reply.type = RespReply::Type::Bulk;
+            reply.str = read_exact(static_cast<size_t>(len) + 2);
+            reply.str.resize(static_cast<size_t>(len));
+            return reply;
+        }
+        case '*': {
+            int64_t len = std::stoll(rest);
+            if (len < 0) return reply;
+            reply.type = RespReply::Type::Array;
+            for (int64_t i = 0; i < len; i++) reply.elements.push_back(read());
+            return reply;
+        }
+        }
+        throw std::runtime_error("unexpected reply line: " + line);
+    }
+
+    RespReply call(const std::vector<std::string>& parts) {
+        send(parts);
+        return read();
+    }
+
+private:
+    void fill() {
+        char chunk[16384];
+        ssize_t n = ::recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) throw std::runtime_error("connection closed");
+        buffer_.append(chunk, static_cast<size_t>(n));
+    }
+
+    std::string read_line() {
+        size_t end;
+        while ((end = buffer_.find("\r\n", pos_)) == std::string::npos) fill();
+        std::string line = buffer_.substr(pos_, end - pos_);
+        consume(end + 2 - pos_);
+        return line;
+    }
+
+    std::string read_exact(size_t len) {
+        while (buffer_.size() - pos_ < len) fill();
+        std::string data = buffer_.substr(pos_, len);
+        consume(len);
+        return data;
+    }
+
+    void consume(size_t len) {
+        pos_ += len;
+        // Compact once the consumed prefix dominates, so long pipelines
+        // don't copy the buffer on every reply
+        if (pos_ > 65536 && pos_ * 2 > buffer_.size()) {
+            buffer_.erase(0, pos_);
+            pos_ = 0;
+        }
+    }
+
+    int fd_ = -1;
+    std::string buffer_;
+    size_t pos_ = 0;
+};
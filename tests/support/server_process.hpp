@@ -0,0 +1,121 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "resp_client.hpp"
+
+// A loopback port nothing listens on right now. The kernel picks it, so
+// tests running side by side don't collide.
+inline int free_port() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+        throw std::runtime_error("can't pick a free port");
+    }
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+// Fresh directory under the system temp dir, removed by the caller
+inline std::filesystem::path make_temp_dir(const std::string& prefix) {
+    std::string pattern = (std::filesystem::temp_directory_path() / (prefix + "-XXXXXX")).string();
+    if (!mkdtemp(pattern.data())) throw std::runtime_error("can't create a temp dir");
+    return pattern;
+}
+
+// A server started on a loopback port, in its own working directory, with
+// its output in server.log there. Stopped with SIGKILL when destroyed, like
+// a crash, so nothing depends on a clean shutdown.
+class ServerProcess {
+public:
+    ServerProcess(const std::string& binary, int port, const std::filesystem::path& dir,
+                  const std::vector<std::string>& extra = {})
+        : port_(port) {
+        std::vector<std::string> args = {binary, "--port", std::to_string(port), "--dir", dir.string()};
+        args.insert(args.end(), extra.begin(), extra.end());
+
+        pid_ = fork();
+        if (pid_ < 0) throw std::runtime_error("fork failed");
+        if (pid_ == 0) {
+            int log = open((dir / "server.log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (log >= 0) {
+                dup2(log, STDOUT_FILENO);
+                dup2(log, STDERR_FILENO);
+            }
+            std::vector<char*> argv;
+            for (auto& arg : args) argv.push_back(arg.data());
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+
+        // Ready once it accepts connections
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (true) {
+            try {
+                RespClient probe(port_);
+                return;
+            } catch (const std::runtime_error&) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    stop();
+                    throw std::runtime_error("server on port " + std::to_string(port_) + " didn't start");
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    }
+    ServerProcess(const ServerProcess&) = delete;
+    ServerProcess& operator=(const ServerProcess&) = delete;
+    ~ServerProcess() { stop(); }
+
+    int port() const { return port_; }
+    pid_t pid() const { return pid_; }
+
+    void stop() {
+        if (pid_ <= 0) return;
+        kill(pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+private:
+    int port_;
+    pid_t pid_ = -1;
+};
+
+// Poll until check() holds or timeout passes, returning whether it held
+template <typename F>
+bool eventually(F&& check, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!check()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+// Value of field in an INFO reply, empty if absent
+inline std::string info_field(const std::string& info, const std::string& field) {
+    size_t at = info.find("\r\n" + field + ":");
+    if (at == std::string::npos) return "";
+    at += field.size() + 3;
+    return info.substr(at, info.find("\r\n", at) - at);
+}